@@ -0,0 +1,45 @@
+cbuffer VSSharedConstants : register(b0)
+{
+    matrix projMat;
+    matrix viewMat;
+    matrix mvpMat;
+};
+
+struct BasicVertex
+{
+    float3 pos : POSITION;
+    float3 nrm : NORMAL;
+    float4 col : COLOUR;
+};
+
+// Object to world, as the rows of an affine 3x4 matrix; see MeshInstanceTransform.
+struct MeshInstance
+{
+    float4 row0 : TRANSFORM0;
+    float4 row1 : TRANSFORM1;
+    float4 row2 : TRANSFORM2;
+};
+
+struct VertexShaderOutput
+{
+    float3 worldPos : POSITION;
+    float3 nrm : NORMAL;
+    float4 col : COLOUR;
+    float4 pos : SV_Position;
+};
+
+VertexShaderOutput main(BasicVertex IN, MeshInstance INSTANCE)
+{
+    VertexShaderOutput OUT;
+
+    float3x4 transform = float3x4(INSTANCE.row0, INSTANCE.row1, INSTANCE.row2);
+    float3 worldPos = mul(transform, float4(IN.pos, 1.0));
+    OUT.pos = mul(mvpMat, float4(worldPos, 1.0));
+
+    // Fine for uniform scales; a non-uniform one would need the inverse transpose.
+    OUT.worldPos = worldPos;
+    OUT.nrm = normalize(mul((float3x3)transform, IN.nrm));
+    OUT.col = IN.col;
+
+    return OUT;
+}
@@ -0,0 +1,22 @@
+// Clip level selection, shared by the hull and domain shaders. Expects ClipmapUVOffset, InvTextureRes and NumClipLevels from TerrainPSConstantBuffer.
+
+// Clip level to sample a (level 0) UV from, with the fraction being how far to blend into the next level.
+float CalcClipLevelBlend(float2 uv)
+{
+    // Translate the UV relative to our offset, i.e. get the UV distance from the current clipmap centre.
+    // Then get the maximum absolute coordinate to pick a clipmap level and scale down.
+    float2 offsetUV = uv - ClipmapUVOffset;
+    float maxCoord = max(abs(offsetUV.x), abs(offsetUV.y));
+    float logMaxCoord = log2(4.0 * maxCoord);
+
+    // We need to leave a few texels of border (on each side, hence * 2) for a few reasons:
+    // 1. One because the upload is clamped to the nearest integer texel.
+    // 2. One to prevent sampling interpolating across the wrap boundary.
+    // 3. I have no idea why it needs more than 2 after quite some time of looking, but 3 does the trick. Possibly an off-by-one error somewhere.
+    // (4). Should probably add at least one more to prevent thrashing if the camera jitters on a boundary at all.
+    // However the blend between levels mostly gets rid of this anyway so it's kinda moot.
+    logMaxCoord += 3.0 * 2.0 * InvTextureRes;
+    
+    // Clamp logMaxCoord to both limit clipLevel and prevent blending with the NumClipLevel'th level.
+    return clamp(logMaxCoord, 0.0, (float)(NumClipLevels - 1));
+}
@@ -8,15 +8,27 @@ cbuffer ComputeNormalsConstants : register(b0)
 {
     int2 UVMin;
     float WorldTexelSizeTimes8;
+    int TextureMask; // Texture dimension - 1; clipmap textures are always a power of 2.
 }
 
-static const int TextureDimension = 256; // Hardcoded for efficiency. Keep in sync with TerrainConstants.hpp
 Texture2D<float> SrcHeightMap : register(t0);
-RWTexture2D<float3> OutNormalMap : register(u0);
+RWTexture2D<float2> OutNormalMap : register(u0);
+
+// Octahedral encoding folded around +Y, so terrain normals never reach the fold. Must match EncodeOctahedral() in TerrainEncoding.cpp.
+float2 EncodeOctahedral(float3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    float2 encoded = n.xz;
+    if (n.y < 0.0)
+    {
+        encoded = (1.0 - abs(n.zx)) * (n.xz >= 0.0 ? 1.0 : -1.0);
+    }
+    return encoded;
+}
 
 #define ComputeNormals_RootSignature                  \
     "RootFlags(0), "                                  \
-    "RootConstants(b0, num32BitConstants = 5),"       \
+    "RootConstants(b0, num32BitConstants = 4),"       \
     "DescriptorTable(SRV(t0, numDescriptors = 1)),"   \
     "DescriptorTable(UAV(u0, numDescriptors = 1)),"
 
@@ -36,19 +48,19 @@ void main(ComputeShaderInput IN)
     int2 h = coords + int2(-1, 0);
     int2 i = coords + int2(-1, -1);
     
-    float zb = SrcHeightMap.Load(int3(b & (TextureDimension - 1), 0), 0);
-    float zc = SrcHeightMap.Load(int3(c & (TextureDimension - 1), 0), 0);
-    float zd = SrcHeightMap.Load(int3(d & (TextureDimension - 1), 0), 0);
-    float ze = SrcHeightMap.Load(int3(e & (TextureDimension - 1), 0), 0);
-    float zf = SrcHeightMap.Load(int3(f & (TextureDimension - 1), 0), 0);
-    float zg = SrcHeightMap.Load(int3(g & (TextureDimension - 1), 0), 0);
-    float zh = SrcHeightMap.Load(int3(h & (TextureDimension - 1), 0), 0);
-    float zi = SrcHeightMap.Load(int3(i & (TextureDimension - 1), 0), 0);
+    float zb = SrcHeightMap.Load(int3(b & TextureMask, 0), 0);
+    float zc = SrcHeightMap.Load(int3(c & TextureMask, 0), 0);
+    float zd = SrcHeightMap.Load(int3(d & TextureMask, 0), 0);
+    float ze = SrcHeightMap.Load(int3(e & TextureMask, 0), 0);
+    float zf = SrcHeightMap.Load(int3(f & TextureMask, 0), 0);
+    float zg = SrcHeightMap.Load(int3(g & TextureMask, 0), 0);
+    float zh = SrcHeightMap.Load(int3(h & TextureMask, 0), 0);
+    float zi = SrcHeightMap.Load(int3(i & TextureMask, 0), 0);
 
     float nx = zg + 2.0 * zh + zi - zc - 2.0 * zd - ze;
     float ny = WorldTexelSizeTimes8;
     float nz = 2.0 * zb + zc + zi - ze - 2.0 * zf - zg;
 
     float3 normal = normalize(float3(nx, ny, nz));
-    OutNormalMap[coords & (TextureDimension - 1)] = normal;
+    OutNormalMap[coords & TextureMask] = EncodeOctahedral(normal);
 }
@@ -6,19 +6,30 @@ cbuffer VSSharedConstants : register(b0)
     matrix viewMat;
     matrix projMat;
     matrix mvpMat;
-    matrix sunShadowMvpMat;
 };
 
+static const int MaxClipLevels = 8; // Keep in sync with ClipmapConfig.hpp. The actual number of levels is NumClipLevels.
+
 cbuffer TerrainPSConstantBuffer : register(b2)
 {
     float2 HighlightPosXZ;
     float2 ClipmapUVOffset;
     float HighlightRadiusSq;
+    float InvTextureRes;
+    float TexelSize;
+    int NumClipLevels;
+    float4 HeightScaleBias[4];          // Height range of each clip level as (scale, bias), two levels per element.
+    float4 RingBounds[MaxClipLevels];   // Outer edge of each ring level that meets a coarser one, in level 0 patches, as (min x, min z, max x, max z).
+    float VertexPatchSize;              // World size of a level 0 patch.
 };
+
+#include "TerrainClipLevels.hlsl"
+#include "TerrainRings.hlsl"
  
 struct HullShaderControlPointOutput
 {
-    float2 pos : POSITION0;
+    float2 pos : POSITION0; // In level 0 patches.
+    uint level : LEVEL;
 };
  
 struct HullShaderConstantOutput
@@ -27,12 +38,8 @@ struct HullShaderConstantOutput
     float InsideTessFactor[2]   : SV_InsideTessFactor;
 };
 
-static const int NumClipLevels = 8;
-static const int HeightmapSize = 256;
-static const float InvTextureRes = 1.0 / (float)HeightmapSize;
-static const float HalfTexel = 0.5 * InvTextureRes;
-Texture2D HeightmapTex[NumClipLevels] : register(t0);
-Texture2D NormalMapTex[NumClipLevels] : register(t8);
+Texture2D HeightmapTex[MaxClipLevels] : register(t0);
+Texture2D NormalMapTex[MaxClipLevels] : register(t8);
 SamplerState HeightmapSampler : register(s2); 
 
 struct DomainShaderOutput
@@ -41,11 +48,19 @@ struct DomainShaderOutput
     float3 worldPos : POSITION;
     float3 nrm : NORMAL;
     float3 tangent : TANGENT;
-    float4 shadowPos : SHADOWPOS;
 #endif
     float4 pos : SV_POSITION;
 };
 
+// Must match DecodeOctahedral() in TerrainEncoding.cpp.
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 n = float3(encoded.x, 1.0 - abs(encoded.x) - abs(encoded.y), encoded.y);
+    float t = saturate(-n.y);
+    n.xz += (n.xz >= 0.0) ? -t : t;
+    return normalize(n);
+}
+
 float4 SampleSingleLevel(Texture2D maps[], float2 uv, int clipLevel)
 {
     // Scale down for the density of this level.
@@ -76,52 +91,102 @@ float4 SampleBlended(Texture2D maps[], float2 uv, int clipLevel, float blendFact
     }
 }
 
+float2 GetHeightScaleBias(int clipLevel)
+{
+    float4 scaleBias = HeightScaleBias[clipLevel >> 1];
+    return (clipLevel & 1) ? scaleBias.zw : scaleBias.xy;
+}
+
+float SampleHeightSingleLevel(float2 uv, int clipLevel)
+{
+    // Heights may be stored normalised with a range per level, so decode before blending between levels.
+    float2 scaleBias = GetHeightScaleBias(clipLevel);
+    return SampleSingleLevel(HeightmapTex, uv, clipLevel).r * scaleBias.x + scaleBias.y;
+}
+
+float SampleHeightBlended(float2 uv, int clipLevel, float blendFactor)
+{
+    float h0 = SampleHeightSingleLevel(uv, clipLevel);
+
+    // Same as SampleBlended().
+    float t = fmod(blendFactor, 1.0);
+    if (t < 0.5)
+    {
+        return h0;
+    }
+    else
+    {
+        float h1 = SampleHeightSingleLevel(uv, clipLevel + 1);
+        t = saturate(2.0 * (t - 0.5));
+        return lerp(h0, h1, t);
+    }
+}
+
+float SampleHeightAt(float2 patchPos)
+{
+    float2 uv = patchPos * VertexPatchSize * InvTextureRes / TexelSize;
+    float logMaxCoord = CalcClipLevelBlend(uv);
+    return SampleHeightBlended(uv, (int)logMaxCoord, logMaxCoord);
+}
+
+// Height of a point on the outer edge of a ring level, on the line between the coarser level's vertices either side of it, so the two levels
+// meet without cracks. The coarser edge is split into as many segments as the factor (see CalcEdgeTessFactor() in TerrainHull.hlsl).
+float CalcSeamHeight(float2 patchPos, float2 coarseA, float2 coarseB, float factor)
+{
+    float t = factor * distance(coarseA, patchPos) / distance(coarseA, coarseB);
+    float segment = min(floor(t), factor - 1.0);
+    float h0 = SampleHeightAt(lerp(coarseA, coarseB, segment / factor));
+    float h1 = SampleHeightAt(lerp(coarseA, coarseB, (segment + 1.0) / factor));
+    return lerp(h0, h1, t - segment);
+}
+
 [domain("quad")]
 DomainShaderOutput main(HullShaderConstantOutput input, float2 domain : SV_DomainLocation, OutputPatch<HullShaderControlPointOutput, 2> patch)
 {
     DomainShaderOutput OUT;
 
-    const float CellSize = 0.05;
-
     // Bilinearly interpolate within the AABB we were passed.
-    float2 pos2D = lerp(patch[0].pos, patch[1].pos, domain);
+    float2 patchPos = lerp(patch[0].pos, patch[1].pos, domain);
+    float2 pos2D = patchPos * VertexPatchSize;
  
     // Get global heightmap coordinates (relative to the first clip level).
     // TODO: Also shift by another half a texel?
-    float2 uv = pos2D * InvTextureRes / CellSize;
-
-    // Translate the UV relative to our offset, i.e. get the UV distance from the current clipmap centre.
-    // Then get the maximum absolute coordinate to pick a clipmap level and scale down.
-    float2 offsetUV = uv - ClipmapUVOffset;
-    float maxCoord = max(abs(offsetUV.x), abs(offsetUV.y));
-    float logMaxCoord = log2(4.0 * maxCoord);
-
-    // We need to leave a few texels of border (on each side, hence * 2) for a few reasons:
-    // 1. One because the upload is clamped to the nearest integer texel.
-    // 2. One to prevent sampling interpolating across the wrap boundary.
-    // 3. I have no idea why it needs more than 2 after quite some time of looking, but 3 does the trick. Possibly an off-by-one error somewhere.
-    // (4). Should probably add at least one more to prevent thrashing if the camera jitters on a boundary at all.
-    // However the blend between levels mostly gets rid of this anyway so it's kinda moot.
-    logMaxCoord += 3.0 * 2.0 * InvTextureRes;
-    
-    // Clamp logMaxCoord to both limit clipLevel and prevent blending with the NumClipLevel'th level.
-    logMaxCoord = clamp(logMaxCoord, 0.0, (float)(NumClipLevels - 1));
+    float2 uv = pos2D * InvTextureRes / TexelSize;
+    float logMaxCoord = CalcClipLevelBlend(uv);
     int clipLevel = (int)logMaxCoord;
 
     // Lookup height and normal.
-    float height = SampleBlended(HeightmapTex, uv, clipLevel, logMaxCoord).r;
+    float height = SampleHeightBlended(uv, clipLevel, logMaxCoord);
+
+    // Edges are numbered like EdgeTessFactor: u == 0, v == 0, u == 1, v == 1. Corners on two seam edges are corners of the coarser
+    // level too, where either edge gives the same height.
+    float2 lo = patch[0].pos;
+    float2 hi = patch[1].pos;
+    float2 edgeStarts[4] = { lo, lo, float2(hi.x, lo.y), float2(lo.x, hi.y) };
+    float2 edgeEnds[4] = { float2(lo.x, hi.y), float2(hi.x, lo.y), hi, hi };
+    bool onEdge[4] = { domain.x == 0.0, domain.y == 0.0, domain.x == 1.0, domain.y == 1.0 };
+    [unroll]
+    for (int edge = 0; edge < 4; ++edge)
+    {
+        if (onEdge[edge] && IsOnLevelEdge(edgeStarts[edge], edgeEnds[edge], patch[0].level))
+        {
+            float2 coarseA, coarseB;
+            GetCoarserEdge(edgeStarts[edge], edgeEnds[edge], coarseA, coarseB);
+            height = CalcSeamHeight(patchPos, coarseA, coarseB, input.EdgeTessFactor[edge]);
+        }
+    }
+
     float3 worldPos = float3(pos2D.x, height, pos2D.y);
     OUT.pos = mul(projMat, mul(viewMat, float4(worldPos, 1.0)));
 
 #ifndef SHADOW_PASS
     OUT.worldPos = worldPos;
-    OUT.nrm = SampleBlended(NormalMapTex, uv, clipLevel, logMaxCoord).rgb;
+    // Normals are octahedral encoded; the encoding is continuous over the upper hemisphere so it's fine to filter and blend before decoding.
+    OUT.nrm = DecodeOctahedral(SampleBlended(NormalMapTex, uv, clipLevel, logMaxCoord).rg);
 
     // Calculate tangent, always in XY plane (assuming normal has nonzero Y component).
     // Approximately, T = X, B = Z, N = Y
     OUT.tangent = cross(OUT.nrm, float3(0.0, 0.0, 1.0));
-
-    OUT.shadowPos = mul(sunShadowMvpMat, float4(worldPos, 1.0));
 #endif
 
     return OUT;
@@ -4,31 +4,120 @@ cbuffer PSSharedConstants : register(b1)
     float3 SunDirection;
 };
 
+static const int MaxClipLevels = 8; // Keep in sync with ClipmapConfig.hpp.
+
+cbuffer TerrainPSConstantBuffer : register(b2)
+{
+    float2 HighlightPosXZ;
+    float2 ClipmapUVOffset;
+    float HighlightRadiusSq;
+    float InvTextureRes;
+    float TexelSize;
+    int NumClipLevels;
+    float4 HeightScaleBias[4];          // Height range of each clip level as (scale, bias), two levels per element.
+    float4 RingBounds[MaxClipLevels];   // Outer edge of each ring level that meets a coarser one, in level 0 patches, as (min x, min z, max x, max z).
+    float VertexPatchSize;              // World size of a level 0 patch.
+    float ScreenErrorScale;             // Pixels per metre at a distance of 1m, over the target error in pixels. 0 to tessellate by distance alone.
+    int RoughnessNodes;                 // Along each side of the finest level of each clip level's roughness pyramid.
+    int RoughnessCellTexels;            // Along each side of the cells of those.
+};
+
+#include "TerrainClipLevels.hlsl"
+#include "TerrainRings.hlsl"
+
+StructuredBuffer<float> Roughness : register(t0); // Every clip level's RoughnessPyramid nodes, one level after another.
+
 struct VertexShaderOutput
 {
-    float2 pos : POSITION;
+    float2 pos : POSITION; // In level 0 patches.
+    uint level : LEVEL;
 };
 
 struct HullShaderControlPointOutput
 {
     float2 pos : POSITION;
+    uint level : LEVEL;
 };
- 
+
 struct HullShaderConstantOutput
 {
     float EdgeTessFactor[4]     : SV_TessFactor;
     float InsideTessFactor[2]   : SV_InsideTessFactor;
 };
- 
+
 typedef InputPatch<VertexShaderOutput, 4> InPatch;
 
-float CalcTessFactor(float2 pos)
+// Max deviation from bilinear of the roughness cells under a square, in level 0 patches, in the clip level drawn at its centre.
+// The same lookup as RoughnessPyramid::Query(). Also gives the world size of the level's cells.
+float SampleRoughness(float2 centre, float halfSize, out float cellSize)
 {
-    // Scale from 1-64 exponentially over the range 1m-512m.
-    const float MinDist = 1.0;
-    const float MaxDist = 512.0;
-    float dist = distance(CamPos, float3(pos.x, 0.0, pos.y));
-    return clamp(MaxDist / dist, 1.0, 64.0);
+    float2 uv = centre * VertexPatchSize * InvTextureRes / TexelSize;
+    int clipLevel = (int)CalcClipLevelBlend(uv);
+    float levelScale = (float)(1 << clipLevel);
+    cellSize = RoughnessCellTexels * TexelSize * levelScale;
+
+    // Texels filtering can read for points in the square, like Terrain::CalcLevelRegionHeightBounds().
+    float halfTexels = halfSize * VertexPatchSize / (TexelSize * levelScale);
+    float2 texelCentre = (uv / levelScale + 0.5) / InvTextureRes - 0.5;
+    int2 texelMin = (int2)floor(texelCentre - halfTexels);
+    int2 texelMax = (int2)floor(texelCentre + halfTexels) + 2; // Exclusive.
+
+    // The first level of the pyramid whose nodes are at least as big as the square, so it touches no more than 2x2 of them.
+    int extentCells = (max(texelMax.x - texelMin.x, texelMax.y - texelMin.y) + RoughnessCellTexels - 1) / RoughnessCellTexels;
+    int level = min(extentCells > 1 ? firstbithigh(extentCells - 1) + 1 : 0, firstbithigh(RoughnessNodes));
+    int levelNodes = RoughnessNodes >> level;
+    int offset = clipLevel * (4 * RoughnessNodes * RoughnessNodes - 1) / 3 + 4 * (RoughnessNodes * RoughnessNodes - levelNodes * levelNodes) / 3;
+    int shift = firstbithigh(RoughnessCellTexels) + level;
+    int2 nodeMin = texelMin >> shift;
+    int2 nodeMax = min((texelMax - 1) >> shift, nodeMin + 1);
+
+    float roughness = 0.0;
+    [unroll]
+    for (int i = 0; i < 4; ++i)
+    {
+        int2 node = min(nodeMin + int2(i & 1, i >> 1), nodeMax) & (levelNodes - 1);
+        roughness = max(roughness, Roughness[offset + levelNodes * node.y + node.x]);
+    }
+    return roughness;
+}
+
+float CalcTessFactor(float2 pos, float edgeLength)
+{
+    float2 worldPos = pos * VertexPatchSize;
+    float dist = distance(CamPos, float3(worldPos.x, 0.0, worldPos.y));
+    if (ScreenErrorScale <= 0.0)
+    {
+        // Scale from 1-64 exponentially over the range 1m-512m, for a level 0 patch. Bigger patches get proportionally more.
+        const float MaxDist = 512.0;
+        return clamp(MaxDist * edgeLength / dist, 1.0, 64.0);
+    }
+
+    // Screen-space error: a cell of size s that's e off bilinear curves by about 8e / s^2, so triangles of size h miss the ground by
+    // about e * (h / s)^2. Pick h so that's the target error on screen. Flat ground gets a single quad, whatever the distance.
+    float cellSize;
+    float roughness = SampleRoughness(pos, 0.5 * edgeLength, cellSize);
+    float factor = (edgeLength * VertexPatchSize / cellSize) * sqrt(roughness * ScreenErrorScale / max(dist, 1.0));
+    return clamp(factor, 1.0, 64.0);
+}
+
+float CalcEdgeTessFactor(float2 a, float2 b, uint level)
+{
+    // Edges on a seam between ring levels are tessellated the same from both sides, from the coarser level's edge.
+    float2 coarseA, coarseB;
+    if (level > 0 && IsOnLevelEdge(a, b, level - 1))
+    {
+        coarseA = min(a, b);
+        coarseB = max(a, b);
+    }
+    else if (IsOnLevelEdge(a, b, level))
+    {
+        GetCoarserEdge(a, b, coarseA, coarseB);
+    }
+    else
+    {
+        return CalcTessFactor(lerp(a, b, 0.5), distance(a, b));
+    }
+    return ToSeamTessFactor(CalcTessFactor(lerp(coarseA, coarseB, 0.5), distance(coarseA, coarseB)));
 }
 
 // Patch Constant Function
@@ -36,26 +125,22 @@ HullShaderConstantOutput CalcHSPatchConstants(InPatch ip, uint PatchID : SV_Prim
 {
     HullShaderConstantOutput output;
 
-    // Get the midpoint of each edge to find the tesselation factor for that edge.
-    // Could also improve this by sampling the heightmap here too to get a better idea of screen coverage.
-    float2 edge0 = (ip[0].pos + ip[2].pos) * 0.5;
-    float2 edge1 = lerp(ip[0].pos, ip[1].pos, 0.5); // For some reason if this is 0.5 * (a + b), it ends up at the centre of the patch. Compiler bug?
-    float2 edge2 = (ip[1].pos + ip[3].pos) * 0.5;
-    float2 edge3 = (ip[2].pos + ip[3].pos) * 0.5;
-    float2 centre = (ip[0].pos + ip[1].pos + ip[2].pos + ip[3].pos) * 0.25;
+    // Use the midpoint of each edge to find the tesselation factor for that edge. The roughness around an edge is looked up from a
+    // square centred on it, so the patches either side agree on its factor.
+    uint level = ip[0].level;
+    output.EdgeTessFactor[0] = CalcEdgeTessFactor(ip[0].pos, ip[2].pos, level);
+    output.EdgeTessFactor[1] = CalcEdgeTessFactor(ip[0].pos, ip[1].pos, level);
+    output.EdgeTessFactor[2] = CalcEdgeTessFactor(ip[1].pos, ip[3].pos, level);
+    output.EdgeTessFactor[3] = CalcEdgeTessFactor(ip[2].pos, ip[3].pos, level);
 
-    output.EdgeTessFactor[0] = CalcTessFactor(edge0);
-    output.EdgeTessFactor[1] = CalcTessFactor(edge1);
-    output.EdgeTessFactor[2] = CalcTessFactor(edge2);
-    output.EdgeTessFactor[3] = CalcTessFactor(edge3);
-    
-    float centreFactor = CalcTessFactor(centre);
+    float2 centre = (ip[0].pos + ip[1].pos + ip[2].pos + ip[3].pos) * 0.25;
+    float centreFactor = CalcTessFactor(centre, distance(ip[0].pos, ip[1].pos));
     output.InsideTessFactor[0] = centreFactor;
     output.InsideTessFactor[1] = centreFactor;
- 
+
     return output;
 }
- 
+
 [domain("quad")]
 [partitioning("fractional_odd")]
 [outputtopology("triangle_ccw")]
@@ -64,10 +149,11 @@ HullShaderConstantOutput CalcHSPatchConstants(InPatch ip, uint PatchID : SV_Prim
 HullShaderControlPointOutput main(InPatch ip, uint i : SV_OutputControlPointID, uint PatchID : SV_PrimitiveID)
 {
     HullShaderControlPointOutput output;
- 
+
     // Output the AABB of the patch as a min/max pair.
     float2 candidates[2] = { ip[0].pos, ip[3].pos };
     output.pos = candidates[i];
- 
+    output.level = ip[0].level;
+
     return output;
 }
@@ -1,3 +1,15 @@
+static const int MaxShadowCascades = 4; // Keep in sync with ShadowCascades.hpp.
+
+cbuffer VSSharedConstants : register(b0)
+{
+    matrix viewMat;
+    matrix projMat;
+    matrix mvpMat;
+    matrix SunShadowMats[MaxShadowCascades];   // World to shadow map texture coords and (biased) depth, per cascade.
+    float4 SunShadowSpheres[MaxShadowCascades]; // Where each cascade can be used, as (centre, radius squared).
+    int NumShadowCascades;
+};
+
 cbuffer PSSharedConstants : register(b1)
 {
     float3 CamPos;
@@ -9,6 +21,10 @@ cbuffer TerrainPSConstantBuffer : register(b2)
     float2 HighlightPosXZ;
     float2 ClipmapUVOffset;
     float HighlightRadiusSq;
+    float InvTextureRes;
+    float TexelSize;
+    int NumClipLevels;
+    float4 HeightScaleBias[4]; // Height range of each clip level as (scale, bias), two levels per element.
 };
 
 Texture2D DiffuseTex0 : register(t0);
@@ -24,9 +40,23 @@ struct DomainShaderOutput
     float3 worldPos : POSITION;
     float3 nrm : NORMAL;
     float3 tangent : TANGENT;
-    float4 shadowPos : SHADOWPOS;
 };
 
+float CalcSunShadow(float3 worldPos)
+{
+    // Use the first (i.e. finest) cascade whose sphere the point is in. Past the last one, everything's lit.
+    for (int i = 0; i < NumShadowCascades; ++i)
+    {
+        float3 offset = worldPos - SunShadowSpheres[i].xyz;
+        if (dot(offset, offset) < SunShadowSpheres[i].w)
+        {
+            float3 shadowCoords = mul(SunShadowMats[i], float4(worldPos, 1.0)).xyz;
+            return SunShadowMap.SampleCmp(ShadowSampler, shadowCoords.xy, min(shadowCoords.z, 1.0)).r;
+        }
+    }
+    return 1.0;
+}
+
 float4 main(DomainShaderOutput IN) : SV_Target
 {
     float2 uv = IN.worldPos.xz * 0.15;
@@ -59,16 +89,8 @@ float4 main(DomainShaderOutput IN) : SV_Target
     float3 ambient = 0.1 * albedo;
     float3 diffuse = 0.85 * ndotl * albedo;
 
-    // Transform shadow pos from clip space [-1, 1] to texture space [0, 1] (depth is already [0, 1])
-    float3 lightSpaceCoords = (IN.shadowPos.xyz / IN.shadowPos.w);
-    lightSpaceCoords.x =  lightSpaceCoords.x * 0.5 + 0.5;
-    lightSpaceCoords.y = -lightSpaceCoords.y * 0.5 + 0.5;
-    
     // Sample shadow map to occlude diffuse light.
-    float pixelShadowDepth = min(lightSpaceCoords.z, 1.0); // Clamp depth to the range of the shadowmap
-    float bias = 0.005;
-    float shadowFactor = SunShadowMap.SampleCmp(ShadowSampler, lightSpaceCoords.xy, pixelShadowDepth - bias).r;        
-    diffuse *= shadowFactor;
+    diffuse *= CalcSunShadow(IN.worldPos);
     
     // Selection highlight
     float2 highlightOffset = IN.worldPos.xz - HighlightPosXZ;
@@ -0,0 +1,28 @@
+// Helpers for the seams between clipmap ring levels, shared by the hull and domain shaders.
+// Expects RingBounds from TerrainPSConstantBuffer. Positions are in level 0 vertex patches, where everything is a whole number.
+
+// Whether the edge from a to b runs along the outer edge of a ring level.
+bool IsOnLevelEdge(float2 a, float2 b, uint level)
+{
+    float4 bounds = RingBounds[level];
+    bool alongZ = a.x == b.x && (a.x == bounds.x || a.x == bounds.z) && min(a.y, b.y) >= bounds.y && max(a.y, b.y) <= bounds.w;
+    bool alongX = a.y == b.y && (a.y == bounds.y || a.y == bounds.w) && min(a.x, b.x) >= bounds.x && max(a.x, b.x) <= bounds.z;
+    return alongZ || alongX;
+}
+
+// The edge of the next level's patch that a patch edge along its level's outer edge lies on. Levels start on whole coarser patches.
+void GetCoarserEdge(float2 a, float2 b, out float2 coarseA, out float2 coarseB)
+{
+    float2 along = (a.x == b.x) ? float2(0.0, 1.0) : float2(1.0, 0.0);
+    float coarseSize = 2.0 * distance(a, b);
+    coarseA = min(a, b);
+    coarseA -= along * (dot(coarseA, along) - floor(dot(coarseA, along) / coarseSize) * coarseSize);
+    coarseB = coarseA + along * coarseSize;
+}
+
+// With fractional_odd partitioning, only odd whole number factors split an edge into equal segments. Splitting both halves of a
+// coarse edge by the coarse edge's factor then puts a fine vertex on every coarse one, and one more in the middle of each coarse segment.
+float ToSeamTessFactor(float factor)
+{
+    return min(2.0 * floor(0.5 * factor) + 1.0, 63.0);
+}
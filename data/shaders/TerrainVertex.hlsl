@@ -1,17 +1,20 @@
 struct Vertex
 {
-    float2 pos : POSITION;
+    float2 pos : POSITION;      // In the piece's own patches.
+    float4 instance : INSTANCE; // Where the piece goes, as (offset x, offset z, patch size, ring level), in level 0 patches.
 };
 
 struct VertexShaderOutput
 {
-    float2 pos : POSITION;
+    float2 pos : POSITION; // In level 0 patches.
+    uint level : LEVEL;
 };
 
- 
+
 VertexShaderOutput main(Vertex IN)
 {
     VertexShaderOutput OUT;
-    OUT.pos = IN.pos; 
+    OUT.pos = IN.pos * IN.instance.z + IN.instance.xy;
+    OUT.level = (uint)IN.instance.w;
     return OUT;
 }
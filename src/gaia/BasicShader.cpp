@@ -7,11 +7,13 @@ namespace gaia
 bool BasicShader::Init(Renderer& renderer)
 {
     ComPtr<ID3DBlob> vertexShader = renderer.LoadCompiledShader(L"BasicVertex.cso");
+    ComPtr<ID3DBlob> instancedVertexShader = renderer.LoadCompiledShader(L"BasicInstancedVertex.cso");
     ComPtr<ID3DBlob> pixelShader = renderer.LoadCompiledShader(L"BasicPixel.cso");
-    if (!(vertexShader && pixelShader))
+    if (!(vertexShader && instancedVertexShader && pixelShader))
         return false;
 
-    return CreatePipelineState(renderer, vertexShader.Get(), pixelShader.Get());
+    return CreatePipelineState(renderer, vertexShader.Get(), pixelShader.Get(), false, m_pipelineState)
+        && CreatePipelineState(renderer, instancedVertexShader.Get(), pixelShader.Get(), true, m_instancedPipelineState);
 }
 
 void BasicShader::Bind(Renderer& renderer)
@@ -20,7 +22,13 @@ void BasicShader::Bind(Renderer& renderer)
     commandList.SetPipelineState(m_pipelineState.Get());
 }
 
-bool BasicShader::CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader, ID3DBlob* pixelShader)
+void BasicShader::BindInstanced(Renderer& renderer)
+{
+    ID3D12GraphicsCommandList& commandList = renderer.GetDirectCommandList();
+    commandList.SetPipelineState(m_instancedPipelineState.Get());
+}
+
+bool BasicShader::CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader, ID3DBlob* pixelShader, bool instanced, ComPtr<ID3D12PipelineState>& outPipelineState)
 {
     struct PipelineStateStream
     {
@@ -37,8 +45,12 @@ bool BasicShader::CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader
     D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
         { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "COLOUR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+        { "COLOUR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "TRANSFORM", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "TRANSFORM", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+        { "TRANSFORM", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
     };
+    const UINT numInputElements = instanced ? (UINT)std::size(inputLayout) : 3; // The instanced pipeline also reads the transform.
 
     D3D12_RT_FORMAT_ARRAY rtvFormats = {};
     rtvFormats.NumRenderTargets = 1;
@@ -46,7 +58,7 @@ bool BasicShader::CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader
 
     PipelineStateStream pipelineStateStream;
     pipelineStateStream.rootSignature = &renderer.GetRootSignature();
-    pipelineStateStream.inputLayout = { inputLayout, (UINT)std::size(inputLayout) };
+    pipelineStateStream.inputLayout = { inputLayout, numInputElements };
     pipelineStateStream.primType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
     pipelineStateStream.vs = CD3DX12_SHADER_BYTECODE(vertexShader);
     pipelineStateStream.ps = CD3DX12_SHADER_BYTECODE(pixelShader);
@@ -55,7 +67,7 @@ bool BasicShader::CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader
     ((CD3DX12_RASTERIZER_DESC&)pipelineStateStream.rasterizer).FrontCounterClockwise = true;
 
     D3D12_PIPELINE_STATE_STREAM_DESC pipelineStateStreamDesc = { sizeof(PipelineStateStream), &pipelineStateStream };
-    if (FAILED(renderer.GetDevice().CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&m_pipelineState))))
+    if (FAILED(renderer.GetDevice().CreatePipelineState(&pipelineStateStreamDesc, IID_PPV_ARGS(&outPipelineState))))
     {
         DebugOut("Failed to create BasicShader pipeline state object!\n");
         return false;
@@ -18,10 +18,14 @@ public:
     bool Init(Renderer& renderer);
     void Bind(Renderer& renderer);
 
+    // For StaticMesh::RenderInstanced(), with a MeshInstanceTransform per instance.
+    void BindInstanced(Renderer& renderer);
+
 private:
-    bool CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader, ID3DBlob* pixelShader);
+    bool CreatePipelineState(Renderer& renderer, ID3DBlob* vertexShader, ID3DBlob* pixelShader, bool instanced, ComPtr<ID3D12PipelineState>& outPipelineState);
 
     ComPtr<ID3D12PipelineState> m_pipelineState;
+    ComPtr<ID3D12PipelineState> m_instancedPipelineState;
 };
 
 }
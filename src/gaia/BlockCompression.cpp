@@ -0,0 +1,266 @@
+#include "BlockCompression.hpp"
+
+namespace gaia
+{
+
+static constexpr int BlockTexels = BlockDimension * BlockDimension;
+
+// Endpoints are stored as integers; -128 is never written since it decodes the same as -127.
+struct EndpointRange
+{
+    int min;
+    int max;
+    float scale; // Endpoint units per unit of texel value.
+};
+
+static EndpointRange GetEndpointRange(bool isSigned)
+{
+    return isSigned ? EndpointRange{ -127, 127, 127.f } : EndpointRange{ 0, 255, 255.f };
+}
+
+// Values in endpoint units for each index. red0 > red1 selects 8 interpolated values, otherwise 6 plus the format's extremes.
+static void MakePalette(int red0, int red1, const EndpointRange& range, float (&palette)[8])
+{
+    palette[0] = (float)red0;
+    palette[1] = (float)red1;
+    if (red0 > red1)
+    {
+        for (int i = 2; i < 8; ++i)
+        {
+            palette[i] = (float)((8 - i) * red0 + (i - 1) * red1) / 7.f;
+        }
+    }
+    else
+    {
+        for (int i = 2; i < 6; ++i)
+        {
+            palette[i] = (float)((6 - i) * red0 + (i - 1) * red1) / 5.f;
+        }
+        palette[6] = (float)range.min;
+        palette[7] = (float)range.max;
+    }
+}
+
+// Picks the nearest palette entry for each value and returns the total squared error (in endpoint units).
+static float FitIndices(const float (&values)[BlockTexels], int red0, int red1, const EndpointRange& range, uint8 (&indices)[BlockTexels])
+{
+    float palette[8];
+    MakePalette(red0, red1, range, palette);
+
+    float error = 0.f;
+    for (int i = 0; i < BlockTexels; ++i)
+    {
+        float bestError = FLT_MAX;
+        for (int index = 0; index < 8; ++index)
+        {
+            float e = math::Square(values[i] - palette[index]);
+            if (e < bestError)
+            {
+                bestError = e;
+                indices[i] = (uint8)index;
+            }
+        }
+        error += bestError;
+    }
+    return error;
+}
+
+// Least squares endpoints for the current (8 value mode) indices, i.e. minimising the error if the indices stay the same.
+static void RefineEndpoints(const float (&values)[BlockTexels], const uint8 (&indices)[BlockTexels], const EndpointRange& range, int& red0, int& red1)
+{
+    // Each texel is w * red0 + (1 - w) * red1; solve the 2x2 normal equations for red0 and red1.
+    float aa = 0.f, ab = 0.f, bb = 0.f, av = 0.f, bv = 0.f;
+    for (int i = 0; i < BlockTexels; ++i)
+    {
+        float w = indices[i] == 0 ? 1.f : indices[i] == 1 ? 0.f : (float)(8 - indices[i]) / 7.f;
+        aa += w * w;
+        ab += w * (1.f - w);
+        bb += (1.f - w) * (1.f - w);
+        av += w * values[i];
+        bv += (1.f - w) * values[i];
+    }
+
+    float det = aa * bb - ab * ab;
+    if (fabsf(det) < 1e-6f)
+        return;
+
+    red0 = math::clamp((int)lroundf((av * bb - bv * ab) / det), range.min, range.max);
+    red1 = math::clamp((int)lroundf((bv * aa - av * ab) / det), range.min, range.max);
+}
+
+static void WriteBC4Block(int red0, int red1, const uint8 (&indices)[BlockTexels], uint8* block)
+{
+    block[0] = (uint8)red0;
+    block[1] = (uint8)red1;
+
+    // 3 bits per texel, in row major order, little endian.
+    uint64 bits = 0;
+    for (int i = 0; i < BlockTexels; ++i)
+    {
+        bits |= (uint64)indices[i] << (3 * i);
+    }
+    for (int i = 0; i < 6; ++i)
+    {
+        block[2 + i] = (uint8)(bits >> (8 * i));
+    }
+}
+
+void EncodeBC4Block(const float* texels, int pitch, bool isSigned, BlockCompressionQuality::E quality, uint8* block)
+{
+    const EndpointRange range = GetEndpointRange(isSigned);
+    float values[BlockTexels];
+    float low = FLT_MAX;
+    float high = -FLT_MAX;
+    for (int z = 0; z < BlockDimension; ++z)
+    {
+        for (int x = 0; x < BlockDimension; ++x)
+        {
+            float value = math::clamp(texels[pitch * z + x] * range.scale, (float)range.min, (float)range.max);
+            values[BlockDimension * z + x] = value;
+            low = std::min(low, value);
+            high = std::max(high, value);
+        }
+    }
+
+    // Endpoints just covering the block. If they're equal we get the 6 value mode, which is fine since every texel is the same.
+    int bestRed0 = (int)ceilf(high);
+    int bestRed1 = (int)floorf(low);
+    uint8 bestIndices[BlockTexels];
+    float bestError = FitIndices(values, bestRed0, bestRed1, range, bestIndices);
+
+    if (quality == BlockCompressionQuality::High && bestError > 0.f)
+    {
+        uint8 indices[BlockTexels];
+        auto TryEndpoints = [&](int red0, int red1)
+        {
+            red0 = math::clamp(red0, range.min, range.max);
+            red1 = math::clamp(red1, range.min, range.max);
+            float error = FitIndices(values, red0, red1, range, indices);
+            if (error < bestError)
+            {
+                bestError = error;
+                bestRed0 = red0;
+                bestRed1 = red1;
+                std::copy(std::begin(indices), std::end(indices), bestIndices);
+            }
+        };
+
+        // Nudge the endpoints inwards, since the extremes are often better served by an interpolated value.
+        int roundedHigh = (int)lroundf(high);
+        int roundedLow = (int)lroundf(low);
+        for (int dHigh = -1; dHigh <= 1; ++dHigh)
+        {
+            for (int dLow = -1; dLow <= 1; ++dLow)
+            {
+                if (roundedHigh + dHigh > roundedLow + dLow)
+                {
+                    TryEndpoints(roundedHigh + dHigh, roundedLow + dLow);
+                }
+            }
+        }
+
+        // Then fit endpoints to the indices we've settled on, a couple of times over.
+        for (int i = 0; i < 2 && bestRed0 > bestRed1; ++i)
+        {
+            int red0 = bestRed0;
+            int red1 = bestRed1;
+            RefineEndpoints(values, bestIndices, range, red0, red1);
+            if (red0 > red1)
+            {
+                TryEndpoints(red0, red1);
+            }
+        }
+
+        // The 6 value mode can spend its interpolated values on the middle of the block, leaving outliers to the format's extremes.
+        float innerLow = FLT_MAX;
+        float innerHigh = -FLT_MAX;
+        for (float value : values)
+        {
+            if (value > range.min + 0.5f && value < range.max - 0.5f)
+            {
+                innerLow = std::min(innerLow, value);
+                innerHigh = std::max(innerHigh, value);
+            }
+        }
+        TryEndpoints(roundedLow, roundedHigh);
+        if (innerLow <= innerHigh)
+        {
+            TryEndpoints((int)floorf(innerLow), (int)ceilf(innerHigh));
+        }
+    }
+
+    WriteBC4Block(bestRed0, bestRed1, bestIndices, block);
+}
+
+void DecodeBC4Block(const uint8* block, bool isSigned, float* texels, int pitch)
+{
+    const EndpointRange range = GetEndpointRange(isSigned);
+    int red0 = isSigned ? (int)(int8)block[0] : (int)block[0];
+    int red1 = isSigned ? (int)(int8)block[1] : (int)block[1];
+    float palette[8];
+    MakePalette(std::max(red0, range.min), std::max(red1, range.min), range, palette);
+
+    uint64 bits = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        bits |= (uint64)block[2 + i] << (8 * i);
+    }
+    for (int i = 0; i < BlockTexels; ++i)
+    {
+        int index = (int)(bits >> (3 * i)) & 7;
+        texels[pitch * (i / BlockDimension) + (i % BlockDimension)] = palette[index] / range.scale;
+    }
+}
+
+void EncodeBC5Block(const Vec2f* texels, int pitch, bool isSigned, BlockCompressionQuality::E quality, uint8* block)
+{
+    // Just a BC4 block for each channel.
+    float channels[2][BlockTexels];
+    for (int i = 0; i < BlockTexels; ++i)
+    {
+        const Vec2f& texel = texels[pitch * (i / BlockDimension) + (i % BlockDimension)];
+        channels[0][i] = texel.x;
+        channels[1][i] = texel.y;
+    }
+    EncodeBC4Block(channels[0], BlockDimension, isSigned, quality, block);
+    EncodeBC4Block(channels[1], BlockDimension, isSigned, quality, block + BC4BlockBytes);
+}
+
+void DecodeBC5Block(const uint8* block, bool isSigned, Vec2f* texels, int pitch)
+{
+    float channels[2][BlockTexels];
+    DecodeBC4Block(block, isSigned, channels[0], BlockDimension);
+    DecodeBC4Block(block + BC4BlockBytes, isSigned, channels[1], BlockDimension);
+    for (int i = 0; i < BlockTexels; ++i)
+    {
+        texels[pitch * (i / BlockDimension) + (i % BlockDimension)] = Vec2f(channels[0][i], channels[1][i]);
+    }
+}
+
+void EncodeBC4(const float* src, int srcPitch, int width, int height, bool isSigned, BlockCompressionQuality::E quality, uint8* dst, int dstRowPitch)
+{
+    Assert(width % BlockDimension == 0 && height % BlockDimension == 0);
+    for (int z = 0; z < height; z += BlockDimension)
+    {
+        uint8* row = dst + dstRowPitch * (z / BlockDimension);
+        for (int x = 0; x < width; x += BlockDimension)
+        {
+            EncodeBC4Block(src + srcPitch * z + x, srcPitch, isSigned, quality, row + BC4BlockBytes * (x / BlockDimension));
+        }
+    }
+}
+
+void EncodeBC5(const Vec2f* src, int srcPitch, int width, int height, bool isSigned, BlockCompressionQuality::E quality, uint8* dst, int dstRowPitch)
+{
+    Assert(width % BlockDimension == 0 && height % BlockDimension == 0);
+    for (int z = 0; z < height; z += BlockDimension)
+    {
+        uint8* row = dst + dstRowPitch * (z / BlockDimension);
+        for (int x = 0; x < width; x += BlockDimension)
+        {
+            EncodeBC5Block(src + srcPitch * z + x, srcPitch, isSigned, quality, row + BC5BlockBytes * (x / BlockDimension));
+        }
+    }
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace gaia
+{
+
+// Speed/quality trade-off for the block encoders.
+namespace BlockCompressionQuality
+{
+enum E
+{
+    Fast, // Endpoints at the block's min and max; a few ns per block.
+    High, // Also searches nearby endpoints and the 6-value mode, roughly 10x slower.
+};
+}
+
+static constexpr int BlockDimension = 4;   // Texels along each side of a block.
+static constexpr int BC4BlockBytes = 8;
+static constexpr int BC5BlockBytes = 16;
+
+/*
+ * CPU BC4 (one channel) and BC5 (two channel) block compression, for height and normal data generated at runtime.
+ * Texel values are in [0, 1], or [-1, 1] when isSigned (i.e. the _UNORM and _SNORM formats); anything outside is clamped.
+ * Source pitches are in elements, destination pitches in bytes.
+ */
+void EncodeBC4Block(const float* texels, int pitch, bool isSigned, BlockCompressionQuality::E quality, uint8* block);
+void DecodeBC4Block(const uint8* block, bool isSigned, float* texels, int pitch);
+void EncodeBC5Block(const Vec2f* texels, int pitch, bool isSigned, BlockCompressionQuality::E quality, uint8* block);
+void DecodeBC5Block(const uint8* block, bool isSigned, Vec2f* texels, int pitch);
+
+// Encode whole images, whose dimensions must be multiples of BlockDimension.
+void EncodeBC4(const float* src, int srcPitch, int width, int height, bool isSigned, BlockCompressionQuality::E quality, uint8* dst, int dstRowPitch);
+void EncodeBC5(const Vec2f* src, int srcPitch, int width, int height, bool isSigned, BlockCompressionQuality::E quality, uint8* dst, int dstRowPitch);
+
+// Bytes in a row of blocks (i.e. four rows of texels), before any pitch alignment.
+inline int GetBlockRowBytes(int width, int blockBytes)
+{
+    return (width / BlockDimension) * blockBytes;
+}
+
+}
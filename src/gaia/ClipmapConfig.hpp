@@ -0,0 +1,143 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * Size and resolution of the terrain clipmap, chosen at startup.
+ * Trades view distance (numLevels, textureDimension, texelSize) against memory.
+ * All dimensions must be powers of two so that wrapping stays a mask and tiles line up with texture edges.
+ */
+struct ClipmapConfig
+{
+    static constexpr int MaxClipLevels = 8; // Limited by the size of the clipmap descriptor tables in the root signature.
+
+    int numLevels = 8;              // Number of clipmap levels (i.e. number of textures).
+    int textureDimension = 256;     // Dimension of each heightmap texture.
+    int tileDimension = 64;         // Dimension of each tile/chunk in the tile caches.
+    int vertexGridDimension = 256;  // Number of vertices in each dimension of the vertex grid.
+    int patchTexels = 64;           // Number of level 0 texels along each side of a vertex patch.
+    float texelSize = 0.05f;        // World size of a texel at clip level 0.
+    int ringBlockPatches = 6;       // Patches along each side of the blocks the clipmap rings are made of. Each ring is 4x this plus 2 across.
+    bool compactHeights = false;    // Store heights as 16 bit unorms with a range per level, rather than 32 bit floats.
+    bool preciseNormals = false;    // Store octahedral normals with 16 rather than 8 bits per component.
+    int compressedLevels = 0;       // Number of coarsest levels whose heights are BC4 compressed (with a range per level), where small errors go unnoticed.
+
+    bool IsValid() const
+    {
+        return 1 <= numLevels && numLevels <= MaxClipLevels
+            && math::IsPow2(textureDimension) && math::IsPow2(tileDimension) && math::IsPow2(patchTexels)
+            && 8 <= tileDimension && tileDimension <= textureDimension / 2 // Uploads assume the clipmap offset is tile aligned.
+            && vertexGridDimension >= 2
+            && ringBlockPatches >= 1
+            && 0 <= compressedLevels && compressedLevels <= numLevels
+            && texelSize > 0.f;
+    }
+
+    float VertexPatchSize() const { return texelSize * (float)patchTexels; }                          // World size of a vertex patch.
+    int VertexBufferLength() const { return math::Square(vertexGridDimension); }                      // Number of vertices in the vertex buffer.
+    int IndexBufferLength() const { return 4 * math::Square(vertexGridDimension - 1); }               // Number of indices in the index buffer.
+    bool NeedsLargeIndices() const { return VertexBufferLength() > (1 << 16); }                       // Whether 16 bit indices are too small.
+    Vec2i TextureSize() const { return Vec2i(textureDimension, textureDimension); }                  // 2D texture size helper.
+    int HeightTexelSize() const { return compactHeights ? (int)sizeof(uint16) : (int)sizeof(float); } // Bytes per height map texel.
+    int NormalBits() const { return preciseNormals ? 16 : 8; }                                        // Bits per octahedral normal component.
+    bool IsCompressedLevel(int level) const { return level >= numLevels - compressedLevels; }         // Whether a level's heights are BC4 compressed.
+    bool HasHeightRange(int level) const { return compactHeights || IsCompressedLevel(level); }       // Whether a level's heights are normalised to a range.
+
+    // Number of clipmap ring levels whose outer edge stays inside the coarsest clip level, wherever the rings snap to.
+    int NumRingLevels() const
+    {
+        // Leave the same border as the level selection in TerrainClipLevels.hlsl. Each ring can be off centre by up to a patch of the next level.
+        const float halfCoarsestLevel = (float)((textureDimension / 2 - 3) << (numLevels - 1)) / (float)patchTexels; // In level 0 patches.
+        int ringLevels = 1;
+        while (ringLevels < MaxClipLevels && (float)(((2 * ringBlockPatches + 1) << ringLevels) + (2 << ringLevels)) <= halfCoarsestLevel)
+        {
+            ++ringLevels;
+        }
+        return ringLevels;
+    }
+
+    // Returns index of a heightmap sample within a tile.
+    int TileIndex(int x, int z) const
+    {
+        Assert(0 <= x && x < tileDimension);
+        Assert(0 <= z && z < tileDimension);
+        return tileDimension * z + x;
+    }
+
+    int TileIndex(Vec2i coords) const { return TileIndex(coords.x, coords.y); }
+
+    // Returns index of a vertex within the vertex buffer.
+    int VertexIndex(int x, int z) const
+    {
+        Assert(0 <= x && x < vertexGridDimension);
+        Assert(0 <= z && z < vertexGridDimension);
+        return vertexGridDimension * z + x;
+    }
+
+    int VertexIndex(Vec2i coords) const { return VertexIndex(coords.x, coords.y); }
+
+    // Returns index of a sample within a heightmap/clipmap texture.
+    int HeightmapIndex(int x, int z) const
+    {
+        Assert(0 <= x && x < textureDimension);
+        Assert(0 <= z && z < textureDimension);
+        return textureDimension * z + x;
+    }
+
+    int HeightmapIndex(Vec2i coords) const { return HeightmapIndex(coords.x, coords.y); }
+
+    Vec2i WrapHeightmapCoords(Vec2i levelGlobalCoords) const
+    {
+        // Turns a "world" UV coordinate into a local one.
+        // This is a mod operation that always returns a positive result.
+        return levelGlobalCoords & (textureDimension - 1);
+    }
+
+    Vec2i WrapTileCoords(Vec2i levelGlobalCoords) const
+    {
+        return levelGlobalCoords & (tileDimension - 1);
+    }
+
+    // Returns the tile containing the given coords and the coords within that tile.
+    Pair<Vec2i, Vec2i> LevelGlobalCoordsToTile(Vec2i levelGlobalCoords) const
+    {
+        Vec2i coordsInTile = WrapTileCoords(levelGlobalCoords);
+        Vec2i tile = (levelGlobalCoords - coordsInTile) / tileDimension;
+        return { tile, coordsInTile };
+    }
+
+    Pair<Vec2i, Vec2i> GlobalCoordsToTile(Vec2i globalCoords, int level) const
+    {
+        return LevelGlobalCoordsToTile(globalCoords >> level);
+    }
+
+    // Returns coordinates relative to the given tile; may be out of bounds for that tile.
+    Vec2i LevelGlobalCoordsToTileCoords(Vec2i levelGlobalCoords, Vec2i tile) const
+    {
+        return levelGlobalCoords - (tileDimension * tile);
+    }
+
+    // Returns coordinates relative to the given tile; may be out of bounds for that tile.
+    Vec2i GlobalCoordsToTileCoords(Vec2i globalCoords, Vec2i tile, int level) const
+    {
+        return LevelGlobalCoordsToTileCoords(globalCoords >> level, tile);
+    }
+
+    Vec2i WorldPosToGlobalCoords(Vec2f worldPos) const
+    {
+        return math::Vec2Floor(worldPos / texelSize);
+    }
+
+    Pair<Vec2i, Vec2i> WorldPosToTile(Vec2f worldPos, int level) const
+    {
+        return GlobalCoordsToTile(WorldPosToGlobalCoords(worldPos), level);
+    }
+
+    Vec2f GlobalCoordsToWorldPos(Vec2i globalCoords) const
+    {
+        return Vec2f(globalCoords) * texelSize;
+    }
+};
+
+}
@@ -0,0 +1,126 @@
+#include "ClipmapRings.hpp"
+
+namespace gaia
+{
+
+void ClipmapRings::Init(int blockPatches, int numLevels)
+{
+    Assert(blockPatches >= 1 && numLevels >= 1);
+    m_blockPatches = blockPatches;
+    m_levelMins.assign(numLevels, Vec2i(INT_MAX, INT_MAX));
+    for (auto& instances : m_instances)
+    {
+        instances.clear();
+    }
+}
+
+bool ClipmapRings::Update(Vec2f centre)
+{
+    Assert(m_blockPatches > 0);
+    const int b = m_blockPatches;
+
+    // The finest level is centred on the nearest even patch, so its corner is on a whole patch of the next level.
+    std::vector<Vec2i> levelMins(m_levelMins.size());
+    const float halfLevel = (float)(2 * b + 1);
+    levelMins[0] = Vec2i(math::IFloorF(0.5f * (centre.x - halfLevel) + 0.5f), math::IFloorF(0.5f * (centre.y - halfLevel) + 0.5f)) * 2;
+
+    // A level's hole is 2b + 2 of its patches across, one more than the finer level inside it covers, so the finer level
+    // can go against either side of it. Pick whichever side puts this level's corner on an even patch too.
+    Vec2i holeMins[32];
+    Assert(m_levelMins.size() <= 32);
+    for (size_t level = 1; level < levelMins.size(); ++level)
+    {
+        const int cell = 1 << level;
+        const Vec2i& innerMin = levelMins[level - 1];
+        Vec2i& holeMin = holeMins[level];
+        holeMin.x = (((innerMin.x / cell) - b) & 1) ? innerMin.x - cell : innerMin.x;
+        holeMin.y = (((innerMin.y / cell) - b) & 1) ? innerMin.y - cell : innerMin.y;
+        levelMins[level] = holeMin - Vec2i(b * cell, b * cell);
+    }
+
+    if (levelMins == m_levelMins)
+        return false;
+
+    m_levelMins = levelMins;
+    for (auto& instances : m_instances)
+    {
+        instances.clear();
+    }
+
+    m_instances[RingPiece::Centre].push_back({ m_levelMins[0] + Vec2i(b, b), 0 });
+    for (int level = 0; level < GetNumLevels(); ++level)
+    {
+        AddRing(level);
+        if (level == 0)
+            continue;
+
+        // The L-shaped strip goes on whichever sides the finer level doesn't reach.
+        const int cell = 1 << level;
+        const Vec2i& holeMin = holeMins[level];
+        const Vec2i& innerMin = m_levelMins[level - 1];
+        const int trimX = (holeMin.x == innerMin.x) ? holeMin.x + (2 * b + 1) * cell : holeMin.x;
+        const int trimZ = (holeMin.y == innerMin.y) ? holeMin.y + (2 * b + 1) * cell : holeMin.y;
+        const int rowX = (trimX == holeMin.x) ? holeMin.x + cell : holeMin.x;
+        m_instances[RingPiece::TrimColumn].push_back({ Vec2i(trimX, holeMin.y), level });
+        m_instances[RingPiece::TrimRow].push_back({ Vec2i(rowX, trimZ), level });
+    }
+    return true;
+}
+
+Vec2i ClipmapRings::GetPieceSize(RingPiece::E piece) const
+{
+    const int b = m_blockPatches;
+    switch (piece)
+    {
+    case RingPiece::Centre:
+        return Vec2i(2 * b + 2, 2 * b + 2);
+    case RingPiece::Block:
+        return Vec2i(b, b);
+    case RingPiece::RowFixup:
+        return Vec2i(2, b);
+    case RingPiece::ColumnFixup:
+        return Vec2i(b, 2);
+    case RingPiece::TrimColumn:
+        return Vec2i(1, 2 * b + 2);
+    case RingPiece::TrimRow:
+        return Vec2i(2 * b + 1, 1);
+    default:
+        Assert(false);
+        return Vec2i(0, 0);
+    }
+}
+
+int ClipmapRings::GetNumPatches() const
+{
+    // The finest level is solid; every other one has the finer level's square (less its strip) cut out of it.
+    const int levelPatches = GetLevelPatches();
+    return math::Square(levelPatches) + (GetNumLevels() - 1) * (math::Square(levelPatches) - math::Square(levelPatches / 2));
+}
+
+void ClipmapRings::AddRing(int level)
+{
+    // Blocks go in a 4x4 grid with a two patch gap down the middle each way, leaving out the middle four.
+    const int b = m_blockPatches;
+    const int cell = 1 << level;
+    const int offsets[4] = { 0, b, 2 * b + 2, 3 * b + 2 };
+    const Vec2i& levelMin = m_levelMins[level];
+    for (int z = 0; z < 4; ++z)
+    {
+        for (int x = 0; x < 4; ++x)
+        {
+            if ((x == 1 || x == 2) && (z == 1 || z == 2))
+                continue;
+
+            m_instances[RingPiece::Block].push_back({ levelMin + Vec2i(offsets[x], offsets[z]) * cell, level });
+        }
+    }
+
+    for (int side = 0; side < 2; ++side)
+    {
+        const int edge = offsets[3 * side];
+        m_instances[RingPiece::RowFixup].push_back({ levelMin + Vec2i(2 * b, edge) * cell, level });
+        m_instances[RingPiece::ColumnFixup].push_back({ levelMin + Vec2i(edge, 2 * b) * cell, level });
+    }
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+namespace gaia
+{
+
+namespace RingPiece
+{
+enum E
+{
+    Centre,       // 2b + 2 patches square, filling the finest level's hole.
+    Block,        // b x b patches. Twelve of these make up most of each ring.
+    RowFixup,     // 2 x b, between the blocks in the middle of the ring's bottom and top rows.
+    ColumnFixup,  // b x 2, between the blocks in the middle of its left and right columns.
+    TrimColumn,   // 1 x (2b + 2): the side of the L-shaped strip between a ring and the finer level inside it that runs along Z.
+    TrimRow,      // (2b + 1) x 1: the side that runs along X.
+    Count
+};
+}
+
+struct RingPieceInstance
+{
+    Vec2i origin; // Lower (x, z) corner, in finest level patches.
+    int level;    // Patches are 2^level finest level patches across.
+};
+
+/*
+ * Layout of the nested square rings of patches (a geometry clipmap) the terrain is drawn with around the camera.
+ * Each level's patches are twice the size of the last's. A level is 4b + 2 patches across with a hole of 2b + 2 in the middle, which
+ * the next finer level fills but for a one patch wide L-shaped strip on whichever two sides its snapping leaves it.
+ * Rings are made of a handful of fixed pieces, so each piece only needs building once and can be drawn instanced wherever Update() puts it.
+ * Every level's corner is on a whole patch of the next level, so the vertices along its outer edge are all on the coarser level's edges.
+ */
+class ClipmapRings
+{
+public:
+    void Init(int blockPatches, int numLevels);
+
+    // Snaps the levels around a position, in finest level patches. Returns whether any of them moved.
+    bool Update(Vec2f centre);
+
+    int GetBlockPatches() const { return m_blockPatches; }
+    int GetNumLevels() const { return (int)m_levelMins.size(); }
+    int GetLevelPatches() const { return 4 * m_blockPatches + 2; } // Across each level, in that level's patches.
+    Vec2i GetPieceSize(RingPiece::E piece) const;                  // In patches of the piece's level.
+
+    // Lower corner of a level, in finest level patches. It spans GetLevelPatches() << level of them.
+    Vec2i GetLevelMin(int level) const { return m_levelMins[level]; }
+
+    const std::vector<RingPieceInstance>& GetInstances(RingPiece::E piece) const { return m_instances[piece]; }
+
+    // These don't depend on where the rings are.
+    int GetNumInstances() const { return 18 * GetNumLevels() - 1; } // Sixteen blocks and fixups per level, two trims per level but the finest, and the centre.
+    int GetNumPatches() const;
+
+private:
+    void AddRing(int level);
+
+    int m_blockPatches = 0;
+    std::vector<Vec2i> m_levelMins;
+    std::vector<RingPieceInstance> m_instances[RingPiece::Count];
+};
+
+}
@@ -0,0 +1,178 @@
+#include "ClipmapUpdater.hpp"
+
+namespace gaia
+{
+
+static int RegionArea(const ClipmapLevelUpdate::Region& region)
+{
+    Vec2i size = math::max(region.max - region.min, Vec2iZero);
+    return size.x * size.y;
+}
+
+int ClipmapLevelUpdate::NumWrittenTexels() const
+{
+    int numTexels = 0;
+    for (int i = 0; i < numWrites; ++i)
+    {
+        numTexels += RegionArea(writes[i]);
+    }
+    return numTexels;
+}
+
+ClipmapUpdater::ClipmapUpdater(int textureDimension)
+    : m_textureDimension(textureDimension)
+{
+    Assert(math::IsPow2(textureDimension));
+}
+
+bool ClipmapUpdater::CalcMoveUpdate(int level, Vec2i oldTexelOffset, Vec2i newTexelOffset, ClipmapLevelUpdate& update) const
+{
+    // Check we've moved far enough to trigger an update at this level.
+    oldTexelOffset >>= level;
+    newTexelOffset >>= level;
+    if (oldTexelOffset == newTexelOffset)
+        return false;
+
+    update = ClipmapLevelUpdate();
+    auto AddWrite = [&](Vec2i min, Vec2i max)
+    {
+        if (min.x < max.x && min.y < max.y)
+        {
+            update.writes[update.numWrites++] = { min, max };
+        }
+    };
+
+    // Calculate dirty region in texel space for this clip level.
+    // All "regions" in this function actually represent a cross in the texture.
+    const int dim = m_textureDimension;
+    const Vec2i fullSize(dim, dim);
+    const Vec2i halfSize = fullSize / 2;
+    Vec2i deltaSign = math::sign(newTexelOffset - oldTexelOffset);
+    Vec2i worldUploadRegionMin = oldTexelOffset + halfSize + deltaSign * halfSize;
+    Vec2i worldUploadRegionMax = newTexelOffset + halfSize + deltaSign * halfSize;
+    for (int i = 0; i < 2; ++i)
+    {
+        // Ensure min < max and limit the upload in case we teleported more than the width of the whole texture.
+        if (worldUploadRegionMax[i] < worldUploadRegionMin[i])
+        {
+            std::swap(worldUploadRegionMin[i], worldUploadRegionMax[i]);
+            worldUploadRegionMax[i] = std::min(worldUploadRegionMax[i], worldUploadRegionMin[i] + dim);
+        }
+        else
+        {
+            worldUploadRegionMin[i] = std::max(worldUploadRegionMin[i], worldUploadRegionMax[i] - dim);
+        }
+    }
+
+    // Calculate the whole world texel region that we want for the clip level.
+    Vec2i wantRegionMin = newTexelOffset;
+    Vec2i wantRegionMax = newTexelOffset + fullSize;
+
+    // Write the two (wrapped) quads we need to update.
+    bool wholeTexture = (worldUploadRegionMax.x - worldUploadRegionMin.x == dim) || (worldUploadRegionMax.y - worldUploadRegionMin.y == dim);
+    if (wholeTexture)
+    {
+        // If we need to copy the whole texture, just do it once.
+        AddWrite(wantRegionMin, wantRegionMax);
+    }
+    else
+    {
+        // Else copy the two (wrapping) slices.
+        AddWrite(Vec2i(worldUploadRegionMin.x, wantRegionMin.y), Vec2i(worldUploadRegionMax.x, wantRegionMax.y));
+        AddWrite(Vec2i(wantRegionMin.x, worldUploadRegionMin.y), Vec2i(wantRegionMax.x, worldUploadRegionMax.y));
+    }
+
+    // Update normals. Normals are computed with wrapping so this is always just one region per slice.
+    // Pad the region by 1 cell in each direction since height affects adjacent normals.
+    // A slice we didn't move along has no new heights, so it doesn't need its normals updating.
+    if (worldUploadRegionMin.x < worldUploadRegionMax.x)
+    {
+        update.normals[update.numNormals++] = { Vec2i(worldUploadRegionMin.x - 1, -1), Vec2i(worldUploadRegionMax.x + 2, dim + 1) }; // Vertical slice
+    }
+    if (worldUploadRegionMin.y < worldUploadRegionMax.y)
+    {
+        update.normals[update.numNormals++] = { Vec2i(-1, worldUploadRegionMin.y - 1), Vec2i(dim + 1, worldUploadRegionMax.y + 2) }; // Horizontal slice
+    }
+
+    return true;
+}
+
+bool ClipmapUpdater::CalcRegionUpdate(int level, Vec2i globalMin, Vec2i globalMax, Vec2i texelOffset, ClipmapLevelUpdate& update) const
+{
+    // Note that the logic in this function is different to CalcMoveUpdate();
+    // here we are dealing with a single AABB, whereas that function must upload a cross that spans the whole clipmap texture.
+    Assert(globalMin.x <= globalMax.x);
+    Assert(globalMin.y <= globalMax.y);
+    Vec2i levelGlobalMin = globalMin >> level;
+    Vec2i levelGlobalMax = globalMax >> level;
+
+    // Transform to a [min, max) region now that we're done shifting for levels.
+    levelGlobalMax += Vec2i(1, 1);
+
+    // Offset to account for clipmap tiling origin.
+    const int dim = m_textureDimension;
+    const Vec2i fullSize(dim, dim);
+    const Vec2i halfSize = fullSize / 2;
+    levelGlobalMin += halfSize;
+    levelGlobalMax += halfSize;
+
+    // Does the dirty region actually overlap with the active texture region at this clip level?
+    Vec2i textureRegionMin = (texelOffset >> level);
+    Vec2i textureRegionMax = (texelOffset >> level) + fullSize;
+    levelGlobalMin = math::clamp(levelGlobalMin, textureRegionMin, textureRegionMax);
+    levelGlobalMax = math::clamp(levelGlobalMax, textureRegionMin, textureRegionMax);
+    if (levelGlobalMin.x == levelGlobalMax.x || levelGlobalMin.y == levelGlobalMax.y)
+        return false;
+
+    update = ClipmapLevelUpdate();
+    update.writes[update.numWrites++] = { levelGlobalMin, levelGlobalMax };
+
+    // Update normals with a single region, padded by 1 cell in each direction since height affects adjacent normals.
+    update.normals[update.numNormals++] = { levelGlobalMin - Vec2i(1, 1), levelGlobalMax + Vec2i(1, 1) };
+
+    return true;
+}
+
+int ClipmapUpdater::SplitWrappedRegion(const ClipmapLevelUpdate::Region& region, ClipmapLevelUpdate::Region (&pieces)[4]) const
+{
+    // Split each axis where it crosses a multiple of the texture dimension, then take every combination.
+    Pair<int, int> ranges[2][2];
+    int numRanges[2];
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        int min = region.min[axis];
+        int max = region.max[axis];
+        Assert(min < max && max - min <= m_textureDimension);
+        int wrap = math::RoundUpPow2(min, m_textureDimension);
+        if (min < wrap && wrap < max)
+        {
+            // Order by where they start in the texture so that the strips are written in texture order.
+            ranges[axis][0] = { wrap, max };
+            ranges[axis][1] = { min, wrap };
+            numRanges[axis] = 2;
+        }
+        else
+        {
+            ranges[axis][0] = { min, max };
+            numRanges[axis] = 1;
+        }
+    }
+
+    int numPieces = 0;
+    for (int z = 0; z < numRanges[1]; ++z)
+    {
+        for (int x = 0; x < numRanges[0]; ++x)
+        {
+            pieces[numPieces++] = { Vec2i(ranges[0][x].first, ranges[1][z].first), Vec2i(ranges[0][x].second, ranges[1][z].second) };
+        }
+    }
+    return numPieces;
+}
+
+Vec2i ClipmapUpdater::WrapCoords(Vec2i levelGlobalCoords) const
+{
+    // This is a mod operation that always returns a positive result.
+    return levelGlobalCoords & (m_textureDimension - 1);
+}
+
+}
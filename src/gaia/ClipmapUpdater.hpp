@@ -0,0 +1,66 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * A list of operations needed to bring a single clipmap level up to date, in the order they must be executed:
+ * write height data for each region into upload strips, copy the strips into the texture, then recompute normals.
+ * Contains no API objects so that it can be executed by the renderer or in memory (see CpuClipmapTexture).
+ */
+struct ClipmapLevelUpdate
+{
+    struct Region
+    {
+        Vec2i min; // Inclusive.
+        Vec2i max; // Exclusive.
+    };
+
+    // Regions of level global coords (offset by half the texture, i.e. the clipmap tiling origin) that need new height data.
+    // These may wrap across the edge of the texture; see ClipmapUpdater::SplitWrappedRegion().
+    Region writes[2];
+    int numWrites = 0;
+
+    // Regions to recompute normals for, in the same coords as the writes. These may extend past the texture and wrap.
+    Region normals[2];
+    int numNormals = 0;
+
+    int NumWrittenTexels() const;
+};
+
+/*
+ * Works out how to update a toroidally addressed clipmap level when the clipmap moves or part of the terrain is modified.
+ * Texturing is done toroidally, so when the camera moves we replace the furthest slice of the texture in the direction
+ * we are moving away from with the new slice we need. In most cases this will be a single horizontal or vertical slice,
+ * but in general it will be both (i.e. a cross) or up to four slices if the dirty region wraps across the edge of the texture.
+ * A good overview of clipmaps:
+ * https://developer.nvidia.com/gpugems/gpugems2/part-i-geometric-complexity/chapter-2-terrain-rendering-using-gpu-based-geometry
+ */
+class ClipmapUpdater
+{
+public:
+    explicit ClipmapUpdater(int textureDimension);
+
+    // Update needed at the given level when the clipmap moves between texel offsets (in level 0 texels).
+    // Returns false if we haven't moved far enough to need an update at this level.
+    bool CalcMoveUpdate(int level, Vec2i oldTexelOffset, Vec2i newTexelOffset, ClipmapLevelUpdate& update) const;
+
+    // Update needed at the given level after the terrain in a region (inclusive level 0 global coords) was modified.
+    // Returns false if the region doesn't overlap the texture at this level.
+    bool CalcRegionUpdate(int level, Vec2i globalMin, Vec2i globalMax, Vec2i texelOffset, ClipmapLevelUpdate& update) const;
+
+    // Splits a region of level global coords into at most four pieces that don't wrap across the edge of the texture,
+    // so that each one can be packed into its own upload strip and copied as a single box. Returns the number of pieces.
+    int SplitWrappedRegion(const ClipmapLevelUpdate::Region& region, ClipmapLevelUpdate::Region (&pieces)[4]) const;
+
+    // Returns the texture coords that the given level global coords are stored at.
+    Vec2i WrapCoords(Vec2i levelGlobalCoords) const;
+
+    int GetTextureDimension() const { return m_textureDimension; }
+
+private:
+
+    int m_textureDimension;
+};
+
+}
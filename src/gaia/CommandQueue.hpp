@@ -12,6 +12,7 @@ public:
     [[nodiscard]] UINT64 Execute(ID3D12GraphicsCommandList2* commandList);
     [[nodiscard]] UINT64 SignalFence();
     void WaitFence(UINT64 value);
+    UINT64 GetCompletedFenceValue() const { return m_fence->GetCompletedValue(); }
     void Flush();
 
 private:
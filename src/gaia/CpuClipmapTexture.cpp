@@ -0,0 +1,110 @@
+#include "CpuClipmapTexture.hpp"
+#include "ClipmapUpdater.hpp"
+#include "SobelNormals.hpp"
+#include "TerrainEncoding.hpp"
+
+namespace gaia
+{
+
+// Matches the thread group size of TerrainComputeNormals.
+static constexpr int NormalsGroupSize = 8;
+
+CpuClipmapTexture::CpuClipmapTexture(int textureDimension, float texelSize, int level, int normalBits)
+    : m_textureDimension(textureDimension)
+    , m_texelSize(texelSize)
+    , m_level(level)
+    , m_normalBits(normalBits)
+{
+    Assert(math::IsPow2(textureDimension));
+    m_heights.resize(math::Square(textureDimension), 0.f);
+    m_normals.resize(math::Square(textureDimension), EncodeOctahedral(Vec3fY));
+    m_unencodedNormals.resize(math::Square(textureDimension), Vec3fY);
+}
+
+void CpuClipmapTexture::Execute(const ClipmapLevelUpdate& update, const WriteRegionFunc& writeRegion)
+{
+    // Pack each non-wrapping piece of the writes into a strip and copy it into place, as the renderer does with upload memory.
+    ClipmapUpdater updater(m_textureDimension);
+    for (int i = 0; i < update.numWrites; ++i)
+    {
+        ClipmapLevelUpdate::Region pieces[4];
+        int numPieces = updater.SplitWrappedRegion(update.writes[i], pieces);
+        for (int piece = 0; piece < numPieces; ++piece)
+        {
+            Vec2i size = pieces[piece].max - pieces[piece].min;
+            m_strip.resize(size.x * size.y);
+            writeRegion(m_strip.data(), size.x, pieces[piece].min, pieces[piece].max);
+
+            Vec2i texMin = updater.WrapCoords(pieces[piece].min);
+            Assert(texMin.x + size.x <= m_textureDimension && texMin.y + size.y <= m_textureDimension);
+            for (int z = 0; z < size.y; ++z)
+            {
+                std::copy(&m_strip[size.x * z], &m_strip[size.x * z] + size.x, &m_heights[Index(texMin + Vec2i(0, z))]);
+            }
+            ++m_stats.numStrips;
+        }
+    }
+
+    for (int i = 0; i < update.numNormals; ++i)
+    {
+        ComputeNormals(update.normals[i].min, update.normals[i].max);
+    }
+
+    m_stats.bytesWritten += (uint64)update.NumWrittenTexels() * sizeof(float);
+    ++m_stats.numUpdates;
+}
+
+CpuClipmapTexture::Comparison CpuClipmapTexture::CompareWithFullRegeneration(Vec2i texelOffset, const WriteRegionFunc& writeRegion) const
+{
+    // Write everything we want for this clip level and copy it all across.
+    const Vec2i fullSize(m_textureDimension, m_textureDimension);
+    Vec2i wantRegionMin = texelOffset >> m_level;
+
+    ClipmapLevelUpdate update;
+    update.writes[update.numWrites++] = { wantRegionMin, wantRegionMin + fullSize };
+    update.normals[update.numNormals++] = { Vec2iZero, fullSize };
+
+    CpuClipmapTexture reference(m_textureDimension, m_texelSize, m_level, m_normalBits);
+    reference.Execute(update, writeRegion);
+
+    Comparison comparison;
+    for (int i = 0; i < (int)m_heights.size(); ++i)
+    {
+        comparison.maxHeightError = std::max(comparison.maxHeightError, fabsf(m_heights[i] - reference.m_heights[i]));
+        comparison.maxNormalError = std::max(comparison.maxNormalError, math::length(DecodeOctahedral(m_normals[i]) - DecodeOctahedral(reference.m_normals[i])));
+    }
+    return comparison;
+}
+
+int CpuClipmapTexture::Index(Vec2i texCoords) const
+{
+    Assert(0 <= texCoords.x && texCoords.x < m_textureDimension);
+    Assert(0 <= texCoords.y && texCoords.y < m_textureDimension);
+    return m_textureDimension * texCoords.y + texCoords.x;
+}
+
+void CpuClipmapTexture::ComputeNormals(Vec2i min, Vec2i max)
+{
+    // Same as TerrainComputeNormals.hlsl: a Sobel filter over the wrapped height map, dispatched in whole thread groups.
+    Assert(max.x > min.x && max.y > min.y);
+    max = math::min(max, min + Vec2i(m_textureDimension, m_textureDimension));
+    min = math::RoundDownPow2(min, Vec2i(NormalsGroupSize, NormalsGroupSize));
+    max = math::RoundUpPow2(max, Vec2i(NormalsGroupSize, NormalsGroupSize));
+    m_stats.normalTexelsComputed += (uint64)(max.x - min.x) * (max.y - min.y);
+
+    // Rounding out to whole groups can cover some texels twice; they'd get the same result, so just do them once.
+    max = math::min(max, min + Vec2i(m_textureDimension, m_textureDimension));
+    ComputeSobelNormals(m_heights.data(), m_textureDimension, min, max, m_texelSize * float(1 << m_level), m_unencodedNormals.data());
+
+    const int mask = m_textureDimension - 1;
+    for (int z = min.y; z < max.y; ++z)
+    {
+        for (int x = min.x; x < max.x; ++x)
+        {
+            int index = Index(Vec2i(x & mask, z & mask));
+            m_normals[index] = QuantiseSnorm(EncodeOctahedral(m_unencodedNormals[index]), m_normalBits);
+        }
+    }
+}
+
+}
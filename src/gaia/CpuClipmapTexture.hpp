@@ -0,0 +1,63 @@
+#pragma once
+#include "TerrainEncoding.hpp"
+
+namespace gaia
+{
+
+struct ClipmapLevelUpdate;
+
+/*
+ * In-memory stand-in for a single clipmap level's height map and normal map.
+ * Executes ClipmapLevelUpdates the same way the renderer does (including wrapped normal computation in 8x8 groups),
+ * and stores normals with the same octahedral encoding and precision, so clipmap updates can be measured and validated without a device.
+ */
+class CpuClipmapTexture
+{
+public:
+    // Writes height data for a [min, max) region of offset level global coords, that doesn't wrap, to a strip with the given row pitch (in floats).
+    using WriteRegionFunc = std::function<void(float* strip, int rowPitch, Vec2i levelGlobalMin, Vec2i levelGlobalMax)>;
+
+    struct Stats
+    {
+        uint64 bytesWritten = 0;         // Bytes written to upload strips and copied to the texture, i.e. uploaded.
+        uint64 normalTexelsComputed = 0; // Including any padding to whole thread groups.
+        int numStrips = 0;
+        int numUpdates = 0;
+    };
+
+    struct Comparison
+    {
+        float maxHeightError = 0.f;
+        float maxNormalError = 0.f;
+    };
+
+    CpuClipmapTexture(int textureDimension, float texelSize, int level, int normalBits = 8);
+
+    void Execute(const ClipmapLevelUpdate& update, const WriteRegionFunc& writeRegion);
+
+    // Builds the whole level from scratch for the given clipmap offset (in level 0 texels) and compares it with our contents.
+    // Heights should match exactly; anything else means an update missed part of the texture or wrote stale data.
+    Comparison CompareWithFullRegeneration(Vec2i texelOffset, const WriteRegionFunc& writeRegion) const;
+
+    float GetHeight(Vec2i texCoords) const { return m_heights[Index(texCoords)]; }
+    Vec3f GetNormal(Vec2i texCoords) const { return DecodeOctahedral(m_normals[Index(texCoords)]); }
+
+    const Stats& GetStats() const { return m_stats; }
+    void ResetStats() { m_stats = Stats(); }
+
+private:
+    int Index(Vec2i texCoords) const;
+    void ComputeNormals(Vec2i min, Vec2i max);
+
+    int m_textureDimension;
+    float m_texelSize;
+    int m_level;
+    int m_normalBits;
+    std::vector<float> m_strip;
+    std::vector<float> m_heights;
+    std::vector<Vec2f> m_normals; // Quantised octahedral encoding.
+    std::vector<Vec3f> m_unencodedNormals; // Scratch output of the Sobel filter.
+    Stats m_stats;
+};
+
+}
@@ -1,5 +1,11 @@
 #pragma once
 
+#ifdef _WIN32
+#define GAIA_DEBUG_BREAK() _CrtDbgBreak()
+#else
+#define GAIA_DEBUG_BREAK() __builtin_trap()
+#endif
+
 #ifdef _DEBUG
 #define Assert(expr)                                                                      \
     do                                                                                    \
@@ -7,7 +13,7 @@
         if (!(expr))                                                                      \
         {                                                                                 \
             DebugOut("Assertion failed in %s, line %d: %s\n", __FILE__, __LINE__, #expr); \
-            _CrtDbgBreak();                                                               \
+            GAIA_DEBUG_BREAK();                                                           \
         }                                                                                 \
     } while (0)
 #else
@@ -32,6 +38,7 @@ using float64 = double;
 
 template<typename T1, typename T2> using Pair = std::pair<T1, T2>;
 
+#ifdef _WIN32
 using Microsoft::WRL::ComPtr;
 
 inline void DebugOut(const char* fmt, ...)
@@ -44,6 +51,16 @@ inline void DebugOut(const char* fmt, ...)
     ::OutputDebugStringA(buf);
     va_end(args);
 }
+#else
+// Headless builds have no debugger output window, so just print it.
+inline void DebugOut(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+#endif
 
 // TODO: Maybe encapsulate the double constant buffer to avoid other code having to deal with swap chains?
 static constexpr int BackbufferCount = 2;
@@ -0,0 +1,208 @@
+#include "HeightfieldRaycast.hpp"
+#include "MinMaxPyramid.hpp"
+
+namespace gaia
+{
+
+// Cells are the level below the pyramid's finest level.
+static constexpr int CellLevel = -1;
+
+// Exactly intersects the ray with the bilinear patch over a cell, for t in [tMin, tMax].
+static bool IntersectCell(const WrappedHeightfield& heightfield, Vec2i cell, const Vec3f& origin, const Vec3f& dir, float tMin, float tMax, float& outT)
+{
+    float h00 = heightfield.GetHeight(cell);
+    float h10 = heightfield.GetHeight(cell + Vec2i(1, 0));
+    float h01 = heightfield.GetHeight(cell + Vec2i(0, 1));
+    float h11 = heightfield.GetHeight(cell + Vec2i(1, 1));
+
+    // Relative to the cell and tMin: u = u0 + s * du, v = v0 + s * dv, for s in [0, tMax - tMin].
+    // The surface is h = h00 + a * u + b * v + c * u * v, so (ray height - surface height) is a quadratic in s.
+    Vec3f start = origin + tMin * dir;
+    float u0 = start.x - (float)cell.x;
+    float v0 = start.z - (float)cell.y;
+    float a = h10 - h00;
+    float b = h01 - h00;
+    float c = h00 - h10 - h01 + h11;
+    float c0 = start.y - (h00 + a * u0 + b * v0 + c * u0 * v0);
+    float c1 = dir.y - (a * dir.x + b * dir.z + c * (u0 * dir.z + v0 * dir.x));
+    float c2 = -c * dir.x * dir.z;
+    float sMax = tMax - tMin;
+
+    // Already below the surface (e.g. we stepped over a grazing hit at the cell edge).
+    if (c0 <= 0.f)
+    {
+        outT = tMin;
+        return true;
+    }
+
+    float roots[2];
+    int numRoots = 0;
+    if (fabsf(c2) < 1e-8f)
+    {
+        if (fabsf(c1) > 1e-12f)
+        {
+            roots[numRoots++] = -c0 / c1;
+        }
+    }
+    else
+    {
+        float discriminant = c1 * c1 - 4.f * c2 * c0;
+        if (discriminant >= 0.f)
+        {
+            // Numerically stable form, avoiding cancellation.
+            float q = -0.5f * (c1 + std::copysign(sqrtf(discriminant), c1));
+            roots[numRoots++] = q / c2;
+            if (q != 0.f)
+            {
+                roots[numRoots++] = c0 / q;
+            }
+        }
+    }
+
+    float best = FLT_MAX;
+    for (int i = 0; i < numRoots; ++i)
+    {
+        if (0.f <= roots[i] && roots[i] <= sMax)
+        {
+            best = std::min(best, roots[i]);
+        }
+    }
+
+    if (best == FLT_MAX)
+        return false;
+
+    outT = tMin + best;
+    return true;
+}
+
+// Clips [inOutTMin, inOutTMax] to where the ray is between min and max along one axis.
+static bool ClipRayToSlab(float origin, float dir, float min, float max, float& inOutTMin, float& inOutTMax)
+{
+    if (dir == 0.f)
+        return min <= origin && origin <= max;
+
+    float t0 = (min - origin) / dir;
+    float t1 = (max - origin) / dir;
+    inOutTMin = std::max(inOutTMin, std::min(t0, t1));
+    inOutTMax = std::min(inOutTMax, std::max(t0, t1));
+    return inOutTMin <= inOutTMax;
+}
+
+bool ClipRayToHeightfield(const WrappedHeightfield& heightfield, const Vec3f& origin, const Vec3f& dir, float& inOutTMin, float& inOutTMax)
+{
+    // Cells with all four corners valid.
+    const float size = (float)(heightfield.dimension - 1);
+    return ClipRayToSlab(origin.x, dir.x, (float)heightfield.validMin.x, (float)heightfield.validMin.x + size, inOutTMin, inOutTMax)
+        && ClipRayToSlab(origin.z, dir.z, (float)heightfield.validMin.y, (float)heightfield.validMin.y + size, inOutTMin, inOutTMax);
+}
+
+bool RaycastHeightfield(const WrappedHeightfield& heightfield, const Vec3f& origin, const Vec3f& dir, float tMin, float tMax, float& outT)
+{
+    Assert(heightfield.bounds && heightfield.bounds->GetDimension() == heightfield.dimension);
+    // Nothing above the highest texel can hit; anything below the lowest is underground, so is kept for the march to report.
+    Vec2f heightBounds = heightfield.bounds->GetBounds();
+    if (!ClipRayToHeightfield(heightfield, origin, dir, tMin, tMax) || !ClipRayToSlab(origin.y, dir.y, -FLT_MAX, heightBounds.y, tMin, tMax))
+        return false;
+
+    // Enough to step over a node boundary (a thousandth of a texel) without skipping any cells, when finding a child to go down into.
+    const float stepT = 1e-3f / std::max({ fabsf(dir.x), fabsf(dir.z), 1e-6f });
+    const int topLevel = heightfield.bounds->GetNumLevels() - 1;
+    const Vec2i maxCell = heightfield.validMin + Vec2i(heightfield.dimension - 2, heightfield.dimension - 2);
+    auto NodeTexels = [&](int level) { return level == CellLevel ? 1 : heightfield.bounds->GetNodeTexels(level); };
+    auto NodeAt = [&](float t, int level)
+    {
+        Vec3f p = origin + t * dir;
+        float nodeTexels = (float)NodeTexels(level);
+        return Vec2i((int)floorf(p.x / nodeTexels), (int)floorf(p.z / nodeTexels));
+    };
+    auto ParentShift = [&](int level) { return math::ILog2(NodeTexels(level + 1) / NodeTexels(level)); };
+
+    // Start at the top and go down wherever the ray might touch a node's heights, and back up once it leaves the parent.
+    // Children are looked up just past where the ray entered them (tEnter + stepT) and kept within their parent, but tested from exactly
+    // where it did (tEnter), so stepping over the boundary can't skip a hit. Neighbours are stepped to directly rather than looked up,
+    // as a step along an axis the ray barely moves on can be lost to rounding far from the origin.
+    int level = topLevel;
+    float tEnter = tMin;
+    Vec2i node = NodeAt(tMin, level);
+    for (;;)
+    {
+        if (level == CellLevel)
+        {
+            // The ray can end exactly on the last valid texel, or go down into a node just outside the first, either of which would
+            // otherwise read a cell past the edge.
+            node = math::clamp(node, heightfield.validMin, maxCell);
+        }
+
+        // Where the ray leaves this node, and through which sides.
+        int nodeTexels = NodeTexels(level);
+        float tExits[2] = { FLT_MAX, FLT_MAX };
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            float d = dir[2 * axis];
+            if (d != 0.f)
+            {
+                float edge = (float)((node[axis] + (d > 0.f ? 1 : 0)) * nodeTexels);
+                tExits[axis] = (edge - origin[2 * axis]) / d;
+            }
+        }
+        float tExit = std::max(std::min({ tExits[0], tExits[1], tMax }), tEnter);
+
+        Vec2f bounds = (level == CellLevel)
+            ? Vec2f(std::min({ heightfield.GetHeight(node), heightfield.GetHeight(node + Vec2i(1, 0)), heightfield.GetHeight(node + Vec2i(0, 1)), heightfield.GetHeight(node + Vec2i(1, 1)) }),
+                    std::max({ heightfield.GetHeight(node), heightfield.GetHeight(node + Vec2i(1, 0)), heightfield.GetHeight(node + Vec2i(0, 1)), heightfield.GetHeight(node + Vec2i(1, 1)) }))
+            : heightfield.GetNodeCellBounds(level, node);
+        float y0 = origin.y + tEnter * dir.y;
+        float y1 = origin.y + tExit * dir.y;
+
+        // Wholly below every texel under the node, so below the surface from where it came in (e.g. it started underground,
+        // or came in from outside the valid cells under the ground).
+        if (std::max(y0, y1) < bounds.x)
+        {
+            outT = tEnter;
+            return true;
+        }
+
+        bool overlaps = std::min(y0, y1) <= bounds.y;
+        if (overlaps && level == CellLevel)
+        {
+            if (IntersectCell(heightfield, node, origin, dir, tEnter, tExit, outT))
+                return true;
+        }
+        else if (overlaps)
+        {
+            --level;
+            int shift = ParentShift(level);
+            Vec2i firstChild = node << shift;
+            node = math::clamp(NodeAt(tEnter + stepT, level), firstChild, firstChild + Vec2i((1 << shift) - 1, (1 << shift) - 1));
+            continue;
+        }
+
+        if (tExit >= tMax)
+            break;
+
+        // Move on to the next node, through whichever sides the ray leaves by, going up for as long as that's in a different parent.
+        Vec2i next = node;
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            if (tExits[axis] <= tExit)
+            {
+                next[axis] += dir[2 * axis] > 0.f ? 1 : -1;
+            }
+        }
+        while (level < topLevel && (next >> ParentShift(level)) != (node >> ParentShift(level)))
+        {
+            next = next >> ParentShift(level);
+            node = node >> ParentShift(level);
+            ++level;
+        }
+        if (level == CellLevel && (next.x < heightfield.validMin.x || next.y < heightfield.validMin.y || next.x > maxCell.x || next.y > maxCell.y))
+            break; // Rounding left the ray short of tMax at the edge of the valid cells.
+
+        node = next;
+        tEnter = tExit;
+    }
+
+    return false;
+}
+
+}
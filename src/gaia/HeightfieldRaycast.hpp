@@ -0,0 +1,15 @@
+#pragma once
+#include "WrappedHeightfield.hpp"
+
+namespace gaia
+{
+
+// Intersects a ray with the bilinear surface through the texels of a height field, marching its min/max pyramid to skip empty space.
+// The ray is in texel space (x and z in level global texels, y in height units) and only t in [tMin, tMax] is considered,
+// within the cells whose corners are all valid. Returns whether it hit, and if so the first t where it did.
+bool RaycastHeightfield(const WrappedHeightfield& heightfield, const Vec3f& origin, const Vec3f& dir, float tMin, float tMax, float& outT);
+
+// Clips [inOutTMin, inOutTMax] to where the ray is over (or under) the valid cells of a height field. Returns false if nothing is left.
+bool ClipRayToHeightfield(const WrappedHeightfield& heightfield, const Vec3f& origin, const Vec3f& dir, float& inOutTMin, float& inOutTMax);
+
+}
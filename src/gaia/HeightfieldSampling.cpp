@@ -0,0 +1,107 @@
+#include "HeightfieldSampling.hpp"
+
+namespace gaia
+{
+
+// Floor for SSE2, which has no rounding instructions: truncate, then step down where that rounded up (negative inputs).
+static inline __m128i FloorToInt(__m128 x, __m128& outFloor)
+{
+    __m128i truncated = _mm_cvttps_epi32(x);
+    __m128 floor = _mm_cvtepi32_ps(truncated);
+    __m128 roundedUp = _mm_cmpgt_ps(floor, x);
+    outFloor = _mm_sub_ps(floor, _mm_and_ps(roundedUp, _mm_set1_ps(1.f)));
+    return _mm_add_epi32(truncated, _mm_castps_si128(roundedUp)); // The mask is -1 where we rounded up.
+}
+
+// Samples four positions, writing the lanes below numValid.
+static inline void SampleFour(const WrappedHeightfield& heightfield, __m128 x, __m128 z, const int* indices, int numValid,
+    float invWorldTexelSize, int rowShift, float* outHeights, Vec3f* outNormals)
+{
+    __m128 floorX, floorZ;
+    __m128i cellX = FloorToInt(x, floorX);
+    __m128i cellZ = FloorToInt(z, floorZ);
+    __m128 u = _mm_sub_ps(x, floorX);
+    __m128 v = _mm_sub_ps(z, floorZ);
+
+    // Wrap the corners into the map. SSE2 can't multiply 32 bit ints, but the dimension is a power of two.
+    const __m128i mask = _mm_set1_epi32(heightfield.dimension - 1);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i shift = _mm_cvtsi32_si128(rowShift);
+    __m128i x0 = _mm_and_si128(cellX, mask);
+    __m128i x1 = _mm_and_si128(_mm_add_epi32(cellX, one), mask);
+    __m128i row0 = _mm_sll_epi32(_mm_and_si128(cellZ, mask), shift);
+    __m128i row1 = _mm_sll_epi32(_mm_and_si128(_mm_add_epi32(cellZ, one), mask), shift);
+
+    alignas(16) int i00[4], i10[4], i01[4], i11[4];
+    _mm_store_si128((__m128i*)i00, _mm_add_epi32(row0, x0));
+    _mm_store_si128((__m128i*)i10, _mm_add_epi32(row0, x1));
+    _mm_store_si128((__m128i*)i01, _mm_add_epi32(row1, x0));
+    _mm_store_si128((__m128i*)i11, _mm_add_epi32(row1, x1));
+
+    // No gathers in SSE; the loads are the only scalar part.
+    const float* heights = heightfield.heights;
+    __m128 h00 = _mm_setr_ps(heights[i00[0]], heights[i00[1]], heights[i00[2]], heights[i00[3]]);
+    __m128 h10 = _mm_setr_ps(heights[i10[0]], heights[i10[1]], heights[i10[2]], heights[i10[3]]);
+    __m128 h01 = _mm_setr_ps(heights[i01[0]], heights[i01[1]], heights[i01[2]], heights[i01[3]]);
+    __m128 h11 = _mm_setr_ps(heights[i11[0]], heights[i11[1]], heights[i11[2]], heights[i11[3]]);
+
+    __m128 dx0 = _mm_sub_ps(h10, h00); // Along x at z0 and z1.
+    __m128 dx1 = _mm_sub_ps(h11, h01);
+    __m128 h0 = _mm_add_ps(h00, _mm_mul_ps(u, dx0));
+    __m128 h1 = _mm_add_ps(h01, _mm_mul_ps(u, dx1));
+    alignas(16) float h[4];
+    _mm_store_ps(h, _mm_add_ps(h0, _mm_mul_ps(v, _mm_sub_ps(h1, h0))));
+    for (int lane = 0; lane < numValid; ++lane)
+    {
+        outHeights[indices[lane]] = h[lane];
+    }
+
+    if (!outNormals)
+        return;
+
+    // Normal of the bilinear patch, (-dh/dx, 1, -dh/dz) normalised, with the slopes converted from texels to world units.
+    __m128 slopeX = _mm_add_ps(dx0, _mm_mul_ps(v, _mm_sub_ps(dx1, dx0)));
+    __m128 slopeZ = _mm_sub_ps(h1, h0);
+    const __m128 scale = _mm_set1_ps(-invWorldTexelSize);
+    __m128 nx = _mm_mul_ps(slopeX, scale);
+    __m128 nz = _mm_mul_ps(slopeZ, scale);
+    const __m128 ones = _mm_set1_ps(1.f);
+    __m128 invLength = _mm_div_ps(ones, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz)), ones)));
+
+    alignas(16) float normalX[4], normalY[4], normalZ[4];
+    _mm_store_ps(normalX, _mm_mul_ps(nx, invLength));
+    _mm_store_ps(normalY, invLength);
+    _mm_store_ps(normalZ, _mm_mul_ps(nz, invLength));
+    for (int lane = 0; lane < numValid; ++lane)
+    {
+        outNormals[indices[lane]] = Vec3f(normalX[lane], normalY[lane], normalZ[lane]);
+    }
+}
+
+void SampleHeightfield(const WrappedHeightfield& heightfield, const float* x, const float* z, const int* indices, int count,
+    float worldTexelSize, float* outHeights, Vec3f* outNormals)
+{
+    Assert(math::IsPow2(heightfield.dimension));
+    const int rowShift = math::ILog2(heightfield.dimension);
+    const float invWorldTexelSize = 1.f / worldTexelSize;
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        SampleFour(heightfield, _mm_loadu_ps(x + i), _mm_loadu_ps(z + i), indices + i, 4, invWorldTexelSize, rowShift, outHeights, outNormals);
+    }
+
+    // Pad the remainder by repeating the last position; only the real lanes are written.
+    if (i < count)
+    {
+        alignas(16) float tailX[4], tailZ[4];
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            tailX[lane] = x[std::min(i + lane, count - 1)];
+            tailZ[lane] = z[std::min(i + lane, count - 1)];
+        }
+        SampleFour(heightfield, _mm_load_ps(tailX), _mm_load_ps(tailZ), indices + i, count - i, invWorldTexelSize, rowShift, outHeights, outNormals);
+    }
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "WrappedHeightfield.hpp"
+
+namespace gaia
+{
+
+// Bilinearly interpolates a height field at count texel space positions (x and z in level global texels, SoA), four at a time with SSE.
+// Every position must lie within the cells whose corners are all valid. Result i is written to outHeights[indices[i]],
+// so callers can sort positions for locality and still get results in their own order.
+// If outNormals isn't null, also writes the normals of the bilinear surface; worldTexelSize is the world distance between texels.
+void SampleHeightfield(const WrappedHeightfield& heightfield, const float* x, const float* z, const int* indices, int count,
+    float worldTexelSize, float* outHeights, Vec3f* outNormals);
+
+}
@@ -0,0 +1,598 @@
+#include "HeightfieldSweep.hpp"
+#include "MinMaxPyramid.hpp"
+
+namespace gaia
+{
+
+// Depth of the traversal stack: up to four roots, then four children for each level below.
+static constexpr int MaxStackDepth = 64;
+
+struct Triangle
+{
+    Vec3f v[3];
+};
+
+// Earliest t in [0, tMax] when a point moving along dir is within radius of centre; 0 if it starts there.
+static bool SweepPointSphere(const Vec3f& origin, const Vec3f& dir, const Vec3f& centre, float radius, float tMax, float& outT)
+{
+    Vec3f m = origin - centre;
+    float c = math::dot(m, m) - radius * radius;
+    if (c <= 0.f)
+    {
+        outT = 0.f;
+        return true;
+    }
+
+    float a = math::dot(dir, dir);
+    float b = math::dot(m, dir);
+    float discriminant = b * b - a * c;
+    if (b >= 0.f || discriminant < 0.f)
+        return false;
+
+    float t = (-b - sqrtf(discriminant)) / a;
+    if (t > tMax)
+        return false;
+
+    outT = t;
+    return true;
+}
+
+// As above, for the side of the cylinder around the segment [p0, p1]: within radius of the segment, closest to a point between its ends.
+// Touching the ends first is left to a sphere at each end.
+static bool SweepPointCylinder(const Vec3f& origin, const Vec3f& dir, const Vec3f& p0, const Vec3f& p1, float radius, float tMax, float& outT)
+{
+    Vec3f axis = p1 - p0;
+    float axisLengthSq = math::dot(axis, axis);
+    if (axisLengthSq < 1e-12f)
+        return false;
+
+    // Work perpendicular to the axis, where the cylinder is a circle.
+    Vec3f m = origin - p0;
+    float mAlong = math::dot(m, axis);
+    float dirAlong = math::dot(dir, axis);
+    Vec3f mPerp = m - axis * (mAlong / axisLengthSq);
+    Vec3f dirPerp = dir - axis * (dirAlong / axisLengthSq);
+    float a = math::dot(dirPerp, dirPerp);
+    float b = math::dot(mPerp, dirPerp);
+    float c = math::dot(mPerp, mPerp) - radius * radius;
+
+    float t = 0.f;
+    if (c > 0.f)
+    {
+        float discriminant = b * b - a * c;
+        if (b >= 0.f || a < 1e-12f || discriminant < 0.f)
+            return false;
+
+        t = (-b - sqrtf(discriminant)) / a;
+        if (t > tMax)
+            return false;
+    }
+
+    float s = (mAlong + t * dirAlong) / axisLengthSq;
+    if (s < 0.f || s > 1.f)
+        return false;
+
+    outT = t;
+    return true;
+}
+
+// Closest point to p on a triangle (Ericson, Real-Time Collision Detection 5.1.5).
+static Vec3f ClosestPointOnTriangle(const Vec3f& p, const Triangle& tri)
+{
+    const Vec3f& a = tri.v[0];
+    const Vec3f& b = tri.v[1];
+    const Vec3f& c = tri.v[2];
+    Vec3f ab = b - a;
+    Vec3f ac = c - a;
+    Vec3f ap = p - a;
+    float d1 = math::dot(ab, ap);
+    float d2 = math::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+        return a;
+
+    Vec3f bp = p - b;
+    float d3 = math::dot(ab, bp);
+    float d4 = math::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+        return b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+        return a + ab * (d1 / (d1 - d3));
+
+    Vec3f cp = p - c;
+    float d5 = math::dot(ab, cp);
+    float d6 = math::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+        return c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+        return a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denom = 1.f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Closest points between segments [p0, p1] and [q0, q1] (Ericson 5.1.9).
+static void ClosestPointsOnSegments(const Vec3f& p0, const Vec3f& p1, const Vec3f& q0, const Vec3f& q1, Vec3f& outP, Vec3f& outQ)
+{
+    Vec3f d1 = p1 - p0;
+    Vec3f d2 = q1 - q0;
+    Vec3f r = p0 - q0;
+    float a = math::dot(d1, d1);
+    float e = math::dot(d2, d2);
+    float f = math::dot(d2, r);
+    float s = 0.f;
+    float t = 0.f;
+    if (a < 1e-12f && e < 1e-12f)
+    {
+        // Both are points.
+    }
+    else if (a < 1e-12f)
+    {
+        t = math::clamp(f / e, 0.f, 1.f);
+    }
+    else
+    {
+        float c = math::dot(d1, r);
+        if (e < 1e-12f)
+        {
+            s = math::clamp(-c / a, 0.f, 1.f);
+        }
+        else
+        {
+            float b = math::dot(d1, d2);
+            float denom = a * e - b * b;
+            s = (denom != 0.f) ? math::clamp((b * f - c * e) / denom, 0.f, 1.f) : 0.f;
+            t = (b * s + f) / e;
+            if (t < 0.f)
+            {
+                t = 0.f;
+                s = math::clamp(-c / a, 0.f, 1.f);
+            }
+            else if (t > 1.f)
+            {
+                t = 1.f;
+                s = math::clamp((b - c) / a, 0.f, 1.f);
+            }
+        }
+    }
+    outP = p0 + d1 * s;
+    outQ = q0 + d2 * t;
+}
+
+// Where the segment [p0, p1] crosses a triangle, if it does (Moller-Trumbore, limited to the segment).
+static bool SegmentIntersectsTriangle(const Vec3f& p0, const Vec3f& p1, const Triangle& tri, Vec3f& outPoint)
+{
+    Vec3f dir = p1 - p0;
+    Vec3f e1 = tri.v[1] - tri.v[0];
+    Vec3f e2 = tri.v[2] - tri.v[0];
+    Vec3f p = math::cross(dir, e2);
+    float det = math::dot(e1, p);
+    if (fabsf(det) < 1e-12f)
+        return false;
+
+    float invDet = 1.f / det;
+    Vec3f s = p0 - tri.v[0];
+    float u = math::dot(s, p) * invDet;
+    if (u < 0.f || u > 1.f)
+        return false;
+
+    Vec3f q = math::cross(s, e1);
+    float v = math::dot(dir, q) * invDet;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+
+    float t = math::dot(e2, q) * invDet;
+    if (t < 0.f || t > 1.f)
+        return false;
+
+    outPoint = p0 + t * dir;
+    return true;
+}
+
+// Earliest t in [0, tMax] when a sphere moving by delta touches a triangle: its face, the sides of its edges, then its corners.
+static bool SweepSphereTriangle(const Vec3f& centre, float radius, const Vec3f& delta, const Triangle& tri, float tMax, float& outT)
+{
+    float best = tMax;
+    bool hit = false;
+
+    // Face, facing whichever side the sphere starts on.
+    Vec3f faceNormal = math::cross(tri.v[1] - tri.v[0], tri.v[2] - tri.v[0]);
+    float normalLength = math::length(faceNormal);
+    if (normalLength > 1e-12f)
+    {
+        faceNormal /= normalLength;
+        Vec3f normal = faceNormal;
+        float distance = math::dot(centre - tri.v[0], normal);
+        if (distance < 0.f)
+        {
+            normal = -normal;
+            distance = -distance;
+        }
+
+        float approach = math::dot(delta, normal);
+        float t = (distance <= radius) ? 0.f : (approach < 0.f ? (radius - distance) / approach : FLT_MAX);
+        if (t <= best)
+        {
+            // Check the point on the plane under the sphere's centre is inside the triangle.
+            Vec3f c = centre + t * delta;
+            Vec3f p = c - normal * math::dot(c - tri.v[0], normal);
+            bool inside = true;
+            for (int i = 0; i < 3; ++i)
+            {
+                inside &= math::dot(math::cross(tri.v[(i + 1) % 3] - tri.v[i], p - tri.v[i]), faceNormal) >= 0.f;
+            }
+            if (inside)
+            {
+                best = t;
+                hit = true;
+            }
+        }
+    }
+
+    float t;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (SweepPointCylinder(centre, delta, tri.v[i], tri.v[(i + 1) % 3], radius, best, t))
+        {
+            best = t;
+            hit = true;
+        }
+        if (SweepPointSphere(centre, delta, tri.v[i], radius, best, t))
+        {
+            best = t;
+            hit = true;
+        }
+    }
+
+    outT = best;
+    return hit;
+}
+
+// Earliest t in [0, tMax] when the axes of a capsule moving by delta and a triangle edge come within radius of each other, away from either's ends.
+static bool SweepSegmentEdge(const Vec3f& p0, const Vec3f& p1, float radius, const Vec3f& delta, const Vec3f& q0, const Vec3f& q1, float tMax, float& outT)
+{
+    // The lines' distance only changes along their common normal, so solve along that.
+    Vec3f u = p1 - p0;
+    Vec3f e = q1 - q0;
+    Vec3f normal = math::cross(u, e);
+    float normalLengthSq = math::dot(normal, normal);
+    if (normalLengthSq < 1e-8f * math::dot(u, u) * math::dot(e, e))
+        return false; // Parallel; the ends get there first.
+
+    normal /= sqrtf(normalLengthSq);
+    float distance = math::dot(p0 - q0, normal);
+    float approach = math::dot(delta, normal);
+    float t;
+    if (fabsf(distance) <= radius)
+    {
+        t = 0.f;
+    }
+    else if (distance * approach < 0.f)
+    {
+        t = (std::copysign(radius, distance) - distance) / approach;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (t > tMax)
+        return false;
+
+    // Check the closest points of the lines are within both segments then.
+    Vec3f r = p0 + t * delta - q0;
+    float a = math::dot(u, u);
+    float b = math::dot(u, e);
+    float c = math::dot(u, r);
+    float f = math::dot(e, r);
+    float denom = a * math::dot(e, e) - b * b;
+    float s = (b * f - c * math::dot(e, e)) / denom;
+    float w = (a * f - b * c) / denom;
+    if (s < 0.f || s > 1.f || w < 0.f || w > 1.f)
+        return false;
+
+    outT = t;
+    return true;
+}
+
+// Earliest t in [0, tMax] when a capsule moving by delta touches a triangle. First contact is always between one of:
+// an end sphere and the triangle, a triangle corner and the capsule's side, or a triangle edge and the capsule's side.
+static bool SweepCapsuleTriangle(const Vec3f& p0, const Vec3f& p1, float radius, const Vec3f& delta, const Triangle& tri, float tMax, float& outT)
+{
+    float best = tMax;
+    bool hit = false;
+    float t;
+
+    // The axis already passing through the triangle; anything that does so later touches it first.
+    Vec3f crossing;
+    if (SegmentIntersectsTriangle(p0, p1, tri, crossing))
+    {
+        outT = 0.f;
+        return true;
+    }
+
+    if (SweepSphereTriangle(p0, radius, delta, tri, best, t))
+    {
+        best = t;
+        hit = true;
+    }
+    if (SweepSphereTriangle(p1, radius, delta, tri, best, t))
+    {
+        best = t;
+        hit = true;
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        // A corner moving the other way, against the capsule standing still.
+        if (SweepPointCylinder(tri.v[i], -delta, p0, p1, radius, best, t))
+        {
+            best = t;
+            hit = true;
+        }
+        if (SweepSegmentEdge(p0, p1, radius, delta, tri.v[i], tri.v[(i + 1) % 3], best, t))
+        {
+            best = t;
+            hit = true;
+        }
+    }
+
+    outT = best;
+    return hit;
+}
+
+// Closest points between a segment (a point if p0 == p1) and a triangle.
+static void ClosestPointsSegmentTriangle(const Vec3f& p0, const Vec3f& p1, const Triangle& tri, Vec3f& outSegmentPoint, Vec3f& outTrianglePoint)
+{
+    Vec3f crossing;
+    if (SegmentIntersectsTriangle(p0, p1, tri, crossing))
+    {
+        outSegmentPoint = crossing;
+        outTrianglePoint = crossing;
+        return;
+    }
+
+    float bestDistanceSq = FLT_MAX;
+    auto Consider = [&](const Vec3f& segmentPoint, const Vec3f& trianglePoint)
+    {
+        float distanceSq = math::dot(segmentPoint - trianglePoint, segmentPoint - trianglePoint);
+        if (distanceSq < bestDistanceSq)
+        {
+            bestDistanceSq = distanceSq;
+            outSegmentPoint = segmentPoint;
+            outTrianglePoint = trianglePoint;
+        }
+    };
+
+    Consider(p0, ClosestPointOnTriangle(p0, tri));
+    Consider(p1, ClosestPointOnTriangle(p1, tri));
+    for (int i = 0; i < 3; ++i)
+    {
+        Vec3f segmentPoint, edgePoint;
+        ClosestPointsOnSegments(p0, p1, tri.v[i], tri.v[(i + 1) % 3], segmentPoint, edgePoint);
+        Consider(segmentPoint, edgePoint);
+    }
+}
+
+// The two triangles of a cell, in height field space.
+static void GetCellTriangles(const WrappedHeightfield& heightfield, float texelSize, Vec2i cell, Triangle (&outTriangles)[2])
+{
+    Vec3f v00((float)cell.x * texelSize, heightfield.GetHeight(cell), (float)cell.y * texelSize);
+    Vec3f v10(v00.x + texelSize, heightfield.GetHeight(cell + Vec2i(1, 0)), v00.z);
+    Vec3f v01(v00.x, heightfield.GetHeight(cell + Vec2i(0, 1)), v00.z + texelSize);
+    Vec3f v11(v00.x + texelSize, heightfield.GetHeight(cell + Vec2i(1, 1)), v00.z + texelSize);
+    outTriangles[0] = { { v00, v10, v11 } };
+    outTriangles[1] = { { v00, v11, v01 } };
+}
+
+// Earliest t in [0, tMax] that a box of the given half extents, moving from centre by delta, overlaps [boxMin, boxMax]. Returns FLT_MAX if it doesn't.
+static float SweepBoxEntry(const Vec3f& centre, const Vec3f& extent, const Vec3f& delta, const Vec3f& boxMin, const Vec3f& boxMax, float tMax)
+{
+    float tEnter = 0.f;
+    float tExit = tMax;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float min = boxMin[axis] - extent[axis];
+        float max = boxMax[axis] + extent[axis];
+        if (delta[axis] == 0.f)
+        {
+            if (centre[axis] < min || centre[axis] > max)
+                return FLT_MAX;
+
+            continue;
+        }
+
+        float t0 = (min - centre[axis]) / delta[axis];
+        float t1 = (max - centre[axis]) / delta[axis];
+        tEnter = std::max(tEnter, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+    }
+    return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+
+// Walks the pyramid nearest first, calling sweepTriangle on the triangles of every valid cell the moving box might reach before the best hit so far.
+// sweepTriangle(triangle, tMax, outT) returns whether it hit before tMax.
+template <typename SweepTriangleFunc>
+static bool SweepHeightfield(const WrappedHeightfield& heightfield, float texelSize, const Vec3f& centre, const Vec3f& extent, const Vec3f& delta,
+    const SweepTriangleFunc& sweepTriangle, float& outT, Triangle& outTriangle)
+{
+    Assert(heightfield.bounds && heightfield.bounds->GetDimension() == heightfield.dimension);
+    const MinMaxPyramid& pyramid = *heightfield.bounds;
+    const Vec2i cellsMin = heightfield.validMin;
+    const Vec2i cellsMax = heightfield.validMin + Vec2i(heightfield.dimension - 2, heightfield.dimension - 2); // Inclusive.
+
+    struct Node
+    {
+        int level;
+        Vec2i coords;
+        float tEnter;
+    };
+
+    float tMax = 1.f; // Shrinks to the best hit so far.
+    auto NodeEntry = [&](int level, Vec2i coords, Vec2f heightBounds)
+    {
+        // Cells covered by the node, clipped to the valid ones.
+        int nodeTexels = pyramid.GetNodeTexels(level);
+        Vec2i min = math::max(coords * nodeTexels, cellsMin);
+        Vec2i max = math::min((coords + Vec2i(1, 1)) * nodeTexels - Vec2i(1, 1), cellsMax);
+        if (min.x > max.x || min.y > max.y)
+            return FLT_MAX;
+
+        Vec3f boxMin((float)min.x * texelSize, heightBounds.x, (float)min.y * texelSize);
+        Vec3f boxMax((float)(max.x + 1) * texelSize, heightBounds.y, (float)(max.y + 1) * texelSize);
+        return SweepBoxEntry(centre, extent, delta, boxMin, boxMax, tMax);
+    };
+
+    Node stack[MaxStackDepth];
+    int stackSize = 0;
+    auto PushSorted = [&](Node (&nodes)[4], int numNodes)
+    {
+        // Push the furthest first, so the nearest is popped first. At most four, so an insertion sort.
+        for (int i = 1; i < numNodes; ++i)
+        {
+            Node node = nodes[i];
+            int j = i;
+            for (; j > 0 && nodes[j - 1].tEnter < node.tEnter; --j)
+            {
+                nodes[j] = nodes[j - 1];
+            }
+            nodes[j] = node;
+        }
+        for (int i = 0; i < numNodes; ++i)
+        {
+            Assert(stackSize < MaxStackDepth);
+            stack[stackSize++] = nodes[i];
+        }
+    };
+
+    // The valid cells overlap at most two top level nodes along each axis.
+    const int topLevel = pyramid.GetNumLevels() - 1;
+    const int topNodeShift = math::ILog2(pyramid.GetNodeTexels(topLevel));
+    Node roots[4];
+    int numRoots = 0;
+    for (int z = cellsMin.y >> topNodeShift; z <= cellsMax.y >> topNodeShift; ++z)
+    {
+        for (int x = cellsMin.x >> topNodeShift; x <= cellsMax.x >> topNodeShift; ++x)
+        {
+            float tEnter = NodeEntry(topLevel, Vec2i(x, z), heightfield.GetNodeCellBounds(topLevel, Vec2i(x, z)));
+            if (tEnter != FLT_MAX)
+            {
+                roots[numRoots++] = { topLevel, Vec2i(x, z), tEnter };
+            }
+        }
+    }
+    PushSorted(roots, numRoots);
+
+    outT = FLT_MAX;
+    bool hit = false;
+    while (stackSize > 0)
+    {
+        Node node = stack[--stackSize];
+        if (node.tEnter > tMax)
+            continue;
+
+        if (node.level > 0)
+        {
+            Node children[4];
+            int numChildren = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                Vec2i coords = 2 * node.coords + Vec2i(i & 1, i >> 1);
+                float tEnter = NodeEntry(node.level - 1, coords, heightfield.GetNodeCellBounds(node.level - 1, coords));
+                if (tEnter <= tMax)
+                {
+                    children[numChildren++] = { node.level - 1, coords, tEnter };
+                }
+            }
+            PushSorted(children, numChildren);
+            continue;
+        }
+
+        // Finest nodes: test each valid cell's box, then its triangles.
+        const int nodeTexels = pyramid.GetNodeTexels(0);
+        Vec2i min = math::max(node.coords * nodeTexels, cellsMin);
+        Vec2i max = math::min((node.coords + Vec2i(1, 1)) * nodeTexels - Vec2i(1, 1), cellsMax);
+        for (int z = min.y; z <= max.y; ++z)
+        {
+            for (int x = min.x; x <= max.x; ++x)
+            {
+                Triangle triangles[2];
+                GetCellTriangles(heightfield, texelSize, Vec2i(x, z), triangles);
+                Vec3f cellMin = math::min(math::min(triangles[0].v[0], triangles[0].v[1]), math::min(triangles[0].v[2], triangles[1].v[2]));
+                Vec3f cellMax = math::max(math::max(triangles[0].v[0], triangles[0].v[1]), math::max(triangles[0].v[2], triangles[1].v[2]));
+                if (SweepBoxEntry(centre, extent, delta, cellMin, cellMax, tMax) == FLT_MAX)
+                    continue;
+
+                for (const Triangle& triangle : triangles)
+                {
+                    float t;
+                    if (sweepTriangle(triangle, tMax, t))
+                    {
+                        tMax = t;
+                        outT = t;
+                        outTriangle = triangle;
+                        hit = true;
+                    }
+                }
+            }
+        }
+    }
+    return hit;
+}
+
+bool SweepSphereHeightfield(const WrappedHeightfield& heightfield, float texelSize, const Spheref& sphere, const Vec3f& delta, SweepHit& outHit)
+{
+    auto SweepTriangle = [&](const Triangle& triangle, float tMax, float& outT)
+    {
+        return SweepSphereTriangle(sphere.m_centre, sphere.m_radius, delta, triangle, tMax, outT);
+    };
+
+    float t;
+    Triangle triangle;
+    const Vec3f extent(sphere.m_radius);
+    if (!SweepHeightfield(heightfield, texelSize, sphere.m_centre, extent, delta, SweepTriangle, t, triangle))
+        return false;
+
+    Vec3f centre = sphere.m_centre + t * delta;
+    Vec3f point = ClosestPointOnTriangle(centre, triangle);
+    Vec3f separation = centre - point;
+    float distance = math::length(separation);
+    outHit.time = t;
+    outHit.point = point;
+    outHit.normal = distance > 1e-6f ? separation / distance : math::normalize(math::cross(triangle.v[2] - triangle.v[0], triangle.v[1] - triangle.v[0]));
+    return true;
+}
+
+bool SweepCapsuleHeightfield(const WrappedHeightfield& heightfield, float texelSize, const Capsulef& capsule, const Vec3f& delta, SweepHit& outHit)
+{
+    auto SweepTriangle = [&](const Triangle& triangle, float tMax, float& outT)
+    {
+        return SweepCapsuleTriangle(capsule.m_start, capsule.m_end, capsule.m_radius, delta, triangle, tMax, outT);
+    };
+
+    // The broad phase moves the capsule's bounding box.
+    float t;
+    Triangle triangle;
+    const Vec3f centre = 0.5f * (capsule.m_start + capsule.m_end);
+    const Vec3f extent = 0.5f * math::abs(capsule.m_end - capsule.m_start) + Vec3f(capsule.m_radius);
+    if (!SweepHeightfield(heightfield, texelSize, centre, extent, delta, SweepTriangle, t, triangle))
+        return false;
+
+    Vec3f axisPoint, point;
+    ClosestPointsSegmentTriangle(capsule.m_start + t * delta, capsule.m_end + t * delta, triangle, axisPoint, point);
+    Vec3f separation = axisPoint - point;
+    float distance = math::length(separation);
+    outHit.time = t;
+    outHit.point = point;
+    outHit.normal = distance > 1e-6f ? separation / distance : math::normalize(math::cross(triangle.v[2] - triangle.v[0], triangle.v[1] - triangle.v[0]));
+    return true;
+}
+
+}
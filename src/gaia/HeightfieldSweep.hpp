@@ -0,0 +1,24 @@
+#pragma once
+#include "Math/Capsule.hpp"
+#include "Math/Sphere.hpp"
+#include "WrappedHeightfield.hpp"
+
+namespace gaia
+{
+
+struct SweepHit
+{
+    float time = FLT_MAX;    // Fraction of the movement completed before touching; 0 if the shape started touching.
+    Vec3f point = Vec3fZero; // Contact point on the surface.
+    Vec3f normal = Vec3fY;   // Unit normal at the contact, pointing from the surface towards the shape.
+};
+
+// Continuous collision of shapes moving through a height field, treating each cell as two triangles split along its (0, 0) to (1, 1) diagonal.
+// Shapes are in height field space: x and z in world units from level global texel (0, 0), i.e. texel coords scaled by texelSize,
+// and y in height units. The height field's min/max pyramid is used to skip cells the shape can't reach, so only the cells near its path are tested.
+// Only the cells whose corners are all valid take part.
+// Returns whether the shape touches the surface while moving by delta, and if so the first contact.
+bool SweepSphereHeightfield(const WrappedHeightfield& heightfield, float texelSize, const Spheref& sphere, const Vec3f& delta, SweepHit& outHit);
+bool SweepCapsuleHeightfield(const WrappedHeightfield& heightfield, float texelSize, const Capsulef& capsule, const Vec3f& delta, SweepHit& outHit);
+
+}
@@ -0,0 +1,130 @@
+#include "HeightfieldVisibility.hpp"
+#include "MinMaxPyramid.hpp"
+
+namespace gaia
+{
+
+// Traces one line of sight of a viewshed, from the observer out to the offset edge (whose major axis component is the radius).
+static void TraceViewshedRay(const WrappedHeightfield& heightfield, Vec2i observerCell, float eyeHeight, float targetHeight, int radius, Vec2i edge, uint8* outVisible)
+{
+    const MinMaxPyramid& pyramid = *heightfield.bounds;
+    const int dimension = 2 * radius + 1;
+    const int major = abs(edge.x) >= abs(edge.y) ? 0 : 1;
+    const int minor = 1 - major;
+    const int majorSign = edge[major] > 0 ? 1 : -1;
+    const float minorStep = (float)edge[minor] / (float)radius;
+    const Vec2i validMin = heightfield.validMin;
+    const Vec2i validMax = heightfield.validMin + Vec2i(heightfield.dimension - 1, heightfield.dimension - 1); // Inclusive.
+
+    // Distances along the ray are in steps of the major axis; they're all scaled the same, so slopes still compare.
+    float maxSlope = -FLT_MAX;
+    int step = 1;
+    const int finestNodeShift = math::ILog2(pyramid.GetNodeTexels(0));
+    Vec2i checkedNode(INT_MAX, INT_MAX); // Finest node last tried for skipping; only try again once the ray moves into another one.
+    bool occluded = false;               // Whether the last step was below the horizon; skipping is only worth trying from there.
+    while (step <= radius)
+    {
+        float minorPos = (float)observerCell[minor] + minorStep * (float)step;
+        Vec2i texel;
+        texel[major] = observerCell[major] + majorSign * step;
+        texel[minor] = (int)floorf(minorPos);
+
+        // The horizon interpolates between the texels either side of the ray, so both need to be valid. Within half a step past the
+        // first or last valid row or column there's still a cell to see, and the horizon there comes from its texel alone.
+        float t = minorPos - (float)texel[minor];
+        Vec2i nextTexel = texel;
+        nextTexel[minor] += 1;
+        if (texel[major] < validMin[major] || texel[major] > validMax[major] || nextTexel[minor] < validMin[minor] || texel[minor] > validMax[minor])
+            break;
+        if (texel[minor] < validMin[minor])
+        {
+            if (t < 0.5f)
+                break;
+            texel = nextTexel;
+        }
+        else if (nextTexel[minor] > validMax[minor])
+        {
+            if (t >= 0.5f)
+                break;
+            nextTexel = texel;
+        }
+
+        // Skip the biggest pyramid node (and the ray's steps within it) that's wholly below the horizon; nothing in it can be seen or raise the horizon.
+        const Vec2i finestNode = texel >> finestNodeShift;
+        if (occluded && finestNode != checkedNode)
+        {
+            checkedNode = finestNode;
+            int skipTo = 0;
+            for (int level = 0; level < pyramid.GetNumLevels(); ++level)
+            {
+                // Last step whose texels are in this node.
+                const int nodeTexels = pyramid.GetNodeTexels(level);
+                Vec2i node = texel >> (finestNodeShift + level);
+                int nodeMajorMin = node[major] * nodeTexels;
+                int lastStep = (majorSign > 0) ? nodeMajorMin + nodeTexels - 1 - observerCell[major] : observerCell[major] - nodeMajorMin;
+                if (minorStep != 0.f)
+                {
+                    float nodeMinorEdge = (float)(node[minor] * nodeTexels + (minorStep > 0.f ? nodeTexels : 0));
+                    lastStep = std::min(lastStep, (int)((nodeMinorEdge - (float)observerCell[minor]) / minorStep));
+                    while (lastStep > step && (int)floorf(((float)observerCell[minor] + minorStep * (float)lastStep) / (float)nodeTexels) != node[minor])
+                    {
+                        --lastStep; // Rounding took it into the next node.
+                    }
+                }
+                lastStep = std::min(lastStep, radius);
+
+                // Lowest the horizon gets over those steps.
+                float horizon = eyeHeight + maxSlope * (float)(maxSlope >= 0.f ? step : lastStep);
+                if (heightfield.GetNodeCellBounds(level, node).y + targetHeight >= horizon)
+                    break;
+
+                skipTo = lastStep + 1;
+            }
+
+            if (skipTo > step)
+            {
+                step = skipTo;
+                continue;
+            }
+        }
+
+        float height = heightfield.GetHeight(texel) + t * (heightfield.GetHeight(nextTexel) - heightfield.GetHeight(texel));
+        Vec2i cell = (t < 0.5f) ? texel : nextTexel;
+        float targetSlope = (heightfield.GetHeight(cell) + targetHeight - eyeHeight) / (float)step;
+        if (targetSlope >= maxSlope)
+        {
+            Vec2i offset = cell - observerCell;
+            outVisible[dimension * (offset.y + radius) + (offset.x + radius)] = 1;
+        }
+        float slope = (height - eyeHeight) / (float)step;
+        occluded = slope < maxSlope;
+        maxSlope = std::max(maxSlope, slope);
+        ++step;
+    }
+}
+
+void ComputeViewshed(const WrappedHeightfield& heightfield, Vec2i observerCell, float observerHeight, float targetHeight, int radius, uint8* outVisible)
+{
+    Assert(heightfield.bounds && heightfield.bounds->GetDimension() == heightfield.dimension);
+    Assert(radius >= 0 && targetHeight >= 0.f);
+    const int dimension = 2 * radius + 1;
+    std::fill(outVisible, outVisible + math::Square(dimension), (uint8)0);
+
+    const Vec2i validMax = heightfield.validMin + Vec2i(heightfield.dimension - 1, heightfield.dimension - 1);
+    if (observerCell.x < heightfield.validMin.x || observerCell.y < heightfield.validMin.y || observerCell.x > validMax.x || observerCell.y > validMax.y)
+        return;
+
+    outVisible[dimension * radius + radius] = 1;
+    const float eyeHeight = heightfield.GetHeight(observerCell) + observerHeight;
+
+    // Every cell on the edge of the square, going round it.
+    for (int i = -radius; i < radius; ++i)
+    {
+        TraceViewshedRay(heightfield, observerCell, eyeHeight, targetHeight, radius, Vec2i(i, -radius), outVisible);
+        TraceViewshedRay(heightfield, observerCell, eyeHeight, targetHeight, radius, Vec2i(radius, i), outVisible);
+        TraceViewshedRay(heightfield, observerCell, eyeHeight, targetHeight, radius, Vec2i(-i, radius), outVisible);
+        TraceViewshedRay(heightfield, observerCell, eyeHeight, targetHeight, radius, Vec2i(-radius, -i), outVisible);
+    }
+}
+
+}
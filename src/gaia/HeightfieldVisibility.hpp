@@ -0,0 +1,27 @@
+#pragma once
+#include "WrappedHeightfield.hpp"
+
+namespace gaia
+{
+
+/*
+ * Which cells around an observer can be seen from it, on a square grid of (2 * radius + 1)^2 cells centred on the observer.
+ */
+struct Viewshed
+{
+    Vec2f centreXZ = Vec2fZero;  // World position of the centre cell, under the observer.
+    float cellSize = 0.f;        // World distance between cells.
+    int radius = 0;              // In cells.
+    std::vector<uint8> visible;  // Row major, 1 where a target on the ground there can be seen.
+
+    int Dimension() const { return 2 * radius + 1; }
+    bool IsVisible(Vec2i offset) const { return visible[Dimension() * (offset.y + radius) + (offset.x + radius)] != 0; }
+};
+
+// Radial (R2) viewshed of a height field from the texel observerCell, with eyes at observerHeight above the ground, looking for targets
+// targetHeight (>= 0) above the ground. Lines of sight are traced from the observer to every cell on the edge of the square and each cell they pass
+// is visible if it clears the highest horizon so far. Spans of the min/max pyramid that are wholly below the horizon can't be seen or raise it, so are skipped.
+// Cells outside the height field's valid texels are left hidden. outVisible has (2 * radius + 1)^2 entries.
+void ComputeViewshed(const WrappedHeightfield& heightfield, Vec2i observerCell, float observerHeight, float targetHeight, int radius, uint8* outVisible);
+
+}
@@ -0,0 +1,195 @@
+#include "HorizonCuller.hpp"
+
+namespace gaia
+{
+
+// Azimuths the horizon is kept for. A power of two, so bins wrap with a mask.
+static constexpr int NumAzimuths = 512;
+
+// Chebyshev distances the horizon is kept at: bucket j holds the occluders within cellSize * 2^(j / BucketsPerOctave) of the eye.
+static constexpr int BucketsPerOctave = 4;
+static constexpr int NumDistanceBuckets = 16 * BucketsPerOctave;
+
+void HorizonCuller::Init(float cellSize, int cellsPerSide, int numLevels)
+{
+    Assert(cellSize > 0.f && cellsPerSide >= 4 && cellsPerSide % 4 == 0 && numLevels >= 1);
+    m_cellSize = cellSize;
+    m_cellsPerSide = cellsPerSide;
+    m_numLevels = numLevels;
+    m_levelCentres.assign(numLevels, Vec2i(INT_MAX, INT_MAX));
+    m_horizon.assign(NumDistanceBuckets * NumAzimuths, -FLT_MAX);
+}
+
+bool HorizonCuller::UpdateLayout(Vec2f eyeXZ)
+{
+    // Each level's square is centred on an even cell, so the finer level's square covers whole cells of it.
+    bool moved = false;
+    for (int level = 0; level < m_numLevels; ++level)
+    {
+        const float levelCellSize = m_cellSize * (float)(1 << level);
+        const Vec2i centre = 2 * math::Vec2Floor(eyeXZ / (2.f * levelCellSize) + Vec2f(0.5f, 0.5f));
+        moved |= (centre != m_levelCentres[level]);
+        m_levelCentres[level] = centre;
+    }
+    if (!moved)
+        return false;
+
+    m_occluderRects.clear();
+    const int halfCells = m_cellsPerSide / 2;
+    for (int level = 0; level < m_numLevels; ++level)
+    {
+        const float levelCellSize = m_cellSize * (float)(1 << level);
+        const Vec2i min = m_levelCentres[level] - Vec2i(halfCells, halfCells);
+        const Vec2i holeMin = (level > 0) ? m_levelCentres[level - 1] / 2 - Vec2i(halfCells / 2, halfCells / 2) : Vec2i(INT_MAX, INT_MAX);
+        const Vec2i holeMax = (level > 0) ? holeMin + Vec2i(halfCells, halfCells) : Vec2i(INT_MIN, INT_MIN);
+        for (int z = min.y; z < min.y + m_cellsPerSide; ++z)
+        {
+            for (int x = min.x; x < min.x + m_cellsPerSide; ++x)
+            {
+                if (x >= holeMin.x && x < holeMax.x && z >= holeMin.y && z < holeMax.y)
+                    continue;
+
+                m_occluderRects.push_back(Vec4f((float)x, (float)z, (float)(x + 1), (float)(z + 1)) * levelCellSize);
+            }
+        }
+    }
+    m_occluderHeights.assign(m_occluderRects.size(), -FLT_MAX);
+    return true;
+}
+
+Vec2f HorizonCuller::CalcAngleRange(const Vec4f& rect) const
+{
+    // Relative to the direction of the centre, so the range doesn't wrap. It's under half a turn, as the rect doesn't contain the eye.
+    const float centreAngle = atan2f(0.5f * (rect.y + rect.w) - m_eye.z, 0.5f * (rect.x + rect.z) - m_eye.x);
+    float minOffset = 0.f;
+    float maxOffset = 0.f;
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        const float x = (corner & 1) ? rect.z : rect.x;
+        const float z = (corner & 2) ? rect.w : rect.y;
+        float offset = atan2f(z - m_eye.z, x - m_eye.x) - centreAngle;
+        offset += (offset > Pif) ? -2.f * Pif : (offset < -Pif) ? 2.f * Pif : 0.f;
+        minOffset = std::min(minOffset, offset);
+        maxOffset = std::max(maxOffset, offset);
+    }
+
+    const float binsPerRadian = (float)NumAzimuths / (2.f * Pif);
+    float first = (centreAngle + minOffset) * binsPerRadian;
+    const float shift = (first < 0.f) ? (float)NumAzimuths : 0.f;
+    return Vec2f(first + shift, (centreAngle + maxOffset) * binsPerRadian + shift);
+}
+
+void HorizonCuller::Build(Vec3f eye)
+{
+    m_eye = eye;
+    std::fill(m_horizon.begin(), m_horizon.end(), -FLT_MAX);
+    for (int i = 0; i < GetNumOccluders(); ++i)
+    {
+        const float height = m_occluderHeights[i];
+        const Vec4f& rect = m_occluderRects[i];
+        const float nearX = std::max({ rect.x - eye.x, eye.x - rect.z, 0.f });
+        const float nearZ = std::max({ rect.y - eye.z, eye.z - rect.w, 0.f });
+        if (height == -FLT_MAX || (nearX == 0.f && nearZ == 0.f))
+            continue;
+
+        // Goes in the first bucket at least as far as all of it. A little extra keeps rounding from putting it in the one before.
+        const float farX = std::max(fabsf(rect.x - eye.x), fabsf(rect.z - eye.x));
+        const float farZ = std::max(fabsf(rect.y - eye.z), fabsf(rect.w - eye.z));
+        const int bucket = std::max((int)ceilf(BucketsPerOctave * log2f(std::max(farX, farZ) / m_cellSize) + 1e-3f), 0);
+        if (bucket >= NumDistanceBuckets)
+            continue;
+
+        // The ground is at least this high everywhere in the cell, so it blocks rays that cross it below this slope, wherever they cross.
+        const float rise = height - eye.y;
+        const float slope = rise / ((rise >= 0.f) ? sqrtf(farX * farX + farZ * farZ) : sqrtf(nearX * nearX + nearZ * nearZ));
+
+        // Only bins whose every ray crosses the cell.
+        const Vec2f range = CalcAngleRange(rect);
+        float* horizon = &m_horizon[NumAzimuths * bucket];
+        for (int bin = (int)ceilf(range.x); bin < (int)floorf(range.y); ++bin)
+        {
+            float& binSlope = horizon[bin & (NumAzimuths - 1)];
+            binSlope = std::max(binSlope, slope);
+        }
+    }
+
+    // Then each bucket takes in everything nearer.
+    for (int bucket = 1; bucket < NumDistanceBuckets; ++bucket)
+    {
+        const float* nearer = &m_horizon[NumAzimuths * (bucket - 1)];
+        float* horizon = &m_horizon[NumAzimuths * bucket];
+        for (int bin = 0; bin < NumAzimuths; ++bin)
+        {
+            horizon[bin] = std::max(horizon[bin], nearer[bin]);
+        }
+    }
+}
+
+bool HorizonCuller::IsOccluded(const AABB3f& box) const
+{
+    if (m_horizon.empty())
+        return false;
+
+    const Vec4f rect(box.m_min.x, box.m_min.z, box.m_max.x, box.m_max.z);
+    const float nearX = std::max({ rect.x - m_eye.x, m_eye.x - rect.z, 0.f });
+    const float nearZ = std::max({ rect.y - m_eye.z, m_eye.z - rect.w, 0.f });
+    if (nearX == 0.f && nearZ == 0.f)
+        return false;
+
+    // The last bucket wholly nearer than the box.
+    const int bucket = std::min((int)floorf(BucketsPerOctave * log2f(std::max(nearX, nearZ) / m_cellSize)), NumDistanceBuckets - 1);
+    if (bucket < 0)
+        return false;
+
+    // The steepest slope to any of it, which every bin it's in has to block.
+    const float rise = box.m_max.y - m_eye.y;
+    const float farX = std::max(fabsf(rect.x - m_eye.x), fabsf(rect.z - m_eye.x));
+    const float farZ = std::max(fabsf(rect.y - m_eye.z), fabsf(rect.w - m_eye.z));
+    const float slope = rise / ((rise >= 0.f) ? sqrtf(nearX * nearX + nearZ * nearZ) : sqrtf(farX * farX + farZ * farZ));
+
+    const Vec2f range = CalcAngleRange(rect);
+    const float* horizon = &m_horizon[NumAzimuths * bucket];
+    for (int bin = (int)floorf(range.x); bin <= (int)floorf(range.y); ++bin)
+    {
+        if (horizon[bin & (NumAzimuths - 1)] <= slope)
+            return false;
+    }
+    return true;
+}
+
+void HorizonCuller::BuildOccluderMesh(Vec3f eye, float bottom, TriangleMesh& outMesh) const
+{
+    // Each cell that can occlude becomes a box from its height down to bottom, below all the ground. Anywhere on its top or sides is at or under
+    // the ground over the cell, so anything behind it is hidden, and neighbouring boxes leave no gaps whatever their heights.
+    // Only the top and the sides facing the eye can be seen.
+    static constexpr uint32 Faces[5][4] = { { 4, 5, 7, 6 }, { 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 } }; // Top, -x, +x, -z, +z.
+    outMesh.vertices.clear();
+    outMesh.indices.clear();
+    for (int i = 0; i < GetNumOccluders(); ++i)
+    {
+        const float top = m_occluderHeights[i];
+        if (top == -FLT_MAX)
+            continue;
+
+        const Vec4f& rect = m_occluderRects[i];
+        const bool facing[5] = { true, eye.x < rect.x, eye.x > rect.z, eye.z < rect.y, eye.z > rect.w };
+        const uint32 firstVertex = (uint32)outMesh.vertices.size();
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            outMesh.vertices.push_back(Vec3f((corner & 1) ? rect.z : rect.x, (corner & 4) ? top : bottom, (corner & 2) ? rect.w : rect.y));
+        }
+        for (int face = 0; face < 5; ++face)
+        {
+            if (!facing[face])
+                continue;
+
+            const uint32* quad = Faces[face];
+            for (int corner : { 0, 1, 2, 0, 2, 3 })
+            {
+                outMesh.indices.push_back(firstVertex + quad[corner]);
+            }
+        }
+    }
+}
+
+}
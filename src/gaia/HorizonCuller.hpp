@@ -0,0 +1,53 @@
+#pragma once
+#include "Math/AABB.hpp"
+#include "RtinHierarchy.hpp"
+
+namespace gaia
+{
+
+/*
+ * Conservative occlusion culling against the terrain's horizon, as seen from a single viewpoint.
+ * Occluders are square cells of ground around the viewpoint, nested like the clipmap rings: each level's cells are twice the size of the
+ * last's, and fill a square twice as big but for the hole the finer level covers. Each cell's height is a lower bound on the ground in it.
+ * Build() sweeps them outward, keeping per azimuth the steepest slope from the eye that they're known to block, and keeping it per distance
+ * too: a box is only tested against cells that lie wholly nearer, in Chebyshev distance, than all of it. That distance only grows along any
+ * ray from the eye, so every ray to the box must have crossed those cells first, and the test doesn't care what order boxes come in.
+ */
+class HorizonCuller
+{
+public:
+    // cellSize is the world size of the finest cells. cellsPerSide must be a multiple of 4.
+    void Init(float cellSize, int cellsPerSide, int numLevels);
+
+    // Snaps the cells around a position. Returns whether any moved, so their heights need setting again.
+    bool UpdateLayout(Vec2f eyeXZ);
+
+    int GetNumLevels() const { return m_numLevels; }
+    int GetNumOccluders() const { return (int)m_occluderRects.size(); }
+    const Vec4f& GetOccluderRect(int i) const { return m_occluderRects[i]; } // (min x, min z, max x, max z).
+    float GetOccluderHeight(int i) const { return m_occluderHeights[i]; }
+    void SetOccluderHeight(int i, float minHeight) { m_occluderHeights[i] = minHeight; } // -FLT_MAX if the cell can't occlude, e.g. it isn't drawn.
+
+    // Rebuilds the horizon from the occluders, as seen from the eye.
+    void Build(Vec3f eye);
+
+    // Whether a box is wholly hidden below the horizon. Nothing is before Init().
+    bool IsOccluded(const AABB3f& box) const;
+
+    // The occluders as boxes from their heights down to bottom, for OcclusionRasteriser: the tops, and the sides facing the eye.
+    void BuildOccluderMesh(Vec3f eye, float bottom, TriangleMesh& outMesh) const;
+
+private:
+    Vec2f CalcAngleRange(const Vec4f& rect) const; // In azimuth bins, from the eye; the end may be past NumAzimuths.
+
+    float m_cellSize = 0.f;
+    int m_cellsPerSide = 0;
+    int m_numLevels = 0;
+    std::vector<Vec2i> m_levelCentres; // Of each level's square, in its own cells.
+    std::vector<Vec4f> m_occluderRects;
+    std::vector<float> m_occluderHeights;
+    Vec3f m_eye = Vec3fZero;
+    std::vector<float> m_horizon;      // Steepest blocked slope per distance bucket, then per azimuth bin.
+};
+
+}
@@ -0,0 +1,214 @@
+#include "LooseQuadtree.hpp"
+
+namespace gaia
+{
+
+void LooseQuadtree::Init(Vec2f origin, float size, int numLevels)
+{
+    Assert(size > 0.f && numLevels >= 1 && numLevels <= 16);
+    m_origin = origin;
+    m_size = size;
+    m_levelOffsets.clear();
+    int numNodes = 0;
+    for (int level = 0; level < numLevels; ++level)
+    {
+        m_levelOffsets.push_back(numNodes);
+        numNodes += 1 << (2 * level);
+    }
+    m_nodes.assign(numNodes, Node());
+    m_overflow = Node();
+    m_items.clear();
+    m_freeItems.clear();
+}
+
+int LooseQuadtree::Insert(int id, const AABB3f& box)
+{
+    int handle;
+    if (!m_freeItems.empty())
+    {
+        handle = m_freeItems.back();
+        m_freeItems.pop_back();
+    }
+    else
+    {
+        handle = (int)m_items.size();
+        m_items.emplace_back();
+    }
+
+    Item& item = m_items[handle];
+    item.box = box;
+    item.id = id;
+    item.node = FindNode(box);
+    Link(handle);
+    return handle;
+}
+
+void LooseQuadtree::Update(int handle, const AABB3f& box)
+{
+    // Small moves usually stay in the same cell, which only has to take in the new height range.
+    Item& item = m_items[handle];
+    const int node = FindNode(box);
+    if (node == item.node && node != OverflowNode && box.m_min.y >= m_nodes[node].heights.x && box.m_max.y <= m_nodes[node].heights.y)
+    {
+        item.box = box;
+        return;
+    }
+
+    Unlink(handle);
+    item.box = box;
+    item.node = node;
+    Link(handle);
+}
+
+void LooseQuadtree::Remove(int handle)
+{
+    Unlink(handle);
+    m_freeItems.push_back(handle);
+}
+
+int LooseQuadtree::FindNode(const AABB3f& box) const
+{
+    const Vec2f centre = 0.5f * (Vec2f(box.m_min.x, box.m_min.z) + Vec2f(box.m_max.x, box.m_max.z)) - m_origin;
+    const float extent = std::max(box.m_max.x - box.m_min.x, box.m_max.z - box.m_min.z);
+    if (centre.x < 0.f || centre.y < 0.f || centre.x >= m_size || centre.y >= m_size || extent > m_size)
+        return OverflowNode;
+
+    int level = 0;
+    while (level + 1 < (int)m_levelOffsets.size() && extent <= m_size / (float)(2 << level))
+    {
+        ++level;
+    }
+
+    const int cellsPerSide = 1 << level;
+    const Vec2i cell = math::min(math::Vec2Floor(centre * ((float)cellsPerSide / m_size)), Vec2i(cellsPerSide - 1, cellsPerSide - 1));
+    return NodeIndex(level, cell);
+}
+
+void LooseQuadtree::Link(int handle)
+{
+    Item& item = m_items[handle];
+    Node& node = GetNode(item.node);
+    item.slot = (int)node.items.size();
+    node.items.push_back(handle);
+    if (item.node != OverflowNode)
+    {
+        UpdateAncestors(item, true);
+    }
+}
+
+void LooseQuadtree::Unlink(int handle)
+{
+    const Item& item = m_items[handle];
+    Node& node = GetNode(item.node);
+    const int last = node.items.back();
+    node.items[item.slot] = last;
+    m_items[last].slot = item.slot;
+    node.items.pop_back();
+    if (item.node != OverflowNode)
+    {
+        UpdateAncestors(item, false);
+    }
+}
+
+void LooseQuadtree::UpdateAncestors(const Item& item, bool adding)
+{
+    // Each level is a contiguous range of node indices, so the item's level is the last one starting at or before its node.
+    int level = (int)m_levelOffsets.size() - 1;
+    while (m_levelOffsets[level] > item.node)
+    {
+        --level;
+    }
+
+    const int cellsPerSide = 1 << level;
+    const int offset = item.node - m_levelOffsets[level];
+    for (Vec2i cell(offset % cellsPerSide, offset / cellsPerSide); level >= 0; --level, cell /= 2)
+    {
+        Node& node = m_nodes[NodeIndex(level, cell)];
+        if (adding)
+        {
+            ++node.numItems;
+            node.heights = Vec2f(std::min(node.heights.x, item.box.m_min.y), std::max(node.heights.y, item.box.m_max.y));
+        }
+        else if (--node.numItems == 0)
+        {
+            node.heights = Vec2f(FLT_MAX, -FLT_MAX);
+        }
+    }
+}
+
+void LooseQuadtree::Query(const Frustumf& frustum, std::vector<int>& outIds)
+{
+    m_queryStats = QueryStats();
+    m_candidates.clear();
+    QueryNode(frustum, 0, Vec2iZero, outIds);
+    m_candidates.insert(m_candidates.end(), m_overflow.items.begin(), m_overflow.items.end());
+
+    // Items of nodes straddling the frustum, and those outside the tree, all in one go.
+    const int numCandidates = (int)m_candidates.size();
+    m_candidateBoxes.Resize(numCandidates);
+    for (int i = 0; i < numCandidates; ++i)
+    {
+        m_candidateBoxes.Set(i, m_items[m_candidates[i]].box);
+    }
+    m_candidateMask.resize(CullMaskWords(numCandidates));
+    CullAABBs(frustum, m_candidateBoxes, 0, numCandidates, m_candidateMask.data());
+    for (int word = 0; word < CullMaskWords(numCandidates); ++word)
+    {
+        for (uint32 bits = m_candidateMask[word]; bits != 0; bits &= bits - 1)
+        {
+            outIds.push_back(m_items[m_candidates[32 * word + math::CountTrailingZeros(bits)]].id);
+        }
+    }
+    m_queryStats.numItemsTested = numCandidates;
+}
+
+void LooseQuadtree::QueryNode(const Frustumf& frustum, int level, Vec2i cell, std::vector<int>& outIds)
+{
+    const Node& node = m_nodes[NodeIndex(level, cell)];
+    if (node.numItems == 0)
+        return;
+
+    ++m_queryStats.numNodesVisited;
+    const float cellSize = m_size / (float)(1 << level);
+    const Vec2f looseMin = m_origin + (Vec2f(cell) - Vec2f(0.5f, 0.5f)) * cellSize;
+    const Vec2f looseMax = m_origin + (Vec2f(cell) + Vec2f(1.5f, 1.5f)) * cellSize;
+    const FrustumTest::E test = frustum.Classify({ Vec3f(looseMin.x, node.heights.x, looseMin.y), Vec3f(looseMax.x, node.heights.y, looseMax.y) });
+    if (test == FrustumTest::Outside)
+        return;
+
+    if (test == FrustumTest::Inside)
+    {
+        AppendSubtree(level, cell, outIds);
+        return;
+    }
+
+    m_candidates.insert(m_candidates.end(), node.items.begin(), node.items.end());
+    if (level + 1 < (int)m_levelOffsets.size())
+    {
+        for (int child = 0; child < 4; ++child)
+        {
+            QueryNode(frustum, level + 1, 2 * cell + Vec2i(child & 1, child >> 1), outIds);
+        }
+    }
+}
+
+void LooseQuadtree::AppendSubtree(int level, Vec2i cell, std::vector<int>& outIds) const
+{
+    const Node& node = m_nodes[NodeIndex(level, cell)];
+    if (node.numItems == 0)
+        return;
+
+    for (int handle : node.items)
+    {
+        outIds.push_back(m_items[handle].id);
+    }
+    if (level + 1 < (int)m_levelOffsets.size())
+    {
+        for (int child = 0; child < 4; ++child)
+        {
+            AppendSubtree(level + 1, 2 * cell + Vec2i(child & 1, child >> 1), outIds);
+        }
+    }
+}
+
+}
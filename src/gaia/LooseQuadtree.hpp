@@ -0,0 +1,79 @@
+#pragma once
+#include "Math/BatchCulling.hpp"
+
+namespace gaia
+{
+
+/*
+ * Loose quadtree of boxes over a square of the XZ plane, for finding the ones in a frustum without testing them all.
+ * An item goes in the deepest level whose cells are at least as big as it along X and Z, in the cell its centre falls in. Cells' loose bounds
+ * are twice their size, so an item always fits in its cell's and finding its node is a division rather than a descent. Nodes keep the count
+ * and height range of the items under them, so empty subtrees are never visited and frustum tests are tight vertically.
+ * Items the square can't hold are kept to one side and always tested.
+ */
+class LooseQuadtree
+{
+public:
+    struct QueryStats
+    {
+        int numNodesVisited = 0;
+        int numItemsTested = 0; // Individually, rather than taken with a node wholly in the frustum.
+    };
+
+    // numLevels includes the root, so the finest cells are size / 2^(numLevels - 1) across.
+    void Init(Vec2f origin, float size, int numLevels);
+
+    // Adds an item with a caller's id, which is what queries return. Returns a handle for moving or removing it.
+    int Insert(int id, const AABB3f& box);
+    void Update(int handle, const AABB3f& box);
+    void Remove(int handle);
+
+    const AABB3f& GetBounds(int handle) const { return m_items[handle].box; }
+    int GetNumItems() const { return (int)m_items.size() - (int)m_freeItems.size(); }
+
+    // Appends the ids of the items whose boxes touch the frustum. Nodes wholly inside it are taken without testing their items;
+    // the rest of the items are tested four at a time with CullAABBs().
+    void Query(const Frustumf& frustum, std::vector<int>& outIds);
+    const QueryStats& GetLastQueryStats() const { return m_queryStats; }
+
+private:
+    static constexpr int OverflowNode = -1;
+
+    struct Item
+    {
+        AABB3f box;
+        int id = 0;
+        int node = 0; // Or OverflowNode.
+        int slot = 0; // In the node's item list.
+    };
+
+    struct Node
+    {
+        std::vector<int> items;
+        int numItems = 0;                         // In this node and all under it.
+        Vec2f heights = Vec2f(FLT_MAX, -FLT_MAX); // Of those items. Grows as they're added, and only resets once they're all gone.
+    };
+
+    int FindNode(const AABB3f& box) const;
+    Node& GetNode(int node) { return (node == OverflowNode) ? m_overflow : m_nodes[node]; }
+    int NodeIndex(int level, Vec2i cell) const { return m_levelOffsets[level] + (cell.y << level) + cell.x; }
+    void Link(int handle);
+    void Unlink(int handle);
+    void UpdateAncestors(const Item& item, bool adding); // The node's count and heights, and all its ancestors'.
+    void QueryNode(const Frustumf& frustum, int level, Vec2i cell, std::vector<int>& outIds);
+    void AppendSubtree(int level, Vec2i cell, std::vector<int>& outIds) const;
+
+    Vec2f m_origin = Vec2fZero;
+    float m_size = 0.f;
+    std::vector<int> m_levelOffsets;
+    std::vector<Node> m_nodes;    // Root first, then each level row major.
+    Node m_overflow;
+    std::vector<Item> m_items;
+    std::vector<int> m_freeItems;
+    std::vector<int> m_candidates; // Scratch for queries: items needing their own test, and their boxes.
+    AABBBatch m_candidateBoxes;
+    std::vector<uint32> m_candidateMask;
+    QueryStats m_queryStats;
+};
+
+}
@@ -17,8 +17,8 @@ public:
     D3D12_GPU_VIRTUAL_ADDRESS GetBufferGPUVirtualAddress(int frame) { return m_buffer->GetGPUVirtualAddress() + frame * AlignedDataSize(); }
     DataType* GetMappedData(int frame) { return (DataType*)((uchar*)m_mappedData + frame * AlignedDataSize()); }
 
-    // Align up to pad between read/write buffers and avoid GPU cache hazards.
-    static size_t AlignedDataSize() { return math::RoundUpPow2(sizeof(DataType), (size_t)128); }
+    // Align up to pad between read/write buffers and avoid GPU cache hazards. Root CBVs also need each frame's copy 256 byte aligned.
+    static size_t AlignedDataSize() { return math::RoundUpPow2(sizeof(DataType), (size_t)D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT); }
     static size_t TotalSize() { return AlignedDataSize() * BackbufferCount; }
 
 private:
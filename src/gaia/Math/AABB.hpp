@@ -26,52 +26,30 @@ public:
         m_max = maxp;
     }
 
-    AABB3f AffineTransformed(const Mat4f& mat)
+    // Bounds after transforming by (mat * Vec4f(p, 1)).xyz, like Mat4fTransformVec3f().
+    AABB3f Transformed(const Mat4f& mat)
     {
-        math::AssertMat4fIsAffine(mat);
+        // Each axis of the result starts at the translation, then each input axis adds the smaller of its scaled min and max
+        // to the new min and the larger to the new max, which is the same as transforming all eight corners (Arvo).
         Vec3f translation = math::Mat4fGetTranslation(mat);
         AABB3f ret = { translation, translation };
-
         for (int i = 0; i < 3; ++i)
         {
-            for (int j = 0; j < 3; ++j)
-            {
-                float a = mat[i][j] * m_min[i];
-                float b = mat[i][j] * m_max[i];
-                if (a < b)
-                {
-                    ret.m_min[j] += a;
-                    ret.m_max[j] += b;
-                }
-                else
-                {
-                    ret.m_min[j] += b;
-                    ret.m_max[j] += a;
-                }
-            }
+            Vec3f column(mat[i]);
+            Vec3f a = column * m_min[i];
+            Vec3f b = column * m_max[i];
+            ret.m_min += math::min(a, b);
+            ret.m_max += math::max(a, b);
         }
 
         return ret;
     }
 
-    AABB3f Transformed(const Mat4f& mat)
+    // As Transformed(), for callers that expect an affine matrix.
+    AABB3f AffineTransformed(const Mat4f& mat)
     {
-        Vec3f v[8];
-        v[0] = Vec3f(m_min.x, m_min.y, m_min.z);
-        v[1] = Vec3f(m_max.x, m_min.y, m_min.z);
-        v[2] = Vec3f(m_max.x, m_max.y, m_min.z);
-        v[3] = Vec3f(m_min.x, m_max.y, m_min.z);
-        v[4] = Vec3f(m_min.x, m_min.y, m_max.z);
-        v[5] = Vec3f(m_max.x, m_min.y, m_max.z);
-        v[6] = Vec3f(m_max.x, m_max.y, m_max.z);
-        v[7] = Vec3f(m_min.x, m_max.y, m_max.z);
-
-        for (int i = 0; i < 8; i++)
-            v[i] = math::Mat4fTransformVec3f(mat, v[i]);
-
-        AABB3f ret;
-        ret.SetFromPoints(8, v);
-        return ret;
+        math::AssertMat4fIsAffine(mat);
+        return Transformed(mat);
     }
 
     Vec3f m_min = Vec3fZero;
@@ -0,0 +1,242 @@
+#include "BatchCulling.hpp"
+
+namespace gaia
+{
+
+void AABBBatch::Resize(int count)
+{
+    for (std::vector<float>* component : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ })
+    {
+        component->resize(count);
+    }
+}
+
+void AABBBatch::Set(int i, const AABB3f& box)
+{
+    minX[i] = box.m_min.x;
+    minY[i] = box.m_min.y;
+    minZ[i] = box.m_min.z;
+    maxX[i] = box.m_max.x;
+    maxY[i] = box.m_max.y;
+    maxZ[i] = box.m_max.z;
+}
+
+void SphereBatch::Resize(int count)
+{
+    for (std::vector<float>* component : { &centreX, &centreY, &centreZ, &radius })
+    {
+        component->resize(count);
+    }
+}
+
+void SphereBatch::Set(int i, const Spheref& sphere)
+{
+    centreX[i] = sphere.m_centre.x;
+    centreY[i] = sphere.m_centre.y;
+    centreZ[i] = sphere.m_centre.z;
+    radius[i] = sphere.m_radius;
+}
+
+// Loads four floats from i onwards, repeating the last valid one past end.
+static inline __m128 LoadFour(const float* values, int i, int end)
+{
+    if (i + 4 <= end)
+        return _mm_loadu_ps(values + i);
+
+    alignas(16) float tail[4];
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        tail[lane] = values[std::min(i + lane, end - 1)];
+    }
+    return _mm_load_ps(tail);
+}
+
+// Each plane's components, broadcast across the lanes.
+struct PlaneLanes
+{
+    __m128 normalX, normalY, normalZ;
+    __m128 absNormalX, absNormalY, absNormalZ;
+    __m128 depth;
+};
+
+static void LoadPlanes(const Frustumf& frustum, PlaneLanes (&outPlanes)[6])
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const Planef& plane = frustum.m_planes[i];
+        outPlanes[i].normalX = _mm_set1_ps(plane.m_normal.x);
+        outPlanes[i].normalY = _mm_set1_ps(plane.m_normal.y);
+        outPlanes[i].normalZ = _mm_set1_ps(plane.m_normal.z);
+        outPlanes[i].absNormalX = _mm_set1_ps(fabsf(plane.m_normal.x));
+        outPlanes[i].absNormalY = _mm_set1_ps(fabsf(plane.m_normal.y));
+        outPlanes[i].absNormalZ = _mm_set1_ps(fabsf(plane.m_normal.z));
+        outPlanes[i].depth = _mm_set1_ps(plane.m_depth);
+    }
+}
+
+static inline __m128 Dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+// Adds four lanes' results to the mask. Groups start at multiples of four, so they never straddle a word.
+static inline int StoreMask(__m128 visible, int i, int count, uint32* outMask)
+{
+    int bits = _mm_movemask_ps(visible);
+    if (count - i < 4)
+    {
+        bits &= (1 << (count - i)) - 1;
+    }
+    outMask[i >> 5] |= (uint32)bits << (i & 31);
+
+    static constexpr int BitCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    return BitCounts[bits];
+}
+
+int CullAABBs(const Frustumf& frustum, const AABBBatch& boxes, int first, int count, uint32* outMask)
+{
+    Assert(first >= 0 && count >= 0 && first + count <= boxes.Size());
+    std::fill(outMask, outMask + CullMaskWords(count), 0u);
+    PlaneLanes planes[6];
+    LoadPlanes(frustum, planes);
+
+    // A box is outside a plane if its corner furthest along the normal is: dot(n, centre) + dot(|n|, extent) < depth.
+    const __m128 half = _mm_set1_ps(0.5f);
+    const int end = first + count;
+    int numVisible = 0;
+    for (int i = 0; i < count; i += 4)
+    {
+        const __m128 minX = LoadFour(boxes.minX.data(), first + i, end);
+        const __m128 minY = LoadFour(boxes.minY.data(), first + i, end);
+        const __m128 minZ = LoadFour(boxes.minZ.data(), first + i, end);
+        const __m128 maxX = LoadFour(boxes.maxX.data(), first + i, end);
+        const __m128 maxY = LoadFour(boxes.maxY.data(), first + i, end);
+        const __m128 maxZ = LoadFour(boxes.maxZ.data(), first + i, end);
+        const __m128 centreX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        const __m128 centreY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        const __m128 centreZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        const __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        const __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        const __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const PlaneLanes& plane : planes)
+        {
+            __m128 distance = Dot(centreX, centreY, centreZ, plane.normalX, plane.normalY, plane.normalZ);
+            __m128 radius = Dot(extentX, extentY, extentZ, plane.absNormalX, plane.absNormalY, plane.absNormalZ);
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, radius), plane.depth));
+        }
+        numVisible += StoreMask(visible, i, count, outMask);
+    }
+    return numVisible;
+}
+
+int CullSpheres(const Frustumf& frustum, const SphereBatch& spheres, int first, int count, uint32* outMask)
+{
+    Assert(first >= 0 && count >= 0 && first + count <= spheres.Size());
+    std::fill(outMask, outMask + CullMaskWords(count), 0u);
+    PlaneLanes planes[6];
+    LoadPlanes(frustum, planes);
+
+    const int end = first + count;
+    int numVisible = 0;
+    for (int i = 0; i < count; i += 4)
+    {
+        const __m128 centreX = LoadFour(spheres.centreX.data(), first + i, end);
+        const __m128 centreY = LoadFour(spheres.centreY.data(), first + i, end);
+        const __m128 centreZ = LoadFour(spheres.centreZ.data(), first + i, end);
+        const __m128 radius = LoadFour(spheres.radius.data(), first + i, end);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const PlaneLanes& plane : planes)
+        {
+            __m128 distance = Dot(centreX, centreY, centreZ, plane.normalX, plane.normalY, plane.normalZ);
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(_mm_add_ps(distance, radius), plane.depth));
+        }
+        numVisible += StoreMask(visible, i, count, outMask);
+    }
+    return numVisible;
+}
+
+void TransformPoints(const Mat4f& m, const float* x, const float* y, const float* z, int count, float* outX, float* outY, float* outZ)
+{
+    __m128 columns[4][3];
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 3; ++row)
+        {
+            columns[column][row] = _mm_set1_ps(m[column][row]);
+        }
+    }
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        float* outputs[3] = { outX, outY, outZ };
+        for (int row = 0; row < 3; ++row)
+        {
+            __m128 result = _mm_add_ps(Dot(px, py, pz, columns[0][row], columns[1][row], columns[2][row]), columns[3][row]);
+            _mm_storeu_ps(outputs[row] + i, result);
+        }
+    }
+
+    for (; i < count; ++i)
+    {
+        const Vec3f p = math::Mat4fTransformVec3f(m, Vec3f(x[i], y[i], z[i]));
+        outX[i] = p.x;
+        outY[i] = p.y;
+        outZ[i] = p.z;
+    }
+}
+
+void TransformAABBs(const Mat4f& m, const AABBBatch& boxes, AABBBatch& outBoxes)
+{
+    // Each output axis starts at the translation, then each input axis adds the smaller of its scaled min and max
+    // to the new min, and the larger to the new max (Arvo), rather than transforming all eight corners.
+    const int count = boxes.Size();
+    outBoxes.Resize(count);
+    const float* mins[3] = { boxes.minX.data(), boxes.minY.data(), boxes.minZ.data() };
+    const float* maxs[3] = { boxes.maxX.data(), boxes.maxY.data(), boxes.maxZ.data() };
+    float* outMins[3] = { outBoxes.minX.data(), outBoxes.minY.data(), outBoxes.minZ.data() };
+    float* outMaxs[3] = { outBoxes.maxX.data(), outBoxes.maxY.data(), outBoxes.maxZ.data() };
+
+    for (int i = 0; i < count; i += 4)
+    {
+        __m128 min[3], max[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            min[axis] = LoadFour(mins[axis], i, count);
+            max[axis] = LoadFour(maxs[axis], i, count);
+        }
+
+        // Loaded everything first, so writing over the inputs is fine.
+        alignas(16) float results[2][3][4];
+        for (int row = 0; row < 3; ++row)
+        {
+            __m128 newMin = _mm_set1_ps(m[3][row]);
+            __m128 newMax = newMin;
+            for (int column = 0; column < 3; ++column)
+            {
+                const __m128 scale = _mm_set1_ps(m[column][row]);
+                const __m128 a = _mm_mul_ps(scale, min[column]);
+                const __m128 b = _mm_mul_ps(scale, max[column]);
+                newMin = _mm_add_ps(newMin, _mm_min_ps(a, b));
+                newMax = _mm_add_ps(newMax, _mm_max_ps(a, b));
+            }
+            _mm_store_ps(results[0][row], newMin);
+            _mm_store_ps(results[1][row], newMax);
+        }
+
+        const int numValid = std::min(4, count - i);
+        for (int row = 0; row < 3; ++row)
+        {
+            std::copy(results[0][row], results[0][row] + numValid, outMins[row] + i);
+            std::copy(results[1][row], results[1][row] + numValid, outMaxs[row] + i);
+        }
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Frustum.hpp"
+
+namespace gaia
+{
+
+//
+// Boxes stored as one array per component (structure of arrays), so the kernels below can load four at a time.
+//
+struct AABBBatch
+{
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    int Size() const { return (int)minX.size(); }
+    void Resize(int count);
+    void Set(int i, const AABB3f& box);
+    AABB3f Get(int i) const { return { Vec3f(minX[i], minY[i], minZ[i]), Vec3f(maxX[i], maxY[i], maxZ[i]) }; }
+};
+
+//
+// Spheres stored as one array per component.
+//
+struct SphereBatch
+{
+    std::vector<float> centreX, centreY, centreZ;
+    std::vector<float> radius;
+
+    int Size() const { return (int)centreX.size(); }
+    void Resize(int count);
+    void Set(int i, const Spheref& sphere);
+};
+
+// Words needed for the visibility mask of count elements.
+constexpr inline int CullMaskWords(int count) { return (count + 31) / 32; }
+
+// Test elements [first, first + count) against a frustum with SSE, four at a time. Element first + i is visible if bit (i & 31)
+// of outMask[i / 32] is set; all CullMaskWords(count) words are written. Conservative like Frustumf::Classify(). Returns the number visible.
+int CullAABBs(const Frustumf& frustum, const AABBBatch& boxes, int first, int count, uint32* outMask);
+int CullSpheres(const Frustumf& frustum, const SphereBatch& spheres, int first, int count, uint32* outMask);
+
+// Transforms count points by (m * Vec4f(p, 1)).xyz, like Mat4fTransformVec3f(). The outputs may be the inputs.
+void TransformPoints(const Mat4f& m, const float* x, const float* y, const float* z, int count, float* outX, float* outY, float* outZ);
+
+// Bounds of each box after transforming it like TransformPoints() (the same as AABB3f::Transformed()). outBoxes may be boxes.
+void TransformAABBs(const Mat4f& m, const AABBBatch& boxes, AABBBatch& outBoxes);
+
+}
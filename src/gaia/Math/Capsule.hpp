@@ -0,0 +1,24 @@
+#pragma once
+
+namespace gaia
+{
+
+//
+// A capsule: every point within m_radius of the segment from m_start to m_end.
+//
+class Capsulef
+{
+public:
+    Capsulef(const Vec3f& start, const Vec3f& end, float radius)
+        : m_start(start)
+        , m_end(end)
+        , m_radius(radius)
+    {
+    }
+
+    Vec3f m_start = Vec3fZero;
+    Vec3f m_end = Vec3fZero;
+    float m_radius = 0.f;
+};
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "AABB.hpp"
+#include "Plane.hpp"
+#include "Sphere.hpp"
+
+namespace gaia
+{
+
+namespace FrustumTest
+{
+    enum E
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+}
+
+//
+// A convex volume bounded by six planes whose normals point inwards, i.e. dot(p, m_normal) >= m_depth inside all of them.
+//
+class Frustumf
+{
+public:
+    Frustumf() = default;
+
+    // From a projection * view matrix with [0, 1] clip space depth, which maps the frustum to the clip space box.
+    explicit Frustumf(const Mat4f& viewProj)
+    {
+        // Each plane is a sum of rows of the matrix (Gribb & Hartmann), e.g. the left plane is where clip x >= -clip w.
+        const Vec4f row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+        const Vec4f row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+        const Vec4f row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+        const Vec4f row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+        const Vec4f planes[6] = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+        for (int i = 0; i < 6; ++i)
+        {
+            const float invLength = 1.f / math::length(Vec3f(planes[i]));
+            m_planes[i] = Planef(Vec3f(planes[i]) * invLength, -planes[i].w * invLength);
+        }
+    }
+
+    // Conservative: boxes near the frustum's edges but outside it can still count as intersecting.
+    FrustumTest::E Classify(const AABB3f& box) const
+    {
+        FrustumTest::E result = FrustumTest::Inside;
+        for (const Planef& plane : m_planes)
+        {
+            // The corners furthest inside and furthest outside the plane.
+            const Vec3b positive = math::greaterThanEqual(plane.m_normal, Vec3fZero);
+            const Vec3f inner = math::Vec3Select(box.m_max, box.m_min, positive);
+            const Vec3f outer = math::Vec3Select(box.m_min, box.m_max, positive);
+            if (math::dot(inner, plane.m_normal) < plane.m_depth)
+                return FrustumTest::Outside;
+
+            if (math::dot(outer, plane.m_normal) < plane.m_depth)
+            {
+                result = FrustumTest::Intersecting;
+            }
+        }
+        return result;
+    }
+
+    bool Intersects(const AABB3f& box) const { return Classify(box) != FrustumTest::Outside; }
+
+    bool Intersects(const Spheref& sphere) const
+    {
+        for (const Planef& plane : m_planes)
+        {
+            if (math::dot(sphere.m_centre, plane.m_normal) + sphere.m_radius < plane.m_depth)
+                return false;
+        }
+        return true;
+    }
+
+    Planef m_planes[6]; // Left, right, bottom, top, near, far.
+};
+
+}
@@ -148,6 +148,19 @@ constexpr inline int ILog2(int32 n)
 #undef S
 }
 
+// Index of the lowest set bit.
+inline int CountTrailingZeros(uint32 n)
+{
+    Assert(n != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, n);
+    return (int)index;
+#else
+    return __builtin_ctz(n);
+#endif
+}
+
 
 //
 // Vector functions:
@@ -10,6 +10,7 @@ namespace gaia
 class Planef
 {
 public:
+    Planef() = default;
     Planef(const Vec3f& normal, float depth)
         : m_normal(normal)
         , m_depth(depth)
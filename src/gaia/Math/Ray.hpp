@@ -19,7 +19,7 @@ public:
     Rayf(const Vec3f& start, const Vec3f& dirAndLength)
         : m_start(start)
     {
-        m_length = dirAndLength.length();
+        m_length = math::length(dirAndLength);
         Assert(m_length >= Epsilonf);
         m_dir = dirAndLength / m_length;
     }
@@ -0,0 +1,22 @@
+#pragma once
+
+namespace gaia
+{
+
+//
+// A sphere.
+//
+class Spheref
+{
+public:
+    Spheref(const Vec3f& centre, float radius)
+        : m_centre(centre)
+        , m_radius(radius)
+    {
+    }
+
+    Vec3f m_centre = Vec3fZero;
+    float m_radius = 0.f;
+};
+
+}
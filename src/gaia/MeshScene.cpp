@@ -0,0 +1,144 @@
+#include "MeshScene.hpp"
+
+namespace gaia
+{
+
+static inline MeshInstanceTransform ToInstanceTransform(const Mat4f& transform)
+{
+    MeshInstanceTransform instanceTransform;
+    for (int row = 0; row < 3; ++row)
+    {
+        instanceTransform.rows[row] = Vec4f(transform[0][row], transform[1][row], transform[2][row], transform[3][row]);
+    }
+    return instanceTransform;
+}
+
+void MeshScene::Init(Vec2f origin, float size, int quadtreeLevels)
+{
+    m_quadtree.Init(origin, size, quadtreeLevels);
+    m_meshBounds.clear();
+    m_instances.clear();
+    m_freeInstances.clear();
+}
+
+int MeshScene::AddMesh(const AABB3f& localBounds)
+{
+    m_meshBounds.push_back(localBounds);
+    return (int)m_meshBounds.size() - 1;
+}
+
+int MeshScene::AddInstance(int mesh, const Mat4f& transform)
+{
+    Assert(0 <= mesh && mesh < GetNumMeshes());
+    int instance;
+    if (!m_freeInstances.empty())
+    {
+        instance = m_freeInstances.back();
+        m_freeInstances.pop_back();
+    }
+    else
+    {
+        instance = (int)m_instances.size();
+        m_instances.emplace_back();
+    }
+
+    Instance& data = m_instances[instance];
+    data.mesh = mesh;
+    data.handle = m_quadtree.Insert(instance, CalcWorldBounds(mesh, transform));
+    data.transform = ToInstanceTransform(transform);
+    return instance;
+}
+
+void MeshScene::SetTransform(int instance, const Mat4f& transform)
+{
+    Instance& data = m_instances[instance];
+    Assert(data.mesh >= 0);
+    data.transform = ToInstanceTransform(transform);
+    m_quadtree.Update(data.handle, CalcWorldBounds(data.mesh, transform));
+}
+
+void MeshScene::RemoveInstance(int instance)
+{
+    Instance& data = m_instances[instance];
+    Assert(data.mesh >= 0);
+    m_quadtree.Remove(data.handle);
+    data.mesh = -1;
+    m_freeInstances.push_back(instance);
+}
+
+AABB3f MeshScene::CalcWorldBounds(int mesh, const Mat4f& transform) const
+{
+    // Centre and half extents, so any affine transform works, scaled or not.
+    const AABB3f& bounds = m_meshBounds[mesh];
+    const Vec3f centre = Vec3f(transform * Vec4f(0.5f * (bounds.m_min + bounds.m_max), 1.f));
+    const Vec3f halfExtent = 0.5f * (bounds.m_max - bounds.m_min);
+    const Vec3f worldHalfExtent = math::abs(Vec3f(transform[0])) * halfExtent.x + math::abs(Vec3f(transform[1])) * halfExtent.y
+        + math::abs(Vec3f(transform[2])) * halfExtent.z;
+    return { centre - worldHalfExtent, centre + worldHalfExtent };
+}
+
+void MeshScene::Cull(const Frustumf& frustum, const OcclusionTest& occlusionTest, std::vector<Batch>& outBatches, std::vector<MeshInstanceTransform>& outTransforms)
+{
+    m_cullStats = CullStats();
+    m_visible.clear();
+    m_quadtree.Query(frustum, m_visible);
+    m_cullStats.query = m_quadtree.GetLastQueryStats();
+
+    // Then drop whatever's hidden, keeping the order.
+    if (occlusionTest && !m_visible.empty())
+    {
+        m_visibleBounds.resize(m_visible.size());
+        for (size_t i = 0; i < m_visible.size(); ++i)
+        {
+            m_visibleBounds[i] = GetInstanceBounds(m_visible[i]);
+        }
+        if (m_occludedCapacity < m_visible.size())
+        {
+            m_occludedCapacity = m_visible.size();
+            m_occluded.reset(new bool[m_occludedCapacity]);
+        }
+
+        occlusionTest(Span<const AABB3f>(m_visibleBounds.data(), m_visible.size()), Span<bool>(m_occluded.get(), m_visible.size()));
+        size_t numKept = 0;
+        for (size_t i = 0; i < m_visible.size(); ++i)
+        {
+            if (!m_occluded[i])
+            {
+                m_visible[numKept++] = m_visible[i];
+            }
+        }
+        m_cullStats.numOccluded = (int)(m_visible.size() - numKept);
+        m_visible.resize(numKept);
+    }
+    m_cullStats.numVisible = (int)m_visible.size();
+
+    // Counting sort by mesh: each batch starts where the meshes before it end.
+    const int numMeshes = GetNumMeshes();
+    m_meshCounts.assign(numMeshes, 0);
+    for (int instance : m_visible)
+    {
+        ++m_meshCounts[m_instances[instance].mesh];
+    }
+
+    outBatches.clear();
+    int firstInstance = 0;
+    for (int mesh = 0; mesh < numMeshes; ++mesh)
+    {
+        const int count = m_meshCounts[mesh];
+        m_meshCounts[mesh] = firstInstance;
+        if (count > 0)
+        {
+            outBatches.push_back({ mesh, firstInstance, count });
+        }
+        firstInstance += count;
+    }
+
+    outTransforms.resize(m_visible.size());
+    for (int instance : m_visible)
+    {
+        const Instance& data = m_instances[instance];
+        outTransforms[m_meshCounts[data.mesh]++] = data.transform;
+    }
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "LooseQuadtree.hpp"
+
+namespace gaia
+{
+
+// Object to world transform of one instance, as the instanced vertex shaders read it: the rows of an affine 3x4 matrix.
+struct MeshInstanceTransform
+{
+    Vec4f rows[3];
+};
+
+/*
+ * Instances of meshes placed around the world, kept in a loose quadtree so a frustum only has to test the ones near it.
+ * Culling groups what's visible into one batch per mesh, with the transforms laid out for a single instanced draw each.
+ * Meshes are only known by their local bounds here; MeshSceneRenderer draws the batches.
+ */
+class MeshScene
+{
+public:
+    // Fills in whether each box is hidden, e.g. Terrain::TestOcclusion().
+    using OcclusionTest = std::function<void(const Span<const AABB3f>& boxes, const Span<bool>& outOccluded)>;
+
+    struct Batch
+    {
+        int mesh = 0;
+        int firstInstance = 0; // In the transform list.
+        int numInstances = 0;
+    };
+
+    struct CullStats
+    {
+        int numVisible = 0;  // Drawn.
+        int numOccluded = 0; // In the frustum, but hidden.
+        LooseQuadtree::QueryStats query;
+    };
+
+    // The quadtree covers a square of the XZ plane. Instances outside it still work, they're just always tested.
+    void Init(Vec2f origin, float size, int quadtreeLevels);
+
+    // Returns the mesh's index, which instances and batches refer to it by.
+    int AddMesh(const AABB3f& localBounds);
+    int GetNumMeshes() const { return (int)m_meshBounds.size(); }
+
+    // Transforms must be affine. Returns the instance's index, which stays the same until it's removed.
+    int AddInstance(int mesh, const Mat4f& transform);
+    void SetTransform(int instance, const Mat4f& transform);
+    void RemoveInstance(int instance);
+    int GetNumInstances() const { return m_quadtree.GetNumItems(); }
+    const AABB3f& GetInstanceBounds(int instance) const { return m_quadtree.GetBounds(m_instances[instance].handle); }
+
+    // Finds the instances touching the frustum, and not hidden by the occlusion test if there is one, as one batch per mesh with any.
+    // Batches are in mesh order, and each batch's transforms are consecutive in outTransforms, in the quadtree's (roughly spatial) order.
+    void Cull(const Frustumf& frustum, const OcclusionTest& occlusionTest, std::vector<Batch>& outBatches, std::vector<MeshInstanceTransform>& outTransforms);
+    const CullStats& GetLastCullStats() const { return m_cullStats; }
+
+private:
+    struct Instance
+    {
+        int mesh = -1; // -1 once removed.
+        int handle = 0;
+        MeshInstanceTransform transform;
+    };
+
+    AABB3f CalcWorldBounds(int mesh, const Mat4f& transform) const;
+
+    LooseQuadtree m_quadtree;
+    std::vector<AABB3f> m_meshBounds;
+    std::vector<Instance> m_instances;
+    std::vector<int> m_freeInstances;
+    std::vector<int> m_visible;          // Scratch for culling.
+    std::vector<AABB3f> m_visibleBounds;
+    std::unique_ptr<bool[]> m_occluded;
+    size_t m_occludedCapacity = 0;
+    std::vector<int> m_meshCounts;
+    CullStats m_cullStats;
+};
+
+}
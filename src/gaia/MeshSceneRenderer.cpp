@@ -0,0 +1,73 @@
+#include "MeshSceneRenderer.hpp"
+#include "Renderer.hpp"
+#include "StaticMesh.hpp"
+#include "Timer.hpp"
+
+namespace gaia
+{
+
+void MeshSceneRenderer::Init(Renderer& renderer, int maxInstances)
+{
+    m_maxInstances = maxInstances;
+    InitPass(renderer, m_viewPass);
+    for (Pass& pass : m_shadowPasses)
+    {
+        InitPass(renderer, pass);
+    }
+}
+
+void MeshSceneRenderer::InitPass(Renderer& renderer, Pass& pass)
+{
+    // Rewritten every frame, so each frame in flight has its own.
+    const size_t bufferSize = m_maxInstances * sizeof(MeshInstanceTransform);
+    for (int i = 0; i < BackbufferCount; ++i)
+    {
+        VertexBuffer& instanceBuffer = pass.instanceBuffers[i];
+        instanceBuffer.buffer = renderer.CreateUploadBuffer(bufferSize);
+        instanceBuffer.view.BufferLocation = instanceBuffer.buffer->GetGPUVirtualAddress();
+        instanceBuffer.view.SizeInBytes = (UINT)bufferSize;
+        instanceBuffer.view.StrideInBytes = sizeof(MeshInstanceTransform);
+
+        D3D12_RANGE readRange = {};
+        instanceBuffer.buffer->Map(0, &readRange, (void**)&pass.mappedInstances[i]);
+        Assert(pass.mappedInstances[i]);
+    }
+}
+
+void MeshSceneRenderer::Render(Renderer& renderer, MeshScene& scene, const Span<StaticMesh* const>& meshes, const MeshScene::OcclusionTest& occlusionTest)
+{
+    DrawPass(renderer, renderer.GetViewProjMatrix(), scene, meshes, occlusionTest, m_viewPass);
+}
+
+void MeshSceneRenderer::RenderShadowPass(Renderer& renderer, MeshScene& scene, const Span<StaticMesh* const>& meshes)
+{
+    // The occluders are only known to hide things from the camera, not from the sun.
+    DrawPass(renderer, renderer.GetSunShadowViewProjMatrix(), scene, meshes, nullptr, m_shadowPasses[renderer.GetShadowCascade()]);
+}
+
+void MeshSceneRenderer::DrawPass(Renderer& renderer, const Mat4f& viewProj, MeshScene& scene, const Span<StaticMesh* const>& meshes, const MeshScene::OcclusionTest& occlusionTest, Pass& pass)
+{
+    Assert((int)meshes.Size() == scene.GetNumMeshes());
+    Timer timer;
+    scene.Cull(Frustumf(viewProj), occlusionTest, m_batches, m_transforms);
+
+    // Batches past the end of the buffer are cut short, or dropped.
+    const int currentBuffer = renderer.GetCurrentBuffer();
+    pass.stats.numDropped = std::max((int)m_transforms.size() - m_maxInstances, 0);
+    pass.stats.numInstances = (int)m_transforms.size() - pass.stats.numDropped;
+    memcpy(pass.mappedInstances[currentBuffer], m_transforms.data(), pass.stats.numInstances * sizeof(MeshInstanceTransform));
+    pass.stats.cullMs = 1000.f * timer.GetSecondsAndReset();
+
+    pass.stats.numDrawCalls = 0;
+    for (const MeshScene::Batch& batch : m_batches)
+    {
+        const int count = std::min(batch.numInstances, pass.stats.numInstances - batch.firstInstance);
+        if (count <= 0)
+            break;
+
+        meshes[batch.mesh]->RenderInstanced(renderer, pass.instanceBuffers[currentBuffer].view, batch.firstInstance, count);
+        ++pass.stats.numDrawCalls;
+    }
+}
+
+}
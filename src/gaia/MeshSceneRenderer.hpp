@@ -0,0 +1,58 @@
+#pragma once
+#include "MeshScene.hpp"
+#include "ShadowCascades.hpp"
+
+namespace gaia
+{
+
+class Renderer;
+class StaticMesh;
+
+/*
+ * Draws a MeshScene: culls it for each pass, writes the visible instances' transforms to the pass's instance buffer for this frame,
+ * and issues one instanced draw per mesh. Like the terrain, the view and each shadow cascade are culled against their own frustum,
+ * and have their own buffers, so every pass can be drawn in the same frame. The caller binds a pipeline that reads the transforms from
+ * the second input slot, e.g. BasicShader::BindInstanced().
+ */
+class MeshSceneRenderer
+{
+public:
+    struct PassStats
+    {
+        int numDrawCalls = 0; // Last frame.
+        int numInstances = 0;
+        int numDropped = 0;
+        float cullMs = 0.f;
+    };
+
+    // maxInstances is the most drawn in one pass in a frame; instances past it are dropped, and counted.
+    void Init(Renderer& renderer, int maxInstances);
+
+    // meshes are indexed like the scene's. Culls against the camera.
+    void Render(Renderer& renderer, MeshScene& scene, const Span<StaticMesh* const>& meshes, const MeshScene::OcclusionTest& occlusionTest = nullptr);
+
+    // Culls against the current cascade's frustum. Call for each cascade in the shadow pass, with a depth only pipeline bound.
+    void RenderShadowPass(Renderer& renderer, MeshScene& scene, const Span<StaticMesh* const>& meshes);
+
+    const PassStats& GetViewStats() const { return m_viewPass.stats; }
+    const PassStats& GetShadowStats(int cascade) const { return m_shadowPasses[cascade].stats; }
+
+private:
+    struct Pass
+    {
+        VertexBuffer instanceBuffers[BackbufferCount];
+        MeshInstanceTransform* mappedInstances[BackbufferCount] = {};
+        PassStats stats;
+    };
+
+    void InitPass(Renderer& renderer, Pass& pass);
+    void DrawPass(Renderer& renderer, const Mat4f& viewProj, MeshScene& scene, const Span<StaticMesh* const>& meshes, const MeshScene::OcclusionTest& occlusionTest, Pass& pass);
+
+    int m_maxInstances = 0;
+    Pass m_viewPass;
+    Pass m_shadowPasses[MaxShadowCascades];
+    std::vector<MeshScene::Batch> m_batches; // Scratch for culling.
+    std::vector<MeshInstanceTransform> m_transforms;
+};
+
+}
@@ -0,0 +1,112 @@
+#include "MinMaxPyramid.hpp"
+
+namespace gaia
+{
+
+// Query() reads at most this many nodes along each side.
+static constexpr int MaxQueryNodes = 4;
+
+MinMaxPyramid::MinMaxPyramid(int dimension, int blockDimension)
+    : m_dimension(dimension)
+    , m_blockDimension(blockDimension)
+{
+    Assert(math::IsPow2(dimension) && math::IsPow2(blockDimension) && blockDimension <= dimension);
+    int numNodes = 0;
+    for (int levelDimension = dimension / blockDimension; levelDimension >= 1; levelDimension /= 2)
+    {
+        m_levelOffsets.push_back(numNodes);
+        numNodes += math::Square(levelDimension);
+    }
+    m_nodes.resize(numNodes, Vec2f(0.f, 0.f));
+}
+
+void MinMaxPyramid::Update(const float* heights, int pitch, Vec2i min, Vec2i max)
+{
+    min = math::max(min, Vec2iZero);
+    max = math::min(max, Vec2i(m_dimension, m_dimension));
+    if (min.x >= max.x || min.y >= max.y)
+        return;
+
+    // Blocks touching the region, inclusive.
+    Vec2i nodeMin = min / m_blockDimension;
+    Vec2i nodeMax = (max - Vec2i(1, 1)) / m_blockDimension;
+    for (int z = nodeMin.y; z <= nodeMax.y; ++z)
+    {
+        for (int x = nodeMin.x; x <= nodeMax.x; ++x)
+        {
+            Vec2f bounds(FLT_MAX, -FLT_MAX);
+            for (int texZ = z * m_blockDimension; texZ < (z + 1) * m_blockDimension; ++texZ)
+            {
+                const float* row = heights + pitch * texZ + x * m_blockDimension;
+                for (int i = 0; i < m_blockDimension; ++i)
+                {
+                    bounds.x = std::min(bounds.x, row[i]);
+                    bounds.y = std::max(bounds.y, row[i]);
+                }
+            }
+            m_nodes[NodeIndex(0, Vec2i(x, z))] = bounds;
+        }
+    }
+
+    // Then each parent of those, a level at a time.
+    for (int level = 1; level < GetNumLevels(); ++level)
+    {
+        nodeMin /= 2;
+        nodeMax /= 2;
+        for (int z = nodeMin.y; z <= nodeMax.y; ++z)
+        {
+            for (int x = nodeMin.x; x <= nodeMax.x; ++x)
+            {
+                Vec2f bounds(FLT_MAX, -FLT_MAX);
+                for (int child = 0; child < 4; ++child)
+                {
+                    Vec2f childBounds = GetNode(level - 1, Vec2i(2 * x + (child & 1), 2 * z + (child >> 1)));
+                    bounds.x = std::min(bounds.x, childBounds.x);
+                    bounds.y = std::max(bounds.y, childBounds.y);
+                }
+                m_nodes[NodeIndex(level, Vec2i(x, z))] = bounds;
+            }
+        }
+    }
+}
+
+Vec2f MinMaxPyramid::Query(Vec2i min, Vec2i max) const
+{
+    min = math::max(min, Vec2iZero);
+    max = math::min(max, Vec2i(m_dimension, m_dimension));
+    if (min.x >= max.x || min.y >= max.y)
+        return Vec2f(FLT_MAX, -FLT_MAX);
+
+    // Go up levels until the region only covers a few nodes.
+    int level = 0;
+    Vec2i nodeMin = min / m_blockDimension;
+    Vec2i nodeMax = (max - Vec2i(1, 1)) / m_blockDimension;
+    while (level + 1 < GetNumLevels() && std::max(nodeMax.x - nodeMin.x, nodeMax.y - nodeMin.y) >= MaxQueryNodes)
+    {
+        ++level;
+        nodeMin /= 2;
+        nodeMax /= 2;
+    }
+
+    Vec2f bounds(FLT_MAX, -FLT_MAX);
+    for (int z = nodeMin.y; z <= nodeMax.y; ++z)
+    {
+        for (int x = nodeMin.x; x <= nodeMax.x; ++x)
+        {
+            Vec2f node = GetNode(level, Vec2i(x, z));
+            bounds.x = std::min(bounds.x, node.x);
+            bounds.y = std::max(bounds.y, node.y);
+        }
+    }
+    return bounds;
+}
+
+int MinMaxPyramid::NodeIndex(int level, Vec2i coords) const
+{
+    int levelDimension = GetLevelDimension(level);
+    Assert(0 <= coords.x && coords.x < levelDimension);
+    Assert(0 <= coords.y && coords.y < levelDimension);
+    return m_levelOffsets[level] + levelDimension * coords.y + coords.x;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * Min/max quadtree over a square, power of two height map: the bounds of each block of blockDimension^2 texels, then of each 2x2 block of those, up to a single root.
+ * Kept up to date incrementally by re-reading just the blocks under a changed region, so it can serve as the acceleration structure
+ * for raycasts, culling and bounds fitting without touching every texel.
+ */
+class MinMaxPyramid
+{
+public:
+    MinMaxPyramid() = default;
+    MinMaxPyramid(int dimension, int blockDimension);
+
+    // Recomputes the blocks overlapping texels [min, max) from the height map (which has the given row pitch, in floats), then their ancestors.
+    void Update(const float* heights, int pitch, Vec2i min, Vec2i max);
+    void Build(const float* heights, int pitch) { Update(heights, pitch, Vec2iZero, Vec2i(m_dimension, m_dimension)); }
+
+    // Conservative (min, max) of texels [min, max), clamped to the map. Uses coarser nodes for bigger regions, so may be looser than the exact range.
+    Vec2f Query(Vec2i min, Vec2i max) const;
+
+    Vec2f GetBounds() const { return m_nodes.back(); }
+    int GetDimension() const { return m_dimension; }
+    int GetNumLevels() const { return (int)m_levelOffsets.size(); }
+    int GetLevelDimension(int level) const { return (m_dimension / m_blockDimension) >> level; } // Nodes along each side at a level; level 0 is the finest.
+    int GetNodeTexels(int level) const { return m_blockDimension << level; }                    // Texels along each side of a node at a level.
+    Vec2f GetNode(int level, Vec2i coords) const { return m_nodes[NodeIndex(level, coords)]; }
+
+private:
+    int NodeIndex(int level, Vec2i coords) const;
+
+    int m_dimension = 0;
+    int m_blockDimension = 0;
+    std::vector<int> m_levelOffsets;
+    std::vector<Vec2f> m_nodes; // (min, max) for every node, finest level first.
+};
+
+}
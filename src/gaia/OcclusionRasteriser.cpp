@@ -0,0 +1,298 @@
+#include "OcclusionRasteriser.hpp"
+#include "ThreadPool.hpp"
+
+namespace gaia
+{
+
+// Triangles and boxes closer than this to the eye, in view depth, aren't rasterised or tested.
+static constexpr float NearW = 0.1f;
+
+// Items each thread pool job transforms, sets up or tests.
+static constexpr int ItemsPerJob = 1024;
+static constexpr int QueriesPerJob = 64;
+
+// Pixel coordinates of a clip space position, with pixel centres at halves and y down the screen.
+static inline Vec2f ToScreen(const Vec4f& clip, float invW, Vec2f screenSize)
+{
+    return Vec2f(clip.x * invW * 0.5f + 0.5f, 0.5f - clip.y * invW * 0.5f) * screenSize;
+}
+
+static inline float Cross(Vec2f a, Vec2f b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+void OcclusionRasteriser::Init(int width, int height)
+{
+    Assert(width > 0 && height > 0 && width % TileWidth == 0 && height % TileHeight == 0);
+    m_width = width;
+    m_height = height;
+    m_tilesX = width / TileWidth;
+    m_tileBins.resize(m_tilesX * (height / TileHeight));
+
+    m_levelOffsets.clear();
+    m_levelSizes.clear();
+    int numTexels = 0;
+    for (Vec2i size(width, height);; size = (size + Vec2i(1, 1)) / 2)
+    {
+        m_levelOffsets.push_back(numTexels);
+        m_levelSizes.push_back(size);
+        numTexels += size.x * size.y;
+        if (size == Vec2i(1, 1))
+            break;
+    }
+    m_depth.assign(numTexels, 0.f);
+}
+
+void OcclusionRasteriser::Begin(const Mat4f& viewProj)
+{
+    m_viewProj = viewProj;
+    std::fill_n(m_depth.begin(), m_width * m_height, 0.f);
+    m_stats = Stats();
+}
+
+bool OcclusionRasteriser::Setup(const Vec4f& clip0, const Vec4f& clip1, const Vec4f& clip2, SetupTriangle& outTriangle) const
+{
+    if (std::min({ clip0.w, clip1.w, clip2.w }) < NearW)
+        return false;
+
+    const Vec2f screenSize((float)m_width, (float)m_height);
+    Vec2f s[3];
+    float z[3] = { 1.f / clip0.w, 1.f / clip1.w, 1.f / clip2.w };
+    s[0] = ToScreen(clip0, z[0], screenSize);
+    s[1] = ToScreen(clip1, z[1], screenSize);
+    s[2] = ToScreen(clip2, z[2], screenSize);
+
+    // Either winding, since occluders are solid.
+    float area = Cross(s[1] - s[0], s[2] - s[0]);
+    if (area == 0.f)
+        return false;
+
+    if (area < 0.f)
+    {
+        std::swap(s[1], s[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    outTriangle.min = math::max(math::Vec2Floor(math::min(math::min(s[0], s[1]), s[2])), Vec2iZero);
+    outTriangle.max = math::min(math::Vec2Floor(math::max(math::max(s[0], s[1]), s[2])) + Vec2i(1, 1), Vec2i(m_width, m_height));
+    if (outTriangle.min.x >= outTriangle.max.x || outTriangle.min.y >= outTriangle.max.y)
+        return false;
+
+    // Each edge function is positive inside. Moving it in by half a pixel along each axis means it's only positive at centres of pixels wholly inside.
+    for (int i = 0; i < 3; ++i)
+    {
+        const Vec2f a = s[i];
+        const Vec2f b = s[(i + 1) % 3];
+        outTriangle.edgeA[i] = a.y - b.y;
+        outTriangle.edgeB[i] = b.x - a.x;
+        outTriangle.edgeC[i] = -(outTriangle.edgeA[i] * a.x + outTriangle.edgeB[i] * a.y) - 0.5f * (fabsf(outTriangle.edgeA[i]) + fabsf(outTriangle.edgeB[i]));
+    }
+
+    // Likewise the depth plane is moved back by the most it changes across half a pixel, so it's the furthest in each pixel.
+    const Vec2f d1 = s[1] - s[0];
+    const Vec2f d2 = s[2] - s[0];
+    outTriangle.depthA = ((z[1] - z[0]) * d2.y - (z[2] - z[0]) * d1.y) / area;
+    outTriangle.depthB = ((z[2] - z[0]) * d1.x - (z[1] - z[0]) * d2.x) / area;
+    outTriangle.depthC = z[0] - outTriangle.depthA * s[0].x - outTriangle.depthB * s[0].y - 0.5f * (fabsf(outTriangle.depthA) + fabsf(outTriangle.depthB));
+    outTriangle.minDepth = std::min({ z[0], z[1], z[2] });
+    return true;
+}
+
+bool OcclusionRasteriser::CoversAnyPixel(const SetupTriangle& triangle, Vec2i min, Vec2i max)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        const float x = (triangle.edgeA[i] > 0.f) ? (float)max.x - 0.5f : (float)min.x + 0.5f;
+        const float y = (triangle.edgeB[i] > 0.f) ? (float)max.y - 0.5f : (float)min.y + 0.5f;
+        if (triangle.edgeA[i] * x + triangle.edgeB[i] * y + triangle.edgeC[i] < 0.f)
+            return false;
+    }
+    return true;
+}
+
+void OcclusionRasteriser::RasteriseTriangles(const TriangleMesh& mesh)
+{
+    const int numVertices = (int)mesh.vertices.size();
+    const int numTriangles = (int)mesh.indices.size() / 3;
+    m_stats.numTriangles += numTriangles;
+    m_clipVertices.resize(numVertices);
+    m_triangles.resize(numTriangles);
+    m_triangleValid.resize(numTriangles);
+
+    ThreadPool::Instance().ParallelFor((numVertices + ItemsPerJob - 1) / ItemsPerJob, [&](int job)
+    {
+        const int end = std::min((job + 1) * ItemsPerJob, numVertices);
+        for (int i = job * ItemsPerJob; i < end; ++i)
+        {
+            m_clipVertices[i] = m_viewProj * Vec4f(mesh.vertices[i], 1.f);
+        }
+    });
+    ThreadPool::Instance().ParallelFor((numTriangles + ItemsPerJob - 1) / ItemsPerJob, [&](int job)
+    {
+        const int end = std::min((job + 1) * ItemsPerJob, numTriangles);
+        for (int i = job * ItemsPerJob; i < end; ++i)
+        {
+            const uint32* indices = &mesh.indices[3 * i];
+            m_triangleValid[i] = Setup(m_clipVertices[indices[0]], m_clipVertices[indices[1]], m_clipVertices[indices[2]], m_triangles[i]);
+        }
+    });
+
+    // Bin them, then each tile only reads its own triangles and writes its own pixels.
+    for (std::vector<int>& bin : m_tileBins)
+    {
+        bin.clear();
+    }
+    for (int i = 0; i < numTriangles; ++i)
+    {
+        if (!m_triangleValid[i])
+            continue;
+
+        const SetupTriangle& triangle = m_triangles[i];
+        const Vec2i tileMin = triangle.min / Vec2i(TileWidth, TileHeight);
+        const Vec2i tileMax = (triangle.max - Vec2i(1, 1)) / Vec2i(TileWidth, TileHeight);
+        for (int y = tileMin.y; y <= tileMax.y; ++y)
+        {
+            for (int x = tileMin.x; x <= tileMax.x; ++x)
+            {
+                if (!CoversAnyPixel(triangle, Vec2i(TileWidth * x, TileHeight * y), Vec2i(TileWidth * (x + 1), TileHeight * (y + 1))))
+                    continue;
+
+                m_tileBins[m_tilesX * y + x].push_back(i);
+                ++m_stats.numBinned;
+            }
+        }
+        ++m_stats.numRasterised;
+    }
+
+    ThreadPool::Instance().ParallelFor((int)m_tileBins.size(), [&](int tile) { RasteriseTile(tile); });
+}
+
+void OcclusionRasteriser::RasteriseTile(int tile)
+{
+    const Vec2i tileMin(TileWidth * (tile % m_tilesX), TileHeight * (tile / m_tilesX));
+    const __m128 laneCentres = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for (int index : m_tileBins[tile])
+    {
+        const SetupTriangle& triangle = m_triangles[index];
+        const int minX = std::max(triangle.min.x, tileMin.x) & ~3;
+        const int maxX = std::min(triangle.max.x, tileMin.x + TileWidth);
+        const int minY = std::max(triangle.min.y, tileMin.y);
+        const int maxY = std::min(triangle.max.y, tileMin.y + TileHeight);
+        const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+        const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+        const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+        const __m128 depthA = _mm_set1_ps(triangle.depthA);
+        const __m128 minDepth = _mm_set1_ps(triangle.minDepth);
+        for (int y = minY; y < maxY; ++y)
+        {
+            // Along the row, each function only changes with x.
+            const float centreY = (float)y + 0.5f;
+            const __m128 row0 = _mm_set1_ps(triangle.edgeB[0] * centreY + triangle.edgeC[0]);
+            const __m128 row1 = _mm_set1_ps(triangle.edgeB[1] * centreY + triangle.edgeC[1]);
+            const __m128 row2 = _mm_set1_ps(triangle.edgeB[2] * centreY + triangle.edgeC[2]);
+            const __m128 rowDepth = _mm_set1_ps(triangle.depthB * centreY + triangle.depthC);
+            float* row = &m_depth[m_width * y];
+            for (int x = minX; x < maxX; x += 4)
+            {
+                const __m128 centreX = _mm_add_ps(_mm_set1_ps((float)x), laneCentres);
+                __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, centreX), row0), zero);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, centreX), row1), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, centreX), row2), zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                // Keeps the nearest occluder, i.e. the largest 1 / w; pixels outside are masked to 0, which never wins.
+                const __m128 depth = _mm_max_ps(_mm_add_ps(_mm_mul_ps(depthA, centreX), rowDepth), minDepth);
+                _mm_storeu_ps(row + x, _mm_max_ps(_mm_loadu_ps(row + x), _mm_and_ps(inside, depth)));
+            }
+        }
+    }
+}
+
+void OcclusionRasteriser::BuildPyramid()
+{
+    // Texels past the end of an odd sized level read its last row or column again.
+    for (int level = 1; level < GetNumLevels(); ++level)
+    {
+        const Vec2i childSize = m_levelSizes[level - 1];
+        const Vec2i size = m_levelSizes[level];
+        const float* children = &m_depth[m_levelOffsets[level - 1]];
+        float* texels = &m_depth[m_levelOffsets[level]];
+        for (int y = 0; y < size.y; ++y)
+        {
+            const float* childRow0 = children + childSize.x * (2 * y);
+            const float* childRow1 = children + childSize.x * std::min(2 * y + 1, childSize.y - 1);
+            for (int x = 0; x < size.x; ++x)
+            {
+                const int x0 = 2 * x;
+                const int x1 = std::min(2 * x + 1, childSize.x - 1);
+                texels[size.x * y + x] = std::min({ childRow0[x0], childRow0[x1], childRow1[x0], childRow1[x1] });
+            }
+        }
+    }
+}
+
+bool OcclusionRasteriser::IsOccluded(const AABB3f& box) const
+{
+    // Depth is linear in world space, so the nearest point of the box is one of its corners.
+    const Vec2f screenSize((float)m_width, (float)m_height);
+    Vec2f screenMin(FLT_MAX, FLT_MAX);
+    Vec2f screenMax(-FLT_MAX, -FLT_MAX);
+    float minW = FLT_MAX;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        const Vec3f pos((corner & 1) ? box.m_max.x : box.m_min.x, (corner & 2) ? box.m_max.y : box.m_min.y, (corner & 4) ? box.m_max.z : box.m_min.z);
+        const Vec4f clip = m_viewProj * Vec4f(pos, 1.f);
+        if (clip.w < NearW)
+            return false;
+
+        const Vec2f screen = ToScreen(clip, 1.f / clip.w, screenSize);
+        screenMin = math::min(screenMin, screen);
+        screenMax = math::max(screenMax, screen);
+        minW = std::min(minW, clip.w);
+    }
+
+    const Vec2i pixelMin = math::max(math::Vec2Floor(screenMin), Vec2iZero);
+    const Vec2i pixelMax = math::min(math::Vec2Floor(screenMax), Vec2i(m_width - 1, m_height - 1)); // Inclusive.
+    if (pixelMin.x > pixelMax.x || pixelMin.y > pixelMax.y)
+        return false;
+
+    // The first level where it touches no more than two texels along each side.
+    int level = 0;
+    while (level + 1 < GetNumLevels() && ((pixelMax.x >> level) - (pixelMin.x >> level) > 1 || (pixelMax.y >> level) - (pixelMin.y >> level) > 1))
+    {
+        ++level;
+    }
+
+    const float nearest = 1.f / minW;
+    const Vec2i size = m_levelSizes[level];
+    const float* texels = GetLevel(level);
+    for (int y = pixelMin.y >> level; y <= pixelMax.y >> level; ++y)
+    {
+        for (int x = pixelMin.x >> level; x <= pixelMax.x >> level; ++x)
+        {
+            if (texels[size.x * y + x] < nearest)
+                return false;
+        }
+    }
+    return true;
+}
+
+void OcclusionRasteriser::TestOcclusion(const Span<const AABB3f>& boxes, const Span<bool>& outOccluded) const
+{
+    Assert(outOccluded.Size() == boxes.Size());
+    const int numBoxes = (int)boxes.Size();
+    ThreadPool::Instance().ParallelFor((numBoxes + QueriesPerJob - 1) / QueriesPerJob, [&](int job)
+    {
+        const int end = std::min((job + 1) * QueriesPerJob, numBoxes);
+        for (int i = job * QueriesPerJob; i < end; ++i)
+        {
+            outOccluded[i] = IsOccluded(boxes[i]);
+        }
+    });
+}
+
+}
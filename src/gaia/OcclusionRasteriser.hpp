@@ -0,0 +1,87 @@
+#pragma once
+#include "Math/AABB.hpp"
+#include "RtinHierarchy.hpp"
+
+namespace gaia
+{
+
+/*
+ * Software depth buffer for occlusion culling on the CPU, so nothing has to be read back from the GPU.
+ * Occluders are triangle meshes that lie wholly behind what they stand for, e.g. under the ground. They're rasterised at low resolution
+ * into tiles spread across the thread pool, four pixels at a time, conservatively: a pixel only takes a triangle's depth if the triangle
+ * covers all of it, and then the furthest depth the triangle has in it. Depth is stored as 1 / w, which is linear in screen space.
+ * A min pyramid over it then tests boxes against a few texels each.
+ */
+class OcclusionRasteriser
+{
+public:
+    static constexpr int TileWidth = 32;
+    static constexpr int TileHeight = 8;
+
+    struct Stats
+    {
+        int numTriangles = 0;  // Passed in.
+        int numRasterised = 0; // That weren't off screen, too thin to cover a pixel or through the near plane.
+        int numBinned = 0;     // Triangle and tile pairs.
+    };
+
+    // Dimensions must be multiples of the tile size.
+    void Init(int width, int height);
+
+    // Clears the depth, and sets the view the rest uses.
+    void Begin(const Mat4f& viewProj);
+
+    // Adds occluders. Triangles that reach the near plane are skipped, which leaves holes rather than anything wrong.
+    void RasteriseTriangles(const TriangleMesh& mesh);
+
+    // Rebuilds the depth pyramid. Call after the last RasteriseTriangles() and before testing.
+    void BuildPyramid();
+
+    // Whether a box is wholly behind the occluders. Boxes off screen or reaching the near plane aren't.
+    bool IsOccluded(const AABB3f& box) const;
+
+    // Batched version, spread across the thread pool.
+    void TestOcclusion(const Span<const AABB3f>& boxes, const Span<bool>& outOccluded) const;
+
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    int GetNumLevels() const { return (int)m_levelOffsets.size(); }
+    Vec2i GetLevelSize(int level) const { return m_levelSizes[level]; } // Each level's texels are the min of up to 2x2 of the last's.
+    const float* GetLevel(int level) const { return &m_depth[m_levelOffsets[level]]; } // 1 / w of the furthest occluder in each texel, 0 for none.
+    const Stats& GetStats() const { return m_stats; }
+
+private:
+    // Edge functions, inset so they pass pixel centres only where the whole pixel is inside, and the depth plane.
+    struct SetupTriangle
+    {
+        Vec2i min; // Pixels it touches.
+        Vec2i max; // Exclusive.
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float depthA;
+        float depthB;
+        float depthC;
+        float minDepth; // Of its vertices, which bounds the depth anywhere inside.
+    };
+
+    bool Setup(const Vec4f& clip0, const Vec4f& clip1, const Vec4f& clip2, SetupTriangle& outTriangle) const;
+    // Whether any pixel centre in [min, max) could be inside, going by each edge on its own. Skips the tiles a long thin triangle's bounds only graze.
+    static bool CoversAnyPixel(const SetupTriangle& triangle, Vec2i min, Vec2i max);
+    void RasteriseTile(int tile);
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_tilesX = 0;
+    Mat4f m_viewProj = Mat4fIdentity;
+    std::vector<int> m_levelOffsets;
+    std::vector<Vec2i> m_levelSizes;
+    std::vector<float> m_depth;               // Each level of the pyramid, finest first, row major.
+    std::vector<Vec4f> m_clipVertices;        // Scratch, for the mesh being rasterised.
+    std::vector<SetupTriangle> m_triangles;   // Scratch, likewise.
+    std::vector<uint8> m_triangleValid;       // Whether each was set up, i.e. could cover a pixel.
+    std::vector<std::vector<int>> m_tileBins; // Triangles touching each tile.
+    Stats m_stats;
+};
+
+}
@@ -0,0 +1,239 @@
+#include "PatchCuller.hpp"
+
+namespace gaia
+{
+
+// Patches along each side of a block.
+static constexpr int BlockPatches = 16;
+
+template<typename IndexType>
+static inline IndexType* WritePatch(IndexType* out, int vertexGridDimension, int x, int z)
+{
+    out[0] = (IndexType)(vertexGridDimension * (z + 0) + (x + 0));
+    out[1] = (IndexType)(vertexGridDimension * (z + 0) + (x + 1));
+    out[2] = (IndexType)(vertexGridDimension * (z + 1) + (x + 0));
+    out[3] = (IndexType)(vertexGridDimension * (z + 1) + (x + 1));
+    return out + 4;
+}
+
+void PatchCuller::Init(int vertexGridDimension, Vec2f origin, float patchSize, PatchOrder::E order)
+{
+    Assert(vertexGridDimension >= 2);
+    m_patchesPerSide = vertexGridDimension - 1;
+    m_blocksPerSide = (m_patchesPerSide + BlockPatches - 1) / BlockPatches;
+    m_origin = origin;
+    m_patchSize = patchSize;
+
+    // Until told otherwise, patches could be at any height.
+    m_heightBounds.assign(math::Square(m_patchesPerSide), Vec2f(-FLT_MAX, FLT_MAX));
+    m_blockHeightBounds.assign(math::Square(m_blocksPerSide), Vec2f(-FLT_MAX, FLT_MAX));
+    m_blockFirstPatches.resize(math::Square(m_blocksPerSide));
+    m_patchBoxes.Resize(math::Square(m_patchesPerSide));
+
+    // Group the patches by block, keeping blocks and the patches within each in the order they first come up.
+    // Blocks are a power of two, so with the curves each one is already a single run and this changes nothing.
+    std::vector<Vec2i> patchOrder;
+    CalcPatchOrder(order, m_patchesPerSide, m_patchesPerSide, patchOrder);
+    std::vector<int> nextPatches(math::Square(m_blocksPerSide), -1);
+    m_blockOrder.clear();
+    for (Vec2i coords : patchOrder)
+    {
+        const Vec2i block = coords / BlockPatches;
+        int& next = nextPatches[m_blocksPerSide * block.y + block.x];
+        if (next < 0)
+        {
+            next = 0;
+            m_blockOrder.push_back(block);
+        }
+    }
+
+    int first = 0;
+    for (Vec2i block : m_blockOrder)
+    {
+        const int blockIndex = m_blocksPerSide * block.y + block.x;
+        const auto [begin, end] = GetBlockRange(block);
+        m_blockFirstPatches[blockIndex] = first;
+        nextPatches[blockIndex] = first;
+        first += (end.x - begin.x) * (end.y - begin.y);
+    }
+
+    m_patchOrder.resize(patchOrder.size());
+    for (Vec2i coords : patchOrder)
+    {
+        const Vec2i block = coords / BlockPatches;
+        m_patchOrder[nextPatches[m_blocksPerSide * block.y + block.x]++] = coords;
+    }
+    UpdateBlocks();
+}
+
+AABB3f PatchCuller::GetPatchBounds(int x, int z) const
+{
+    const Vec2f heights = m_heightBounds[m_patchesPerSide * z + x];
+    const Vec2f min = m_origin + Vec2f((float)x, (float)z) * m_patchSize;
+    return { Vec3f(min.x, heights.x, min.y), Vec3f(min.x + m_patchSize, heights.y, min.y + m_patchSize) };
+}
+
+Pair<Vec2i, Vec2i> PatchCuller::GetBlockRange(Vec2i block) const
+{
+    const Vec2i begin = block * BlockPatches;
+    const Vec2i end = math::min(begin + Vec2i(BlockPatches, BlockPatches), Vec2i(m_patchesPerSide, m_patchesPerSide));
+    return { begin, end };
+}
+
+void PatchCuller::UpdateBlocks()
+{
+    for (Vec2i block : m_blockOrder)
+    {
+        const int blockIndex = m_blocksPerSide * block.y + block.x;
+        const auto [begin, end] = GetBlockRange(block);
+        const int first = m_blockFirstPatches[blockIndex];
+        const int numPatches = (end.x - begin.x) * (end.y - begin.y);
+
+        Vec2f bounds(FLT_MAX, -FLT_MAX);
+        for (int patch = first; patch < first + numPatches; ++patch)
+        {
+            const Vec2i coords = m_patchOrder[patch];
+            const Vec2f heights = m_heightBounds[m_patchesPerSide * coords.y + coords.x];
+            bounds.x = std::min(bounds.x, heights.x);
+            bounds.y = std::max(bounds.y, heights.y);
+            m_patchBoxes.Set(patch, GetPatchBounds(coords.x, coords.y));
+        }
+        m_blockHeightBounds[blockIndex] = bounds;
+    }
+}
+
+Vec2f PatchCuller::CalcHeightBounds(Vec2f worldMin, Vec2f worldMax) const
+{
+    // Clamp in patch units before converting to ints, since the rectangle can be unbounded.
+    Vec2f bounds(FLT_MAX, -FLT_MAX);
+    const float gridSize = (float)m_patchesPerSide;
+    const Vec2f first = (worldMin - m_origin) / m_patchSize;
+    const Vec2f last = (worldMax - m_origin) / m_patchSize;
+    if (last.x < 0.f || last.y < 0.f || first.x > gridSize || first.y > gridSize)
+        return bounds;
+
+    const Vec2i begin = math::Vec2Floor(std::clamp(first, Vec2fZero, Vec2f(gridSize - 1.f, gridSize - 1.f)));
+    const Vec2i end = math::Vec2Floor(std::clamp(last, Vec2fZero, Vec2f(gridSize - 1.f, gridSize - 1.f))) + Vec2i(1, 1); // Exclusive.
+    for (int blockZ = begin.y / BlockPatches; blockZ <= (end.y - 1) / BlockPatches; ++blockZ)
+    {
+        for (int blockX = begin.x / BlockPatches; blockX <= (end.x - 1) / BlockPatches; ++blockX)
+        {
+            // Use the block's bounds if it's wholly inside, otherwise its patches that are.
+            const Vec2i blockBegin(blockX * BlockPatches, blockZ * BlockPatches);
+            const Vec2i blockEnd = math::min(blockBegin + Vec2i(BlockPatches, BlockPatches), Vec2i(m_patchesPerSide, m_patchesPerSide));
+            const Vec2i patchBegin = math::max(blockBegin, begin);
+            const Vec2i patchEnd = math::min(blockEnd, end);
+            if (patchBegin == blockBegin && patchEnd == blockEnd)
+            {
+                const Vec2f heights = m_blockHeightBounds[m_blocksPerSide * blockZ + blockX];
+                bounds.x = std::min(bounds.x, heights.x);
+                bounds.y = std::max(bounds.y, heights.y);
+                continue;
+            }
+
+            for (int z = patchBegin.y; z < patchEnd.y; ++z)
+            {
+                for (int x = patchBegin.x; x < patchEnd.x; ++x)
+                {
+                    const Vec2f heights = m_heightBounds[m_patchesPerSide * z + x];
+                    bounds.x = std::min(bounds.x, heights.x);
+                    bounds.y = std::max(bounds.y, heights.y);
+                }
+            }
+        }
+    }
+    return bounds;
+}
+
+int PatchCuller::WriteAllIndices(uint16* outIndices) const
+{
+    return WriteAllIndicesImpl(outIndices);
+}
+
+int PatchCuller::WriteAllIndices(uint32* outIndices) const
+{
+    return WriteAllIndicesImpl(outIndices);
+}
+
+template<typename IndexType>
+int PatchCuller::WriteAllIndicesImpl(IndexType* outIndices) const
+{
+    const int vertexGridDimension = m_patchesPerSide + 1;
+    IndexType* out = outIndices;
+    for (Vec2i coords : m_patchOrder)
+    {
+        out = WritePatch(out, vertexGridDimension, coords.x, coords.y);
+    }
+    return (int)(out - outIndices);
+}
+
+int PatchCuller::WriteVisibleIndices(const Frustumf& frustum, uint16* outIndices, const HorizonCuller* horizon, int* outNumOccluded) const
+{
+    return WriteVisibleIndicesImpl(frustum, outIndices, horizon, outNumOccluded);
+}
+
+int PatchCuller::WriteVisibleIndices(const Frustumf& frustum, uint32* outIndices, const HorizonCuller* horizon, int* outNumOccluded) const
+{
+    return WriteVisibleIndicesImpl(frustum, outIndices, horizon, outNumOccluded);
+}
+
+template<typename IndexType>
+int PatchCuller::WriteVisibleIndicesImpl(const Frustumf& frustum, IndexType* outIndices, const HorizonCuller* horizon, int* outNumOccluded) const
+{
+    // Indices are written strictly in order, since the output is usually write-combined upload memory.
+    const int vertexGridDimension = m_patchesPerSide + 1;
+    IndexType* out = outIndices;
+    int numOccluded = 0;
+    for (Vec2i block : m_blockOrder)
+    {
+        const auto [begin, end] = GetBlockRange(block);
+        const Vec2f heights = m_blockHeightBounds[m_blocksPerSide * block.y + block.x];
+        const Vec2f min = m_origin + Vec2f(begin) * m_patchSize;
+        const Vec2f max = m_origin + Vec2f(end) * m_patchSize;
+        const AABB3f blockBox = { Vec3f(min.x, heights.x, min.y), Vec3f(max.x, heights.y, max.y) };
+        const FrustumTest::E blockTest = frustum.Classify(blockBox);
+        if (blockTest == FrustumTest::Outside)
+            continue;
+
+        // Which of its patches touch the frustum: all of them if the block's inside, else test each.
+        const int first = m_blockFirstPatches[m_blocksPerSide * block.y + block.x];
+        const int numPatches = (end.x - begin.x) * (end.y - begin.y);
+        uint32 visible[CullMaskWords(BlockPatches * BlockPatches)];
+        if (blockTest == FrustumTest::Inside)
+        {
+            std::fill_n(visible, CullMaskWords(numPatches), ~0u);
+            if (numPatches % 32 != 0)
+            {
+                visible[numPatches / 32] = (1u << (numPatches % 32)) - 1;
+            }
+        }
+        else
+        {
+            CullAABBs(frustum, m_patchBoxes, first, numPatches, visible);
+        }
+
+        // Hidden behind the ground nearer the eye: the whole block, or else patch by patch.
+        const bool blockOccluded = horizon && horizon->IsOccluded(blockBox);
+        for (int word = 0; word < CullMaskWords(numPatches); ++word)
+        {
+            for (uint32 bits = visible[word]; bits != 0; bits &= bits - 1)
+            {
+                const int patch = first + 32 * word + math::CountTrailingZeros(bits);
+                if (horizon && (blockOccluded || horizon->IsOccluded(m_patchBoxes.Get(patch))))
+                {
+                    ++numOccluded;
+                    continue;
+                }
+                out = WritePatch(out, vertexGridDimension, m_patchOrder[patch].x, m_patchOrder[patch].y);
+            }
+        }
+    }
+
+    if (outNumOccluded)
+    {
+        *outNumOccluded = numOccluded;
+    }
+    return (int)(out - outIndices);
+}
+
+}
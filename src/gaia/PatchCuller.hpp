@@ -0,0 +1,61 @@
+#pragma once
+#include "HorizonCuller.hpp"
+#include "Math/BatchCulling.hpp"
+#include "PatchOrder.hpp"
+
+namespace gaia
+{
+
+/*
+ * CPU culling of the terrain's vertex patches, the quads of the vertex grid that the hull shader tessellates.
+ * Each patch's box is its square of the grid in XZ and a height range, usually from the clipmap's min/max pyramids.
+ * Patches are grouped into blocks whose boxes are tested first, so blocks wholly outside the frustum are skipped and blocks
+ * wholly inside are written out without testing each patch. The patches of the rest are tested four at a time with the SIMD kernels.
+ */
+class PatchCuller
+{
+public:
+    // origin is the world XZ of the grid's first vertex. Blocks, and the patches within each, are visited in the given order,
+    // which is the order of the full index list and of every culled one.
+    void Init(int vertexGridDimension, Vec2f origin, float patchSize, PatchOrder::E order);
+
+    int GetPatchesPerSide() const { return m_patchesPerSide; }
+    AABB3f GetPatchBounds(int x, int z) const;
+
+    // Height range of patch (x, z). Call UpdateBlocks() once they're all set.
+    void SetHeightBounds(int x, int z, Vec2f bounds) { m_heightBounds[m_patchesPerSide * z + x] = bounds; }
+    void UpdateBlocks();
+
+    // Height range of the patches a world XZ rectangle touches, or (FLT_MAX, -FLT_MAX) if it's off the grid. The rectangle can be unbounded.
+    Vec2f CalcHeightBounds(Vec2f worldMin, Vec2f worldMax) const;
+
+    // Writes the four control point indices of every patch, for the full index buffer. Returns the number of indices written.
+    int WriteAllIndices(uint16* outIndices) const;
+    int WriteAllIndices(uint32* outIndices) const;
+
+    // Writes the four control point indices of each patch whose box touches the frustum, in the same order as WriteAllIndices().
+    // With a horizon, patches in the frustum but hidden below it are left out too, and counted in outNumOccluded if that's given.
+    // Returns the number of indices written.
+    int WriteVisibleIndices(const Frustumf& frustum, uint16* outIndices, const HorizonCuller* horizon = nullptr, int* outNumOccluded = nullptr) const;
+    int WriteVisibleIndices(const Frustumf& frustum, uint32* outIndices, const HorizonCuller* horizon = nullptr, int* outNumOccluded = nullptr) const;
+
+private:
+    template<typename IndexType>
+    int WriteAllIndicesImpl(IndexType* outIndices) const;
+    template<typename IndexType>
+    int WriteVisibleIndicesImpl(const Frustumf& frustum, IndexType* outIndices, const HorizonCuller* horizon, int* outNumOccluded) const;
+    Pair<Vec2i, Vec2i> GetBlockRange(Vec2i block) const; // First patch and one past the last.
+
+    int m_patchesPerSide = 0;
+    int m_blocksPerSide = 0;
+    Vec2f m_origin = Vec2fZero;
+    float m_patchSize = 0.f;
+    std::vector<Vec2f> m_heightBounds;      // (min, max) per patch, row major.
+    std::vector<Vec2f> m_blockHeightBounds; // Over the patches in each block.
+    std::vector<int> m_blockFirstPatches;   // Where each block's patches start in m_patchBoxes.
+    std::vector<Vec2i> m_blockOrder;        // The order blocks are visited in.
+    std::vector<Vec2i> m_patchOrder;        // Each patch's (x, z), grouped by block like m_patchBoxes.
+    AABBBatch m_patchBoxes;                 // Grouped by block in visiting order, then in the same order within each.
+};
+
+}
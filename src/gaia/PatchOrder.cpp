@@ -0,0 +1,131 @@
+#include "PatchOrder.hpp"
+
+namespace gaia
+{
+
+// Every other bit of n, from the bottom.
+static inline int CompactEvenBits(uint32 n)
+{
+    n &= 0x55555555;
+    n = (n | (n >> 1)) & 0x33333333;
+    n = (n | (n >> 2)) & 0x0f0f0f0f;
+    n = (n | (n >> 4)) & 0x00ff00ff;
+    n = (n | (n >> 8)) & 0x0000ffff;
+    return (int)n;
+}
+
+static inline Vec2i MortonToCoords(uint32 d)
+{
+    return Vec2i(CompactEvenBits(d), CompactEvenBits(d >> 1));
+}
+
+// Position d along the Hilbert curve over an n by n square, where n is a power of two.
+static inline Vec2i HilbertToCoords(int n, int d)
+{
+    Vec2i coords(0, 0);
+    for (int s = 1; s < n; s *= 2)
+    {
+        const int rx = 1 & (d / 2);
+        const int ry = 1 & (d ^ rx);
+
+        // Rotate the quadrant so the sub-curves join up end to end.
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                coords = Vec2i(s - 1, s - 1) - coords;
+            }
+            std::swap(coords.x, coords.y);
+        }
+
+        coords += Vec2i(s * rx, s * ry);
+        d /= 4;
+    }
+    return coords;
+}
+
+void CalcPatchOrder(PatchOrder::E order, int width, int height, std::vector<Vec2i>& outPatches)
+{
+    Assert(width > 0 && height > 0);
+    outPatches.clear();
+    outPatches.reserve(width * height);
+    if (order == PatchOrder::RowMajor)
+    {
+        for (int z = 0; z < height; ++z)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                outPatches.push_back(Vec2i(x, z));
+            }
+        }
+        return;
+    }
+
+    int n = 1;
+    while (n < std::max(width, height))
+    {
+        n *= 2;
+    }
+
+    for (int d = 0; d < n * n; ++d)
+    {
+        const Vec2i coords = (order == PatchOrder::Morton) ? MortonToCoords((uint32)d) : HilbertToCoords(n, d);
+        if (coords.x < width && coords.y < height)
+        {
+            outPatches.push_back(coords);
+        }
+    }
+    Assert((int)outPatches.size() == width * height);
+}
+
+template<typename IndexType>
+static VertexCacheStats SimulateVertexCacheImpl(const Span<const IndexType>& indices, int indicesPerPrimitive, int cacheSize)
+{
+    Assert(indicesPerPrimitive > 0 && cacheSize > 0);
+    VertexCacheStats stats;
+    if (indices.Size() == 0)
+        return stats;
+
+    // FIFO, like most hardware: a hit doesn't refresh the entry, and a miss pushes out the oldest.
+    std::vector<uint32> cache(cacheSize, ~0u);
+    std::vector<bool> seen;
+    int next = 0;
+    int numUnique = 0;
+    for (size_t i = 0; i < indices.Size(); ++i)
+    {
+        const uint32 index = indices[i];
+        if (std::find(cache.begin(), cache.end(), index) != cache.end())
+            continue;
+
+        cache[next] = index;
+        next = (next + 1) % cacheSize;
+        ++stats.numMisses;
+
+        if (index >= seen.size())
+        {
+            seen.resize(index + 1, false);
+        }
+        if (!seen[index])
+        {
+            seen[index] = true;
+            ++numUnique;
+        }
+    }
+
+    const int numPrimitives = (int)indices.Size() / indicesPerPrimitive;
+    stats.acmr = (float)stats.numMisses / (float)std::max(numPrimitives, 1);
+    stats.atvr = (float)stats.numMisses / (float)numUnique;
+    return stats;
+}
+
+VertexCacheStats SimulateVertexCache(const Span<const uint16>& indices, int indicesPerPrimitive, int cacheSize)
+{
+    return SimulateVertexCacheImpl(indices, indicesPerPrimitive, cacheSize);
+}
+
+VertexCacheStats SimulateVertexCache(const Span<const uint32>& indices, int indicesPerPrimitive, int cacheSize)
+{
+    return SimulateVertexCacheImpl(indices, indicesPerPrimitive, cacheSize);
+}
+
+}
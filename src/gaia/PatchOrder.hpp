@@ -0,0 +1,35 @@
+#pragma once
+
+namespace gaia
+{
+
+namespace PatchOrder
+{
+enum E
+{
+    RowMajor,
+    Morton,  // Z-order: interleaved coordinate bits.
+    Hilbert, // Only steps to a neighbour over a power of two square. Elsewhere, skipping the patches outside the grid leaves some longer jumps.
+    Count
+};
+}
+
+struct VertexCacheStats
+{
+    float acmr = 0.f; // Average cache misses (vertex shader invocations) per primitive.
+    float atvr = 0.f; // Average invocations per unique vertex; 1 is ideal.
+    int numMisses = 0;
+};
+
+// Post-transform cache size the stats are usually quoted at.
+static constexpr int DefaultVertexCacheSize = 32;
+
+// The patches of a width by height grid in the given order, as (x, z). Curves are walked over the enclosing power of two square,
+// skipping what's outside the grid, so with them every aligned power of two square of patches comes out contiguous.
+void CalcPatchOrder(PatchOrder::E order, int width, int height, std::vector<Vec2i>& outPatches);
+
+// Simulates a FIFO post-transform vertex cache over an indexed primitive list, e.g. 4 control point patches or triangles.
+VertexCacheStats SimulateVertexCache(const Span<const uint16>& indices, int indicesPerPrimitive, int cacheSize = DefaultVertexCacheSize);
+VertexCacheStats SimulateVertexCache(const Span<const uint32>& indices, int indicesPerPrimitive, int cacheSize = DefaultVertexCacheSize);
+
+}
@@ -6,7 +6,6 @@
 #include <examples/imgui_impl_dx12.h>
 #include "Math/GaiaMath.hpp"
 #include "Math/AABB.hpp"
-#include "Math/Plane.hpp"
 #include "File.hpp"
 #include "CommandQueue.hpp"
 #include "GenerateMips.hpp"
@@ -18,11 +17,17 @@ namespace gaia
 {
 
 static constexpr int CBufferAlignment = 256;
+static constexpr int BufferUploadAlignment = 16;
 static constexpr int NumCBVDescriptors = 32;
 static constexpr int NumComputeDescriptors = 64;
 static constexpr int NumSamplers = 1;
 
 static constexpr int SunShadowmapSize = 4096;
+static constexpr int ShadowCascadeSize = SunShadowmapSize / 2; // Cascades are tiled 2x2 in the shadow map.
+
+static constexpr float CameraFovY = 0.25f * Pif;
+static constexpr float CameraNearClip = 0.01f;
+static constexpr float CameraFarClip = 1000.f;
 
 static int CountMips(int width, int height)
 {
@@ -37,7 +42,9 @@ struct VSSharedConstants
     Mat4f viewMat;
     Mat4f projMat;
     Mat4f mvpMat;
-    Mat4f shadowMvpMat;
+    Mat4f sunShadowMats[MaxShadowCascades];   // World to shadow map texture coords and (biased) depth, per cascade.
+    Vec4f sunShadowSpheres[MaxShadowCascades]; // Where each cascade can be used, as (centre, radius squared).
+    int numShadowCascades;
 };
 
 struct PSSharedConstants
@@ -65,7 +72,8 @@ struct RendererDebugState
 {
     bool m_freezeCascades = false;
     bool m_drawShadowBounds = false;
-    AABB3f m_frozenShadowBounds = AABB3fInvalid;
+    bool m_hasFrozenCamera = false;
+    ShadowCameraParams m_frozenCamera; // Cascades are fit to this while frozen.
 };
 
 static RendererDebugState s_debugState;
@@ -210,7 +218,10 @@ bool Renderer::Create(HWND hwnd)
 
     // Create constant buffers
     CreateMappedConstantBuffer(m_vsSharedConstants);
-    CreateMappedConstantBuffer(m_vsSharedConstantsShadowPass);
+    for (auto& buffer : m_vsSharedConstantsShadowPass)
+    {
+        CreateMappedConstantBuffer(buffer);
+    }
 
     // Create command allocators
     for (auto& allocator : m_commandAllocators)
@@ -249,7 +260,8 @@ bool Renderer::Create(HWND hwnd)
     if (!CreateRootSignature())
         return false;
 
-    m_uploadManager = std::make_unique<UploadManager>();
+    CommandQueue* uploadQueues[UploadQueue::Count] = { m_copyCommandQueue.get(), m_computeCommandQueue.get() };
+    m_uploadManager = std::make_unique<UploadManager>(m_device.Get(), uploadQueues);
 
     m_genMips = std::make_unique<gaia::GenerateMips>();
     if (!m_genMips->Init(*this))
@@ -331,13 +343,10 @@ bool Renderer::ResizeViewport(int width, int height)
     m_sunShadowDepthBuffer->SetName(L"Sun Shadowmap");
 #endif
 
-    // Create a readback buffer for the depth.
-    m_depthReadbackBuffer = CreateReadbackBuffer(GetTexturePitchBytes(width, sizeof(float)) * height);
-
     ImGui_ImplDX12_CreateDeviceObjects();
 
     m_viewport = CD3DX12_VIEWPORT(0.f, 0.f, (float)width, (float)height);
-    m_projMat = math::perspectiveFovRH(0.25f * Pif, m_viewport.Width, m_viewport.Height, 0.01f, 1000.f);
+    m_projMat = math::perspectiveFovRH(CameraFovY, m_viewport.Width, m_viewport.Height, CameraNearClip, CameraFarClip);
     return true;
 }
 
@@ -369,6 +378,7 @@ bool Renderer::CreateRootSignature()
     rootParams[RootParam::Texture3].InitAsDescriptorTable(1, &srvDescRange3, D3D12_SHADER_VISIBILITY_PIXEL);
     rootParams[RootParam::SunShadowMap].InitAsDescriptorTable(1, &sunShadowMapDescRange, D3D12_SHADER_VISIBILITY_PIXEL);
     rootParams[RootParam::Sampler0].InitAsDescriptorTable(1, &samplerSrvDescRange, D3D12_SHADER_VISIBILITY_DOMAIN);
+    rootParams[RootParam::HullBuffer].InitAsShaderResourceView(0, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, D3D12_SHADER_VISIBILITY_HULL);
 
     // Static sampler for textures.
     CD3DX12_STATIC_SAMPLER_DESC staticSamplers[StaticSampler::Count];
@@ -430,8 +440,8 @@ void Renderer::BeginFrame()
 {
     ID3D12CommandAllocator* commandAllocator = m_commandAllocators[m_currentBuffer].Get();
 
-    // Wait/clear pending uploads.
-    m_uploadManager->BeginFrame(*m_copyCommandQueue);
+    // Wait/recycle pending uploads.
+    m_uploadManager->BeginFrame();
 
     // Reset command list
     commandAllocator->Reset();
@@ -487,26 +497,11 @@ void Renderer::EndFrame()
         m_renderTargets[m_currentBuffer].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
     m_directCommandList->ResourceBarrier(1, &rtBarrier);
 
-    // Transition depth buffer to allow readback
+    // Transition depth buffer back to its state at the start of the frame
     CD3DX12_RESOURCE_BARRIER dsBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
         m_depthBuffer.Get(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COMMON);
     m_directCommandList->ResourceBarrier(1, &dsBarrier);
 
-    // Read back depth buffer after drawing.
-    // TODO: If we used a separate command list (but still m_directCommandQueue),
-    // could we allow the frame to present before this has finished, and wait on it separately?
-    D3D12_TEXTURE_COPY_LOCATION dst;
-    dst.pResource = m_depthReadbackBuffer.Get(),
-    dst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    dst.PlacedFootprint.Offset = 0;
-    dst.PlacedFootprint.Footprint.Format = DXGI_FORMAT_D32_FLOAT;
-    dst.PlacedFootprint.Footprint.Width = (UINT)m_viewport.Width;
-    dst.PlacedFootprint.Footprint.Height = (UINT)m_viewport.Height;
-    dst.PlacedFootprint.Footprint.Depth = 1;
-    dst.PlacedFootprint.Footprint.RowPitch = GetTexturePitchBytes(dst.PlacedFootprint.Footprint.Width, sizeof(float));
-    D3D12_TEXTURE_COPY_LOCATION src = { m_depthBuffer.Get() };
-    m_directCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
-
     // Get stats query data.
     m_directCommandList->EndQuery(m_statsQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0);
     m_directCommandList->ResolveQueryData(m_statsQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0, 1, m_statsQueryBuffers[m_currentBuffer].Get(), 0);
@@ -524,6 +519,39 @@ void Renderer::EndFrame()
 
 void Renderer::BeginShadowPass()
 {
+    // Fit the cascades to the view.
+    ShadowCameraParams camera;
+    camera.viewMat = m_viewMat;
+    camera.tanHalfFovY = tanf(0.5f * CameraFovY);
+    camera.aspect = m_viewport.Width / m_viewport.Height;
+    camera.nearClip = CameraNearClip;
+    camera.farClip = CameraFarClip;
+
+    // Debug option to look at the cascades from elsewhere.
+    if (s_debugState.m_freezeCascades)
+    {
+        if (!s_debugState.m_hasFrozenCamera)
+        {
+            s_debugState.m_frozenCamera = camera;
+            s_debugState.m_hasFrozenCamera = true;
+        }
+        camera = s_debugState.m_frozenCamera;
+    }
+
+    m_shadowCascadeParams.resolution = ShadowCascadeSize;
+    m_numShadowCascades = CalcShadowCascades(camera, m_shadowCascadeParams, m_sunDirection, m_sceneHeightBounds, m_shadowCascades);
+
+    // Debug draw.
+    if (s_debugState.m_drawShadowBounds)
+    {
+        static const Vec4u8 cascadeColours[MaxShadowCascades] = { Vec4u8(0xff, 0x00, 0x00, 0xff), Vec4u8(0x00, 0xff, 0x00, 0xff), Vec4u8(0x00, 0x00, 0xff, 0xff), Vec4u8(0xff, 0xff, 0x00, 0xff) };
+        for (int i = 0; i < m_numShadowCascades; ++i)
+        {
+            const ShadowCascade& cascade = m_shadowCascades[i];
+            DebugDraw::Instance().DrawAABB3f(cascade.lightSpaceBounds, cascadeColours[i], math::affineInverse(cascade.viewMat));
+        }
+    }
+
     // Transition depth buffer to a renderable state
     CD3DX12_RESOURCE_BARRIER dsBarrier = CD3DX12_RESOURCE_BARRIER::Transition(
         m_sunShadowDepthBuffer.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
@@ -532,20 +560,30 @@ void Renderer::BeginShadowPass()
     // Clear depth buffer
     m_directCommandList->ClearDepthStencilView(GetSunShadowDSV(), D3D12_CLEAR_FLAG_DEPTH, 1.f, 0, 0, nullptr);
 
-    // Set render target and viewport
+    // Set render target; each cascade sets its own viewport.
     D3D12_CPU_DESCRIPTOR_HANDLE dsv = GetSunShadowDSV();
     m_directCommandList->OMSetRenderTargets(0, nullptr, FALSE, &dsv);
-    CD3DX12_VIEWPORT viewport(0.f, 0.f, (float)SunShadowmapSize, (float)SunShadowmapSize);
+}
+
+void Renderer::SetShadowCascade(int cascade)
+{
+    Assert(0 <= cascade && cascade < m_numShadowCascades);
+    m_currentShadowCascade = cascade;
+
+    // Render into the cascade's tile of the shadow map.
+    const Vec2f tileOrigin = Vec2f(GetShadowCascadeTile(cascade)) * (float)ShadowCascadeSize;
+    CD3DX12_VIEWPORT viewport(tileOrigin.x, tileOrigin.y, (float)ShadowCascadeSize, (float)ShadowCascadeSize);
     m_directCommandList->RSSetViewports(1, &viewport);
 
-    // Set VSSharedConstants (matrices) buffer for this pass
-    VSSharedConstants& constants = *m_vsSharedConstantsShadowPass.GetMappedData(m_currentBuffer);
-    const auto& [viewMat, projMat] = GetSunShadowMatrices();
-    constants.viewMat = viewMat;
-    constants.projMat = projMat;
-    constants.mvpMat = projMat * viewMat; // Note: no model matrix for now
-    constants.shadowMvpMat = Mat4fIdentity;
-    m_directCommandList->SetGraphicsRootConstantBufferView(RootParam::VSSharedConstants, m_vsSharedConstantsShadowPass.GetBufferGPUVirtualAddress(m_currentBuffer));
+    // Set VSSharedConstants (matrices) buffer for this cascade
+    const ShadowCascade& shadowCascade = m_shadowCascades[cascade];
+    MappedConstantBuffer<VSSharedConstants>& constantBuffer = m_vsSharedConstantsShadowPass[cascade];
+    VSSharedConstants& constants = *constantBuffer.GetMappedData(m_currentBuffer);
+    constants.viewMat = shadowCascade.viewMat;
+    constants.projMat = shadowCascade.projMat;
+    constants.mvpMat = shadowCascade.viewProjMat; // Note: no model matrix for now
+    constants.numShadowCascades = 0;
+    m_directCommandList->SetGraphicsRootConstantBufferView(RootParam::VSSharedConstants, constantBuffer.GetBufferGPUVirtualAddress(m_currentBuffer));
 }
 
 void Renderer::EndShadowPass()
@@ -569,8 +607,22 @@ void Renderer::BeginGeometryPass()
     constants.viewMat = m_viewMat;
     constants.projMat = m_projMat;
     constants.mvpMat = m_projMat * m_viewMat; // Note: no model matrix for now
-    const auto& [shadowView, shadowProj] = GetSunShadowMatrices();
-    constants.shadowMvpMat = shadowProj * shadowView;
+    for (int i = 0; i < m_numShadowCascades; ++i)
+    {
+        // Clip space to the cascade's tile of the shadow map (flipping Y), with a depth bias of a couple of texels.
+        const ShadowCascade& cascade = m_shadowCascades[i];
+        const Vec2f tileOffset = 0.5f * Vec2f(GetShadowCascadeTile(i));
+        const float depthRange = cascade.lightSpaceBounds.m_max.z - cascade.lightSpaceBounds.m_min.z;
+        Mat4f clipToTexture = Mat4fIdentity;
+        clipToTexture[0][0] = 0.25f;
+        clipToTexture[1][1] = -0.25f;
+        clipToTexture[3] = Vec4f(0.25f + tileOffset.x, 0.25f + tileOffset.y, -2.f * cascade.texelSize / depthRange, 1.f);
+        constants.sunShadowMats[i] = clipToTexture * cascade.viewProjMat;
+
+        // Shrink the spheres by a couple of texels so filtering never reads over the edge of a tile.
+        constants.sunShadowSpheres[i] = Vec4f(cascade.centre, math::Square(cascade.radius - 2.f * cascade.texelSize));
+    }
+    constants.numShadowCascades = m_numShadowCascades;
     m_directCommandList->SetGraphicsRootConstantBufferView(RootParam::VSSharedConstants, m_vsSharedConstants.GetBufferGPUVirtualAddress(m_currentBuffer));
 
     // Bind sun shadow map
@@ -745,33 +797,33 @@ ComPtr<ID3D12Resource> Renderer::CreateConstantBuffer(size_t size)
 
 ComPtr<ID3D12Resource> Renderer::CreateBuffer(size_t size, const void* data)
 {
-    // Create destination and upload buffer.
-    ID3D12Resource* uploadBuffer = nullptr;
-    ComPtr<ID3D12Resource> residentBuffer = CreateBuffer(uploadBuffer, size);
+    // Create destination buffer and copy the data into upload memory.
+    UploadAllocation upload;
+    ComPtr<ID3D12Resource> residentBuffer = CreateBuffer(upload, size);
+    memcpy(upload.cpuAddress, data, size);
 
     // Upload initial data.
-    D3D12_SUBRESOURCE_DATA subresourceData = {};
-    subresourceData.pData = data;
-    subresourceData.RowPitch = size;
-    subresourceData.SlicePitch = size;
-    ::UpdateSubresources<1>(m_copyCommandList.Get(), residentBuffer.Get(), uploadBuffer, 0, 0, 1, &subresourceData);
+    m_copyCommandList->CopyBufferRegion(residentBuffer.Get(), 0, upload.buffer, upload.offset, size);
 
     return residentBuffer;
 }
 
-ComPtr<ID3D12Resource> Renderer::CreateBuffer(ID3D12Resource*& outUploadBuffer, size_t size)
+ComPtr<ID3D12Resource> Renderer::CreateBuffer(UploadAllocation& outUpload, size_t size)
 {
     // Create destination buffer
     ComPtr<ID3D12Resource> residentBuffer = CreateResidentBuffer(size);
 
-    // Create an intermediate buffer to upload via
-    ComPtr<ID3D12Resource> uploadBuffer = CreateUploadBuffer(size);
-    m_uploadManager->AddIntermediateResource(uploadBuffer.Get());
-    outUploadBuffer = uploadBuffer.Get();
+    // Allocate upload memory to copy via.
+    outUpload = AllocateUpload(UploadQueue::Copy, size, BufferUploadAlignment);
 
     return residentBuffer;
 }
 
+UploadAllocation Renderer::AllocateUpload(UploadQueue::E queue, size_t size, size_t alignment)
+{
+    return m_uploadManager->Allocate(queue, size, alignment);
+}
+
 ComPtr<ID3D12Resource> Renderer::CreateTexture2D(const Texture2DParams& params)
 {
     // Create resident texture.
@@ -790,20 +842,6 @@ ComPtr<ID3D12Resource> Renderer::CreateTexture2D(const Texture2DParams& params)
     return texture;
 }
 
-ComPtr<ID3D12Resource> Renderer::CreateTexture2DUploadBuffer(const Texture2DParams& params)
-{
-    // Create upload buffer.
-    size_t texelBytes = GetFormatSize(params.format);
-    ComPtr<ID3D12Resource> uploadBuffer = CreateUploadBuffer(params.width * params.height * texelBytes);
-
-#ifdef _DEBUG
-    std::wstring uploadBufferName = std::wstring(params.name) + L" intermediate buffer";
-    uploadBuffer->SetName(uploadBufferName.c_str());
-#endif
-
-    return uploadBuffer;
-}
-
 int Renderer::AllocateTex2DSRVs(int count, ID3D12Resource** textures, DXGI_FORMAT format)
 {
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -871,10 +909,9 @@ int Renderer::LoadTexture(ComPtr<ID3D12Resource>& textureOut, const wchar_t* fil
         // when it is used on a direct command list, but for now, calling code should 
         // then transition to D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE for performance.
         // Could manage that internally to the renderer if we wanted.
-        size_t bufferSize = std::accumulate(subresources.begin(), subresources.end(), (size_t)0, [](size_t lhs, const D3D12_SUBRESOURCE_DATA& rhs) { return lhs + rhs.SlicePitch; });
-        ComPtr<ID3D12Resource> intermediateBuffer = CreateUploadBuffer(subresources.size() * subresources.front().SlicePitch);
-        m_uploadManager->AddIntermediateResource(intermediateBuffer.Get());
-        ::UpdateSubresources<MaxSubresources>(m_copyCommandList.Get(), rawTexture, intermediateBuffer.Get(), 0, 0, subresources.size(), subresources.data());
+        UINT64 uploadSize = GetRequiredIntermediateSize(rawTexture, 0, (UINT)subresources.size());
+        UploadAllocation upload = AllocateUpload(UploadQueue::Copy, uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        ::UpdateSubresources<MaxSubresources>(m_copyCommandList.Get(), rawTexture, upload.buffer, upload.offset, 0, subresources.size(), subresources.data());
 
         // Allocate an SRV.
         D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -899,7 +936,6 @@ int Renderer::LoadTexture(ComPtr<ID3D12Resource>& textureOut, const wchar_t* fil
 
 #ifdef _DEBUG
         rawTexture->SetName(filepath);
-        intermediateBuffer->SetName((std::wstring(filepath) + L" intermediate buffer").c_str());
 #endif
 
         textureOut = rawTexture;
@@ -912,7 +948,7 @@ int Renderer::LoadTexture(ComPtr<ID3D12Resource>& textureOut, const wchar_t* fil
 UINT64 Renderer::EndUploads()
 {
     UINT64 fenceValue = m_copyCommandQueue->Execute(m_copyCommandList.Get());
-    m_uploadManager->SetFenceValue(fenceValue);
+    m_uploadManager->Submit(UploadQueue::Copy, fenceValue);
     return fenceValue;
 }
 
@@ -969,7 +1005,9 @@ void Renderer::BeginCompute()
 
 UINT64 Renderer::EndCompute()
 {
-    return m_computeCommandQueue->Execute(m_computeCommandList.Get());
+    UINT64 fenceValue = m_computeCommandQueue->Execute(m_computeCommandList.Get());
+    m_uploadManager->Submit(UploadQueue::Compute, fenceValue);
+    return fenceValue;
 }
 
 void Renderer::WaitCompute(UINT64 fenceVal)
@@ -1048,31 +1086,6 @@ D3D12_FEATURE_DATA_ROOT_SIGNATURE Renderer::GetRootSignatureFeaturedData() const
     return featureData;
 }
 
-float Renderer::ReadDepth(int x, int y)
-{
-    Assert(0 <= x && x < (int)m_viewport.Width);
-    Assert(0 <= y && y < (int)m_viewport.Height);
-
-    // Make sure we've finished reading back the last frame's depth buffer.
-    WaitCurrentFrame();
-
-    int pitch = GetTexturePitchBytes((int)m_viewport.Width, sizeof(float)) / sizeof(float);
-    int index = pitch * y + x;
-
-    // Map readback buffer and return the value.
-    const float* depthData = nullptr;
-    D3D12_RANGE readRange = { index * sizeof(float), (index + 1) * sizeof(float) };
-    m_depthReadbackBuffer->Map(0, &readRange, (void**)&depthData);
-    Assert(depthData);
-
-    float depth = depthData[index];
-
-    D3D12_RANGE writeRange = {};
-    m_depthReadbackBuffer->Unmap(0, &writeRange);
-
-    return depth;
-}
-
 Vec3f Renderer::Unproject(Vec3f screenCoords) const
 {
     Assert(0.f <= screenCoords.z && screenCoords.z <= 1.f);
@@ -1124,13 +1137,29 @@ void Renderer::Imgui()
 
         if (ImGui::CollapsingHeader("Sun Shadows"))
         {
+            ImGui::SliderInt("Cascades", &m_shadowCascadeParams.numCascades, 1, MaxShadowCascades);
+            ImGui::SliderFloat("Split Lambda", &m_shadowCascadeParams.splitLambda, 0.f, 1.f);
+            ImGui::SliderFloat("Max Distance", &m_shadowCascadeParams.maxDistance, 50.f, CameraFarClip);
             ImGui::Checkbox("Draw Bounds", &s_debugState.m_drawShadowBounds);
             if (ImGui::Checkbox("Freeze Cascades", &s_debugState.m_freezeCascades))
             {
-                s_debugState.m_frozenShadowBounds = AABB3fInvalid;
+                s_debugState.m_hasFrozenCamera = false;
+            }
+
+            for (int i = 0; i < m_numShadowCascades; ++i)
+            {
+                const ShadowCascade& cascade = m_shadowCascades[i];
+                const AABB3f& bounds = cascade.lightSpaceBounds;
+                ImGui::Text("%d: %.1f - %.1f m, radius %.1f m, texel %.3f m, depth %.1f m", i, cascade.splitNear, cascade.splitFar,
+                    cascade.radius, cascade.texelSize, bounds.m_max.z - bounds.m_min.z);
             }
         }
 
+        if (ImGui::CollapsingHeader("Uploads"))
+        {
+            m_uploadManager->Imgui();
+        }
+
         if (ImGui::CollapsingHeader("Stats (Direct Command List Only)"))
         {
             // Read stats out of the previous frame's buffer.
@@ -1168,114 +1197,9 @@ D3D12_CPU_DESCRIPTOR_HANDLE Renderer::GetSunShadowDSV()
     return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_dsvDescHeap->GetCPUDescriptorHandleForHeapStart(), 1, m_dsvDescriptorSize);
 }
 
-Pair<Mat4f, Mat4f> Renderer::GetSunShadowMatrices() const 
+Vec2i Renderer::GetShadowCascadeTile(int cascade)
 {
-    // Transform world shadow bounds into view space.
-    Mat4f sunViewMatrix = math::lookAtRH(Vec3fZero, m_sunDirection, fabsf(m_sunDirection.y) < 0.999f ? Vec3fY : Vec3fZ);
-
-    // Get AABB of the area we want to cast and receive shadows over.
-    AABB3f shadowBounds = GetShadowBounds();
-
-    // Debug option to view shadow bounds from different angles.
-    if (s_debugState.m_freezeCascades)
-    {
-        if (s_debugState.m_frozenShadowBounds.IsValid())
-        {
-            shadowBounds = s_debugState.m_frozenShadowBounds;
-        }
-        else
-        {
-            s_debugState.m_frozenShadowBounds = shadowBounds;
-        }
-    }
-
-    // Transform AABB and recalculate bounds in shadow space.
-    AABB3f shadowSpaceBounds = shadowBounds.AffineTransformed(sunViewMatrix);
-
-    // Increase z bounds to allow geometry off-camera which should still cast shadows.
-    shadowSpaceBounds.m_min.z -= 100.f;
-    
-    // Debug draw.
-    if (s_debugState.m_drawShadowBounds)
-    {
-        DebugDraw::Instance().DrawAABB3f(shadowBounds, Vec4u8(0xff, 0x00, 0x00, 0xff));
-        DebugDraw::Instance().DrawAABB3f(shadowSpaceBounds, Vec4u8(0x00, 0xff, 0x00, 0xff), math::inverse(sunViewMatrix));
-    }
-    
-    // Create an ortho projection matrix out of the bounds.
-    // Negate and swap min/max Z to account for right-handed world/view space. 
-    // In view space, +Z goes back from the camera,  whereas in clip space it goes in front of it.
-    // Hence, the "max" of the view box in view space is actually the near plane, and the "min" is the far plane.
-    Mat4f proj = math::orthoRH(shadowSpaceBounds.m_min.x, shadowSpaceBounds.m_max.x, shadowSpaceBounds.m_min.y, shadowSpaceBounds.m_max.y, -shadowSpaceBounds.m_max.z, -shadowSpaceBounds.m_min.z);
-
-    return { sunViewMatrix, proj };
-}
-
-AABB3f Renderer::GetShadowBounds() const
-{
-    // Get view frustum corners in world space
-    Mat4f invViewProjMat = math::inverse(m_projMat * m_viewMat);
-    Vec3f frustumCorners[8];
-    for (int z = 0; z < 2; ++z)
-    {
-        for (int y = 0; y < 2; ++y)
-        {
-            for (int x = 0; x < 2; ++x)
-            {
-                // Note: x,y are [-1, 1], z is [0,1]
-                int i = z * 4 + y * 2 + x;
-                Vec4f point = invViewProjMat * Vec4f(2.f * (float)x - 1.f, 2.f * (float)y - 1.f, (float)z, 1.f);
-                frustumCorners[i] = Vec3f(point) / point.w;
-            }
-        }
-    }
-
-    // TODO: Get this from a scenegraph or similar
-    AABB3f sceneBounds{ Vec3f(-450.f, -30.f, -450.f), Vec3f(450.f, 30.f, 450.f) };
-
-    // Cast a ray from the camera to each point and intersect with the lower bounding plane of the scene.
-    // This limits the depth of the frustum to the area we actually care about, and prevents the area we shadow map getting too big.
-    //
-    //  x                  <-- Camera
-    //   \`
-    //    \ `
-    //     \__`______
-    //     |\   `    |     <-- Scene bounds
-    //     |_\____`__|
-    //        \     `      }
-    //         \      `    } This region is redundant
-    //          \       `  }
-
-    //
-    // TODO: This could be better if we conservatively clip the frustum with the scene's AABB (in all axes) instead,
-    // but this works quite well for now with minimal effort. I'm not sure right now how to do that without 
-    // building frustum planes and clipping against each individually.
-    //
-
-    // Intersect far plane corners againt bottom of the scene.
-    Vec3f camPos = Vec3f(math::affineInverse(m_viewMat)[3]);
-    Planef lowPlane{ Vec3f(0.f, 1.f, 0.f), -30.f };
-    for (int i = 4; i < 8; ++i)
-    {
-        Vec3f dir = frustumCorners[i] - camPos;
-        float t = lowPlane.RayIntersect(Rayf(camPos, dir));
-        if (0.f < t && t < 1.f)
-        {
-            frustumCorners[i] = camPos + t * dir;
-        }
-    }  
-
-    // Clamp frustum corners against scene bounds
-    for (Vec3f& point : frustumCorners)
-    {
-        point = math::max(point, sceneBounds.m_min);
-        point = math::min(point, sceneBounds.m_max);
-    }
-
-    // Build an AABB around them
-    AABB3f aabb;
-    aabb.SetFromPoints((int)std::size(frustumCorners), frustumCorners);
-    return aabb;
+    return Vec2i(cascade & 1, cascade >> 1);
 }
 
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "MappedConstantBuffer.hpp"
 #include "Math/AABB.hpp"
+#include "ShadowCascades.hpp"
+#include "UploadManager.hpp"
 
 interface IDXGIFactory4;
 interface IDXGIAdapter1;
@@ -18,7 +20,6 @@ namespace gaia
 
 class CommandQueue;
 class GenerateMips;
-class UploadManager;
 struct VSSharedConstants;
 
 namespace RootParam
@@ -36,6 +37,7 @@ enum E
     Texture3, //
     SunShadowMap,
     Sampler0,
+    HullBuffer, // A root SRV, so it's bound by address rather than through a descriptor.
     Count
 };
 }
@@ -51,6 +53,7 @@ public:
     void BeginFrame();
     void EndFrame();
     void BeginShadowPass();
+    void SetShadowCascade(int cascade); // Call for each cascade in the shadow pass, before rendering into it.
     void EndShadowPass();
     void BeginGeometryPass();
     void EndGeometryPass();
@@ -60,8 +63,15 @@ public:
     void SetViewMatrix(const Mat4f& viewMat) { m_viewMat = viewMat; }
     const Mat4f& GetViewMatrix() const { return m_viewMat; }
     Vec3f GetCamPos() const { return Vec3f(math::affineInverse(m_viewMat)[3]); }
+    Mat4f GetViewProjMatrix() const { return m_projMat * m_viewMat; }
+    const Mat4f& GetProjMatrix() const { return m_projMat; }
+    Vec2f GetViewportSize() const { return Vec2f(m_viewport.Width, m_viewport.Height); }
+    int GetNumShadowCascades() const { return m_numShadowCascades; } // Fit by BeginShadowPass() each frame.
+    int GetShadowCascade() const { return m_currentShadowCascade; }
+    const Mat4f& GetSunShadowViewProjMatrix() const { return m_shadowCascades[m_currentShadowCascade].viewProjMat; } // Of the current cascade.
 
     void SetSunDirection(const Vec3f& dir) { m_sunDirection = dir; }
+    void SetSceneHeightBounds(const HeightBoundsQuery& query) { m_sceneHeightBounds = query; } // Shadow cascades' depth is fit to these.
 
     ID3D12Device2& GetDevice() { Assert(m_device); return *m_device.Get(); }
     ID3D12RootSignature& GetRootSignature() { Assert(m_rootSignature); return *m_rootSignature.Get(); }
@@ -76,12 +86,16 @@ public:
     VertexBuffer CreateVertexBuffer(const Span<const uchar>& vertexData, int vertexStride);
     IndexBuffer CreateIndexBuffer(const Span<const uchar>& indexData, DXGI_FORMAT format);
 
-    // Creates a resident buffer. Temporarily creates an internal upload buffer to copy the input data via.
+    // Creates a resident buffer. The input data is copied via the copy queue's upload ring.
     ComPtr<ID3D12Resource> CreateBuffer(size_t size, const void* data);
 
-    // Creates a resident buffer and an upload buffer. The user is expected to fill the upload buffer and trigger the copy;
-    // A reference to the upload buffer is held internally until the upload completes.
-    ComPtr<ID3D12Resource> CreateBuffer(ID3D12Resource*& outUploadBuffer, size_t size);
+    // Creates a resident buffer and allocates upload memory for it. The user is expected to fill the upload memory
+    // and record the copy on the copy command list before the next EndUploads().
+    ComPtr<ID3D12Resource> CreateBuffer(UploadAllocation& outUpload, size_t size);
+
+    // Sub-allocates upload memory that is recycled once the next submission on the given queue has completed,
+    // i.e. the copy must be recorded before the next EndUploads() or EndCompute() respectively.
+    [[nodiscard]] UploadAllocation AllocateUpload(UploadQueue::E queue, size_t size, size_t alignment);
 
     // Creates and maps a constant buffer with space for each frame in the swapchain.
     template<typename DataType>
@@ -104,7 +118,6 @@ public:
     };
     // Creates an empty texture. No SRV.
     ComPtr<ID3D12Resource> CreateTexture2D(const Texture2DParams& params);
-    ComPtr<ID3D12Resource> CreateTexture2DUploadBuffer(const Texture2DParams& params);
 
     // Loads a texture and allocates an SRV.
     [[nodiscard]] int LoadTexture(ComPtr<ID3D12Resource>& textureOut, const wchar_t* filepath, bool loadMips);
@@ -142,7 +155,6 @@ public:
 
     D3D12_FEATURE_DATA_ROOT_SIGNATURE GetRootSignatureFeaturedData() const;
 
-    float ReadDepth(int x, int y);
     Vec3f Unproject(Vec3f screenCoords) const;
 
     void BeginImguiFrame();
@@ -154,8 +166,7 @@ private:
 
     D3D12_CPU_DESCRIPTOR_HANDLE GetMainDSV();
     D3D12_CPU_DESCRIPTOR_HANDLE GetSunShadowDSV();
-    Pair<Mat4f, Mat4f> GetSunShadowMatrices() const;
-    AABB3f GetShadowBounds() const;
+    static Vec2i GetShadowCascadeTile(int cascade);
 
     ComPtr<IDXGIFactory4> m_factory;
     ComPtr<IDXGIAdapter1> m_adapter;
@@ -172,7 +183,6 @@ private:
     ComPtr<ID3D12DescriptorHeap> m_computeDescHeap;
     ComPtr<ID3D12Resource> m_renderTargets[BackbufferCount];
     ComPtr<ID3D12Resource> m_depthBuffer;
-    ComPtr<ID3D12Resource> m_depthReadbackBuffer;
     ComPtr<ID3D12CommandAllocator> m_commandAllocators[BackbufferCount];
     ComPtr<ID3D12CommandAllocator> m_copyCommandAllocator;
     ComPtr<ID3D12CommandAllocator> m_computeCommandAllocator;
@@ -184,7 +194,7 @@ private:
     int m_sunShadowmapDescIndex = -1;
 
     MappedConstantBuffer<VSSharedConstants> m_vsSharedConstants;
-    MappedConstantBuffer<VSSharedConstants> m_vsSharedConstantsShadowPass;
+    MappedConstantBuffer<VSSharedConstants> m_vsSharedConstantsShadowPass[MaxShadowCascades];
 
     std::unique_ptr<CommandQueue> m_directCommandQueue;
     std::unique_ptr<CommandQueue> m_copyCommandQueue;
@@ -195,7 +205,6 @@ private:
     D3D12_VIEWPORT m_viewport = {};
 
     UINT64 m_frameFenceValues[BackbufferCount] = {};
-    UINT64 m_depthReadbackFenceValue = 0;
     int m_nextCBVDescIndex = 0;
     int m_nextSamplerIndex = 0;
     int m_nextComputeDescIndex = 0;
@@ -210,6 +219,11 @@ private:
     Mat4f m_viewMat = Mat4fIdentity;
     Mat4f m_projMat = Mat4fIdentity;
     Vec3f m_sunDirection = math::normalize(Vec3f(0.65f, -0.5f, 0.65f));
+    HeightBoundsQuery m_sceneHeightBounds;
+    ShadowCascadeParams m_shadowCascadeParams;
+    ShadowCascade m_shadowCascades[MaxShadowCascades];
+    int m_numShadowCascades = 0;
+    int m_currentShadowCascade = 0;
 };
 
 
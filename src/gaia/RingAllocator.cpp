@@ -0,0 +1,75 @@
+#include "RingAllocator.hpp"
+
+namespace gaia
+{
+
+RingAllocator::RingAllocator(uint64 capacity)
+    : m_capacity(capacity)
+{
+    Assert(capacity > 0);
+}
+
+uint64 RingAllocator::Allocate(uint64 size, uint64 alignment)
+{
+    Assert(math::IsPow2(alignment));
+    if (size == 0 || size > m_capacity || m_used == m_capacity)
+        return InvalidOffset;
+
+    if (m_used == 0)
+    {
+        // Nothing is in use, so start again from the beginning to keep allocations contiguous.
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    uint64 offset = math::RoundUpPow2(m_head, alignment);
+    uint64 waste = offset - m_head;
+    if (m_head >= m_tail)
+    {
+        // Free space is [head, capacity) followed by [0, tail).
+        if (offset + size > m_capacity)
+        {
+            // Doesn't fit at the end so skip it and wrap around to the start.
+            if (size > m_tail)
+                return InvalidOffset;
+
+            offset = 0;
+            waste = m_capacity - m_head;
+        }
+    }
+    else if (offset + size > m_tail)
+    {
+        // Free space is [head, tail) and we'd run into the oldest allocation.
+        return InvalidOffset;
+    }
+
+    m_head = offset + size;
+    m_used += waste + size;
+    m_pending += waste + size;
+    Assert(m_used <= m_capacity);
+    return offset;
+}
+
+void RingAllocator::Submit(uint64 fenceValue)
+{
+    Assert(fenceValue > m_lastFenceValue);
+    m_lastFenceValue = fenceValue;
+    if (m_pending == 0)
+        return;
+
+    m_batches.push_back({ fenceValue, m_head, m_pending });
+    m_pending = 0;
+}
+
+void RingAllocator::Retire(uint64 completedFenceValue)
+{
+    while (!m_batches.empty() && m_batches.front().fenceValue <= completedFenceValue)
+    {
+        const Batch& batch = m_batches.front();
+        m_tail = batch.end;
+        m_used -= batch.size;
+        m_batches.pop_front();
+    }
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * Allocates ranges of a fixed size buffer in FIFO order, for data that is written once by the CPU and read once by the GPU.
+ * Allocations are made against the current batch, which is closed with the fence value signalled after the work that reads it.
+ * Once that fence value has completed the whole batch is freed at once.
+ * Knows nothing about the buffer or fence itself (the caller supplies fence values), so it can be driven by a fake fence.
+ */
+class RingAllocator
+{
+public:
+    static constexpr uint64 InvalidOffset = ~0ull;
+
+    explicit RingAllocator(uint64 capacity);
+
+    // Returns the offset of the allocation, or InvalidOffset if there isn't currently enough contiguous space.
+    // Space wasted to alignment or to wrapping back to the start is freed along with the allocation.
+    [[nodiscard]] uint64 Allocate(uint64 size, uint64 alignment);
+
+    // Closes the current batch of allocations; they will be freed when the given fence value completes.
+    // Fence values must increase monotonically.
+    void Submit(uint64 fenceValue);
+
+    // Frees every batch whose fence value is less than or equal to the given completed value.
+    void Retire(uint64 completedFenceValue);
+
+    // Fence value of the oldest batch still in flight, i.e. what to wait for to free some space. Zero if there isn't one.
+    uint64 GetOldestFenceValue() const { return m_batches.empty() ? 0 : m_batches.front().fenceValue; }
+
+    uint64 GetCapacity() const { return m_capacity; }
+    uint64 GetUsedBytes() const { return m_used; }
+    uint64 GetPendingBytes() const { return m_pending; }
+    int GetNumBatchesInFlight() const { return (int)m_batches.size(); }
+
+private:
+    struct Batch
+    {
+        uint64 fenceValue;
+        uint64 end;  // Where the tail moves to when this batch is freed.
+        uint64 size; // Including any alignment or wrapping waste.
+    };
+
+    uint64 m_capacity;
+    uint64 m_head = 0;    // Next free byte.
+    uint64 m_tail = 0;    // Oldest byte still in use.
+    uint64 m_used = 0;    // Bytes between tail and head, including waste.
+    uint64 m_pending = 0; // Bytes allocated since the last Submit().
+    uint64 m_lastFenceValue = 0;
+    std::deque<Batch> m_batches;
+};
+
+}
@@ -0,0 +1,132 @@
+#include "RoughnessPyramid.hpp"
+
+namespace gaia
+{
+
+float CalcBilinearDeviation(const float* heights, int pitch, int dimension)
+{
+    Assert(dimension >= 4 && dimension % 4 == 0);
+    const float* lastRow = heights + pitch * (dimension - 1);
+    const float h00 = heights[0];
+    const float h10 = heights[dimension - 1];
+    const float h01 = lastRow[0];
+    const float h11 = lastRow[dimension - 1];
+    const float invSpan = 1.f / (float)(dimension - 1);
+
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 invSpans = _mm_set1_ps(invSpan);
+    const __m128 laneOffsets = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+    __m128 maxDeviation = _mm_setzero_ps();
+    for (int z = 0; z < dimension; ++z)
+    {
+        // Along a row, the bilinear patch is a line between its left and right edges.
+        const float v = (float)z * invSpan;
+        const float left = h00 + (h01 - h00) * v;
+        const float right = h10 + (h11 - h10) * v;
+        const __m128 lefts = _mm_set1_ps(left);
+        const __m128 slopes = _mm_set1_ps(right - left);
+        const float* row = heights + pitch * z;
+        for (int x = 0; x < dimension; x += 4)
+        {
+            const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), laneOffsets), invSpans);
+            const __m128 plane = _mm_add_ps(lefts, _mm_mul_ps(slopes, u));
+            const __m128 deviation = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(row + x), plane), absMask);
+            maxDeviation = _mm_max_ps(maxDeviation, deviation);
+        }
+    }
+
+    maxDeviation = _mm_max_ps(maxDeviation, _mm_shuffle_ps(maxDeviation, maxDeviation, _MM_SHUFFLE(2, 3, 0, 1)));
+    maxDeviation = _mm_max_ps(maxDeviation, _mm_shuffle_ps(maxDeviation, maxDeviation, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(maxDeviation);
+}
+
+RoughnessPyramid::RoughnessPyramid(int dimension, int cellDimension)
+    : m_dimension(dimension)
+    , m_cellDimension(cellDimension)
+{
+    Assert(math::IsPow2(dimension) && math::IsPow2(cellDimension) && 4 <= cellDimension && cellDimension <= dimension);
+    int numNodes = 0;
+    for (int levelDimension = dimension / cellDimension; levelDimension >= 1; levelDimension /= 2)
+    {
+        m_levelOffsets.push_back(numNodes);
+        numNodes += math::Square(levelDimension);
+    }
+    m_nodes.resize(numNodes, 0.f);
+}
+
+void RoughnessPyramid::Update(const float* heights, int pitch, Vec2i min, Vec2i max)
+{
+    min = math::max(min, Vec2iZero);
+    max = math::min(max, Vec2i(m_dimension, m_dimension));
+    if (min.x >= max.x || min.y >= max.y)
+        return;
+
+    // Cells touching the region, inclusive.
+    Vec2i nodeMin = min / m_cellDimension;
+    Vec2i nodeMax = (max - Vec2i(1, 1)) / m_cellDimension;
+    for (int z = nodeMin.y; z <= nodeMax.y; ++z)
+    {
+        for (int x = nodeMin.x; x <= nodeMax.x; ++x)
+        {
+            const float* cell = heights + pitch * z * m_cellDimension + x * m_cellDimension;
+            m_nodes[NodeIndex(0, Vec2i(x, z))] = CalcBilinearDeviation(cell, pitch, m_cellDimension);
+        }
+    }
+
+    // Then each parent of those, a level at a time.
+    for (int level = 1; level < GetNumLevels(); ++level)
+    {
+        nodeMin /= 2;
+        nodeMax /= 2;
+        for (int z = nodeMin.y; z <= nodeMax.y; ++z)
+        {
+            for (int x = nodeMin.x; x <= nodeMax.x; ++x)
+            {
+                float deviation = 0.f;
+                for (int child = 0; child < 4; ++child)
+                {
+                    deviation = std::max(deviation, GetNode(level - 1, Vec2i(2 * x + (child & 1), 2 * z + (child >> 1))));
+                }
+                m_nodes[NodeIndex(level, Vec2i(x, z))] = deviation;
+            }
+        }
+    }
+}
+
+float RoughnessPyramid::Query(Vec2i min, Vec2i max) const
+{
+    if (min.x >= max.x || min.y >= max.y)
+        return 0.f;
+
+    // The first level whose nodes are at least as big as the region, so it touches no more than two along each side.
+    int level = 0;
+    const int extent = std::max(max.x - min.x, max.y - min.y);
+    while (level + 1 < GetNumLevels() && (m_cellDimension << level) < extent)
+    {
+        ++level;
+    }
+
+    const int nodeTexels = m_cellDimension << level;
+    const int wrapMask = GetLevelDimension(level) - 1;
+    const Vec2i nodeMin = math::Vec2Floor(Vec2f(min) / (float)nodeTexels);
+    const Vec2i nodeMax = math::Vec2Floor(Vec2f(max - Vec2i(1, 1)) / (float)nodeTexels);
+    float deviation = 0.f;
+    for (int z = nodeMin.y; z <= std::min(nodeMax.y, nodeMin.y + 1); ++z)
+    {
+        for (int x = nodeMin.x; x <= std::min(nodeMax.x, nodeMin.x + 1); ++x)
+        {
+            deviation = std::max(deviation, GetNode(level, Vec2i(x & wrapMask, z & wrapMask)));
+        }
+    }
+    return deviation;
+}
+
+int RoughnessPyramid::NodeIndex(int level, Vec2i coords) const
+{
+    int levelDimension = GetLevelDimension(level);
+    Assert(0 <= coords.x && coords.x < levelDimension);
+    Assert(0 <= coords.y && coords.y < levelDimension);
+    return m_levelOffsets[level] + levelDimension * coords.y + coords.x;
+}
+
+}
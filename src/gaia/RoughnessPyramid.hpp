@@ -0,0 +1,45 @@
+#pragma once
+
+namespace gaia
+{
+
+// Largest absolute difference between a square block of heights and the bilinear patch through its four corner texels.
+// dimension must be a multiple of 4 and at least 4; rows are pitch floats apart. Vectorised, four texels at a time.
+float CalcBilinearDeviation(const float* heights, int pitch, int dimension);
+
+/*
+ * Max quadtree of the geometric error of a square, power of two height map: the bilinear deviation of each cell of cellDimension^2 texels,
+ * then the max of each 2x2 block of those, up to a single root. Like MinMaxPyramid, it's kept up to date by re-reading just the cells
+ * under a changed region. Since a cell's deviation is that of a fixed size, it says how curved the ground is rather than how far it rises,
+ * which is what's needed to choose how finely to tessellate it.
+ */
+class RoughnessPyramid
+{
+public:
+    RoughnessPyramid() = default;
+    RoughnessPyramid(int dimension, int cellDimension);
+
+    // Recomputes the cells overlapping texels [min, max) from the height map (which has the given row pitch, in floats), then their ancestors.
+    void Update(const float* heights, int pitch, Vec2i min, Vec2i max);
+
+    // Conservative max deviation of the cells texels [min, max) touch. The region wraps around the map, and always reads at most 2x2 nodes,
+    // so for a big region it's looser than the exact max. This is the lookup TerrainHull.hlsl does.
+    float Query(Vec2i min, Vec2i max) const;
+
+    int GetDimension() const { return m_dimension; }
+    int GetCellDimension() const { return m_cellDimension; }
+    int GetNumLevels() const { return (int)m_levelOffsets.size(); }
+    int GetLevelDimension(int level) const { return (m_dimension / m_cellDimension) >> level; } // Nodes along each side at a level; level 0 is the finest.
+    float GetNode(int level, Vec2i coords) const { return m_nodes[NodeIndex(level, coords)]; }
+    const std::vector<float>& GetNodes() const { return m_nodes; }                              // Finest level first, each level row major.
+
+private:
+    int NodeIndex(int level, Vec2i coords) const;
+
+    int m_dimension = 0;
+    int m_cellDimension = 0;
+    std::vector<int> m_levelOffsets;
+    std::vector<float> m_nodes;
+};
+
+}
@@ -0,0 +1,188 @@
+#include "RtinHierarchy.hpp"
+
+namespace gaia
+{
+
+// Triangles of the bintree are numbered like a heap: 2 and 3 are the two halves of the grid, and triangle i's children are 2i and 2i + 1.
+// Finds the corners of one by walking down to it from its root.
+static inline void GetTriangleCoords(int id, int cells, Vec2i& outA, Vec2i& outB, Vec2i& outC)
+{
+    const int depth = math::ILog2(id) - 1; // Below the roots.
+    Vec2i a, b, c;
+    if ((id >> depth) & 1)
+    {
+        a = Vec2i(0, 0);
+        b = Vec2i(cells, cells);
+        c = Vec2i(cells, 0);
+    }
+    else
+    {
+        a = Vec2i(cells, cells);
+        b = Vec2i(0, 0);
+        c = Vec2i(0, cells);
+    }
+
+    // The bits below the root's pick the left or right child at each level, from the top.
+    for (int bit = depth - 1; bit >= 0; --bit)
+    {
+        Vec2i mid = (a + b) >> 1;
+        if ((id >> bit) & 1)
+        {
+            b = a;
+            a = c;
+        }
+        else
+        {
+            a = b;
+            b = c;
+        }
+        c = mid;
+    }
+
+    outA = a;
+    outB = b;
+    outC = c;
+}
+
+// Furthest any grid sample under a triangle is from its plane, so the error bound holds over the whole triangle rather than just at its new vertex.
+static float CalcTriangleError(const float* heights, int gridDimension, Vec2i a, Vec2i b, Vec2i c)
+{
+    auto edge = [](Vec2i from, Vec2i to, Vec2i p) { return (to.x - from.x) * (p.y - from.y) - (to.y - from.y) * (p.x - from.x); };
+    const int area = edge(a, b, c); // Twice the area, signed by the winding.
+    const int winding = area > 0 ? 1 : -1;
+    const float invArea = 1.f / (float)(winding * area);
+    const float ha = heights[gridDimension * a.y + a.x];
+    const float hb = heights[gridDimension * b.y + b.x];
+    const float hc = heights[gridDimension * c.y + c.x];
+    const Vec2i boundsMin = math::min(math::min(a, b), c);
+    const Vec2i boundsMax = math::max(math::max(a, b), c);
+
+    float error = 0.f;
+    for (int z = boundsMin.y; z <= boundsMax.y; ++z)
+    {
+        for (int x = boundsMin.x; x <= boundsMax.x; ++x)
+        {
+            // Barycentric weights, scaled by twice the area and flipped to match the winding so they're all non-negative inside.
+            // Flipping rather than multiplying by the area keeps them well inside an int, even on the biggest grids.
+            Vec2i p(x, z);
+            int wa = winding * edge(b, c, p);
+            int wb = winding * edge(c, a, p);
+            int wc = winding * edge(a, b, p);
+            if (wa < 0 || wb < 0 || wc < 0)
+                continue;
+
+            float planeHeight = ((float)wa * ha + (float)wb * hb + (float)wc * hc) * invArea;
+            error = std::max(error, fabsf(planeHeight - heights[gridDimension * z + x]));
+        }
+    }
+    return error;
+}
+
+void RtinHierarchy::Build(const float* heights, int gridDimension, const Vec3f& origin, float cellSize)
+{
+    const int cells = gridDimension - 1;
+    Assert(cells >= 1 && math::IsPow2(cells));
+    m_gridDimension = gridDimension;
+    m_origin = origin;
+    m_cellSize = cellSize;
+    m_heights.assign(heights, heights + math::Square(gridDimension));
+    m_errors.assign(math::Square(gridDimension), 0.f);
+    m_vertexIndices.assign(math::Square(gridDimension), ~0u);
+
+    // Only triangles whose hypotenuse midpoint is a grid sample matter, i.e. all but the last level (half cells).
+    // A vertex's error is the most either triangle it splits would be off by without it, and at least its children's,
+    // so that a vertex is only ever needed if the ones it depends on are. Go from the bottom up so the children are done first.
+    const int numTriangles = 2 * math::Square(cells) - 2;
+    const int numParentTriangles = numTriangles - math::Square(cells);
+    for (int i = numTriangles - 1; i >= 0; --i)
+    {
+        Vec2i a, b, c;
+        GetTriangleCoords(i + 2, cells, a, b, c);
+        Vec2i mid = (a + b) >> 1;
+        const int midIndex = Index(mid);
+        float error = std::max(m_errors[midIndex], CalcTriangleError(heights, gridDimension, a, b, c));
+        if (i < numParentTriangles)
+        {
+            // The children's hypotenuse midpoints.
+            error = std::max(error, m_errors[Index((a + c) >> 1)]);
+            error = std::max(error, m_errors[Index((b + c) >> 1)]);
+        }
+        m_errors[midIndex] = error;
+    }
+}
+
+void RtinHierarchy::Extract(float maxError, TriangleMesh& outMesh)
+{
+    ExtractTriangles(maxError, m_gridDimension - 1, Vec2i(0, 0), outMesh);
+}
+
+void RtinHierarchy::ExtractTile(float maxError, int tileDimension, Vec2i tile, TriangleMesh& outMesh)
+{
+    Assert(math::IsPow2(tileDimension) && tileDimension <= m_gridDimension - 1);
+    Assert(tile.x >= 0 && tile.y >= 0 && (tile.x + 1) * tileDimension < m_gridDimension && (tile.y + 1) * tileDimension < m_gridDimension);
+    ExtractTriangles(maxError, tileDimension, tile, outMesh);
+}
+
+void RtinHierarchy::ExtractTriangles(float maxError, int tileDimension, Vec2i tile, TriangleMesh& outMesh)
+{
+    Assert(m_gridDimension > 0);
+    outMesh.vertices.clear();
+    outMesh.indices.clear();
+
+    const int cells = m_gridDimension - 1;
+    const Vec2i tileMin = tile * tileDimension;
+    const Vec2i tileMax = tileMin + Vec2i(tileDimension, tileDimension);
+    m_stack.clear();
+    m_stack.push_back({ Vec2i(cells, cells), Vec2i(0, 0), Vec2i(0, cells) });
+    m_stack.push_back({ Vec2i(0, 0), Vec2i(cells, cells), Vec2i(cells, 0) });
+    while (!m_stack.empty())
+    {
+        Triangle triangle = m_stack.back();
+        m_stack.pop_back();
+
+        const Vec2i boundsMin = math::min(math::min(triangle.a, triangle.b), triangle.c);
+        const Vec2i boundsMax = math::max(math::max(triangle.a, triangle.b), triangle.c);
+        if (boundsMin.x >= tileMax.x || boundsMin.y >= tileMax.y || boundsMax.x <= tileMin.x || boundsMax.y <= tileMin.y)
+            continue;
+
+        // Triangles bigger than a tile straddle tiles, so are always split. Whether that happens only depends on the level in the bintree,
+        // the same as for the triangle on the other side of the hypotenuse, so it never leaves a T-junction.
+        const Vec2i extent = boundsMax - boundsMin;
+        const bool straddlesTiles = std::max(extent.x, extent.y) > tileDimension;
+        const Vec2i leg = triangle.c - triangle.a;
+        const Vec2i mid = (triangle.a + triangle.b) >> 1;
+        if (abs(leg.x) + abs(leg.y) > 1 && (straddlesTiles || m_errors[Index(mid)] > maxError))
+        {
+            // Push the second child first so the first is emitted first, which keeps neighbouring triangles near each other in the mesh.
+            m_stack.push_back({ triangle.b, triangle.c, mid });
+            m_stack.push_back({ triangle.c, triangle.a, mid });
+        }
+        else
+        {
+            AddVertex(triangle.a, outMesh);
+            AddVertex(triangle.b, outMesh);
+            AddVertex(triangle.c, outMesh);
+        }
+    }
+
+    // Reset only the samples that were used, so extraction stays linear in the size of the mesh.
+    for (int index : m_usedVertices)
+    {
+        m_vertexIndices[index] = ~0u;
+    }
+    m_usedVertices.clear();
+}
+
+void RtinHierarchy::AddVertex(Vec2i coords, TriangleMesh& outMesh)
+{
+    const int index = Index(coords);
+    if (m_vertexIndices[index] == ~0u)
+    {
+        m_vertexIndices[index] = (uint32)outMesh.vertices.size();
+        m_usedVertices.push_back(index);
+        outMesh.vertices.push_back(m_origin + Vec3f((float)coords.x * m_cellSize, m_heights[index], (float)coords.y * m_cellSize));
+    }
+    outMesh.indices.push_back(m_vertexIndices[index]);
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+namespace gaia
+{
+
+struct TriangleMesh
+{
+    std::vector<Vec3f> vertices;
+    std::vector<uint32> indices; // Three per triangle, counter-clockwise seen from above.
+};
+
+/*
+ * Right-triangulated irregular network over a square height grid with (2^n + 1)^2 samples.
+ * Build() computes, once, the error each vertex would introduce if it were left out. Extract() then walks the triangle bintree
+ * splitting wherever that error is above a threshold, which is linear in the size of the mesh it makes, for any threshold.
+ * Dependent vertices always have errors at least as big as their children's, so every mesh it makes is conforming (no T-junctions).
+ * Meshes can also be extracted for square tiles of the grid separately; those split everything down to the tile size first,
+ * the same way for every tile, so adjacent tiles' meshes meet without cracks.
+ */
+class RtinHierarchy
+{
+public:
+    // Heights are row major. Output vertices are placed at origin + (x * cellSize, height, z * cellSize) for grid sample (x, z).
+    void Build(const float* heights, int gridDimension, const Vec3f& origin, float cellSize);
+
+    // Mesh of the whole grid, with no vertex further than maxError (in height units) from the surface.
+    void Extract(float maxError, TriangleMesh& outMesh);
+
+    // Mesh of one square tile of cells, tile * tileDimension to (tile + 1) * tileDimension, where tileDimension divides the grid's cells into a power of two.
+    void ExtractTile(float maxError, int tileDimension, Vec2i tile, TriangleMesh& outMesh);
+
+    int GetGridDimension() const { return m_gridDimension; }
+
+private:
+    struct Triangle
+    {
+        Vec2i a; // a to b is the hypotenuse.
+        Vec2i b;
+        Vec2i c; // The right angle.
+    };
+
+    void ExtractTriangles(float maxError, int tileDimension, Vec2i tile, TriangleMesh& outMesh);
+    void AddVertex(Vec2i coords, TriangleMesh& outMesh);
+    int Index(Vec2i coords) const { return m_gridDimension * coords.y + coords.x; }
+
+    int m_gridDimension = 0;
+    Vec3f m_origin = Vec3fZero;
+    float m_cellSize = 1.f;
+    std::vector<float> m_heights;
+    std::vector<float> m_errors;              // Per vertex.
+    std::vector<uint32> m_vertexIndices;      // Scratch for extraction: each grid sample's index in the mesh, or ~0u.
+    std::vector<int> m_usedVertices;          // Scratch: the grid samples the last extraction set in m_vertexIndices.
+    std::vector<Triangle> m_stack;            // Scratch for extraction.
+};
+
+}
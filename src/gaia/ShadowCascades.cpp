@@ -0,0 +1,112 @@
+#include "ShadowCascades.hpp"
+
+namespace gaia
+{
+
+// Cascade radii are rounded up to this, so tiny differences in the inputs can't change the texel size.
+static constexpr float RadiusStep = 1.f / 16.f;
+
+// Stops the caster search running off to infinity when the sun is near (or below) the horizon.
+static constexpr float MinSunElevation = 0.05f;
+
+static bool IsValidHeightRange(Vec2f heights)
+{
+    return heights.x <= heights.y && heights.x > -FLT_MAX && heights.y < FLT_MAX;
+}
+
+// Range of light space depth over the corners of a world space box.
+static Vec2f CalcLightDepthRange(const Mat4f& lightViewMat, Vec2f xzMin, Vec2f xzMax, Vec2f heights)
+{
+    Vec2f range(FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < 8; ++i)
+    {
+        const Vec3f corner((i & 1) ? xzMax.x : xzMin.x, (i & 2) ? heights.y : heights.x, (i & 4) ? xzMax.y : xzMin.y);
+        const float depth = math::Mat4fTransformVec3f(lightViewMat, corner).z;
+        range.x = std::min(range.x, depth);
+        range.y = std::max(range.y, depth);
+    }
+    return range;
+}
+
+void CalcShadowCascadeSplits(float nearClip, float farClip, int numCascades, float lambda, float* outSplits)
+{
+    Assert(0.f < nearClip && nearClip < farClip && numCascades > 0);
+    outSplits[0] = nearClip;
+    for (int i = 1; i < numCascades; ++i)
+    {
+        const float t = (float)i / (float)numCascades;
+        const float logSplit = nearClip * powf(farClip / nearClip, t);
+        const float uniformSplit = nearClip + (farClip - nearClip) * t;
+        outSplits[i] = lambda * logSplit + (1.f - lambda) * uniformSplit;
+    }
+    outSplits[numCascades] = farClip;
+}
+
+ShadowCascade FitShadowCascade(const ShadowCameraParams& camera, float splitNear, float splitFar, const Vec3f& sunDirection, int resolution,
+    const HeightBoundsQuery& heightBounds)
+{
+    Assert(splitNear < splitFar && resolution > 0);
+    ShadowCascade cascade;
+    cascade.splitNear = splitNear;
+    cascade.splitFar = splitFar;
+
+    // Smallest sphere around the slice. The slice is symmetric about the view axis, so the centre is on the axis, as far from the near corners
+    // as from the far ones (or on the far plane, if that's further forward). It only depends on the slice's shape, so turning doesn't resize it.
+    const float cornerOffsetSq = math::Square(camera.tanHalfFovY) * (1.f + math::Square(camera.aspect)); // Squared distance of a corner from the axis per unit depth.
+    const float centreDepth = std::min(0.5f * (splitNear + splitFar) * (1.f + cornerOffsetSq), splitFar);
+    const float radius = ceilf(sqrtf(math::Square(splitFar - centreDepth) + math::Square(splitFar) * cornerOffsetSq) / RadiusStep) * RadiusStep;
+    const Mat4f camMat = math::affineInverse(camera.viewMat);
+    cascade.centre = Vec3f(camMat[3]) - Vec3f(camMat[2]) * centreDepth; // The camera looks down -Z.
+    cascade.radius = radius;
+    cascade.texelSize = 2.f * radius / (float)resolution;
+
+    // The light's view is fixed relative to the world, so snapping its centre to whole texels keeps texels in the same place on the ground.
+    cascade.viewMat = math::lookAtRH(Vec3fZero, sunDirection, fabsf(sunDirection.y) < 0.999f ? Vec3fY : Vec3fZ);
+    Vec3f lightCentre = math::Mat4fTransformVec3f(cascade.viewMat, cascade.centre);
+    lightCentre.x = floorf(lightCentre.x / cascade.texelSize) * cascade.texelSize;
+    lightCentre.y = floorf(lightCentre.y / cascade.texelSize) * cascade.texelSize;
+
+    // Depth goes from the highest terrain that can shadow the cascade to the lowest terrain in it (+Z points back at the sun). Only points
+    // in the sphere use the cascade, so everything it receives on is within the sphere's XZ square.
+    Vec2f depthRange(lightCentre.z - radius, lightCentre.z + radius);
+    const Vec2f receiverMin(cascade.centre.x - radius, cascade.centre.z - radius);
+    const Vec2f receiverMax(cascade.centre.x + radius, cascade.centre.z + radius);
+    const Vec2f receiverHeights = heightBounds ? heightBounds(receiverMin, receiverMax) : Vec2f(FLT_MAX, -FLT_MAX);
+    if (IsValidHeightRange(receiverHeights))
+    {
+        // Casters can be as high as anything in the terrain, and are further towards the sun the higher they are above the receivers.
+        const Vec2f allHeights = heightBounds(Vec2f(-FLT_MAX, -FLT_MAX), Vec2f(FLT_MAX, FLT_MAX));
+        const float maxDrop = std::max(allHeights.y - receiverHeights.x, 0.f);
+        const Vec2f towardsSun = -Vec2f(sunDirection.x, sunDirection.z) * (maxDrop / std::max(-sunDirection.y, MinSunElevation));
+        const Vec2f casterMin = math::min(receiverMin, receiverMin + towardsSun);
+        const Vec2f casterMax = math::max(receiverMax, receiverMax + towardsSun);
+        const Vec2f casterHeights = heightBounds(casterMin, casterMax);
+
+        const Vec2f receiverDepths = CalcLightDepthRange(cascade.viewMat, receiverMin, receiverMax, receiverHeights);
+        const Vec2f casterDepths = CalcLightDepthRange(cascade.viewMat, casterMin, casterMax, casterHeights);
+        depthRange.x = std::max(depthRange.x, receiverDepths.x);
+        depthRange.y = std::max(casterDepths.y, depthRange.x);
+    }
+
+    // Negate and swap Z for the projection, since view space looks down -Z.
+    cascade.lightSpaceBounds = { Vec3f(lightCentre.x - radius, lightCentre.y - radius, depthRange.x), Vec3f(lightCentre.x + radius, lightCentre.y + radius, depthRange.y) };
+    const AABB3f& bounds = cascade.lightSpaceBounds;
+    cascade.projMat = math::orthoRH(bounds.m_min.x, bounds.m_max.x, bounds.m_min.y, bounds.m_max.y, -bounds.m_max.z, -bounds.m_min.z);
+    cascade.viewProjMat = cascade.projMat * cascade.viewMat;
+    return cascade;
+}
+
+int CalcShadowCascades(const ShadowCameraParams& camera, const ShadowCascadeParams& params, const Vec3f& sunDirection,
+    const HeightBoundsQuery& heightBounds, ShadowCascade* outCascades)
+{
+    const int numCascades = std::clamp(params.numCascades, 1, MaxShadowCascades);
+    float splits[MaxShadowCascades + 1];
+    CalcShadowCascadeSplits(camera.nearClip, std::min(params.maxDistance, camera.farClip), numCascades, params.splitLambda, splits);
+    for (int i = 0; i < numCascades; ++i)
+    {
+        outCascades[i] = FitShadowCascade(camera, splits[i], splits[i + 1], sunDirection, params.resolution, heightBounds);
+    }
+    return numCascades;
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Math/AABB.hpp"
+
+namespace gaia
+{
+
+static constexpr int MaxShadowCascades = 4; // Keep in sync with TerrainPixel.hlsl.
+
+// Conservative (min, max) terrain heights over a world XZ rectangle, or (FLT_MAX, -FLT_MAX) if there's nothing there.
+using HeightBoundsQuery = std::function<Vec2f(Vec2f worldMin, Vec2f worldMax)>;
+
+struct ShadowCameraParams
+{
+    Mat4f viewMat = Mat4fIdentity;
+    float tanHalfFovY = 1.f;
+    float aspect = 1.f; // Width over height.
+    float nearClip = 0.1f;
+    float farClip = 1000.f;
+};
+
+struct ShadowCascadeParams
+{
+    int numCascades = MaxShadowCascades;
+    float splitLambda = 0.8f;    // Blend from uniform (0) to logarithmic (1) split distances.
+    float maxDistance = 400.f;   // Shadows end here, or at the far clip plane if that's nearer.
+    int resolution = 2048;       // Shadow map texels along each side of a cascade.
+};
+
+struct ShadowCascade
+{
+    Mat4f viewMat = Mat4fIdentity; // World to light space. The same for every cascade; it only depends on the sun direction.
+    Mat4f projMat = Mat4fIdentity;
+    Mat4f viewProjMat = Mat4fIdentity;
+    AABB3f lightSpaceBounds = AABB3fInvalid; // What projMat maps to the unit cube.
+    Vec3f centre = Vec3fZero;      // Sphere around the cascade's slice of the view frustum, in world space.
+    float radius = 0.f;
+    float splitNear = 0.f;         // View depths the slice covers.
+    float splitFar = 0.f;
+    float texelSize = 0.f;         // World size of a shadow map texel.
+};
+
+// Practical split scheme: view depths where each of numCascades slices of [nearClip, farClip] starts and ends (numCascades + 1 of them),
+// blending between a logarithmic and a uniform distribution.
+void CalcShadowCascadeSplits(float nearClip, float farClip, int numCascades, float lambda, float* outSplits);
+
+// Fits an orthographic shadow map to one slice of the view frustum. The map covers a sphere around the slice, whose size doesn't change
+// as the camera turns, and is moved in whole texels, so shadow edges stay still as the camera moves. Depth is fit to the terrain heights
+// that can shadow, or be shadowed in, the cascade. Only depends on its inputs, so the same inputs always give exactly the same matrices.
+ShadowCascade FitShadowCascade(const ShadowCameraParams& camera, float splitNear, float splitFar, const Vec3f& sunDirection, int resolution,
+    const HeightBoundsQuery& heightBounds);
+
+// Splits the view and fits every cascade. Returns the number of cascades written.
+int CalcShadowCascades(const ShadowCameraParams& camera, const ShadowCascadeParams& params, const Vec3f& sunDirection,
+    const HeightBoundsQuery& heightBounds, ShadowCascade* outCascades);
+
+}
@@ -0,0 +1,166 @@
+#include "SobelNormals.hpp"
+#include "ThreadPool.hpp"
+
+namespace gaia
+{
+
+// Rows per parallel job; enough to amortise the two extra rows each job reads.
+static constexpr int RowsPerJob = 16;
+
+// Copies heights [x - 1, x + count + 1) from a row of the wrapped height map, so the filter can read its neighbours without wrapping.
+static void CopyPaddedRow(const float* row, int dimension, int x, int count, float* dst)
+{
+    const int mask = dimension - 1;
+    int src = (x - 1) & mask;
+    int remaining = count + 2;
+    while (remaining > 0)
+    {
+        int length = std::min(remaining, dimension - src);
+        memcpy(dst, row + src, length * sizeof(float));
+        dst += length;
+        remaining -= length;
+        src = 0;
+    }
+}
+
+// Filters count texels from padded rows, where index 0 is the left neighbour of the first texel.
+// Rows must have space for count rounded up to a multiple of 4, plus 2; out must have space for count rounded up to a multiple of 4.
+static void SobelRow(const float* above, const float* row, const float* below, int count, float ny, Vec3f* out)
+{
+    const __m128 two = _mm_set1_ps(2.f);
+    const __m128 y = _mm_set1_ps(ny);
+    const __m128 yy = _mm_mul_ps(y, y);
+
+    for (int i = 0; i < count; i += 4)
+    {
+        // Same terms as the shader, see TerrainComputeNormals.hlsl.
+        __m128 zi = _mm_loadu_ps(above + i);
+        __m128 zb = _mm_loadu_ps(above + i + 1);
+        __m128 zc = _mm_loadu_ps(above + i + 2);
+        __m128 zh = _mm_loadu_ps(row + i);
+        __m128 zd = _mm_loadu_ps(row + i + 2);
+        __m128 zg = _mm_loadu_ps(below + i);
+        __m128 zf = _mm_loadu_ps(below + i + 1);
+        __m128 ze = _mm_loadu_ps(below + i + 2);
+
+        // nx = zg + 2zh + zi - zc - 2zd - ze
+        // nz = 2zb + zc + zi - ze - 2zf - zg
+        __m128 nx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(zg, zi), _mm_mul_ps(two, zh)), _mm_add_ps(_mm_add_ps(zc, ze), _mm_mul_ps(two, zd)));
+        __m128 nz = _mm_sub_ps(_mm_add_ps(_mm_add_ps(zc, zi), _mm_mul_ps(two, zb)), _mm_add_ps(_mm_add_ps(ze, zg), _mm_mul_ps(two, zf)));
+
+        // A full precision divide rather than an approximate reciprocal, so we match the GPU within its encoding precision.
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(nz, nz)), yy));
+        __m128 invLength = _mm_div_ps(_mm_set1_ps(1.f), length);
+
+        alignas(16) float xs[4];
+        alignas(16) float ys[4];
+        alignas(16) float zs[4];
+        _mm_store_ps(xs, _mm_mul_ps(nx, invLength));
+        _mm_store_ps(ys, _mm_mul_ps(y, invLength));
+        _mm_store_ps(zs, _mm_mul_ps(nz, invLength));
+        for (int j = 0; j < 4; ++j)
+        {
+            out[i + j] = Vec3f(xs[j], ys[j], zs[j]);
+        }
+    }
+}
+
+void ComputeSobelNormals(const float* heights, int dimension, Vec2i min, Vec2i max, float worldTexelSize, Vec3f* normals)
+{
+    Assert(math::IsPow2(dimension));
+    Assert(min.x < max.x && max.x - min.x <= dimension);
+    Assert(min.y < max.y && max.y - min.y <= dimension);
+
+    const int mask = dimension - 1;
+    const int count = max.x - min.x;
+    const int paddedCount = math::RoundUpPow2(count, 4);
+    const float ny = 8.f * worldTexelSize;
+
+    // Three padded rows that rotate as we move down, so each row of heights is only gathered once.
+    std::vector<float> scratch(3 * (paddedCount + 2), 0.f);
+    std::vector<Vec3f> out(paddedCount);
+    float* rows[3] = { &scratch[0], &scratch[paddedCount + 2], &scratch[2 * (paddedCount + 2)] };
+    auto Row = [&](int z) { return heights + dimension * (z & mask); };
+
+    CopyPaddedRow(Row(min.y - 1), dimension, min.x, count, rows[0]);
+    CopyPaddedRow(Row(min.y), dimension, min.x, count, rows[1]);
+    for (int z = min.y; z < max.y; ++z)
+    {
+        CopyPaddedRow(Row(z + 1), dimension, min.x, count, rows[2]);
+        SobelRow(rows[0], rows[1], rows[2], count, ny, out.data());
+
+        Vec3f* dst = normals + dimension * (z & mask);
+        for (int i = 0; i < count; ++i)
+        {
+            dst[(min.x + i) & mask] = out[i];
+        }
+
+        std::rotate(rows, rows + 1, rows + 3);
+    }
+}
+
+void ComputeSobelNormalsParallel(const float* heights, int dimension, Vec2i min, Vec2i max, float worldTexelSize, Vec3f* normals)
+{
+    int numJobs = (max.y - min.y + RowsPerJob - 1) / RowsPerJob;
+    ThreadPool::Instance().ParallelFor(numJobs, [&](int job)
+    {
+        int jobMin = min.y + job * RowsPerJob;
+        int jobMax = std::min(jobMin + RowsPerJob, max.y);
+        ComputeSobelNormals(heights, dimension, Vec2i(min.x, jobMin), Vec2i(max.x, jobMax), worldTexelSize, normals);
+    });
+}
+
+void ComputeSobelNormalsBordered(const float* heights, int pitch, Vec2i size, float worldTexelSize, Vec3f* normals)
+{
+    Assert(size.x > 0 && size.y > 0 && pitch >= size.x + 2);
+    const int paddedCount = math::RoundUpPow2(size.x, 4);
+    const float ny = 8.f * worldTexelSize;
+
+    // SobelRow() reads whole groups of 4, so unless the rows already have room for that, copy them somewhere that does.
+    const bool copyRows = paddedCount != size.x;
+    std::vector<float> scratch(copyRows ? 3 * (paddedCount + 2) : 0, 0.f);
+    std::vector<Vec3f> out(paddedCount);
+    for (int z = 0; z < size.y; ++z)
+    {
+        const float* rows[3];
+        for (int j = 0; j < 3; ++j)
+        {
+            rows[j] = heights + pitch * (z + j);
+            if (copyRows)
+            {
+                float* row = &scratch[j * (paddedCount + 2)];
+                memcpy(row, rows[j], (size.x + 2) * sizeof(float));
+                rows[j] = row;
+            }
+        }
+
+        SobelRow(rows[0], rows[1], rows[2], size.x, ny, out.data());
+        std::copy(out.data(), out.data() + size.x, normals + size.x * z);
+    }
+}
+
+Vec3f ComputeSobelNormalReference(const float* heights, int dimension, Vec2i coords, float worldTexelSize)
+{
+    const int mask = dimension - 1;
+    auto load = [&](Vec2i offset)
+    {
+        Vec2i texCoords = (coords + offset) & Vec2i(mask, mask);
+        return heights[dimension * texCoords.y + texCoords.x];
+    };
+
+    float zb = load(Vec2i(0, -1));
+    float zc = load(Vec2i(1, -1));
+    float zd = load(Vec2i(1, 0));
+    float ze = load(Vec2i(1, 1));
+    float zf = load(Vec2i(0, 1));
+    float zg = load(Vec2i(-1, 1));
+    float zh = load(Vec2i(-1, 0));
+    float zi = load(Vec2i(-1, -1));
+
+    float nx = zg + 2.f * zh + zi - zc - 2.f * zd - ze;
+    float ny = 8.f * worldTexelSize;
+    float nz = 2.f * zb + zc + zi - ze - 2.f * zf - zg;
+    return math::normalize(Vec3f(nx, ny, nz));
+}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+namespace gaia
+{
+
+// CPU versions of the Sobel filter in TerrainComputeNormals.hlsl, for generating normals without a device.
+// The height map is square with a power of two dimension and wraps at the edges, like a clipmap level (or a tileable tile).
+// Computes the normals for texel coords [min, max), which may lie outside the texture and are wrapped; at most one texture's worth in each axis.
+// worldTexelSize is the world distance between adjacent texels, i.e. the level 0 texel size scaled by the clip level.
+void ComputeSobelNormals(const float* heights, int dimension, Vec2i min, Vec2i max, float worldTexelSize, Vec3f* normals);
+
+// As above, but split into bands of rows across the thread pool.
+void ComputeSobelNormalsParallel(const float* heights, int dimension, Vec2i min, Vec2i max, float worldTexelSize, Vec3f* normals);
+
+// For a block that doesn't wrap, such as a tile: heights has a one texel border all round, from its neighbours, so it's (size.x + 2) by
+// (size.y + 2) with rows pitch floats apart. Writes size.x by size.y normals, row major.
+void ComputeSobelNormalsBordered(const float* heights, int pitch, Vec2i size, float worldTexelSize, Vec3f* normals);
+
+// A single texel, computed the way TerrainComputeNormals.hlsl does it: eight wrapped loads, then normalize(). Slow, but it's what the above are checked against.
+Vec3f ComputeSobelNormalReference(const float* heights, int dimension, Vec2i coords, float worldTexelSize);
+
+}
@@ -4,8 +4,9 @@
 namespace gaia
 {
 
-void StaticMesh::Init(Renderer& renderer, const Span<const uchar>& vertexData, int vertexStride, const Span<const uint16>& indexData)
+void StaticMesh::Init(Renderer& renderer, const Span<const uchar>& vertexData, int vertexStride, const Span<const uint16>& indexData, const AABB3f& bounds)
 {
+    m_bounds = bounds;
     m_vb = renderer.CreateVertexBuffer(vertexData, vertexStride);
     m_ib = renderer.CreateIndexBuffer(Span<const uchar>((const uchar*)indexData.Data(), indexData.Size() * sizeof(uint16)), DXGI_FORMAT_R16_UINT);
 }
@@ -19,4 +20,14 @@ void StaticMesh::Render(Renderer& renderer)
     commandList.DrawIndexedInstanced(m_ib.view.SizeInBytes / sizeof(uint16), 1, 0, 0, 0);
 }
 
+void StaticMesh::RenderInstanced(Renderer& renderer, const D3D12_VERTEX_BUFFER_VIEW& instanceBuffer, int firstInstance, int numInstances)
+{
+    ID3D12GraphicsCommandList& commandList = renderer.GetDirectCommandList();
+    const D3D12_VERTEX_BUFFER_VIEW vertexBuffers[] = { m_vb.view, instanceBuffer };
+    commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    commandList.IASetVertexBuffers(0, (UINT)std::size(vertexBuffers), vertexBuffers);
+    commandList.IASetIndexBuffer(&m_ib.view);
+    commandList.DrawIndexedInstanced(m_ib.view.SizeInBytes / sizeof(uint16), numInstances, 0, 0, firstInstance);
+}
+
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "Math/AABB.hpp"
 
 namespace gaia
 {
@@ -6,17 +7,23 @@ namespace gaia
 class Renderer;
 
 /*
- * A basic, no-frills static mesh. Pass in vertex data of whatever format your shader requires.
+ * A basic, no-frills static mesh. Pass in vertex data of whatever format your shader requires, and the bounds of its positions.
  */
 class StaticMesh
 {
 public:
-    void Init(Renderer& renderer, const Span<const uchar>& vertexData, int vertexStride, const Span<const uint16>& indexData);
+    void Init(Renderer& renderer, const Span<const uchar>& vertexData, int vertexStride, const Span<const uint16>& indexData, const AABB3f& bounds);
     void Render(Renderer& renderer);
 
+    // Draws instances [firstInstance, firstInstance + numInstances) of a per-instance vertex buffer, bound to the second input slot.
+    void RenderInstanced(Renderer& renderer, const D3D12_VERTEX_BUFFER_VIEW& instanceBuffer, int firstInstance, int numInstances);
+
+    const AABB3f& GetBounds() const { return m_bounds; }
+
 private:
     VertexBuffer m_vb;
     IndexBuffer m_ib;
+    AABB3f m_bounds;
 };
 
 }
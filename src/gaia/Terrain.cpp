@@ -2,6 +2,11 @@
 #include "TerrainComputeNormals.hpp"
 #include "TerrainConstants.hpp"
 #include "Renderer.hpp"
+#include "SobelNormals.hpp"
+#include "TileMips.hpp"
+#include "HeightfieldSampling.hpp"
+#include "ThreadPool.hpp"
+#include "Timer.hpp"
 #include <DirectXTex/DirectXTex.h>
 #include <stb_perlin.h>
 
@@ -12,7 +17,15 @@ using namespace TerrainConstants;
 
 struct TerrainVertex
 {
-    Vec2f pos;
+    Vec2f pos; // In level 0 vertex patches.
+};
+
+// Where to draw a clipmap ring piece, or the grid.
+struct TerrainInstance
+{
+    Vec2f offset; // In level 0 vertex patches.
+    float scale;  // Size of the piece's patches.
+    float level;  // Ring level.
 };
 
 struct WaterVertex
@@ -24,112 +37,49 @@ struct WaterVertex
 
 static constexpr D3D12_INPUT_ELEMENT_DESC TerrainInputLayout[] = {
     { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+    { "INSTANCE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
 };
 
-// Returns index of a heightmap sample within a tile.
-static int TileIndex(int x, int z)
-{
-    Assert(0 <= x && x < TileDimension);
-    Assert(0 <= z && z < TileDimension);
-    return TileDimension * z + x;
-}
-
-static int TileIndex(Vec2i coords)
-{
-    return TileIndex(coords.x, coords.y);
-}
-
-// Returns index of a vertex within the vertex buffer.
-static int VertexIndex(int x, int z) 
-{
-    Assert(0 <= x && x < VertexGridDimension);
-    Assert(0 <= z && z < VertexGridDimension);
-    return VertexGridDimension * z + x;
-}
-
-static int VertexIndex(Vec2i coords)
-{
-    return VertexIndex(coords.x, coords.y);
-}
-
-// Returns index of a sample within a heightmap/clipmap texture.
-static int HeightmapIndex(int x, int z)
-{
-    Assert(0 <= x && x < HeightmapDimension);
-    Assert(0 <= z && z < HeightmapDimension);
-    return HeightmapDimension * z + x;
-}
-
-static int HeightmapIndex(Vec2i coords)
-{
-    return HeightmapIndex(coords.x, coords.y);
-}
-
-static Vec2i WrapHeightmapCoords(Vec2i levelGlobalCoords)
-{
-    // Turns a "world" UV coordinate into a local one.
-    // This is a mod operation that always returns a positive result.
-    static_assert(math::IsPow2(HeightmapDimension), "HeightmapDimension must be a power of 2");
-    return levelGlobalCoords & (HeightmapDimension - 1);
-}
-
-static Vec2i WrapTileCoords(Vec2i levelGlobalCoords)
-{
-    static_assert(math::IsPow2(TileDimension), "TileDimension must be a power of 2");
-    return levelGlobalCoords & (TileDimension - 1);
-}
-
-static std::pair<Vec2i, Vec2i> LevelGlobalCoordsToTile(Vec2i levelGlobalCoords)
-{
-    Vec2i coordsInTile = WrapTileCoords(levelGlobalCoords);
-    Vec2i tile = (levelGlobalCoords - coordsInTile) / TileDimension;
-    return { tile, coordsInTile };
-}
-
-static std::pair<Vec2i, Vec2i> GlobalCoordsToTile(Vec2i globalCoords, int level)
-{
-    return LevelGlobalCoordsToTile(Vec2i(globalCoords) >> level);
-}
-
-// Returns coordinates relative to the given tile; may be out of bounds for that tile.
-static Vec2i LevelGlobalCoordsToTileCoords(Vec2i levelGlobalCoords, Vec2i tile)
-{
-    return levelGlobalCoords - (TileDimension * tile);
-}
-
-// Returns coordinates relative to the given tile; may be out of bounds for that tile.
-static Vec2i GlobalCoordsToTileCoords(Vec2i globalCoords, Vec2i tile, int level)
+// Writes the four control point indices of each patch of a ring piece's grid, in the given order.
+static void WriteRingPieceIndices(Vec2i size, PatchOrder::E order, std::vector<uint16>& outIndices)
 {
-    return LevelGlobalCoordsToTileCoords(Vec2i(globalCoords) >> level, tile);
+    std::vector<Vec2i> patches;
+    CalcPatchOrder(order, size.x, size.y, patches);
+    for (Vec2i patch : patches)
+    {
+        const int corner = (size.x + 1) * patch.y + patch.x;
+        outIndices.push_back((uint16)corner);
+        outIndices.push_back((uint16)(corner + 1));
+        outIndices.push_back((uint16)(corner + size.x + 1));
+        outIndices.push_back((uint16)(corner + size.x + 2));
+    }
 }
 
-static Vec2i WorldPosToGlobalCoords(Vec2f worldPos)
+static D3D12_TEXTURE_COPY_LOCATION MakeSrcTexCopyLocation(const UploadAllocation& upload, DXGI_FORMAT format, Vec2i size, int rowPitch)
 {
-    return math::Vec2Floor(worldPos / TexelSize);
+    D3D12_TEXTURE_COPY_LOCATION src = {};
+    src.pResource = upload.buffer;
+    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+    src.PlacedFootprint.Offset = upload.offset;
+    src.PlacedFootprint.Footprint.Format = format;
+    src.PlacedFootprint.Footprint.Width = size.x;
+    src.PlacedFootprint.Footprint.Height = size.y;
+    src.PlacedFootprint.Footprint.Depth = 1;
+    src.PlacedFootprint.Footprint.RowPitch = rowPitch;
+    return src;
 }
 
-static std::pair<Vec2i, Vec2i> WorldPosToTile(Vec2f worldPos, int level)
+static DXGI_FORMAT GetHeightmapTexFormat(const ClipmapConfig& config, int level)
 {
-    return GlobalCoordsToTile(WorldPosToGlobalCoords(worldPos), level);
-}
+    if (config.IsCompressedLevel(level))
+        return CompressedHeightmapTexFormat;
 
-static Vec2f GlobalCoordsToWorldPos(Vec2i globalCoords)
-{
-    return Vec2f(globalCoords) * TexelSize;
+    return config.compactHeights ? CompactHeightmapTexFormat : HeightmapTexFormat;
 }
 
-static D3D12_TEXTURE_COPY_LOCATION MakeSrcTexCopyLocation(ID3D12Resource* intermediateBuffer, DXGI_FORMAT format)
+static DXGI_FORMAT GetNormalMapTexFormat(const ClipmapConfig& config)
 {
-    D3D12_TEXTURE_COPY_LOCATION src = {};
-    src.pResource = intermediateBuffer;
-    src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    src.PlacedFootprint.Offset = 0;
-    src.PlacedFootprint.Footprint.Format = format;
-    src.PlacedFootprint.Footprint.Width = HeightmapDimension;
-    src.PlacedFootprint.Footprint.Height = HeightmapDimension;
-    src.PlacedFootprint.Footprint.Depth = 1;
-    src.PlacedFootprint.Footprint.RowPitch = GetTexturePitchBytes(HeightmapDimension, GetFormatSize(format));
-    return src;
+    return config.preciseNormals ? PreciseNormalMapTexFormat : NormalMapTexFormat;
 }
 
 static D3D12_TEXTURE_COPY_LOCATION MakeDstTexCopyLocation(ID3D12Resource* texture)
@@ -142,18 +92,6 @@ static D3D12_TEXTURE_COPY_LOCATION MakeDstTexCopyLocation(ID3D12Resource* textur
     return dst;
 }
 
-static void CopyTex2DRegion(ID3D12GraphicsCommandList& commandList, D3D12_TEXTURE_COPY_LOCATION& dst, const D3D12_TEXTURE_COPY_LOCATION& src, Vec2i minInclusive, Vec2i maxExclusive)
-{
-    D3D12_BOX box;
-    box.left = minInclusive.x;
-    box.top = minInclusive.y;
-    box.front = 0;
-    box.right = maxExclusive.x;
-    box.bottom = maxExclusive.y;
-    box.back = 1;
-    commandList.CopyTextureRegion(&dst, box.left, box.top, 0, &src, &box);
-}
-
 
 Terrain::Terrain()
     : m_baseHeight(-12.f)
@@ -167,15 +105,37 @@ Terrain::Terrain()
 {
 }
 
-Terrain::~Terrain() = default;
+Terrain::~Terrain()
+{
+    // Make sure the worker isn't still touching tiles as they're destroyed.
+    m_editQueue.Stop();
+}
 
-bool Terrain::Init(Renderer& renderer)
+bool Terrain::Init(Renderer& renderer, const ClipmapConfig& config)
 {
+    if (!config.IsValid())
+    {
+        DebugOut("Invalid clipmap configuration!\n");
+        return false;
+    }
+
+    m_config = config;
+    m_clipmapUpdater = ClipmapUpdater(config.textureDimension);
+
     m_computeNormals = std::make_unique<TerrainComputeNormals>();
     if (!m_computeNormals->Init(renderer))
         return false;
 
     CreateConstantBuffers(renderer);
+    for (int i = 0; i < BackbufferCount; ++i)
+    {
+        m_mappedConstantBuffers[i]->invTextureDimension = 1.f / (float)m_config.textureDimension;
+        m_mappedConstantBuffers[i]->texelSize = m_config.texelSize;
+        m_mappedConstantBuffers[i]->numClipLevels = m_config.numLevels;
+        m_mappedConstantBuffers[i]->vertexPatchSize = m_config.VertexPatchSize();
+        m_mappedConstantBuffers[i]->roughnessNodes = m_config.textureDimension / RoughnessCellDimension;
+        m_mappedConstantBuffers[i]->roughnessCellTexels = RoughnessCellDimension;
+    }
 
     renderer.BeginUploads();
 
@@ -185,35 +145,57 @@ bool Terrain::Init(Renderer& renderer)
     m_normalTexDescIndices[1] = renderer.LoadTexture(m_detailNormalMaps[1], L"ground_grey_nor_dx_2k.dds", true);
 
     // Create a set of clipmap textures.
-    ID3D12Resource* heightMaps[NumClipLevels] = {};
-    ID3D12Resource* normalMaps[NumClipLevels] = {};
-    for (int i = 0; i < NumClipLevels; ++i)
+    ID3D12Resource* heightMaps[MaxClipLevels] = {};
+    ID3D12Resource* normalMaps[MaxClipLevels] = {};
+    for (int i = 0; i < m_config.numLevels; ++i)
     {
         Renderer::Texture2DParams texParams;
-        texParams.width = HeightmapDimension;
-        texParams.height = HeightmapDimension;
+        texParams.width = m_config.textureDimension;
+        texParams.height = m_config.textureDimension;
 
         ClipmapLevel& tile = m_clipmapLevels[i];
-        texParams.format = HeightmapTexFormat;
+        texParams.format = GetHeightmapTexFormat(m_config, i);
         texParams.initialState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE; // We'll transition this to and from D3D12_RESOURCE_STATE_COPY_DEST as required.
         texParams.name = L"HeightMap";
         tile.heightMap = renderer.CreateTexture2D(texParams);
-        tile.intermediateBuffer = renderer.CreateTexture2DUploadBuffer(texParams);
         heightMaps[i] = tile.heightMap.Get();
 
-        texParams.format = NormalMapTexFormat;
+        texParams.format = GetNormalMapTexFormat(m_config);
         texParams.flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
         texParams.initialState = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE; // We'll initalise this with compute.
         texParams.name = L"NormalMap";
         tile.normalMap = renderer.CreateTexture2D(texParams);
         normalMaps[i] = tile.normalMap.Get();
+
+        tile.heights.resize(math::Square(m_config.textureDimension), 0.f);
+        tile.bounds = MinMaxPyramid(m_config.textureDimension, HeightBoundsBlockDimension);
+        tile.roughness = RoughnessPyramid(m_config.textureDimension, RoughnessCellDimension);
     }
+    CreateRoughnessBuffers(renderer);
 
-    m_baseHeightMapTexIndex = renderer.AllocateTex2DSRVs((int)std::size(heightMaps), heightMaps, HeightmapTexFormat);
-    m_baseNormalMapTexIndex = renderer.AllocateTex2DSRVs((int)std::size(normalMaps), normalMaps, NormalMapTexFormat);
+    // The shaders always bind a full table of levels, so fill any unused slots with the coarsest level.
+    for (int i = m_config.numLevels; i < MaxClipLevels; ++i)
+    {
+        heightMaps[i] = heightMaps[m_config.numLevels - 1];
+        normalMaps[i] = normalMaps[m_config.numLevels - 1];
+    }
+
+    // Levels can differ in format, so allocate their views one at a time (they still end up contiguous).
+    for (int i = 0; i < MaxClipLevels; ++i)
+    {
+        int index = renderer.AllocateTex2DSRVs(1, &heightMaps[i], GetHeightmapTexFormat(m_config, std::min(i, m_config.numLevels - 1)));
+        m_baseHeightMapTexIndex = (i == 0) ? index : m_baseHeightMapTexIndex;
+        Assert(index == m_baseHeightMapTexIndex + i);
+    }
+    m_baseNormalMapTexIndex = renderer.AllocateTex2DSRVs((int)std::size(normalMaps), normalMaps, GetNormalMapTexFormat(m_config));
 
     renderer.EndUploads();
 
+    // Only depends on the format, so measure it once up front for the stats.
+    m_maxNormalEncodingError = MeasureMaxOctahedralError(m_config.NormalBits(), 1 << 16);
+
+    m_editQueue.Start([this](const std::vector<TerrainEditQueue::RaiseCommand>& commands) { ApplyEdits(commands); });
+
     return LoadCompiledShaders(renderer);
 }
 
@@ -222,6 +204,10 @@ void Terrain::Build(Renderer& renderer)
     // Ensure offset is up to date.
     m_clipmapTexelOffset = CalcClipmapTexelOffset(renderer.GetCamPos());
 
+    // Let any in-flight edits land before we change generation parameters, then keep the worker out of the tiles while we rebuild.
+    m_editQueue.Flush();
+    std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+
     renderer.BeginUploads();
 
     // Note: rand() is not seeded so this is still deterministic, for now.
@@ -232,6 +218,7 @@ void Terrain::Build(Renderer& renderer)
 
     BuildVertexBuffer(renderer);
     BuildIndexBuffer(renderer);
+    BuildRings(renderer);
     BuildWater(renderer);
 
     renderer.EndUploads();
@@ -241,11 +228,22 @@ void Terrain::Build(Renderer& renderer)
     // It's probably not optimal, but this way we don't have to make the compute queue wait for the copy queue to start doing that.
     renderer.BeginCompute();
 
+    // Start compact height ranges off covering everything the noise can generate; edits will grow them if need be.
+    HeightRange generatedRange = CalcGeneratedHeightRange();
+    for (int level = 0; level < m_config.numLevels; ++level)
+    {
+        m_heightRanges[level] = m_config.HasHeightRange(level) ? generatedRange : HeightRange();
+        m_heightRangeGrown[level] = false;
+    }
+
     // Generate clipmap height data and compute normals.
-    for (int level = 0; level < NumClipLevels; ++level)
+    for (int level = 0; level < m_config.numLevels; ++level)
     {
-        UpdateClipmapTextureLevel(renderer, level, -Vec2i(INT_MAX, INT_MAX) / 2, m_clipmapTexelOffset);
+        ClipmapLevelUpdate update;
+        m_clipmapUpdater.CalcMoveUpdate(level, -Vec2i(INT_MAX, INT_MAX) / 2, m_clipmapTexelOffset, update);
+        ExecuteClipmapUpdate(renderer, level, update);
     }
+    RewriteGrownLevels(renderer, m_clipmapTexelOffset);
 
     m_computeFenceVal = renderer.EndCompute();
 }
@@ -257,8 +255,80 @@ void Terrain::PreRender(Renderer& renderer)
         UpdateClipmapTextures(renderer);
     }
 
-    // Update shader UV offset.
-    m_mappedConstantBuffers[renderer.GetCurrentBuffer()]->clipmapUVOffset = Vec2f(m_clipmapTexelOffset) / (float)HeightmapDimension;
+    // The rings follow the clipmap rather than the camera, so they stay over what's resident (and stop when it's frozen).
+    const bool ringsMoved = m_clipmapRings.Update(Vec2f(m_clipmapTexelOffset) / (float)m_config.patchTexels);
+
+    // Shadow cascades fit their depth to the patches' height bounds, so they only cover what's drawn.
+    const bool drawnSurfaceChanged = m_patchBoundsDirty || ringsMoved;
+    if (m_useRings)
+    {
+        renderer.SetSceneHeightBounds([this](Vec2f worldMin, Vec2f worldMax) { return CalcRingHeightBounds(worldMin, worldMax); });
+        if (m_patchBoundsDirty || ringsMoved)
+        {
+            UpdateRingBounds();
+        }
+    }
+    else
+    {
+        renderer.SetSceneHeightBounds([this](Vec2f worldMin, Vec2f worldMax) { return m_patchCuller.CalcHeightBounds(worldMin, worldMax); });
+        if (m_patchBoundsDirty)
+        {
+            UpdatePatchHeightBounds();
+        }
+    }
+
+    // The occlusion depth buffer is drawn from the horizon's cells, so it needs them too.
+    if (m_horizonCulling || m_occlusionRaster)
+    {
+        UpdateHorizon(renderer.GetCamPos(), drawnSurfaceChanged);
+    }
+    if (m_occlusionRaster)
+    {
+        RasteriseOccluders(renderer.GetCamPos(), renderer.GetViewProjMatrix());
+    }
+
+    // Update shader UV offset and height ranges.
+    TerrainPSConstantBuffer* constants = m_mappedConstantBuffers[renderer.GetCurrentBuffer()];
+    constants->clipmapUVOffset = Vec2f(m_clipmapTexelOffset) / (float)m_config.textureDimension;
+    for (int i = 0; i < MaxClipLevels; ++i)
+    {
+        // Unused slots are bound to the coarsest level, so they get its range too.
+        const HeightRange& range = m_heightRanges[std::min(i, m_config.numLevels - 1)];
+        constants->heightScaleBias[i / 2][2 * (i & 1) + 0] = range.Scale();
+        constants->heightScaleBias[i / 2][2 * (i & 1) + 1] = range.min;
+    }
+
+    // Seams between ring levels are stitched in the hull and domain shaders. The outermost level and the grid have nothing to stitch to.
+    for (int level = 0; level < MaxClipLevels; ++level)
+    {
+        Vec4f& bounds = constants->ringBounds[level];
+        if (m_useRings && level < m_clipmapRings.GetNumLevels() - 1)
+        {
+            const Vec2i levelMin = m_clipmapRings.GetLevelMin(level);
+            const int levelSize = m_clipmapRings.GetLevelPatches() << level;
+            bounds = Vec4f((float)levelMin.x, (float)levelMin.y, (float)(levelMin.x + levelSize), (float)(levelMin.y + levelSize));
+        }
+        else
+        {
+            bounds = Vec4f(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+        }
+    }
+
+    // Tessellation is driven by each patch's projected roughness, see CalcTessFactor() in TerrainHull.hlsl.
+    const float pixelsPerMetre = renderer.GetProjMatrix()[1][1] * 0.5f * renderer.GetViewportSize().y;
+    constants->screenErrorScale = m_screenSpaceErrorTess ? pixelsPerMetre / m_tessPixelError : 0.f;
+    if (m_roughnessDirtyFrames > 0)
+    {
+        float* roughness = m_mappedRoughness[renderer.GetCurrentBuffer()];
+        for (int level = 0; level < m_config.numLevels; ++level)
+        {
+            const std::vector<float>& nodes = m_clipmapLevels[level].roughness.GetNodes();
+            memcpy(roughness + level * nodes.size(), nodes.data(), nodes.size() * sizeof(float));
+        }
+        --m_roughnessDirtyFrames;
+    }
+
+    UpdateWater(renderer);
 
     if (m_detailTexStateDirty)
     {
@@ -296,17 +366,16 @@ void Terrain::Render(Renderer& renderer)
     renderer.BindDescriptor(m_normalTexDescIndices[0], RootParam::Texture2);
     renderer.BindDescriptor(m_normalTexDescIndices[1], RootParam::Texture3);
     renderer.BindSampler(m_heightmapSamplerDescIndex);
+    commandList.SetGraphicsRootShaderResourceView(RootParam::HullBuffer, m_roughnessBuffers[renderer.GetCurrentBuffer()]->GetGPUVirtualAddress());
 
     // Render the terrain itself.
     commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
-    commandList.IASetVertexBuffers(0, 1, &m_vertexBuffer.view);
-    commandList.IASetIndexBuffer(&m_indexBuffer.view);
-    commandList.DrawIndexedInstanced(IndexBufferLength, 1, 0, 0, 0);
+    DrawPatches(renderer, renderer.GetViewProjMatrix(), m_horizonCulling ? &m_horizonCuller : nullptr, m_viewPatches);
 
     // Render "water".
     commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     commandList.SetPipelineState(m_waterPipelineState.Get());
-    commandList.IASetVertexBuffers(0, 1, &m_waterVertexBuffer.view);
+    commandList.IASetVertexBuffers(0, 1, &m_waterVertexBuffers[renderer.GetCurrentBuffer()].view);
     commandList.IASetIndexBuffer(&m_waterIndexBuffer.view);
     commandList.DrawIndexedInstanced(m_waterIndexBuffer.view.SizeInBytes / sizeof(uint16), 1, 0, 0, 0);
 }
@@ -320,298 +389,256 @@ void Terrain::RenderShadowPass(Renderer& renderer)
     renderer.BindDescriptor(m_cbufferDescIndex, RootParam::PSConstantBuffer);
     renderer.BindDescriptor(m_baseHeightMapTexIndex, RootParam::VertexTexture0);
     renderer.BindSampler(m_heightmapSamplerDescIndex);
+    commandList.SetGraphicsRootShaderResourceView(RootParam::HullBuffer, m_roughnessBuffers[renderer.GetCurrentBuffer()]->GetGPUVirtualAddress());
 
     // Render the terrain.
     commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
-    commandList.IASetVertexBuffers(0, 1, &m_vertexBuffer.view);
-    commandList.IASetIndexBuffer(&m_indexBuffer.view);
-    commandList.DrawIndexedInstanced(IndexBufferLength, 1, 0, 0, 0);
+    DrawPatches(renderer, renderer.GetSunShadowViewProjMatrix(), nullptr, m_shadowPatches[renderer.GetShadowCascade()]);
 }
 
-void Terrain::UpdateClipmapTextures(Renderer& renderer)
+void Terrain::DrawPatches(Renderer& renderer, const Mat4f& viewProj, const HorizonCuller* horizon, VisiblePatches& patches)
 {
-    Vec2i newTexelOffset = CalcClipmapTexelOffset(renderer.GetCamPos());
-
-    if (m_clipmapTexelOffset == newTexelOffset && m_globalDirtyRegionMin.x >= m_globalDirtyRegionMax.x && m_globalDirtyRegionMin.y >= m_globalDirtyRegionMax.y)
-        return;
-
-    renderer.WaitCurrentFrame();
-    renderer.BeginCompute();
-    ID3D12GraphicsCommandList& commandList = renderer.GetComputeCommandList();
-
-    // Update modified region, if any.
-    Vec2i globalDirtyRegionMin = m_globalDirtyRegionMin;
-    Vec2i globalDirtyRegionMax = m_globalDirtyRegionMax;
-    m_globalDirtyRegionMin = Vec2iZero;
-    m_globalDirtyRegionMax = Vec2iZero;
-    if (globalDirtyRegionMin.x < globalDirtyRegionMax.x && globalDirtyRegionMin.y < globalDirtyRegionMax.y)
+    if (m_useRings)
     {
-        for (int level = 0; level < NumClipLevels; ++level)
-        {
-            UploadClipmapTextureRegion(renderer, level, globalDirtyRegionMin, globalDirtyRegionMax, newTexelOffset);
-        }
+        DrawRings(renderer, viewProj, horizon, patches);
+        return;
     }
 
-    // Update heightmap textures.
-    if (m_clipmapTexelOffset != newTexelOffset)
+    ID3D12GraphicsCommandList& commandList = renderer.GetDirectCommandList();
+    const D3D12_VERTEX_BUFFER_VIEW vertexBuffers[] = { m_vertexBuffer.view, m_gridInstanceBuffer.view };
+    commandList.IASetVertexBuffers(0, (UINT)std::size(vertexBuffers), vertexBuffers);
+    patches.numInstances = 1;
+    if (!m_cullPatches)
     {
-        for (int level = 0; level < NumClipLevels; ++level)
-        {
-            UpdateClipmapTextureLevel(renderer, level, m_clipmapTexelOffset, newTexelOffset);
-        }
+        commandList.IASetIndexBuffer(&m_indexBuffer.view);
+        commandList.DrawIndexedInstanced(m_config.IndexBufferLength(), 1, 0, 0, 0);
+        patches.numPatches = math::Square(m_patchCuller.GetPatchesPerSide());
+        patches.numOccluded = 0;
+        patches.cullMs = 0.f;
+        return;
     }
 
-    m_computeFenceVal = renderer.EndCompute();
+    // Write this frame's copy of the pass's index list; the GPU finished reading it when BeginFrame() waited for this buffer.
+    const int currentBuffer = renderer.GetCurrentBuffer();
+    Timer timer;
+    const Frustumf frustum(viewProj);
+    int numIndices = m_config.NeedsLargeIndices()
+        ? m_patchCuller.WriteVisibleIndices(frustum, (uint32*)patches.mappedIndices[currentBuffer], horizon, &patches.numOccluded)
+        : m_patchCuller.WriteVisibleIndices(frustum, (uint16*)patches.mappedIndices[currentBuffer], horizon, &patches.numOccluded);
+    patches.cullMs = 1000.f * timer.GetSecondsAndReset();
+    patches.numPatches = numIndices / 4;
+    if (numIndices == 0)
+        return;
 
-    m_clipmapTexelOffset = newTexelOffset;
+    commandList.IASetIndexBuffer(&patches.indexBuffers[currentBuffer].view);
+    commandList.DrawIndexedInstanced(numIndices, 1, 0, 0, 0);
 }
- 
-void Terrain::UpdateClipmapTextureLevel(Renderer& renderer, int level, Vec2i oldTexelOffset, Vec2i newTexelOffset)
-{
-    // Update the clipmap at the given level based on camera movement.
-    // Texturing is done toroidally, so when the camera moves we replace the furthest slice
-    // of the texture in the direction we are moving away from with the new slice we need.
-    // In most cases this will be a single horizontal or vertical slice, but in general
-    // it will be both (i.e. a cross) or up to four slices if the dirty region wraps
-    // across the edge of the texture. A good overview of clipmaps:
-    // https://developer.nvidia.com/gpugems/gpugems2/part-i-geometric-complexity/chapter-2-terrain-rendering-using-gpu-based-geometry
-
-    // Check we've moved far enough to trigger an update at this level.
-    oldTexelOffset >>= level;
-    newTexelOffset >>= level;
-    if (oldTexelOffset == newTexelOffset)
-        return;
 
-    // Calculate dirty region in texel space for this clip level.
-    // All "regions" in this function actually represent a cross in the texture
-    // as described above.
-    const Vec2i fullSize(HeightmapDimension, HeightmapDimension);
-    const Vec2i halfSize = fullSize / 2;
-    Vec2i deltaSign = math::sign(newTexelOffset - oldTexelOffset);
-    Vec2i worldUploadRegionMin = oldTexelOffset + halfSize + deltaSign * halfSize;
-    Vec2i worldUploadRegionMax = newTexelOffset + halfSize + deltaSign * halfSize;
-    for (int i = 0; i < 2; ++i)
+void Terrain::DrawRings(Renderer& renderer, const Mat4f& viewProj, const HorizonCuller* horizon, VisiblePatches& patches)
+{
+    // Write this frame's copy of the pass's surviving instances, grouped by piece so each piece is one draw.
+    const int currentBuffer = renderer.GetCurrentBuffer();
+    Timer timer;
+    const int numInstances = m_ringInstanceBoxes.Size();
+    m_ringCullMask.resize(CullMaskWords(numInstances));
+    if (m_cullPatches)
     {
-        // Ensure min < max and limit the upload in case we teleported more than the width of the whole texture.
-        if (worldUploadRegionMax[i] < worldUploadRegionMin[i])
-        {
-            std::swap(worldUploadRegionMin[i], worldUploadRegionMax[i]);
-            worldUploadRegionMax[i] = std::min(worldUploadRegionMax[i], worldUploadRegionMin[i] + HeightmapDimension);
-        }
-        else
-        {
-            worldUploadRegionMin[i] = std::max(worldUploadRegionMin[i], worldUploadRegionMax[i] - HeightmapDimension);
-        }
+        CullAABBs(Frustumf(viewProj), m_ringInstanceBoxes, 0, numInstances, m_ringCullMask.data());
+    }
+    else
+    {
+        std::fill(m_ringCullMask.begin(), m_ringCullMask.end(), ~0u);
     }
 
-    // Calculate the whole world texel region that we want for the clip level.
-    Vec2i wantRegionMin = newTexelOffset;
-    Vec2i wantRegionMax = newTexelOffset + HeightmapSize;
+    TerrainInstance* instances = (TerrainInstance*)patches.mappedInstances[currentBuffer];
+    int pieceCounts[RingPiece::Count] = {};
+    int instanceIndex = 0;
+    patches.numInstances = 0;
+    patches.numPatches = 0;
+    patches.numOccluded = 0;
+    for (int piece = 0; piece < RingPiece::Count; ++piece)
+    {
+        const Vec2i pieceSize = m_clipmapRings.GetPieceSize((RingPiece::E)piece);
+        for (const RingPieceInstance& instance : m_clipmapRings.GetInstances((RingPiece::E)piece))
+        {
+            const int index = instanceIndex++;
+            if (!((m_ringCullMask[index / 32] >> (index & 31)) & 1))
+                continue;
 
-    // Map the intermediate buffer for the height map.
-    ClipmapLevel& levelData = m_clipmapLevels[level];
-    float* mappedHeights = nullptr;
-    levelData.intermediateBuffer->Map(0, nullptr, (void**)&mappedHeights);
-    Assert(mappedHeights);
+            if (horizon && horizon->IsOccluded(m_ringInstanceBoxes.Get(index)))
+            {
+                patches.numOccluded += pieceSize.x * pieceSize.y;
+                continue;
+            }
 
-    // Write the two (wrapped) quads we need to update to the mapped buffer.
-    if ((worldUploadRegionMax.x - worldUploadRegionMin.x == HeightmapDimension) || (worldUploadRegionMax.y - worldUploadRegionMin.y == HeightmapDimension))
-    {
-        // If we need to copy the whole texture, just do it once.
-        WriteIntermediateTextureData(mappedHeights, level, wantRegionMin, wantRegionMax);
+            instances[patches.numInstances++] = { Vec2f(instance.origin), (float)(1 << instance.level), (float)instance.level };
+            patches.numPatches += pieceSize.x * pieceSize.y;
+            ++pieceCounts[piece];
+        }
     }
-    else
+    patches.cullMs = 1000.f * timer.GetSecondsAndReset();
+
+    ID3D12GraphicsCommandList& commandList = renderer.GetDirectCommandList();
+    const D3D12_VERTEX_BUFFER_VIEW vertexBuffers[] = { m_ringVertexBuffer.view, patches.instanceBuffers[currentBuffer].view };
+    commandList.IASetVertexBuffers(0, (UINT)std::size(vertexBuffers), vertexBuffers);
+    commandList.IASetIndexBuffer(&m_ringIndexBuffer.view);
+    int firstInstance = 0;
+    for (int piece = 0; piece < RingPiece::Count; ++piece)
     {
-        // Else copy the two (wrapping) slices.
-        WriteIntermediateTextureData(mappedHeights, level, Vec2i(worldUploadRegionMin.x, wantRegionMin.y), Vec2i(worldUploadRegionMax.x, wantRegionMax.y));
-        WriteIntermediateTextureData(mappedHeights, level, Vec2i(wantRegionMin.x, worldUploadRegionMin.y), Vec2i(wantRegionMax.x, worldUploadRegionMax.y));
+        if (pieceCounts[piece] == 0)
+            continue;
+
+        const RingPieceMesh& mesh = m_ringPieceMeshes[piece];
+        commandList.DrawIndexedInstanced(mesh.numIndices, pieceCounts[piece], mesh.firstIndex, mesh.baseVertex, firstInstance);
+        firstInstance += pieceCounts[piece];
     }
+}
 
-    // Calculate the region of the texture we wrote to (possibly wrapping across the edge).
-    Vec2i texUploadRegionMin(WrapHeightmapCoords(worldUploadRegionMin));
-    Vec2i texUploadRegionMax(WrapHeightmapCoords(worldUploadRegionMax));
+void Terrain::UpdateClipmapTextures(Renderer& renderer)
+{
+    Vec2i newTexelOffset = CalcClipmapTexelOffset(renderer.GetCamPos());
+    bool moved = m_clipmapTexelOffset != newTexelOffset;
 
-    // Unmap intermediate buffer.
-    if (texUploadRegionMin.x == texUploadRegionMax.x && texUploadRegionMin.y < texUploadRegionMax.y)
+    // The edit worker holds the tile lock while it applies a batch of strokes. Don't stall the frame waiting for it: whatever
+    // it has finished by then, and the move, will be picked up at the start of a later frame. Only once the camera has got
+    // an eighth of a texture away from what's resident do we wait, so a long run of big strokes can't leave the finest level behind.
+    std::unique_lock<std::mutex> lock(m_tileCacheMutex, std::try_to_lock);
+    if (!lock.owns_lock())
     {
-        // No vertical slice and no vertical wrap so only flush the rows we touched.
-        D3D12_RANGE writeRange = { (size_t)HeightmapIndex(0, texUploadRegionMin.y), (size_t)HeightmapIndex(HeightmapDimension - 1, texUploadRegionMax.y) + 1 };
-        levelData.intermediateBuffer->Unmap(0, &writeRange);
-    }
-    else
-    {
-        // Flush whole range because we had to touch either every row or at least the top and bottom row.
-        levelData.intermediateBuffer->Unmap(0, nullptr);
-    }
+        const Vec2i lag = math::abs(newTexelOffset - m_clipmapTexelOffset);
+        if (std::max(lag.x, lag.y) < m_config.textureDimension / 8)
+            return;
 
-    // Copy from the intermediate buffer to the actual texture.
-    D3D12_TEXTURE_COPY_LOCATION heightDst = MakeDstTexCopyLocation(levelData.heightMap.Get());
-    D3D12_TEXTURE_COPY_LOCATION heightSrc = MakeSrcTexCopyLocation(levelData.intermediateBuffer.Get(), HeightmapTexFormat);
-    ID3D12GraphicsCommandList& commandList = renderer.GetComputeCommandList();
+        lock.lock();
+    }
 
-    D3D12_RESOURCE_BARRIER preBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_clipmapLevels[level].heightMap.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
-    commandList.ResourceBarrier(1, &preBarrier);
+    if (!moved && !HasDirtyRegion())
+        return;
 
-    auto CopyBox = [&](Vec2i minInclusive, Vec2i maxExclusive) { CopyTex2DRegion(commandList, heightDst, heightSrc, minInclusive, maxExclusive); };
+    renderer.WaitCurrentFrame();
+    renderer.BeginCompute();
+    ID3D12GraphicsCommandList& commandList = renderer.GetComputeCommandList();
 
-    if (worldUploadRegionMin.x + HeightmapDimension == worldUploadRegionMax.x || worldUploadRegionMin.y + HeightmapDimension == worldUploadRegionMax.y)
-    {
-        // Copy the whole thing because we moved the whole width or height of the texture.
-        CopyBox(Vec2iZero, HeightmapSize);
-    }
-    else
+    // Update modified region, if any.
+    ClipmapLevelUpdate update;
+    if (HasDirtyRegion())
     {
-        // Copy vertical slice(s).
-        if (texUploadRegionMin.x < texUploadRegionMax.x)
+        for (int level = 0; level < m_config.numLevels; ++level)
         {
-            CopyBox(Vec2i(texUploadRegionMin.x, 0), Vec2i(texUploadRegionMax.x + 1, HeightmapDimension));
-        }
-        else if (texUploadRegionMin.x > texUploadRegionMax.x)
-        {
-            // Dirty region wraps across the boundary so copy two slices.
-            CopyBox(Vec2i(texUploadRegionMin.x, 0), Vec2i(HeightmapDimension, HeightmapDimension));
-            CopyBox(Vec2i(0, 0), Vec2i(texUploadRegionMax.x + 1, HeightmapDimension));
+            if (m_clipmapUpdater.CalcRegionUpdate(level, m_globalDirtyRegionMin, m_globalDirtyRegionMax, newTexelOffset, update))
+            {
+                ExecuteClipmapUpdate(renderer, level, update);
+            }
         }
+    }
+    m_globalDirtyRegionMin = Vec2iZero;
+    m_globalDirtyRegionMax = Vec2iZero;
 
-        // Copy horizontal slice(s).
-        if (texUploadRegionMin.y < texUploadRegionMax.y)
-        {
-            CopyBox(Vec2i(0, texUploadRegionMin.y), Vec2i(HeightmapDimension, texUploadRegionMax.y + 1));
-        }
-        else if (texUploadRegionMin.y > texUploadRegionMax.y)
+    // Update heightmap textures.
+    if (moved)
+    {
+        for (int level = 0; level < m_config.numLevels; ++level)
         {
-            // Dirty region wraps across the boundary so copy two slices.
-            CopyBox(Vec2i(0, texUploadRegionMin.y), Vec2i(HeightmapDimension, HeightmapDimension));
-            CopyBox(Vec2i(0, 0), Vec2i(HeightmapDimension, texUploadRegionMax.y + 1));
+            if (m_clipmapUpdater.CalcMoveUpdate(level, m_clipmapTexelOffset, newTexelOffset, update))
+            {
+                ExecuteClipmapUpdate(renderer, level, update);
+            }
         }
     }
+    RewriteGrownLevels(renderer, newTexelOffset);
 
-    D3D12_RESOURCE_BARRIER postBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_clipmapLevels[level].heightMap.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    commandList.ResourceBarrier(1, &postBarrier);
-
-    // Update normal map. The compute shader can wrap around so always just two dispatches for this.
-    auto ComputeNormals = [&](Vec2i min, Vec2i max)
-    {
-        // Pad the region by 1 cell in each direction since height affects adjacent normals.
-        Vec2i normalMin = min - Vec2i(1, 1);
-        Vec2i normalMax = max + Vec2i(1, 1);
-        m_computeNormals->Compute(renderer, m_clipmapLevels[level].heightMap.Get(), m_clipmapLevels[level].normalMap.Get(), normalMin, normalMax, level);
-    };
+    m_computeFenceVal = renderer.EndCompute();
 
-    // Pass world UVs into compute since it does the wrapping for us and relies on min < max.
-    ComputeNormals(Vec2i(worldUploadRegionMin.x, 0), Vec2i(worldUploadRegionMax.x + 1, HeightmapDimension)); // Vertical slice
-    ComputeNormals(Vec2i(0, worldUploadRegionMin.y), Vec2i(HeightmapDimension, worldUploadRegionMax.y + 1)); // Horizontal slice
+    m_clipmapTexelOffset = newTexelOffset;
 }
-
-void Terrain::UploadClipmapTextureRegion(Renderer& renderer, int level, Vec2i globalMin, Vec2i globalMax, Vec2i newTexelOffset)
+ 
+void Terrain::ExecuteClipmapUpdate(Renderer& renderer, int level, const ClipmapLevelUpdate& update)
 {
-    // Upload a dirty AABB region (inclusive bounds) of a single clipmap level, after terrain has been modified.
-    // Note that the logic in this function is different to UpdateHeightmapTextureLevel();
-    // here we are dealing with a single AABB, whereas that function must upload a cross that spans the whole clipmap texture.
-
-    Assert(globalMin.x <= globalMax.x);
-    Assert(globalMin.y <= globalMax.y);
-    Vec2i levelGlobalMin = globalMin >> level;
-    Vec2i levelGlobalMax = globalMax >> level;
+    m_patchBoundsDirty = true;
+    ClipmapLevel& levelData = m_clipmapLevels[level];
+    D3D12_TEXTURE_COPY_LOCATION heightDst = MakeDstTexCopyLocation(levelData.heightMap.Get());
+    ID3D12GraphicsCommandList& commandList = renderer.GetComputeCommandList();
 
-    // Transform to a [min, max) region now that we're done shifting for levels.
-    levelGlobalMax += Vec2i(1, 1);
+    D3D12_RESOURCE_BARRIER preBarrier = CD3DX12_RESOURCE_BARRIER::Transition(levelData.heightMap.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+    commandList.ResourceBarrier(1, &preBarrier);
 
-    // Offset to account for clipmap tiling origin.
-    // TODO: this is getting ridiculous, can I remove this?
-    const Vec2i fullSize(HeightmapDimension, HeightmapDimension);
-    const Vec2i halfSize = fullSize / 2;
-    levelGlobalMin += halfSize;
-    levelGlobalMax += halfSize;
+    // Read each piece of the new height data into the CPU copy of the level, then pack it into its own strip of upload memory
+    // and copy it to where it lives in the texture. The upload ring recycles the strips once this compute submission completes.
+    const DXGI_FORMAT heightmapFormat = GetHeightmapTexFormat(m_config, level);
+    const bool compressed = m_config.IsCompressedLevel(level);
+    float writtenLow = FLT_MAX;
+    float writtenHigh = -FLT_MAX;
+    for (int i = 0; i < update.numWrites; ++i)
+    {
+        ClipmapLevelUpdate::Region pieces[4];
+        int numPieces = m_clipmapUpdater.SplitWrappedRegion(update.writes[i], pieces);
+        for (int piece = 0; piece < numPieces; ++piece)
+        {
+            UpdateResidentHeights(level, pieces[piece].min, pieces[piece].max);
 
-    // Does the dirty region actually overlap with the active texture region at this clip level?
-    Vec2i textureRegionMin = (newTexelOffset >> level);
-    Vec2i textureRegionMax = (newTexelOffset >> level) + fullSize;
-    levelGlobalMin = std::clamp(levelGlobalMin, textureRegionMin, textureRegionMax);
-    levelGlobalMax = std::clamp(levelGlobalMax, textureRegionMin, textureRegionMax);
-    if (levelGlobalMin.x == levelGlobalMax.x || levelGlobalMin.y == levelGlobalMax.y)
-        return;
+            Vec2i texMin = m_clipmapUpdater.WrapCoords(pieces[piece].min);
+            Vec2i size = pieces[piece].max - pieces[piece].min;
+            if (compressed)
+            {
+                // Copies to block compressed textures have to cover whole blocks, so round out to them (this never crosses the texture edge).
+                Vec2i texMax = math::RoundUpPow2(texMin + size, Vec2i(BlockDimension, BlockDimension));
+                texMin = math::RoundDownPow2(texMin, Vec2i(BlockDimension, BlockDimension));
+                size = texMax - texMin;
+
+                int rowPitch = GetTexturePitchBytes(GetBlockRowBytes(size.x, BC4BlockBytes), 1);
+                UploadAllocation upload = renderer.AllocateUpload(UploadQueue::Compute, rowPitch * (size.y / BlockDimension), D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+                WriteCompressedUploadStrip(upload.cpuAddress, rowPitch, level, texMin, texMax, writtenLow, writtenHigh);
+
+                D3D12_TEXTURE_COPY_LOCATION heightSrc = MakeSrcTexCopyLocation(upload, heightmapFormat, size, rowPitch);
+                commandList.CopyTextureRegion(&heightDst, texMin.x, texMin.y, 0, &heightSrc, nullptr);
+                m_compressionStats.uploadedBytes += (uint64)rowPitch * (size.y / BlockDimension);
+                continue;
+            }
 
-    // Map the intermediate buffer.
-    ClipmapLevel& levelData = m_clipmapLevels[level];
-    float* mappedData = nullptr;
-    levelData.intermediateBuffer->Map(0, nullptr, (void**)&mappedData);
-    Assert(mappedData);
+            int rowPitch = GetTexturePitchBytes(size.x, m_config.HeightTexelSize());
+            UploadAllocation upload = renderer.AllocateUpload(UploadQueue::Compute, rowPitch * size.y, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            WriteUploadStrip(upload.cpuAddress, rowPitch, level, texMin, texMin + size, writtenLow, writtenHigh);
 
-    // Copy tile data to the intermediate buffer.
-    WriteIntermediateTextureData(mappedData, level, levelGlobalMin, levelGlobalMax);
+            D3D12_TEXTURE_COPY_LOCATION heightSrc = MakeSrcTexCopyLocation(upload, heightmapFormat, size, rowPitch);
+            commandList.CopyTextureRegion(&heightDst, texMin.x, texMin.y, 0, &heightSrc, nullptr);
+        }
+    }
 
-    // Calculate the region of the texture we will write to (possibly wrapping across the edge).
-    Vec2i texUploadRegionMin(WrapHeightmapCoords(levelGlobalMin));
-    Vec2i texUploadRegionMax(WrapHeightmapCoords(levelGlobalMax));
+    D3D12_RESOURCE_BARRIER postBarrier = CD3DX12_RESOURCE_BARRIER::Transition(levelData.heightMap.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    commandList.ResourceBarrier(1, &postBarrier);
 
-    // Unmap intermediate buffer.
-    if (texUploadRegionMin.y < texUploadRegionMax.y)
-    {
-        // No vertical wrap so only flush the rows we touched.
-        D3D12_RANGE writeRange = { (size_t)HeightmapIndex(0, texUploadRegionMin.y), (size_t)HeightmapIndex(HeightmapDimension - 1, texUploadRegionMax.y) + 1 };
-        levelData.intermediateBuffer->Unmap(0, &writeRange);
-    }
-    else
+    // If anything was clamped, grow the range and have the caller rewrite the whole level with it.
+    HeightRange& range = m_heightRanges[level];
+    if (m_config.HasHeightRange(level) && !range.Contains(writtenLow, writtenHigh))
     {
-        // Flush whole range because we had to touch either every row or at least the top and bottom row.
-        levelData.intermediateBuffer->Unmap(0, nullptr);
+        range = range.Grow(writtenLow, writtenHigh);
+        m_heightRangeGrown[level] = true;
+        ++m_heightRangeGrowCounts[level];
     }
 
-    // Copy from the intermediate buffer to the actual texture.
-    D3D12_TEXTURE_COPY_LOCATION dst = MakeDstTexCopyLocation(levelData.heightMap.Get());
-    D3D12_TEXTURE_COPY_LOCATION src = MakeSrcTexCopyLocation(levelData.intermediateBuffer.Get(), HeightmapTexFormat);
-    ID3D12GraphicsCommandList& commandList = renderer.GetComputeCommandList();
-    auto CopyBox = [&](Vec2i minInclusive, Vec2i maxExclusive)
-    {
-        Assert(minInclusive.y < maxExclusive.y);
-        CopyTex2DRegion(commandList, dst, src, minInclusive, maxExclusive);
-    };
-
-    D3D12_RESOURCE_BARRIER preBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_clipmapLevels[level].heightMap.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
-    commandList.ResourceBarrier(1, &preBarrier);
-
-    if (texUploadRegionMin.x < texUploadRegionMax.x)
+    // Update normal map. The compute shader does the wrapping for us.
+    // Compact heights are normalised, which is the same as shrinking the texel size by the height scale (the bias cancels out).
+    // Rounding out to blocks re-encodes texels next to the written region, which can shift them slightly, so pad by a block for those.
+    const Vec2i normalsPadding = compressed ? Vec2i(BlockDimension, BlockDimension) : Vec2iZero;
+    for (int i = 0; i < update.numNormals; ++i)
     {
-        if (texUploadRegionMin.y < texUploadRegionMax.y)
-        {
-            // The region doesn't wrap either boundary so just do a single copy.
-            CopyBox(texUploadRegionMin, texUploadRegionMax + Vec2i(1, 1));
-        }
-        else
-        {
-            // Dirty region wraps across the boundary so copy two regions.
-            CopyBox(Vec2i(texUploadRegionMin.x, 0), texUploadRegionMax + Vec2i(1, 1));
-            CopyBox(texUploadRegionMin, Vec2i(texUploadRegionMax.x + 1, HeightmapDimension));
-        }
+        m_computeNormals->Compute(renderer, levelData.heightMap.Get(), levelData.normalMap.Get(), update.normals[i].min - normalsPadding, update.normals[i].max + normalsPadding, m_config.texelSize * float(1 << level) / range.Scale());
     }
-    else
+}
+
+void Terrain::RewriteGrownLevels(Renderer& renderer, Vec2i texelOffset)
+{
+    // Rewriting a level can only grow its range to cover what we've now seen, so this terminates.
+    for (int level = 0; level < m_config.numLevels; ++level)
     {
-        if (texUploadRegionMin.y < texUploadRegionMax.y)
-        {
-            // Dirty region wraps across the boundary so copy two regions.
-            CopyBox(Vec2i(0, texUploadRegionMin.y), texUploadRegionMax + Vec2i(1, 1));
-            CopyBox(texUploadRegionMin, Vec2i(HeightmapDimension, texUploadRegionMax.y + 1));
-        }
-        else
+        while (m_heightRangeGrown[level])
         {
-            // Dirty region wraps across *both* boundaries so copy four regions!
-            CopyBox(texUploadRegionMin, fullSize);
-            CopyBox(Vec2i(texUploadRegionMin.x, 0), Vec2i(HeightmapDimension, texUploadRegionMax.y + 1));
-            CopyBox(Vec2i(0, texUploadRegionMin.y), Vec2i(texUploadRegionMax.x + 1, HeightmapDimension));
-            CopyBox(Vec2iZero, texUploadRegionMax + Vec2i(1, 1));
+            m_heightRangeGrown[level] = false;
+            ClipmapLevelUpdate update;
+            m_clipmapUpdater.CalcMoveUpdate(level, -Vec2i(INT_MAX, INT_MAX) / 2, texelOffset, update);
+            ExecuteClipmapUpdate(renderer, level, update);
         }
     }
-
-    D3D12_RESOURCE_BARRIER postBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_clipmapLevels[level].heightMap.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    commandList.ResourceBarrier(1, &postBarrier);
-
-    // Update normal map. The compute shader can wrap around so always just a single dispatch for this.
-    // Pad the region by 1 cell in each direction since height affects adjacent normals.
-    // Pass world UVs into compute since it does the wrapping for us and relies on min < max.
-    Vec2i normalMin = levelGlobalMin - Vec2i(1, 1);
-    Vec2i normalMax = levelGlobalMax + Vec2i(1, 1);
-    m_computeNormals->Compute(renderer, m_clipmapLevels[level].heightMap.Get(), m_clipmapLevels[level].normalMap.Get(), normalMin, normalMax, level);
 }
 
 Terrain::HeightmapData& Terrain::GetOrCreateTile(Vec2i tile, int level)
@@ -621,30 +648,68 @@ Terrain::HeightmapData& Terrain::GetOrCreateTile(Vec2i tile, int level)
     if (inserted)
     {
         // We have to initialise this tile. Fill in the noise data.
-        Vec2i tileBaseCoords = tile * TileDimension;
-        heightmap.reserve(math::Square(TileDimension));
-        for (int z = 0; z < TileDimension; ++z)
+        const int tileDimension = m_config.tileDimension;
+        Vec2i tileBaseCoords = tile * tileDimension;
+        heightmap.resize(math::Square(tileDimension));
+        for (int z = 0; z < tileDimension; ++z)
         {
-            for (int x = 0; x < TileDimension; ++x)
-            {
-                heightmap.push_back(GenerateHeight(tileBaseCoords + Vec2i(x, z), level));
-            }
+            GenerateHeights(tileBaseCoords + Vec2i(0, z), tileDimension, level, &heightmap[m_config.TileIndex(0, z)]);
         }
+
+        MinMaxPyramid& bounds = m_tileBounds[level].try_emplace(tile, tileDimension, HeightBoundsBlockDimension).first->second;
+        bounds.Build(heightmap.data(), tileDimension);
     }
     return heightmap;
 }
 
-void Terrain::RaiseAreaRounded(Renderer& renderer, Vec2f posXZ, float radius, float raiseBy)
+void Terrain::RaiseAreaRounded(Vec2f posXZ, float radius, float raiseBy)
+{
+    m_editQueue.Push({ posXZ, radius, raiseBy });
+}
+
+void Terrain::ApplyEdits(const std::vector<TerrainEditQueue::RaiseCommand>& commands)
+{
+    // Called on the edit worker thread.
+    std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+    Timer timer;
+
+    // Apply every stroke to the top level tiles, then propagate the union of
+    // the touched regions down the mip chain once rather than once per stroke.
+    Vec2i unionMin(INT_MAX, INT_MAX);
+    Vec2i unionMax(INT_MIN, INT_MIN);
+    for (const TerrainEditQueue::RaiseCommand& command : commands)
+    {
+        Vec2i minGlobalCoords = m_config.WorldPosToGlobalCoords(command.posXZ - Vec2f(command.radius, command.radius));
+        Vec2i maxGlobalCoords = m_config.WorldPosToGlobalCoords(command.posXZ + Vec2f(command.radius, command.radius));
+        RaiseTiles(command, minGlobalCoords, maxGlobalCoords);
+
+        unionMin = math::min(unionMin, minGlobalCoords);
+        unionMax = math::max(unionMax, maxGlobalCoords);
+    }
+
+    if (commands.empty())
+        return;
+
+    float raiseSeconds = timer.GetSecondsAndReset();
+    UpdateTileMips(unionMin, unionMax);
+    float mipSeconds = timer.GetSecondsAndReset();
+
+    m_editStats.raiseMs = 1000.f * raiseSeconds;
+    m_editStats.mipsMs = 1000.f * mipSeconds;
+    m_editStats.numStrokes = (int)commands.size();
+
+    // Publish the dirty region for the render side to pick up.
+    AddDirtyRegion(unionMin, unionMax);
+}
+
+void Terrain::RaiseTiles(const TerrainEditQueue::RaiseCommand& command, Vec2i minGlobalCoords, Vec2i maxGlobalCoords)
 {
-    // Check buffers not already being uploaded.
-    Assert(m_computeFenceVal == 0);
+    auto [posXZ, radius, raiseBy] = command;
 
     // Find all tiles touched by this transform.
-    // Account for tile borders.
-    Vec2i minGlobalCoords = WorldPosToGlobalCoords(posXZ - Vec2f(radius, radius));
-    Vec2i maxGlobalCoords = WorldPosToGlobalCoords(posXZ + Vec2f(radius, radius));
-    Vec2i minTile = GlobalCoordsToTile(minGlobalCoords - Vec2i(TexelSize, TexelSize), 0).first;
-    Vec2i maxTile = GlobalCoordsToTile(maxGlobalCoords + Vec2i(TexelSize, TexelSize), 0).first;
+    const int tileDimension = m_config.tileDimension;
+    Vec2i minTile = m_config.GlobalCoordsToTile(minGlobalCoords, 0).first;
+    Vec2i maxTile = m_config.GlobalCoordsToTile(maxGlobalCoords, 0).first;
 
     for (int tileZ = minTile.y; tileZ <= maxTile.y; ++tileZ)
     {
@@ -654,59 +719,117 @@ void Terrain::RaiseAreaRounded(Renderer& renderer, Vec2f posXZ, float radius, fl
             HeightmapData& heightmap = GetOrCreateTile(tile, 0);
 
             // Find bounds within the tile that could be touched.
-            Vec2i minVert = GlobalCoordsToTileCoords(minGlobalCoords, tile, 0);
-            Vec2i maxVert = GlobalCoordsToTileCoords(maxGlobalCoords, tile, 0) + Vec2i(1, 1);
+            Vec2i minVert = m_config.GlobalCoordsToTileCoords(minGlobalCoords, tile, 0);
+            Vec2i maxVert = m_config.GlobalCoordsToTileCoords(maxGlobalCoords, tile, 0) + Vec2i(1, 1);
 
             // Clamp to tile bounds.
-            minVert.x = std::clamp(minVert.x, 0, TileDimension);
-            minVert.y = std::clamp(minVert.y, 0, TileDimension);
-            maxVert.x = std::clamp(maxVert.x, 0, TileDimension);
-            maxVert.y = std::clamp(maxVert.y, 0, TileDimension);
+            minVert.x = std::clamp(minVert.x, 0, tileDimension);
+            minVert.y = std::clamp(minVert.y, 0, tileDimension);
+            maxVert.x = std::clamp(maxVert.x, 0, tileDimension);
+            maxVert.y = std::clamp(maxVert.y, 0, tileDimension);
 
             // Update heightmap.
             for (int z = minVert.y; z < maxVert.y; ++z)
             {
                 for (int x = minVert.x; x < maxVert.x; ++x)
                 {
-                    int globalX = x + tileX * TileDimension;
-                    int globalZ = z + tileZ * TileDimension;
-                    Vec2f pos = GlobalCoordsToWorldPos(Vec2i(globalX, globalZ));
+                    int globalX = x + tileX * tileDimension;
+                    int globalZ = z + tileZ * tileDimension;
+                    Vec2f pos = m_config.GlobalCoordsToWorldPos(Vec2i(globalX, globalZ));
                     float distSq = math::length2(pos - posXZ);
-                    heightmap[TileIndex(x, z)] += raiseBy * std::max(math::Square(radius) - distSq, 0.f);
+                    heightmap[m_config.TileIndex(x, z)] += raiseBy * std::max(math::Square(radius) - distSq, 0.f);
                 }
             }
+            m_tileBounds[0].at(tile).Update(heightmap.data(), tileDimension, minVert, maxVert);
         }
     }
+}
 
+void Terrain::UpdateTileMips(Vec2i minGlobalCoords, Vec2i maxGlobalCoords)
+{
     // Update lower tile mips.
-    for (int level = 1; level < NumClipLevels; ++level)
+    // Each destination tile at a level is the 2x2 downsample of a 2x2 block of tiles at the level above,
+    // so work tile-to-tile: look each tile up once, then reduce whole rows at a time.
+    const int tileDimension = m_config.tileDimension;
+    const int halfTileDimension = tileDimension / 2;
+
+    for (int level = 1; level < m_config.numLevels; ++level)
     {
         Vec2i levelGlobalMin = minGlobalCoords >> level;
         Vec2i levelGlobalMax = (maxGlobalCoords >> level) + Vec2i(1, 1);
-        
-        // Could also loop over tiles here to avoid repeated GetOrCreateTile() calls...
-        // But the hashmap lookup should be practically free most of the time, so doesn't seem worth the code bloat.
-        for (int z = levelGlobalMin.y; z < levelGlobalMax.y; ++z)
+        Vec2i minTile = m_config.LevelGlobalCoordsToTile(levelGlobalMin).first;
+        Vec2i maxTile = m_config.LevelGlobalCoordsToTile(levelGlobalMax - Vec2i(1, 1)).first;
+
+        for (int tileZ = minTile.y; tileZ <= maxTile.y; ++tileZ)
         {
-            for (int x = levelGlobalMin.x; x < levelGlobalMax.x; ++x)
+            for (int tileX = minTile.x; tileX <= maxTile.x; ++tileX)
             {
-                Vec2i levelGlobalCoords(x, z);
-                auto [dstTile, dstTileCoords] = LevelGlobalCoordsToTile(levelGlobalCoords);
-                auto [srcTile, srcTileCoords] = LevelGlobalCoordsToTile(levelGlobalCoords << 1);
-                const HeightmapData& srcHeightmap = GetOrCreateTile(srcTile, level - 1);
+                Vec2i dstTile(tileX, tileZ);
+
+                // Clamp the region to this tile. Only texels in it are written: anything outside isn't in the dirty region,
+                // so changing it would leave the GPU's copy out of step.
+                Vec2i dstMin = math::max(m_config.LevelGlobalCoordsToTileCoords(levelGlobalMin, dstTile), Vec2iZero);
+                Vec2i dstMax = math::min(m_config.LevelGlobalCoordsToTileCoords(levelGlobalMax, dstTile), Vec2i(tileDimension, tileDimension));
+
                 HeightmapData& dstHeightmap = GetOrCreateTile(dstTile, level);
-                dstHeightmap[TileIndex(dstTileCoords)] = 0.25f * (srcHeightmap[TileIndex(srcTileCoords)] +
-                                                                  srcHeightmap[TileIndex(srcTileCoords + Vec2i(1, 0))] +
-                                                                  srcHeightmap[TileIndex(srcTileCoords + Vec2i(0, 1))] +
-                                                                  srcHeightmap[TileIndex(srcTileCoords + Vec2i(1, 1))]);
-            }
+
+                // Fetch only the source tiles the region actually covers.
+                const float* srcHeightmaps[2][2] = {};
+                for (int j = 0; j < 2; ++j)
+                {
+                    if (dstMax.y <= j * halfTileDimension || (j + 1) * halfTileDimension <= dstMin.y)
+                        continue;
+
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        if (dstMax.x <= i * halfTileDimension || (i + 1) * halfTileDimension <= dstMin.x)
+                            continue;
+
+                        srcHeightmaps[j][i] = GetOrCreateTile(2 * dstTile + Vec2i(i, j), level - 1).data();
+                    }
+                }
+
+                for (int z = dstMin.y; z < dstMax.y; ++z)
+                {
+                    int j = z / halfTileDimension;
+                    int srcZ = 2 * z - j * tileDimension;
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        int spanMin = std::max(dstMin.x, i * halfTileDimension);
+                        int spanMax = std::min(dstMax.x, (i + 1) * halfTileDimension);
+                        if (spanMin >= spanMax)
+                            continue;
+
+                        const float* src = srcHeightmaps[j][i];
+                        Assert(src);
+                        int srcX = 2 * spanMin - i * tileDimension;
+                        DownsampleRows(&dstHeightmap[m_config.TileIndex(spanMin, z)], &src[m_config.TileIndex(srcX, srcZ)], &src[m_config.TileIndex(srcX, srcZ + 1)], spanMax - spanMin);
+                    }
+                }
+                m_tileBounds[level].at(dstTile).Update(dstHeightmap.data(), tileDimension, dstMin, dstMax);
+            }
         }
     }
+}
+
+void Terrain::AddDirtyRegion(Vec2i globalMin, Vec2i globalMax)
+{
+    // Merge with any region the render side hasn't picked up yet.
+    if (HasDirtyRegion())
+    {
+        m_globalDirtyRegionMin = math::min(m_globalDirtyRegionMin, globalMin);
+        m_globalDirtyRegionMax = math::max(m_globalDirtyRegionMax, globalMax);
+    }
+    else
+    {
+        m_globalDirtyRegionMin = globalMin;
+        m_globalDirtyRegionMax = globalMax;
+    }
+}
 
-    // Flag clipmap as dirty.
-    Assert(m_globalDirtyRegionMin == Vec2iZero && m_globalDirtyRegionMax == Vec2iZero);
-    m_globalDirtyRegionMin = minGlobalCoords;
-    m_globalDirtyRegionMax = maxGlobalCoords;
+bool Terrain::HasDirtyRegion() const
+{
+    return m_globalDirtyRegionMin.x < m_globalDirtyRegionMax.x && m_globalDirtyRegionMin.y < m_globalDirtyRegionMax.y;
 }
 
 bool Terrain::LoadCompiledShaders(Renderer& renderer)
@@ -804,11 +927,219 @@ void Terrain::Imgui(Renderer& renderer)
             noiseParams(m_whiteNoiseParams, 0x8000);
         }
 
+        if (ImGui::CollapsingHeader("Edit Stats"))
+        {
+            ImGui::Text("Last batch:  %d strokes", m_editStats.numStrokes.load());
+            ImGui::Text("Raise tiles: %.3f ms", m_editStats.raiseMs.load());
+            ImGui::Text("Update mips: %.3f ms", m_editStats.mipsMs.load());
+        }
+
+        if (m_config.compactHeights && ImGui::CollapsingHeader("Compact Heights"))
+        {
+            for (int level = 0; level < m_config.numLevels; ++level)
+            {
+                const HeightRange& range = m_heightRanges[level];
+                ImGui::Text("Level %d: [%.2f, %.2f], max error %.3f mm, grown %d times", level, range.min, range.max,
+                            1000.f * range.MaxQuantisationError(), m_heightRangeGrowCounts[level]);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Normal Encoding"))
+        {
+            ImGui::Text("Octahedral RG%d, max error %.4f degrees", m_config.NormalBits(), m_maxNormalEncodingError);
+        }
+
+        if (m_config.compressedLevels > 0 && ImGui::CollapsingHeader("Block Compression"))
+        {
+            ImGui::RadioButton("Fast", (int*)&m_compressionQuality, BlockCompressionQuality::Fast);
+            ImGui::SameLine();
+            ImGui::RadioButton("High Quality", (int*)&m_compressionQuality, BlockCompressionQuality::High);
+
+            // BC4 is half a byte per texel.
+            const int levelTexels = math::Square(m_config.textureDimension);
+            const float savedMB = (float)(m_config.compressedLevels * levelTexels * (2 * m_config.HeightTexelSize() - 1)) / (2.f * 1024.f * 1024.f);
+            ImGui::Text("Levels %d-%d: BC4, saving %.2f MB", m_config.numLevels - m_config.compressedLevels, m_config.numLevels - 1, savedMB);
+            for (int level = m_config.numLevels - m_config.compressedLevels; level < m_config.numLevels; ++level)
+            {
+                ImGui::Text("Level %d: endpoint step %.1f mm", level, 1000.f * m_heightRanges[level].Scale() / 255.f);
+            }
+            ImGui::Text("Blocks encoded: %llu", m_compressionStats.numBlocks);
+            ImGui::Text("Uploaded:       %.2f MB", (float)m_compressionStats.uploadedBytes / (1024.f * 1024.f));
+        }
+
+        if (ImGui::CollapsingHeader("CPU Normals"))
+        {
+            if (ImGui::Button("Benchmark"))
+            {
+                BenchmarkCpuNormals();
+            }
+
+            const NormalsBenchmark& bench = m_normalsBenchmark;
+            ImGui::Text("Single threaded: %.1f Mtexels/s", bench.singleMtexelsPerSec);
+            ImGui::Text("Parallel:        %.1f Mtexels/s (%d threads)", bench.parallelMtexelsPerSec, bench.numThreads);
+            ImGui::Text("Max difference:  %g", bench.maxDifference);
+        }
+
+        if (ImGui::CollapsingHeader("Height Queries"))
+        {
+            if (ImGui::Button("Benchmark##HeightQueries"))
+            {
+                BenchmarkHeightQueries();
+            }
+
+            const HeightQueryBenchmark& bench = m_heightQueryBenchmark;
+            ImGui::Text("Queries per batch: %d", bench.numQueries);
+            ImGui::Text("Heights:           %.1f Mqueries/s", bench.mqueriesPerSec);
+            ImGui::Text("With normals:      %.1f Mqueries/s", bench.mqueriesPerSecWithNormals);
+        }
+
+        if (ImGui::CollapsingHeader("Mesh Extraction"))
+        {
+            ImGui::SliderFloat("Max Error", &m_meshExtractionMaxError, 0.f, 4.f);
+            if (ImGui::Button("Benchmark##MeshExtraction"))
+            {
+                BenchmarkMeshExtraction();
+            }
+
+            const MeshExtractionBenchmark& bench = m_meshExtractionBenchmark;
+            ImGui::Text("Area:      %dx%d tiles", bench.numTiles, bench.numTiles);
+            ImGui::Text("Build:     %.2f ms", bench.buildMs);
+            ImGui::Text("Extract:   %.2f ms", bench.extractMs);
+            ImGui::Text("Triangles: %d (%.1f%% of the grid's %d)", bench.numTriangles,
+                100.f * (float)bench.numTriangles / (float)std::max(bench.gridTriangles, 1), bench.gridTriangles);
+        }
+
+        if (ImGui::CollapsingHeader("Clipmap Rings"))
+        {
+            if (ImGui::Checkbox("Use Rings", &m_useRings))
+            {
+                // The other mode's bounds haven't been kept up to date.
+                m_patchBoundsDirty = true;
+            }
+
+            const int numLevels = m_clipmapRings.GetNumLevels();
+            const float outerSize = m_config.VertexPatchSize() * (float)(m_clipmapRings.GetLevelPatches() << (numLevels - 1));
+            ImGui::Text("Levels:    %d, %d patch blocks", numLevels, m_clipmapRings.GetBlockPatches());
+            ImGui::Text("Instances: %d", m_clipmapRings.GetNumInstances());
+            ImGui::Text("Patches:   %d (grid has %d)", m_clipmapRings.GetNumPatches(), math::Square(m_patchCuller.GetPatchesPerSide()));
+            ImGui::Text("Extent:    %.1f m", outerSize);
+        }
+
+        if (ImGui::CollapsingHeader("Patch Order"))
+        {
+            const char* orderNames[PatchOrder::Count] = { "Row Major", "Morton", "Hilbert" };
+            for (int order = 0; order < PatchOrder::Count; ++order)
+            {
+                if (ImGui::RadioButton(orderNames[order], m_patchOrder == order) && m_patchOrder != order)
+                {
+                    // The index buffers are rebuilt in place, so let the GPU finish with them first.
+                    m_patchOrder = (PatchOrder::E)order;
+                    renderer.WaitCurrentFrame();
+                    renderer.BeginUploads();
+                    BuildIndexBuffer(renderer);
+                    BuildRings(renderer);
+                    renderer.EndUploads();
+                }
+                ImGui::SameLine();
+            }
+            ImGui::NewLine();
+
+            if (ImGui::Button("Benchmark##PatchOrder"))
+            {
+                BenchmarkPatchOrders(renderer.GetViewProjMatrix());
+            }
+
+            // Post-transform cache misses per patch, for a FIFO cache of the given size. A regular grid can't go below one.
+            const PatchOrderBenchmark& bench = m_patchOrderBenchmark;
+            ImGui::Text("ACMR (ATVR), %d entry cache:", bench.cacheSize);
+            for (int order = 0; order < PatchOrder::Count; ++order)
+            {
+                ImGui::Text("%-9s  grid %.3f (%.2f)  view %.3f (%.2f)  rings %.3f (%.2f)", orderNames[order],
+                    bench.grid[order].acmr, bench.grid[order].atvr, bench.view[order].acmr, bench.view[order].atvr,
+                    bench.rings[order].acmr, bench.rings[order].atvr);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Tessellation"))
+        {
+            ImGui::Checkbox("Screen-Space Error", &m_screenSpaceErrorTess);
+            ImGui::SliderFloat("Pixel Error", &m_tessPixelError, 0.25f, 8.f);
+            if (ImGui::Button("Benchmark##Roughness"))
+            {
+                BenchmarkRoughness();
+            }
+
+            const RoughnessBenchmark& bench = m_roughnessBenchmark;
+            ImGui::Text("Rebuild: %.3f ms for %d cells", bench.rebuildMs, bench.numCells);
+            for (int level = 0; level < m_config.numLevels; ++level)
+            {
+                const RoughnessPyramid& roughness = m_clipmapLevels[level].roughness;
+                ImGui::Text("Level %d: max %.3f m", level, roughness.GetNode(roughness.GetNumLevels() - 1, Vec2iZero));
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Patch Culling"))
+        {
+            const int numPatches = m_useRings ? m_clipmapRings.GetNumPatches() : math::Square(m_patchCuller.GetPatchesPerSide());
+            ImGui::Checkbox("Cull Patches", &m_cullPatches);
+            ImGui::Text("View:   %d / %d patches, %d instances, %.3f ms", m_viewPatches.numPatches, numPatches, m_viewPatches.numInstances, m_viewPatches.cullMs);
+            for (int i = 0; i < renderer.GetNumShadowCascades(); ++i)
+            {
+                ImGui::Text("Shadow %d: %d / %d patches, %d instances, %.3f ms", i, m_shadowPatches[i].numPatches, numPatches,
+                    m_shadowPatches[i].numInstances, m_shadowPatches[i].cullMs);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Horizon Culling"))
+        {
+            if (ImGui::Checkbox("Horizon Culling", &m_horizonCulling))
+            {
+                // The occluder heights weren't kept up to date while it was off.
+                m_patchBoundsDirty = true;
+            }
+            const int numFrustumPatches = m_viewPatches.numPatches + m_viewPatches.numOccluded;
+            ImGui::Text("Occluded: %d / %d patches in the frustum (%.1f%%)", m_viewPatches.numOccluded, numFrustumPatches,
+                100.f * (float)m_viewPatches.numOccluded / (float)std::max(numFrustumPatches, 1));
+            ImGui::Text("Occluders: %d / %d cells, %d levels", m_numHorizonOccluders, m_horizonCuller.GetNumOccluders(), m_horizonCuller.GetNumLevels());
+            ImGui::Text("Build: %.3f ms", m_horizonBuildMs);
+        }
+
+        if (ImGui::CollapsingHeader("Occlusion Raster"))
+        {
+            if (ImGui::Checkbox("Occlusion Raster", &m_occlusionRaster))
+            {
+                m_patchBoundsDirty = true;
+            }
+            if (ImGui::Button("Benchmark##OcclusionRaster"))
+            {
+                BenchmarkOcclusionRaster(renderer.GetCamPos(), renderer.GetViewProjMatrix());
+            }
+
+            const OcclusionRasteriser::Stats& stats = m_occlusionRasteriser.GetStats();
+            ImGui::Text("Last frame: %.3f ms, %d / %d triangles, %d binned", m_occlusionRasterMs, stats.numRasterised, stats.numTriangles, stats.numBinned);
+            const OcclusionRasterBenchmark& bench = m_occlusionRasterBenchmark;
+            ImGui::Text("Rasterise: %.3f ms for %d / %d triangles at %dx%d", bench.rasteriseMs, bench.stats.numRasterised, bench.stats.numTriangles,
+                OcclusionBufferWidth, OcclusionBufferHeight);
+            ImGui::Text("Test: %.3f ms for %d boxes in the frustum", bench.testMs, bench.numBoxes);
+            ImGui::Text("Occluded: %d (%d by the horizon)", bench.numOccluded, bench.numHorizonOccluded);
+        }
+
+        if (ImGui::CollapsingHeader("Height Bounds"))
+        {
+            AABB3f bounds = GetResidentBounds();
+            ImGui::Text("Resident: [%.2f, %.2f]", bounds.m_min.y, bounds.m_max.y);
+            for (int level = 0; level < m_config.numLevels; ++level)
+            {
+                Vec2f levelBounds = m_clipmapLevels[level].bounds.GetBounds();
+                ImGui::Text("Level %d: [%.2f, %.2f]", level, levelBounds.x, levelBounds.y);
+            }
+        }
+
         if (ImGui::CollapsingHeader("Coordinates"))
         {
             Vec2f cursorPos = m_mappedConstantBuffers[0]->highlightPosXZ;
-            Vec2i globalCoords = WorldPosToGlobalCoords(cursorPos);
-            auto [tile, tileCoords] = WorldPosToTile(cursorPos, 0);
+            Vec2i globalCoords = m_config.WorldPosToGlobalCoords(cursorPos);
+            auto [tile, tileCoords] = m_config.WorldPosToTile(cursorPos, 0);
             ImGui::Text("Cursor Pos:    (%.2f, %.2f)", cursorPos.x, cursorPos.y);
             ImGui::Text("Global Coords: (%02d, %02d)", globalCoords.x, globalCoords.y);
             ImGui::Text("Tile:          (%02d, %02d)", tile.x, tile.y);
@@ -1012,112 +1343,239 @@ void Terrain::CreateConstantBuffers(Renderer& renderer)
     m_heightmapSamplerDescIndex = renderer.AllocateSampler(samplerDesc);
 }
 
+void Terrain::CreateRoughnessBuffers(Renderer& renderer)
+{
+    // Small enough to rewrite whole whenever anything changes.
+    const size_t dataSize = m_config.numLevels * m_clipmapLevels[0].roughness.GetNodes().size() * sizeof(float);
+    for (int i = 0; i < BackbufferCount; ++i)
+    {
+        m_roughnessBuffers[i] = renderer.CreateUploadBuffer(dataSize);
+        Assert(m_roughnessBuffers[i]);
+
+        D3D12_RANGE readRange = {};
+        m_roughnessBuffers[i]->Map(0, &readRange, (void**)&m_mappedRoughness[i]);
+        Assert(m_mappedRoughness[i]);
+        memset(m_mappedRoughness[i], 0, dataSize);
+    }
+    m_roughnessDirtyFrames = BackbufferCount;
+}
+
 void Terrain::BuildIndexBuffer(Renderer& renderer)
 {
-    size_t dataSize = IndexBufferLength * sizeof(uint16);
-    ID3D12Resource* uploadBuffer = nullptr;
-    m_indexBuffer.buffer = renderer.CreateBuffer(uploadBuffer, dataSize);
+    // Only use 32 bit indices if the vertex grid is too big for 16 bit ones.
+    bool largeIndices = m_config.NeedsLargeIndices();
+    size_t indexSize = largeIndices ? sizeof(uint32) : sizeof(uint16);
+    size_t dataSize = m_config.IndexBufferLength() * indexSize;
+    UploadAllocation upload;
+    m_indexBuffer.buffer = renderer.CreateBuffer(upload, dataSize);
     m_indexBuffer.view.BufferLocation = m_indexBuffer.buffer->GetGPUVirtualAddress();
-    m_indexBuffer.view.Format = DXGI_FORMAT_R16_UINT;
+    m_indexBuffer.view.Format = largeIndices ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
     m_indexBuffer.view.SizeInBytes = (UINT)dataSize;
 
-    uint16* indexData = nullptr;
-    uploadBuffer->Map(0, nullptr, (void**)&indexData);
-    Assert(indexData);
+    // The culler decides the patch order, so the full list and the culled ones share it.
+    m_patchCuller.Init(m_config.vertexGridDimension, ToVertexPos(0, 0), m_config.VertexPatchSize(), m_patchOrder);
+    if (largeIndices)
+    {
+        m_patchCuller.WriteAllIndices((uint32*)upload.cpuAddress);
+    }
+    else
+    {
+        m_patchCuller.WriteAllIndices((uint16*)upload.cpuAddress);
+    }
+
+    ID3D12GraphicsCommandList& commandList = renderer.GetCopyCommandList();
+    commandList.CopyBufferRegion(m_indexBuffer.buffer.Get(), 0, upload.buffer, upload.offset, dataSize);
 
-    // Build quad patches.
-    for (int z = 0; z < VertexGridDimension; ++z)
+    // The culled index lists are rewritten every frame, so they live in upload memory, one per pass and frame in flight.
+    BuildVisiblePatchIndexBuffers(renderer, m_viewPatches);
+    for (VisiblePatches& patches : m_shadowPatches)
     {
-        for (int x = 0; x < VertexGridDimension; ++x)
-        {
-            uint16* p = &indexData[4 * ((VertexGridDimension - 1) * z + x)];
-            p[0] = VertexGridDimension * (z + 0) + (x + 0);
-            p[1] = VertexGridDimension * (z + 0) + (x + 1);
-            p[2] = VertexGridDimension * (z + 1) + (x + 0);
-            p[3] = VertexGridDimension * (z + 1) + (x + 1);
-        }
+        BuildVisiblePatchIndexBuffers(renderer, patches);
     }
+    m_patchBoundsDirty = true;
+}
 
-    uploadBuffer->Unmap(0, nullptr);
+void Terrain::BuildVisiblePatchIndexBuffers(Renderer& renderer, VisiblePatches& outPatches)
+{
+    const bool largeIndices = m_config.NeedsLargeIndices();
+    const size_t dataSize = m_config.IndexBufferLength() * (largeIndices ? sizeof(uint32) : sizeof(uint16));
+    for (int i = 0; i < BackbufferCount; ++i)
+    {
+        IndexBuffer& indexBuffer = outPatches.indexBuffers[i];
+        indexBuffer.buffer = renderer.CreateUploadBuffer(dataSize);
+        indexBuffer.view.BufferLocation = indexBuffer.buffer->GetGPUVirtualAddress();
+        indexBuffer.view.Format = largeIndices ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+        indexBuffer.view.SizeInBytes = (UINT)dataSize;
 
-    ID3D12GraphicsCommandList& commandList = renderer.GetCopyCommandList();
-    commandList.CopyBufferRegion(m_indexBuffer.buffer.Get(), 0, uploadBuffer, 0, dataSize);
+        D3D12_RANGE readRange = {};
+        indexBuffer.buffer->Map(0, &readRange, &outPatches.mappedIndices[i]);
+        Assert(outPatches.mappedIndices[i]);
+    }
 }
 
 void Terrain::BuildVertexBuffer(Renderer& renderer)
 {
-    size_t dataSize = VertexBufferLength * sizeof(TerrainVertex);
-    ID3D12Resource* uploadBuffer = nullptr;
-    m_vertexBuffer.buffer = renderer.CreateBuffer(uploadBuffer, dataSize);
+    size_t dataSize = m_config.VertexBufferLength() * sizeof(TerrainVertex);
+    UploadAllocation upload;
+    m_vertexBuffer.buffer = renderer.CreateBuffer(upload, dataSize);
     m_vertexBuffer.view.BufferLocation = m_vertexBuffer.buffer->GetGPUVirtualAddress();
     m_vertexBuffer.view.SizeInBytes = (UINT)dataSize;
     m_vertexBuffer.view.StrideInBytes = sizeof(TerrainVertex);
 
-    // Map buffer and fill in vertex data.
-    TerrainVertex* vertexData = nullptr;
-    uploadBuffer->Map(0, nullptr, (void**)&vertexData);
-    Assert(vertexData);
+    // Fill in vertex data. The upload memory is already mapped.
+    TerrainVertex* vertexData = (TerrainVertex*)upload.cpuAddress;
 
-    for (int z = 0; z < VertexGridDimension; ++z)
+    // Positions are in patches, so this is ToVertexPos() without the patch size.
+    const float halfGrid = 0.5f * (float)(m_config.vertexGridDimension - 1);
+    for (int z = 0; z < m_config.vertexGridDimension; ++z)
     {
-        for (int x = 0; x < VertexGridDimension; ++x)
+        for (int x = 0; x < m_config.vertexGridDimension; ++x)
         {
-            TerrainVertex& v = vertexData[VertexIndex(x, z)];
-            v.pos = ToVertexPos(x, z);
+            TerrainVertex& v = vertexData[m_config.VertexIndex(x, z)];
+            v.pos = Vec2f((float)x - halfGrid, (float)z - halfGrid);
         }
     }
 
-    uploadBuffer->Unmap(0, nullptr);
-
     // Upload initial data to both buffers.
     ID3D12GraphicsCommandList& commandList = renderer.GetCopyCommandList();
-    commandList.CopyBufferRegion(m_vertexBuffer.buffer.Get(), 0, uploadBuffer, 0, dataSize);
+    commandList.CopyBufferRegion(m_vertexBuffer.buffer.Get(), 0, upload.buffer, upload.offset, dataSize);
 }
 
-void Terrain::BuildWater(Renderer& renderer)
+void Terrain::BuildRings(Renderer& renderer)
 {
-    const float HalfGridSizeX = 0.5f * VertexPatchSize * (float)(VertexGridDimension - 1);
-    const float HalfGridSizeZ = 0.5f * VertexPatchSize * (float)(VertexGridDimension - 1);
-    const WaterVertex WaterVerts[] = {
-        { { -HalfGridSizeX, 0.f, -HalfGridSizeZ }, Vec3fY, { 0x20, 0x70, 0xff, 0x80 } },
-        { { -HalfGridSizeX, 0.f,  HalfGridSizeZ }, Vec3fY, { 0x20, 0x70, 0xff, 0x80 } },
-        { {  HalfGridSizeX, 0.f,  HalfGridSizeZ }, Vec3fY, { 0x20, 0x70, 0xff, 0x80 } },
-        { {  HalfGridSizeX, 0.f, -HalfGridSizeZ }, Vec3fY, { 0x20, 0x70, 0xff, 0x80 } },
+    m_clipmapRings.Init(m_config.ringBlockPatches, m_config.NumRingLevels());
+
+    // Each piece is a small grid of patches like the main one, built once and drawn instanced wherever the rings put it.
+    std::vector<TerrainVertex> vertices;
+    std::vector<uint16> indices;
+    for (int piece = 0; piece < RingPiece::Count; ++piece)
+    {
+        const Vec2i size = m_clipmapRings.GetPieceSize((RingPiece::E)piece);
+        Assert((size.x + 1) * (size.y + 1) <= (1 << 16));
+        RingPieceMesh& mesh = m_ringPieceMeshes[piece];
+        mesh.firstIndex = (int)indices.size();
+        mesh.baseVertex = (int)vertices.size();
+        for (int z = 0; z <= size.y; ++z)
+        {
+            for (int x = 0; x <= size.x; ++x)
+            {
+                vertices.push_back({ Vec2f((float)x, (float)z) });
+            }
+        }
+
+        WriteRingPieceIndices(size, m_patchOrder, indices);
+        mesh.numIndices = (int)indices.size() - mesh.firstIndex;
+    }
+
+    m_ringVertexBuffer = renderer.CreateVertexBuffer(Span<const uchar>((const uchar*)vertices.data(), vertices.size() * sizeof(TerrainVertex)), sizeof(TerrainVertex));
+    m_ringIndexBuffer = renderer.CreateIndexBuffer(Span<const uchar>((const uchar*)indices.data(), indices.size() * sizeof(uint16)), DXGI_FORMAT_R16_UINT);
+
+    const TerrainInstance gridInstance[] = { { Vec2fZero, 1.f, 0.f } };
+    m_gridInstanceBuffer = renderer.CreateVertexBuffer(MakeConstUCharSpan(gridInstance), sizeof(TerrainInstance));
+
+    // Like the culled index lists, each pass's surviving instances are rewritten every frame.
+    const size_t instanceDataSize = m_clipmapRings.GetNumInstances() * sizeof(TerrainInstance);
+    auto buildInstanceBuffers = [&](VisiblePatches& patches)
+    {
+        for (int i = 0; i < BackbufferCount; ++i)
+        {
+            VertexBuffer& instanceBuffer = patches.instanceBuffers[i];
+            instanceBuffer.buffer = renderer.CreateUploadBuffer(instanceDataSize);
+            instanceBuffer.view.BufferLocation = instanceBuffer.buffer->GetGPUVirtualAddress();
+            instanceBuffer.view.SizeInBytes = (UINT)instanceDataSize;
+            instanceBuffer.view.StrideInBytes = sizeof(TerrainInstance);
+
+            D3D12_RANGE readRange = {};
+            instanceBuffer.buffer->Map(0, &readRange, &patches.mappedInstances[i]);
+            Assert(patches.mappedInstances[i]);
+        }
     };
 
+    buildInstanceBuffers(m_viewPatches);
+    for (VisiblePatches& patches : m_shadowPatches)
+    {
+        buildInstanceBuffers(patches);
+    }
+    m_patchBoundsDirty = true;
+}
+
+void Terrain::BuildWater(Renderer& renderer)
+{
+    // The corners are written by UpdateWater() each frame.
+    for (int i = 0; i < BackbufferCount; ++i)
+    {
+        VertexBuffer& vertexBuffer = m_waterVertexBuffers[i];
+        vertexBuffer.buffer = renderer.CreateUploadBuffer(4 * sizeof(WaterVertex));
+        vertexBuffer.view.BufferLocation = vertexBuffer.buffer->GetGPUVirtualAddress();
+        vertexBuffer.view.SizeInBytes = 4 * sizeof(WaterVertex);
+        vertexBuffer.view.StrideInBytes = sizeof(WaterVertex);
+
+        D3D12_RANGE readRange = {};
+        vertexBuffer.buffer->Map(0, &readRange, (void**)&m_mappedWaterVertices[i]);
+        Assert(m_mappedWaterVertices[i]);
+    }
+
     const uint16 WaterIndices[] = {
         0, 1, 2,
         0, 2, 3
     };
 
-    m_waterVertexBuffer.buffer = renderer.CreateBuffer(sizeof(WaterVerts), WaterVerts);
-    m_waterVertexBuffer.view.BufferLocation = m_waterVertexBuffer.buffer->GetGPUVirtualAddress();
-    m_waterVertexBuffer.view.SizeInBytes = sizeof(WaterVerts);
-    m_waterVertexBuffer.view.StrideInBytes = sizeof(WaterVertex);
-
     m_waterIndexBuffer.buffer = renderer.CreateBuffer(sizeof(WaterIndices), WaterIndices);
     m_waterIndexBuffer.view.BufferLocation = m_waterIndexBuffer.buffer->GetGPUVirtualAddress();
     m_waterIndexBuffer.view.Format = DXGI_FORMAT_R16_UINT;
     m_waterIndexBuffer.view.SizeInBytes = sizeof(WaterIndices);
 }
 
+void Terrain::UpdateWater(Renderer& renderer)
+{
+    // Cover whatever terrain is drawn: the outermost ring level, or the grid.
+    const float patchSize = m_config.VertexPatchSize();
+    Vec2f waterMin, waterMax;
+    if (m_useRings)
+    {
+        const int outerLevel = m_clipmapRings.GetNumLevels() - 1;
+        waterMin = Vec2f(m_clipmapRings.GetLevelMin(outerLevel)) * patchSize;
+        waterMax = waterMin + Vec2f(patchSize * (float)(m_clipmapRings.GetLevelPatches() << outerLevel));
+    }
+    else
+    {
+        const float halfGridSize = 0.5f * patchSize * (float)(m_config.vertexGridDimension - 1);
+        waterMin = Vec2f(-halfGridSize);
+        waterMax = Vec2f(halfGridSize);
+    }
+
+    const Vec4u8 colour(0x20, 0x70, 0xff, 0x80);
+    WaterVertex* vertices = m_mappedWaterVertices[renderer.GetCurrentBuffer()];
+    vertices[0] = { Vec3f(waterMin.x, 0.f, waterMin.y), Vec3fY, colour };
+    vertices[1] = { Vec3f(waterMin.x, 0.f, waterMax.y), Vec3fY, colour };
+    vertices[2] = { Vec3f(waterMax.x, 0.f, waterMax.y), Vec3fY, colour };
+    vertices[3] = { Vec3f(waterMax.x, 0.f, waterMin.y), Vec3fY, colour };
+}
+
 float Terrain::GetHeight(Vec2i levelGlobalCoords, int level) const
 {
     // Check if there is a modification at this position.
-    auto [tile, tileCoords] = LevelGlobalCoordsToTile(levelGlobalCoords);
+    auto [tile, tileCoords] = m_config.LevelGlobalCoordsToTile(levelGlobalCoords);
     auto it = m_tileCaches[level].find(tile);
     if (it != m_tileCaches[level].end())
     {
-        return it->second[TileIndex(tileCoords.x, tileCoords.y)];
+        return it->second[m_config.TileIndex(tileCoords.x, tileCoords.y)];
     }
 
     return GenerateHeight(levelGlobalCoords, level);
 }
 
 float Terrain::GenerateHeight(Vec2i levelGlobalCoords, int level) const
+{
+    float height;
+    GenerateHeights(levelGlobalCoords, 1, level, &height);
+    return height;
+}
+
+void Terrain::GenerateHeights(Vec2i levelGlobalStart, int count, int level, float* heights) const
 {
     // Scale back up to global coords.
-    Vec2i globalCoords = (levelGlobalCoords << level);
+    Vec2i globalCoords = (levelGlobalStart << level);
 
     // Offset to get the centre of this bigger texel.
     if (level > 1)
@@ -1125,79 +1583,1124 @@ float Terrain::GenerateHeight(Vec2i levelGlobalCoords, int level) const
         globalCoords += (Vec2i(1, 1) << (level - 1));
     }
 
-    // If not, generate a height from the noise.
-
-    // Additional offset to get the centre of the texel.
-    Vec2f fGlobalCoords(globalCoords);
-    if (level > 0)
-    {
-        fGlobalCoords += Vec2f(0.5f, 0.5f);
-    }
-
-    float height = m_baseHeight;
-
     // Offset perlin seeds for each type of noise.
     const int ridgeBaseSeed = 0x1000;
     const int ridgeWhiteBaseSeed = 0x2000;
 
-    // Calculate a multiplier for the ridge noise, based on normal white noise.
-    float ridgeNoiseMultiplier = 1.f;
-    for (int i = 0; i < (int)std::size(m_ridgeNoiseMultiplierParams); ++i)
-    {
-        auto [frequency, amplitude] = m_ridgeNoiseMultiplierParams[i];
-        ridgeNoiseMultiplier += amplitude * stb_perlin_noise3_seed(globalCoords.x * frequency, 0.f, globalCoords.y * frequency, 0, 0, 0, m_seed + ridgeWhiteBaseSeed + i);
-    }
-    
-    // Do ridge noise to approximate mountain ranges.
-    for (int i = 0; i < (int)std::size(m_ridgeNoiseParams); ++i)
+    // Consecutive samples in the span are a whole level texel apart in global coords.
+    const int step = 1 << level;
+    for (int sample = 0; sample < count; ++sample, globalCoords.x += step)
     {
-        auto [frequency, amplitude] = m_ridgeNoiseParams[i];
-        height += ridgeNoiseMultiplier * amplitude * (1.f - fabsf(stb_perlin_noise3_seed(globalCoords.x * frequency, 0.f, globalCoords.y * frequency, 0, 0, 0, m_seed + ridgeBaseSeed + i)));
-    }
+        float height = m_baseHeight;
 
-    // Apply regular white noise on top.
-    for (int i = 0; i < (int)std::size(m_whiteNoiseParams); ++i)
-    {
-        auto [frequency, amplitude] = m_whiteNoiseParams[i];
-        height += amplitude * stb_perlin_noise3_seed(globalCoords.x * frequency, 0.f, globalCoords.y * frequency, 0, 0, 0, m_seed + i);
-    }
+        // Calculate a multiplier for the ridge noise, based on normal white noise.
+        float ridgeNoiseMultiplier = 1.f;
+        for (int i = 0; i < (int)std::size(m_ridgeNoiseMultiplierParams); ++i)
+        {
+            auto [frequency, amplitude] = m_ridgeNoiseMultiplierParams[i];
+            ridgeNoiseMultiplier += amplitude * stb_perlin_noise3_seed(globalCoords.x * frequency, 0.f, globalCoords.y * frequency, 0, 0, 0, m_seed + ridgeWhiteBaseSeed + i);
+        }
 
-    return height;
+        // Do ridge noise to approximate mountain ranges.
+        for (int i = 0; i < (int)std::size(m_ridgeNoiseParams); ++i)
+        {
+            auto [frequency, amplitude] = m_ridgeNoiseParams[i];
+            height += ridgeNoiseMultiplier * amplitude * (1.f - fabsf(stb_perlin_noise3_seed(globalCoords.x * frequency, 0.f, globalCoords.y * frequency, 0, 0, 0, m_seed + ridgeBaseSeed + i)));
+        }
+
+        // Apply regular white noise on top.
+        for (int i = 0; i < (int)std::size(m_whiteNoiseParams); ++i)
+        {
+            auto [frequency, amplitude] = m_whiteNoiseParams[i];
+            height += amplitude * stb_perlin_noise3_seed(globalCoords.x * frequency, 0.f, globalCoords.y * frequency, 0, 0, 0, m_seed + i);
+        }
+
+        heights[sample] = height;
+    }
 }
 
 Vec2f Terrain::ToVertexPos(int globalX, int globalZ)
 {
+    const float patchSize = m_config.VertexPatchSize();
+    const float halfGrid = 0.5f * (float)(m_config.vertexGridDimension - 1);
     return Vec2f(
-        VertexPatchSize * ((float)globalX - 0.5f * (float)(VertexGridDimension - 1)),
-        VertexPatchSize * ((float)globalZ - 0.5f * (float)(VertexGridDimension - 1)));
+        patchSize * ((float)globalX - halfGrid),
+        patchSize * ((float)globalZ - halfGrid));
 }
 
 Vec2i Terrain::CalcClipmapTexelOffset(const Vec3f& camPos) const
 {
     // Find how many (whole) texels at level 0 in world space we are from the origin.
     // TODO: Store the previous transition direction and fudge to prevent unnecessary jitter.
-    return WorldPosToGlobalCoords(Vec2f(camPos.x, camPos.z));
+    return m_config.WorldPosToGlobalCoords(Vec2f(camPos.x, camPos.z));
+}
+
+void Terrain::UpdateResidentHeights(int level, Vec2i levelGlobalMin, Vec2i levelGlobalMax)
+{
+    // Fill in the CPU copy of a piece of the level (that doesn't wrap), then the bounds above it.
+    // Generating noise is the expensive part, so spread the rows across the thread pool. Callers hold the tile lock, so the caches are safe to read.
+    ClipmapLevel& levelData = m_clipmapLevels[level];
+    const Vec2i texMin = m_clipmapUpdater.WrapCoords(levelGlobalMin);
+    const Vec2i size = levelGlobalMax - levelGlobalMin;
+    ThreadPool::Instance().ParallelFor(size.y, [&](int z)
+    {
+        ReadHeights(level, levelGlobalMin + Vec2i(0, z), size.x, &levelData.heights[m_config.HeightmapIndex(texMin + Vec2i(0, z))]);
+    });
+
+    levelData.bounds.Update(levelData.heights.data(), m_config.textureDimension, texMin, texMin + size);
+    levelData.roughness.Update(levelData.heights.data(), m_config.textureDimension, texMin, texMin + size);
+    m_roughnessDirtyFrames = BackbufferCount;
+}
+
+void Terrain::WriteUploadStrip(uint8* strip, int rowPitch, int level, Vec2i texMin, Vec2i texMax, float& inOutLow, float& inOutHigh) const
+{
+    // The upload memory is write-combined, so fill the strip sequentially from the CPU copy of the level.
+    // Compact heights are encoded a row at a time.
+    const std::vector<float>& heights = m_clipmapLevels[level].heights;
+    const int width = texMax.x - texMin.x;
+    for (int z = texMin.y; z < texMax.y; ++z)
+    {
+        uint8* row = strip + rowPitch * (z - texMin.y);
+        const float* src = &heights[m_config.HeightmapIndex(texMin.x, z)];
+        if (m_config.compactHeights)
+        {
+            EncodeHeightsUnorm16((uint16*)row, src, width, m_heightRanges[level], inOutLow, inOutHigh);
+        }
+        else
+        {
+            memcpy(row, src, width * sizeof(float));
+        }
+    }
+}
+
+void Terrain::ReadHeights(int level, Vec2i levelGlobalStart, int count, float* heights) const
+{
+    // Read in tile-aligned spans so that each tile is only looked up once per span.
+    const int tileDimension = m_config.tileDimension;
+    Assert((m_config.textureDimension / 2) % tileDimension == 0); // Clipmap offset must be tile aligned.
+    const Vec2i clipmapOffset = m_config.TextureSize() / 2;
+    const auto& tileCache = m_tileCaches[level];
+    for (int x = levelGlobalStart.x; x < levelGlobalStart.x + count;)
+    {
+        // Offset input coords back since clipmap tiling is centred at the origin.
+        Vec2i levelGlobalCoords = Vec2i(x, levelGlobalStart.y) - clipmapOffset;
+        auto [tile, tileCoords] = m_config.LevelGlobalCoordsToTile(levelGlobalCoords);
+        int spanCount = std::min(levelGlobalStart.x + count - x, tileDimension - tileCoords.x);
+        float* dst = heights + (x - levelGlobalStart.x);
+
+        auto it = tileCache.find(tile);
+        if (it != tileCache.end())
+        {
+            memcpy(dst, &it->second[m_config.TileIndex(tileCoords)], spanCount * sizeof(float));
+        }
+        else
+        {
+            GenerateHeights(levelGlobalCoords, spanCount, level, dst);
+        }
+
+        x += spanCount;
+    }
+}
+
+void Terrain::WriteCompressedUploadStrip(uint8* strip, int rowPitch, int level, Vec2i texMin, Vec2i texMax, float& inOutLow, float& inOutHigh)
+{
+    // Whole blocks can include texels outside the written region; the CPU copy of the level already has those.
+    const std::vector<float>& levelHeights = m_clipmapLevels[level].heights;
+    const HeightRange range = m_heightRanges[level];
+    const float invScale = 1.f / range.Scale();
+    const int width = texMax.x - texMin.x;
+    const int numBlockRows = (texMax.y - texMin.y) / BlockDimension;
+    const BlockCompressionQuality::E quality = m_compressionQuality;
+
+    // Each block row is independent, so spread them across the thread pool.
+    std::vector<Vec2f> blockRowRanges(numBlockRows, Vec2f(FLT_MAX, -FLT_MAX));
+    ThreadPool::Instance().ParallelFor(numBlockRows, [&](int blockRow)
+    {
+        std::vector<float> heights(BlockDimension * width);
+        Vec2f& rowRange = blockRowRanges[blockRow];
+        for (int z = 0; z < BlockDimension; ++z)
+        {
+            const float* src = &levelHeights[m_config.HeightmapIndex(texMin.x, texMin.y + BlockDimension * blockRow + z)];
+            float* dst = &heights[width * z];
+            for (int x = 0; x < width; ++x)
+            {
+                rowRange.x = std::min(rowRange.x, src[x]);
+                rowRange.y = std::max(rowRange.y, src[x]);
+                dst[x] = (src[x] - range.min) * invScale;
+            }
+        }
+
+        EncodeBC4(heights.data(), width, width, BlockDimension, false, quality, strip + rowPitch * blockRow, rowPitch);
+    });
+
+    for (const Vec2f& rowRange : blockRowRanges)
+    {
+        inOutLow = std::min(inOutLow, rowRange.x);
+        inOutHigh = std::max(inOutHigh, rowRange.y);
+    }
+    m_compressionStats.numBlocks += (uint64)numBlockRows * (width / BlockDimension);
+}
+
+AABB3f Terrain::GetResidentBounds() const
+{
+    // The coarsest level covers the most ground, but its heights are averaged, so take the extremes over every level.
+    const int coarsest = m_config.numLevels - 1;
+    Vec2f heightBounds(FLT_MAX, -FLT_MAX);
+    for (int level = 0; level < m_config.numLevels; ++level)
+    {
+        Vec2f levelBounds = m_clipmapLevels[level].bounds.GetBounds();
+        heightBounds.x = std::min(heightBounds.x, levelBounds.x);
+        heightBounds.y = std::max(heightBounds.y, levelBounds.y);
+    }
+
+    // Level global coords are offset by half the texture, since clipmap tiling is centred at the origin.
+    const float coarsestTexelSize = m_config.texelSize * float(1 << coarsest);
+    Vec2f minXZ = Vec2f((m_clipmapTexelOffset >> coarsest) - m_config.TextureSize() / 2) * coarsestTexelSize;
+    Vec2f maxXZ = minXZ + Vec2f(m_config.TextureSize()) * coarsestTexelSize;
+    return { Vec3f(minXZ.x, heightBounds.x, minXZ.y), Vec3f(maxXZ.x, heightBounds.y, maxXZ.y) };
 }
 
-void Terrain::WriteIntermediateTextureData(float* mappedHeights, int level, Vec2i levelGlobalMin, Vec2i levelGlobalMax)
+bool Terrain::Raycast(const Rayf& ray, float& outDistance) const
 {
-    // TODO: We don't really need to address this buffer as if it were the actual texture;
-    // we could just write to the start of it every time or use a ring buffer.
-    // Is a buffer even appropriate or should it be a texture (and use WriteToSubresource instead)?
-    for (int z = levelGlobalMin.y; z < levelGlobalMax.y; ++z)
+    // Each level covers a square centred (give or take a texel) inside the next level's. Split the ray into the parts
+    // each level covers that a finer level doesn't, then search them in order along the ray so the first hit is the nearest.
+    struct Segment
+    {
+        float tMin;
+        float tMax;
+        int level;
+    };
+
+    Segment segments[2 * MaxClipLevels];
+    int numSegments = 0;
+    float finerMin = FLT_MAX;
+    float finerMax = -FLT_MAX;
+    for (int level = 0; level < m_config.numLevels; ++level)
     {
-        for (int x = levelGlobalMin.x; x < levelGlobalMax.x; ++x)
+        Vec3f origin, dir;
+        ToLevelTexelSpace(level, ray, origin, dir);
+        float tMin = 0.f;
+        float tMax = ray.m_length;
+        if (!ClipRayToHeightfield(GetResidentHeightfield(level), origin, dir, tMin, tMax))
+            continue;
+
+        if (finerMin > finerMax)
+        {
+            segments[numSegments++] = { tMin, tMax, level };
+        }
+        else
         {
-            Vec2i levelGlobalCoords = Vec2i(x, z);
-            Vec2i texCoords = WrapHeightmapCoords(levelGlobalCoords);
+            if (tMin < finerMin)
+            {
+                segments[numSegments++] = { tMin, std::min(tMax, finerMin), level };
+            }
+            if (tMax > finerMax)
+            {
+                segments[numSegments++] = { std::max(tMin, finerMax), tMax, level };
+            }
+        }
+        finerMin = std::min(finerMin, tMin);
+        finerMax = std::max(finerMax, tMax);
+    }
 
-            // Offset input coords back since clipmap tiling is centred at the origin.
-            levelGlobalCoords -= Vec2i(HeightmapDimension, HeightmapDimension) / 2;
+    std::sort(segments, segments + numSegments, [](const Segment& a, const Segment& b) { return a.tMin < b.tMin; });
+    for (int i = 0; i < numSegments; ++i)
+    {
+        Vec3f origin, dir;
+        ToLevelTexelSpace(segments[i].level, ray, origin, dir);
+        if (RaycastHeightfield(GetResidentHeightfield(segments[i].level), origin, dir, segments[i].tMin, segments[i].tMax, outDistance))
+            return true;
+    }
+    return false;
+}
 
-            int idx = HeightmapIndex(texCoords);
-            mappedHeights[idx] = GetHeight(levelGlobalCoords, level);
+void Terrain::Raycast(const Span<const Rayf>& rays, const Span<float>& outDistances) const
+{
+    Assert(rays.Size() == outDistances.Size());
+    constexpr int RaysPerJob = 64;
+    int numJobs = ((int)rays.Size() + RaysPerJob - 1) / RaysPerJob;
+    ThreadPool::Instance().ParallelFor(numJobs, [&](int job)
+    {
+        int end = std::min((job + 1) * RaysPerJob, (int)rays.Size());
+        for (int i = job * RaysPerJob; i < end; ++i)
+        {
+            if (!Raycast(rays[i], outDistances[i]))
+            {
+                outDistances[i] = FLT_MAX;
+            }
+        }
+    });
+}
+
+bool Terrain::SweepSphere(const Spheref& sphere, const Vec3f& delta, SweepHit& outHit) const
+{
+    std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+    return SweepSphereLocked(sphere, delta, outHit);
+}
+
+bool Terrain::SweepCapsule(const Capsulef& capsule, const Vec3f& delta, SweepHit& outHit) const
+{
+    std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+    return SweepCapsuleLocked(capsule, delta, outHit);
+}
+
+void Terrain::SweepSpheres(const Span<const Spheref>& spheres, const Span<const Vec3f>& deltas, const Span<SweepHit>& outHits) const
+{
+    Assert(deltas.Size() == spheres.Size() && outHits.Size() == spheres.Size());
+
+    // The jobs only read the tile caches, so one lock held by the caller covers them all.
+    std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+    constexpr int SweepsPerJob = 64;
+    int numJobs = ((int)spheres.Size() + SweepsPerJob - 1) / SweepsPerJob;
+    ThreadPool::Instance().ParallelFor(numJobs, [&](int job)
+    {
+        int end = std::min((job + 1) * SweepsPerJob, (int)spheres.Size());
+        for (int i = job * SweepsPerJob; i < end; ++i)
+        {
+            if (!SweepSphereLocked(spheres[i], deltas[i], outHits[i]))
+            {
+                outHits[i] = SweepHit();
+            }
+        }
+    });
+}
+
+void Terrain::SweepCapsules(const Span<const Capsulef>& capsules, const Span<const Vec3f>& deltas, const Span<SweepHit>& outHits) const
+{
+    Assert(deltas.Size() == capsules.Size() && outHits.Size() == capsules.Size());
+    std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+    constexpr int SweepsPerJob = 64;
+    int numJobs = ((int)capsules.Size() + SweepsPerJob - 1) / SweepsPerJob;
+    ThreadPool::Instance().ParallelFor(numJobs, [&](int job)
+    {
+        int end = std::min((job + 1) * SweepsPerJob, (int)capsules.Size());
+        for (int i = job * SweepsPerJob; i < end; ++i)
+        {
+            if (!SweepCapsuleLocked(capsules[i], deltas[i], outHits[i]))
+            {
+                outHits[i] = SweepHit();
+            }
+        }
+    });
+}
+
+bool Terrain::SweepSphereLocked(const Spheref& sphere, const Vec3f& delta, SweepHit& outHit) const
+{
+    // Sweeps work relative to level global texel (0, 0) of the level.
+    const Vec3f extent(sphere.m_radius);
+    Vec3f boundsMin = math::min(sphere.m_centre, sphere.m_centre + delta) - extent;
+    Vec3f boundsMax = math::max(sphere.m_centre, sphere.m_centre + delta) + extent;
+    int level = FindSweepLevel(boundsMin, boundsMax);
+    static thread_local GatheredHeightfield threadGathered;
+    GatheredHeightfield& gathered = threadGathered;
+    GatherSweepHeightfield(level, boundsMin, boundsMax, gathered);
+
+    Vec3f offset = GetLevelSweepOffset(level);
+    if (!SweepSphereHeightfield(gathered.heightfield, m_config.texelSize * float(1 << level), Spheref(sphere.m_centre + offset, sphere.m_radius), delta, outHit))
+        return false;
+
+    outHit.point -= offset;
+    return true;
+}
+
+bool Terrain::SweepCapsuleLocked(const Capsulef& capsule, const Vec3f& delta, SweepHit& outHit) const
+{
+    const Vec3f extent(capsule.m_radius);
+    Vec3f boundsMin = math::min(capsule.m_start, capsule.m_end) - extent;
+    Vec3f boundsMax = math::max(capsule.m_start, capsule.m_end) + extent;
+    boundsMin = math::min(boundsMin, boundsMin + delta);
+    boundsMax = math::max(boundsMax, boundsMax + delta);
+    int level = FindSweepLevel(boundsMin, boundsMax);
+    static thread_local GatheredHeightfield threadGathered;
+    GatheredHeightfield& gathered = threadGathered;
+    GatherSweepHeightfield(level, boundsMin, boundsMax, gathered);
+
+    Vec3f offset = GetLevelSweepOffset(level);
+    Capsulef levelCapsule(capsule.m_start + offset, capsule.m_end + offset, capsule.m_radius);
+    if (!SweepCapsuleHeightfield(gathered.heightfield, m_config.texelSize * float(1 << level), levelCapsule, delta, outHit))
+        return false;
+
+    outHit.point -= offset;
+    return true;
+}
+
+bool Terrain::HasLineOfSight(const Vec3f& from, const Vec3f& to) const
+{
+    // Anything touching the terrain right at the end point (such as a target standing on it) doesn't count as blocking.
+    constexpr float EndTolerance = 1e-3f;
+    Vec3f delta = to - from;
+    float distance = math::length(delta);
+    if (distance <= EndTolerance)
+        return true;
+
+    float hitDistance;
+    return !Raycast(Rayf(from, delta / distance, distance - EndTolerance), hitDistance);
+}
+
+void Terrain::HasLineOfSight(const Span<const Vec3f>& from, const Span<const Vec3f>& to, const Span<bool>& outVisible) const
+{
+    Assert(to.Size() == from.Size() && outVisible.Size() == from.Size());
+    constexpr int QueriesPerJob = 64;
+    int numJobs = ((int)from.Size() + QueriesPerJob - 1) / QueriesPerJob;
+    ThreadPool::Instance().ParallelFor(numJobs, [&](int job)
+    {
+        int end = std::min((job + 1) * QueriesPerJob, (int)from.Size());
+        for (int i = job * QueriesPerJob; i < end; ++i)
+        {
+            outVisible[i] = HasLineOfSight(from[i], to[i]);
+        }
+    });
+}
+
+void Terrain::TestOcclusion(const Span<const AABB3f>& boxes, const Span<bool>& outOccluded) const
+{
+    Assert(outOccluded.Size() == boxes.Size());
+    if (m_occlusionRaster)
+    {
+        m_occlusionRasteriser.TestOcclusion(boxes, outOccluded);
+    }
+    else
+    {
+        std::fill_n(outOccluded.Data(), outOccluded.Size(), false);
+    }
+
+    if (m_horizonCulling)
+    {
+        for (size_t i = 0; i < boxes.Size(); ++i)
+        {
+            outOccluded[i] = outOccluded[i] || m_horizonCuller.IsOccluded(boxes[i]);
+        }
+    }
+}
+
+void Terrain::ComputeViewsheds(const Span<const Vec2f>& observersXZ, float observerHeight, float targetHeight, float radius, const Span<Viewshed>& outViewsheds) const
+{
+    Assert(outViewsheds.Size() == observersXZ.Size());
+    const float halfDimension = 0.5f * (float)m_config.textureDimension;
+    ThreadPool::Instance().ParallelFor((int)observersXZ.Size(), [&](int i)
+    {
+        Vec2f pos = observersXZ[i];
+        int level = FindCoveringLevel(Vec3f(pos.x - radius, 0.f, pos.y - radius), Vec3f(pos.x + radius, 0.f, pos.y + radius));
+        const float texelSize = m_config.texelSize * float(1 << level);
+        Vec2i observerCell = math::Vec2Floor(pos / texelSize + Vec2f(halfDimension + 0.5f));
+
+        Viewshed& viewshed = outViewsheds[i];
+        viewshed.centreXZ = (Vec2f(observerCell) - Vec2f(halfDimension)) * texelSize;
+        viewshed.cellSize = texelSize;
+        viewshed.radius = std::max((int)(radius / texelSize), 1);
+        viewshed.visible.resize(math::Square(viewshed.Dimension()));
+        ComputeViewshed(GetResidentHeightfield(level), observerCell, observerHeight, targetHeight, viewshed.radius, viewshed.visible.data());
+    });
+}
+
+void Terrain::SampleHeights(const Span<const float>& posX, const Span<const float>& posZ, const Span<float>& outHeights, const Span<Vec3f>& outNormals) const
+{
+    Assert(posZ.Size() == posX.Size() && outHeights.Size() == posX.Size());
+    Assert(outNormals.Size() == 0 || outNormals.Size() == posX.Size());
+    const int count = (int)posX.Size();
+    const int numLevels = m_config.numLevels;
+    const float halfDimension = 0.5f * (float)m_config.textureDimension;
+    Vec3f* normals = outNormals.Size() > 0 ? outNormals.Data() : nullptr;
+
+    // Each level can sample within its valid cells, i.e. all but the last row and column of texels it holds.
+    float invTexelSizes[MaxClipLevels];
+    Vec2f cellsMin[MaxClipLevels];
+    Vec2f cellsMax[MaxClipLevels];
+    for (int level = 0; level < numLevels; ++level)
+    {
+        invTexelSizes[level] = 1.f / (m_config.texelSize * float(1 << level));
+        cellsMin[level] = Vec2f(m_clipmapTexelOffset >> level);
+        cellsMax[level] = cellsMin[level] + Vec2f((float)(m_config.textureDimension - 1));
+    }
+
+    // Bucket the positions by the finest level covering them, then by tile within that level's texture, with a last bucket for
+    // anything outside the clipmap. A counting sort is linear, and sampling each bucket in turn keeps its texels in cache.
+    const int tilesPerAxis = m_config.textureDimension / m_config.tileDimension;
+    const int tileShift = math::ILog2(m_config.tileDimension);
+    const int bucketsPerLevel = math::Square(tilesPerAxis);
+    const int outsideBucket = numLevels * bucketsPerLevel;
+
+    // Keep the scratch per thread, so callers can query from several threads without allocating every time.
+    struct Scratch
+    {
+        std::vector<int> buckets;
+        std::vector<int> bucketStarts;
+        std::vector<int> indices;
+        std::vector<float> x;
+        std::vector<float> z;
+    };
+    // The jobs below run on other threads, which have thread_locals of their own, so they must get at ours through a reference.
+    static thread_local Scratch threadScratch;
+    Scratch& scratch = threadScratch;
+    scratch.buckets.resize(count);
+    scratch.bucketStarts.assign(outsideBucket + 2, 0);
+    scratch.indices.resize(count);
+    scratch.x.resize(count);
+    scratch.z.resize(count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        int bucket = outsideBucket;
+        for (int level = 0; level < numLevels; ++level)
+        {
+            Vec2f coords(posX[i] * invTexelSizes[level] + halfDimension, posZ[i] * invTexelSizes[level] + halfDimension);
+            if (coords.x >= cellsMin[level].x && coords.y >= cellsMin[level].y && coords.x < cellsMax[level].x && coords.y < cellsMax[level].y)
+            {
+                Vec2i tile = m_config.WrapHeightmapCoords(math::Vec2Floor(coords)) >> tileShift;
+                bucket = level * bucketsPerLevel + tilesPerAxis * tile.y + tile.x;
+                break;
+            }
+        }
+        scratch.buckets[i] = bucket;
+        ++scratch.bucketStarts[bucket + 1];
+    }
+
+    for (int bucket = 1; bucket <= outsideBucket + 1; ++bucket)
+    {
+        scratch.bucketStarts[bucket] += scratch.bucketStarts[bucket - 1];
+    }
+
+    int levelStarts[MaxClipLevels + 1];
+    for (int level = 0; level <= numLevels; ++level)
+    {
+        levelStarts[level] = scratch.bucketStarts[level * bucketsPerLevel];
+    }
+
+    // Scatter into bucket order, converting to each level's texel space.
+    for (int i = 0; i < count; ++i)
+    {
+        int bucket = scratch.buckets[i];
+        int dst = scratch.bucketStarts[bucket]++;
+        int level = std::min(bucket / bucketsPerLevel, numLevels - 1);
+        scratch.indices[dst] = i;
+        scratch.x[dst] = posX[i] * invTexelSizes[level] + halfDimension;
+        scratch.z[dst] = posZ[i] * invTexelSizes[level] + halfDimension;
+    }
+
+    // Sample each level's run in chunks across the thread pool. Results go straight to the callers' indices, so chunks don't overlap.
+    struct Job
+    {
+        int level;
+        int begin;
+        int end;
+    };
+
+    constexpr int PositionsPerJob = 1024;
+    std::vector<Job> jobs;
+    for (int level = 0; level < numLevels; ++level)
+    {
+        for (int begin = levelStarts[level]; begin < levelStarts[level + 1]; begin += PositionsPerJob)
+        {
+            jobs.push_back({ level, begin, std::min(begin + PositionsPerJob, levelStarts[level + 1]) });
+        }
+    }
+
+    ThreadPool::Instance().ParallelFor((int)jobs.size(), [&](int jobIndex)
+    {
+        const Job& job = jobs[jobIndex];
+        SampleHeightfield(GetResidentHeightfield(job.level), &scratch.x[job.begin], &scratch.z[job.begin], &scratch.indices[job.begin],
+            job.end - job.begin, m_config.texelSize * float(1 << job.level), outHeights.Data(), normals);
+    });
+
+    // Anything beyond the clipmap reads the coarsest level's corners from the tile caches (or noise), one position at a time.
+    if (levelStarts[numLevels] < count)
+    {
+        std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+        const int level = numLevels - 1;
+        for (int j = levelStarts[numLevels]; j < count; ++j)
+        {
+            // Lay the corners out as a wrapped 2x2 height field so they go through the same sampler.
+            Vec2i cell = math::Vec2Floor(Vec2f(scratch.x[j], scratch.z[j]));
+            float corners[4];
+            for (int z = 0; z < 2; ++z)
+            {
+                float row[2];
+                ReadHeights(level, cell + Vec2i(0, z), 2, row);
+                corners[2 * ((cell.y + z) & 1) + (cell.x & 1)] = row[0];
+                corners[2 * ((cell.y + z) & 1) + ((cell.x + 1) & 1)] = row[1];
+            }
+
+            WrappedHeightfield heightfield;
+            heightfield.heights = corners;
+            heightfield.dimension = 2;
+            heightfield.validMin = cell;
+            SampleHeightfield(heightfield, &scratch.x[j], &scratch.z[j], &scratch.indices[j], 1, m_config.texelSize * float(1 << level), outHeights.Data(), normals);
+        }
+    }
+}
+
+void Terrain::BuildRtin(int level, Vec2i firstTile, int numTiles, RtinHierarchy& outRtin) const
+{
+    Assert(0 <= level && level < m_config.numLevels && math::IsPow2(numTiles));
+
+    // One more row and column than the tiles hold, from the next ones over, so the last cells are complete.
+    const int gridDimension = numTiles * m_config.tileDimension + 1;
+    const Vec2i levelGlobalStart = firstTile * m_config.tileDimension + m_config.TextureSize() / 2;
+    std::vector<float> heights(math::Square(gridDimension));
+    {
+        std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+        ThreadPool::Instance().ParallelFor(gridDimension, [&](int z)
+        {
+            ReadHeights(level, levelGlobalStart + Vec2i(0, z), gridDimension, &heights[gridDimension * z]);
+        });
+    }
+
+    const float cellSize = m_config.texelSize * float(1 << level);
+    const Vec2f origin = Vec2f(firstTile * m_config.tileDimension) * cellSize;
+    outRtin.Build(heights.data(), gridDimension, Vec3f(origin.x, 0.f, origin.y), cellSize);
+}
+
+void Terrain::ComputeTileNormals(int level, Vec2i tile, const Span<Vec3f>& outNormals) const
+{
+    Assert(0 <= level && level < m_config.numLevels && (int)outNormals.Size() == math::Square(m_config.tileDimension));
+
+    // The tile and a texel of each of its neighbours all round.
+    const int tileDimension = m_config.tileDimension;
+    const int borderedDimension = tileDimension + 2;
+    const Vec2i levelGlobalStart = tile * tileDimension + m_config.TextureSize() / 2 - Vec2i(1, 1);
+    std::vector<float> heights(math::Square(borderedDimension));
+    {
+        std::lock_guard<std::mutex> lock(m_tileCacheMutex);
+        for (int z = 0; z < borderedDimension; ++z)
+        {
+            ReadHeights(level, levelGlobalStart + Vec2i(0, z), borderedDimension, &heights[borderedDimension * z]);
+        }
+    }
+
+    ComputeSobelNormalsBordered(heights.data(), borderedDimension, Vec2i(tileDimension, tileDimension), m_config.texelSize * float(1 << level), outNormals.Data());
+}
+
+WrappedHeightfield Terrain::GetResidentHeightfield(int level) const
+{
+    WrappedHeightfield heightfield;
+    heightfield.heights = m_clipmapLevels[level].heights.data();
+    heightfield.bounds = &m_clipmapLevels[level].bounds;
+    heightfield.dimension = m_config.textureDimension;
+    heightfield.validMin = m_clipmapTexelOffset >> level;
+    return heightfield;
+}
+
+int Terrain::FindCoveringLevel(const Vec3f& boundsMin, const Vec3f& boundsMax) const
+{
+    // The finest level whose valid cells hold the whole of a (world space) box, else the coarsest, which sweeps whatever part of it is resident.
+    const float halfDimension = 0.5f * (float)m_config.textureDimension;
+    for (int level = 0; level < m_config.numLevels - 1; ++level)
+    {
+        const float invTexelSize = 1.f / (m_config.texelSize * float(1 << level));
+        Vec2f cellsMin(m_clipmapTexelOffset >> level);
+        Vec2f cellsMax = cellsMin + Vec2f((float)(m_config.textureDimension - 1));
+        Vec2f min = Vec2f(boundsMin.x, boundsMin.z) * invTexelSize + halfDimension;
+        Vec2f max = Vec2f(boundsMax.x, boundsMax.z) * invTexelSize + halfDimension;
+        if (min.x >= cellsMin.x && min.y >= cellsMin.y && max.x <= cellsMax.x && max.y <= cellsMax.y)
+            return level;
+    }
+    return m_config.numLevels - 1;
+}
+
+Vec3f Terrain::GetLevelSweepOffset(int level) const
+{
+    // From world space to sweep space, where level global texel (0, 0) is at the origin.
+    const float halfSize = 0.5f * (float)m_config.textureDimension * m_config.texelSize * float(1 << level);
+    return Vec3f(halfSize, 0.f, halfSize);
+}
+
+int Terrain::FindSweepLevel(const Vec3f& boundsMin, const Vec3f& boundsMax) const
+{
+    // The finest level where the cells under a (world space) box fit in a gathered height field, else the coarsest.
+    for (int level = 0; level < m_config.numLevels - 1; ++level)
+    {
+        const float invTexelSize = 1.f / (m_config.texelSize * float(1 << level));
+        Vec2i cellsMin = math::Vec2Floor(Vec2f(boundsMin.x, boundsMin.z) * invTexelSize);
+        Vec2i cellsMax = math::Vec2Floor(Vec2f(boundsMax.x, boundsMax.z) * invTexelSize);
+        Vec2i texels = cellsMax - cellsMin + Vec2i(2, 2);
+        if (std::max(texels.x, texels.y) <= SweepGatherDimension)
+            return level;
+    }
+    return m_config.numLevels - 1;
+}
+
+void Terrain::GatherSweepHeightfield(int level, const Vec3f& boundsMin, const Vec3f& boundsMax, GatheredHeightfield& out) const
+{
+    // Called with m_tileCacheMutex held. The texels at the corners of every cell under the box, plus whatever else rounds
+    // the square up to a power of two, read from the tile caches (or noise) and wrapped just like a clipmap level.
+    const float invTexelSize = 1.f / (m_config.texelSize * float(1 << level));
+    const Vec2i halfSize = m_config.TextureSize() / 2;
+    Vec2i cellsMin = math::Vec2Floor(Vec2f(boundsMin.x, boundsMin.z) * invTexelSize) + halfSize;
+    Vec2i cellsMax = math::Vec2Floor(Vec2f(boundsMax.x, boundsMax.z) * invTexelSize) + halfSize;
+    Vec2i texels = cellsMax - cellsMin + Vec2i(2, 2);
+    int dimension = HeightBoundsBlockDimension;
+    while (dimension < std::max(texels.x, texels.y))
+    {
+        dimension *= 2;
+    }
+
+    if (out.bounds.GetDimension() != dimension)
+    {
+        out.heights.resize(math::Square(dimension));
+        out.bounds = MinMaxPyramid(dimension, HeightBoundsBlockDimension);
+    }
+
+    const int mask = dimension - 1;
+    out.row.resize(dimension);
+    for (int z = 0; z < dimension; ++z)
+    {
+        ReadHeights(level, cellsMin + Vec2i(0, z), dimension, out.row.data());
+        float* dst = &out.heights[dimension * ((cellsMin.y + z) & mask)];
+        int split = dimension - (cellsMin.x & mask);
+        memcpy(dst + (cellsMin.x & mask), out.row.data(), split * sizeof(float));
+        memcpy(dst, out.row.data() + split, (dimension - split) * sizeof(float));
+    }
+    out.bounds.Build(out.heights.data(), dimension);
+
+    out.heightfield.heights = out.heights.data();
+    out.heightfield.bounds = &out.bounds;
+    out.heightfield.dimension = dimension;
+    out.heightfield.validMin = cellsMin;
+}
+
+void Terrain::ToLevelTexelSpace(int level, const Rayf& ray, Vec3f& outOrigin, Vec3f& outDir) const
+{
+    // Scale x and z to texels of the level, leaving the ray's parameterisation (distance along it) unchanged.
+    // Level global coords are offset by half the texture, since clipmap tiling is centred at the origin.
+    const float invTexelSize = 1.f / (m_config.texelSize * float(1 << level));
+    const float halfDimension = 0.5f * (float)m_config.textureDimension;
+    outOrigin = Vec3f(ray.m_start.x * invTexelSize + halfDimension, ray.m_start.y, ray.m_start.z * invTexelSize + halfDimension);
+    outDir = Vec3f(ray.m_dir.x * invTexelSize, ray.m_dir.y, ray.m_dir.z * invTexelSize);
+}
+
+HeightRange Terrain::CalcGeneratedHeightRange() const
+{
+    // Bound each octave of GenerateHeights() assuming Perlin noise stays within [-1, 1].
+    // Anything outside this (e.g. after edits) just grows the range of the affected levels.
+    float multiplierAmplitude = 0.f;
+    for (const NoiseOctave& octave : m_ridgeNoiseMultiplierParams)
+    {
+        multiplierAmplitude += fabsf(octave.amplitude);
+    }
+
+    HeightRange range = { m_baseHeight, m_baseHeight };
+    for (const NoiseOctave& octave : m_ridgeNoiseParams)
+    {
+        // Ridges are amplitude * multiplier * [0, 1], where the multiplier is 1 +/- multiplierAmplitude.
+        float a = octave.amplitude * (1.f - multiplierAmplitude);
+        float b = octave.amplitude * (1.f + multiplierAmplitude);
+        range.min += std::min({ a, b, 0.f });
+        range.max += std::max({ a, b, 0.f });
+    }
+    for (const NoiseOctave& octave : m_whiteNoiseParams)
+    {
+        range.min -= fabsf(octave.amplitude);
+        range.max += fabsf(octave.amplitude);
+    }
+
+    // Keep the range non-empty even if every octave is flat.
+    range.max = std::max(range.max, range.min + 1.f);
+    return range;
+}
+
+void Terrain::UpdatePatchHeightBounds()
+{
+    const int patchesPerSide = m_patchCuller.GetPatchesPerSide();
+    ThreadPool::Instance().ParallelFor(patchesPerSide, [&](int z)
+    {
+        for (int x = 0; x < patchesPerSide; ++x)
+        {
+            const AABB3f box = m_patchCuller.GetPatchBounds(x, z);
+            m_patchCuller.SetHeightBounds(x, z, CalcRenderedHeightBounds(Vec2f(box.m_min.x, box.m_min.z), Vec2f(box.m_max.x, box.m_max.z)));
+        }
+    });
+
+    m_patchCuller.UpdateBlocks();
+    m_patchBoundsDirty = false;
+}
+
+void Terrain::UpdateRingBounds()
+{
+    // In the same order as DrawRings() walks the instances.
+    const float patchSize = m_config.VertexPatchSize();
+    m_ringInstanceBoxes.Resize(m_clipmapRings.GetNumInstances());
+    int index = 0;
+    for (int piece = 0; piece < RingPiece::Count; ++piece)
+    {
+        const Vec2i pieceSize = m_clipmapRings.GetPieceSize((RingPiece::E)piece);
+        for (const RingPieceInstance& instance : m_clipmapRings.GetInstances((RingPiece::E)piece))
+        {
+            const Vec2f worldMin = Vec2f(instance.origin) * patchSize;
+            const Vec2f worldMax = Vec2f(instance.origin + (pieceSize << instance.level)) * patchSize;
+            const Vec2f heights = CalcRenderedHeightBounds(worldMin, worldMax);
+            m_ringInstanceBoxes.Set(index++, { Vec3f(worldMin.x, heights.x, worldMin.y), Vec3f(worldMax.x, heights.y, worldMax.y) });
+        }
+    }
+    Assert(index == m_ringInstanceBoxes.Size());
+    m_patchBoundsDirty = false;
+}
+
+void Terrain::UpdateHorizon(const Vec3f& camPos, bool drawnSurfaceChanged)
+{
+    Timer timer;
+
+    // The area the rings, or the grid, cover. The horizon's coarsest cells have to reach across it from anywhere inside it.
+    const float patchSize = m_config.VertexPatchSize();
+    Vec2f drawnMin, drawnMax;
+    if (m_useRings)
+    {
+        const int outerLevel = m_clipmapRings.GetNumLevels() - 1;
+        drawnMin = Vec2f(m_clipmapRings.GetLevelMin(outerLevel)) * patchSize;
+        drawnMax = drawnMin + Vec2f((float)(m_clipmapRings.GetLevelPatches() << outerLevel) * patchSize);
+    }
+    else
+    {
+        const int lastPatch = m_patchCuller.GetPatchesPerSide() - 1;
+        const AABB3f first = m_patchCuller.GetPatchBounds(0, 0);
+        const AABB3f last = m_patchCuller.GetPatchBounds(lastPatch, lastPatch);
+        drawnMin = Vec2f(first.m_min.x, first.m_min.z);
+        drawnMax = Vec2f(last.m_max.x, last.m_max.z);
+    }
+
+    const float drawnExtent = std::max(drawnMax.x - drawnMin.x, drawnMax.y - drawnMin.y);
+    int numLevels = 1;
+    while ((float)(HorizonCellsPerSide << (numLevels - 1)) * patchSize < 2.f * drawnExtent)
+    {
+        ++numLevels;
+    }
+    if (numLevels != m_horizonCuller.GetNumLevels())
+    {
+        m_horizonCuller.Init(patchSize, HorizonCellsPerSide, numLevels);
+    }
+
+    // Each cell occludes down to the lowest the drawn surface gets over it, across the blended clip levels like the patch bounds.
+    // Cells hanging off the drawn surface have a gap to see through, so they don't occlude at all.
+    if (m_horizonCuller.UpdateLayout(Vec2f(camPos.x, camPos.z)) || drawnSurfaceChanged)
+    {
+        ThreadPool::Instance().ParallelFor(m_horizonCuller.GetNumOccluders(), [&](int i)
+        {
+            const Vec4f& rect = m_horizonCuller.GetOccluderRect(i);
+            const Vec2f cellMin(rect.x, rect.y);
+            const Vec2f cellMax(rect.z, rect.w);
+            const bool drawn = math::all(math::greaterThanEqual(cellMin, drawnMin)) && math::all(math::lessThanEqual(cellMax, drawnMax));
+            m_horizonCuller.SetOccluderHeight(i, drawn ? CalcRenderedHeightBounds(cellMin, cellMax).x : -FLT_MAX);
+        });
+
+        m_numHorizonOccluders = 0;
+        for (int i = 0; i < m_horizonCuller.GetNumOccluders(); ++i)
+        {
+            m_numHorizonOccluders += (m_horizonCuller.GetOccluderHeight(i) != -FLT_MAX);
+        }
+    }
+
+    m_horizonCuller.Build(camPos);
+    m_horizonBuildMs = 1000.f * timer.GetSecondsAndReset();
+}
+
+void Terrain::RasteriseOccluders(const Vec3f& camPos, const Mat4f& viewProj)
+{
+    Timer timer;
+    if (m_occlusionRasteriser.GetWidth() == 0)
+    {
+        m_occlusionRasteriser.Init(OcclusionBufferWidth, OcclusionBufferHeight);
+    }
+
+    m_horizonCuller.BuildOccluderMesh(camPos, GetResidentBounds().m_min.y - 1.f, m_occluderMesh);
+    m_occlusionRasteriser.Begin(viewProj);
+    m_occlusionRasteriser.RasteriseTriangles(m_occluderMesh);
+    m_occlusionRasteriser.BuildPyramid();
+    m_occlusionRasterMs = 1000.f * timer.GetSecondsAndReset();
+}
+
+Vec2f Terrain::CalcRenderedHeightBounds(Vec2f worldMin, Vec2f worldMax) const
+{
+    // Mirror the level selection in TerrainClipLevels.hlsl: a point uses the level for its (Chebyshev) distance from the clipmap centre,
+    // blended into the next level out. So a region takes in every level from the one its nearest point uses to the one after its furthest.
+    const float invTextureDimension = 1.f / (float)m_config.textureDimension;
+    const float invLevel0Size = invTextureDimension / m_config.texelSize;
+    const Vec2f centreUV = Vec2f(m_clipmapTexelOffset) * invTextureDimension;
+    const float maxLevel = (float)(m_config.numLevels - 1);
+    auto levelAt = [&](float maxCoord)
+    {
+        float logMaxCoord = log2f(std::max(4.f * maxCoord, FLT_MIN)) + 3.f * 2.f * invTextureDimension;
+        return (int)std::clamp(logMaxCoord, 0.f, maxLevel);
+    };
+
+    const Vec2f uvMin = worldMin * invLevel0Size - centreUV;
+    const Vec2f uvMax = worldMax * invLevel0Size - centreUV;
+    const Vec2f nearest = math::max(math::max(uvMin, -uvMax), Vec2fZero);
+    const Vec2f furthest = math::max(math::abs(uvMin), math::abs(uvMax));
+    const int firstLevel = levelAt(std::max(nearest.x, nearest.y));
+    const int lastLevel = std::min(levelAt(std::max(furthest.x, furthest.y)) + 1, m_config.numLevels - 1);
+
+    Vec2f bounds(FLT_MAX, -FLT_MAX);
+    for (int level = firstLevel; level <= lastLevel; ++level)
+    {
+        Vec2f levelBounds = CalcLevelRegionHeightBounds(level, worldMin, worldMax);
+        bounds.x = std::min(bounds.x, levelBounds.x);
+        bounds.y = std::max(bounds.y, levelBounds.y);
+    }
+    return bounds;
+}
+
+Vec2f Terrain::CalcRingHeightBounds(Vec2f worldMin, Vec2f worldMax) const
+{
+    // Union of the ring instances the rectangle touches, like PatchCuller::CalcHeightBounds() for the grid.
+    const AABBBatch& boxes = m_ringInstanceBoxes;
+    Vec2f bounds(FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < boxes.Size(); ++i)
+    {
+        if (boxes.maxX[i] < worldMin.x || boxes.minX[i] > worldMax.x || boxes.maxZ[i] < worldMin.y || boxes.minZ[i] > worldMax.y)
+            continue;
+
+        bounds.x = std::min(bounds.x, boxes.minY[i]);
+        bounds.y = std::max(bounds.y, boxes.maxY[i]);
+    }
+    return bounds;
+}
+
+Vec2f Terrain::CalcLevelRegionHeightBounds(int level, Vec2f worldMin, Vec2f worldMax) const
+{
+    // Texels bilinear filtering can read for points in the region; level global coords are offset by half the texture.
+    const float invLevelTexelSize = 1.f / (m_config.texelSize * float(1 << level));
+    const Vec2f halfTexture = Vec2f(m_config.TextureSize()) * 0.5f;
+    const Vec2i texelMin = math::Vec2Floor(worldMin * invLevelTexelSize + halfTexture - Vec2f(0.5f, 0.5f));
+    const Vec2i texelMax = math::Vec2Floor(worldMax * invLevelTexelSize + halfTexture - Vec2f(0.5f, 0.5f)) + Vec2i(2, 2); // Exclusive.
+
+    // The GPU's copy can be off from the CPU's by the encoding error. Block compression's is worst for blocks spanning the whole range.
+    const ClipmapLevel& levelData = m_clipmapLevels[level];
+    const float padding = m_config.IsCompressedLevel(level) ? m_heightRanges[level].Scale() / 14.f : m_heightRanges[level].MaxQuantisationError();
+    auto pad = [padding](Vec2f bounds) { return Vec2f(bounds.x - padding, bounds.y + padding); };
+
+    // Outside what's resident, the texture repeats (e.g. beyond the coarsest level), so it could be anything in the level.
+    const Vec2i validMin = m_clipmapTexelOffset >> level;
+    const Vec2i validMax = validMin + m_config.TextureSize();
+    if (texelMin.x < validMin.x || texelMin.y < validMin.y || texelMax.x > validMax.x || texelMax.y > validMax.y)
+        return pad(levelData.bounds.GetBounds());
+
+    // Split where the region wraps around the texture edge.
+    const Vec2i wrappedMin = m_config.WrapHeightmapCoords(texelMin);
+    const Vec2i size = texelMax - texelMin;
+    Vec2f bounds(FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < 4; ++i)
+    {
+        Vec2i pieceMin, pieceMax;
+        for (int axis = 0; axis < 2; ++axis)
+        {
+            const int firstSize = std::min(size[axis], m_config.textureDimension - wrappedMin[axis]);
+            const bool second = ((i >> axis) & 1) != 0;
+            pieceMin[axis] = second ? 0 : wrappedMin[axis];
+            pieceMax[axis] = second ? size[axis] - firstSize : wrappedMin[axis] + firstSize;
+        }
+        if (pieceMin.x >= pieceMax.x || pieceMin.y >= pieceMax.y)
+            continue;
+
+        Vec2f pieceBounds = levelData.bounds.Query(pieceMin, pieceMax);
+        bounds.x = std::min(bounds.x, pieceBounds.x);
+        bounds.y = std::max(bounds.y, pieceBounds.y);
+    }
+    return pad(bounds);
+}
+
+void Terrain::BenchmarkCpuNormals()
+{
+    // Generate level 0 as it's currently centred and filter the whole texture, as a full clipmap update would.
+    const int dim = m_config.textureDimension;
+    const Vec2i texelOffset = m_clipmapTexelOffset;
+    std::vector<float> heights(math::Square(dim));
+    for (int z = 0; z < dim; ++z)
+    {
+        Vec2i levelGlobalCoords = texelOffset + Vec2i(0, z);
+        GenerateHeights(levelGlobalCoords, dim, 0, &heights[m_config.HeightmapIndex(m_config.WrapHeightmapCoords(levelGlobalCoords))]);
+    }
+
+    constexpr int NumRepeats = 8;
+    const float numMtexels = NumRepeats * math::Square(dim) / 1e6f;
+    std::vector<Vec3f> single(math::Square(dim));
+    std::vector<Vec3f> parallel(math::Square(dim));
+
+    Timer timer;
+    for (int i = 0; i < NumRepeats; ++i)
+    {
+        ComputeSobelNormals(heights.data(), dim, Vec2iZero, m_config.TextureSize(), m_config.texelSize, single.data());
+    }
+    m_normalsBenchmark.singleMtexelsPerSec = numMtexels / timer.GetSecondsAndReset();
+
+    for (int i = 0; i < NumRepeats; ++i)
+    {
+        ComputeSobelNormalsParallel(heights.data(), dim, Vec2iZero, m_config.TextureSize(), m_config.texelSize, parallel.data());
+    }
+    m_normalsBenchmark.parallelMtexelsPerSec = numMtexels / timer.GetSecondsAndReset();
+
+    m_normalsBenchmark.maxDifference = 0.f;
+    for (int z = 0; z < dim; ++z)
+    {
+        for (int x = 0; x < dim; ++x)
+        {
+            Vec3f reference = ComputeSobelNormalReference(heights.data(), dim, Vec2i(x, z), m_config.texelSize);
+            m_normalsBenchmark.maxDifference = std::max(m_normalsBenchmark.maxDifference, math::length(parallel[dim * z + x] - reference));
+        }
+    }
+    m_normalsBenchmark.numThreads = ThreadPool::Instance().GetNumThreads();
+}
+
+
+void Terrain::BenchmarkHeightQueries()
+{
+    // Scatter positions over the resident area with a low discrepancy sequence, as units or vegetation might be.
+    constexpr int NumQueries = 10000;
+    constexpr int NumRepeats = 16;
+    const AABB3f bounds = GetResidentBounds();
+    std::vector<float> posX(NumQueries);
+    std::vector<float> posZ(NumQueries);
+    for (int i = 0; i < NumQueries; ++i)
+    {
+        posX[i] = bounds.m_min.x + (bounds.m_max.x - bounds.m_min.x) * fmodf(0.7548777f * (float)i, 1.f);
+        posZ[i] = bounds.m_min.z + (bounds.m_max.z - bounds.m_min.z) * fmodf(0.5698403f * (float)i, 1.f);
+    }
+
+    std::vector<float> heights(NumQueries);
+    std::vector<Vec3f> normals(NumQueries);
+    Span<const float> xs(posX.data(), posX.size());
+    Span<const float> zs(posZ.data(), posZ.size());
+    Span<float> heightSpan(heights.data(), heights.size());
+    const float numMqueries = NumRepeats * NumQueries / 1e6f;
+
+    Timer timer;
+    for (int i = 0; i < NumRepeats; ++i)
+    {
+        SampleHeights(xs, zs, heightSpan);
+    }
+    m_heightQueryBenchmark.mqueriesPerSec = numMqueries / timer.GetSecondsAndReset();
+
+    for (int i = 0; i < NumRepeats; ++i)
+    {
+        SampleHeights(xs, zs, heightSpan, Span<Vec3f>(normals.data(), normals.size()));
+    }
+    m_heightQueryBenchmark.mqueriesPerSecWithNormals = numMqueries / timer.GetSecondsAndReset();
+    m_heightQueryBenchmark.numQueries = NumQueries;
+}
+
+void Terrain::BenchmarkMeshExtraction()
+{
+    // The tiles of level 0 around the camera, extracted a tile at a time as they would be for streaming collision.
+    constexpr int NumTiles = 4;
+    const Vec2i cameraTile = m_config.GlobalCoordsToTile(m_clipmapTexelOffset, 0).first;
+    RtinHierarchy rtin;
+    Timer timer;
+    BuildRtin(0, cameraTile - Vec2i(NumTiles / 2, NumTiles / 2), NumTiles, rtin);
+    m_meshExtractionBenchmark.buildMs = 1000.f * timer.GetSecondsAndReset();
+
+    TriangleMesh mesh;
+    int numTriangles = 0;
+    for (int z = 0; z < NumTiles; ++z)
+    {
+        for (int x = 0; x < NumTiles; ++x)
+        {
+            rtin.ExtractTile(m_meshExtractionMaxError, m_config.tileDimension, Vec2i(x, z), mesh);
+            numTriangles += (int)mesh.indices.size() / 3;
+        }
+    }
+    m_meshExtractionBenchmark.extractMs = 1000.f * timer.GetSecondsAndReset();
+    m_meshExtractionBenchmark.numTriangles = numTriangles;
+    m_meshExtractionBenchmark.gridTriangles = 2 * math::Square(NumTiles * m_config.tileDimension);
+    m_meshExtractionBenchmark.numTiles = NumTiles;
+}
+
+void Terrain::BenchmarkPatchOrders(const Mat4f& viewProj)
+{
+    // Each order's full grid, the grid culled to the current view (by XZ alone, as the layout is all that matters here) and the ring pieces.
+    const int vertexGridDimension = m_config.vertexGridDimension;
+    const Frustumf frustum(viewProj);
+    std::vector<uint32> indices(m_config.IndexBufferLength());
+    std::vector<uint16> ringIndices;
+    for (int order = 0; order < PatchOrder::Count; ++order)
+    {
+        PatchCuller culler;
+        culler.Init(vertexGridDimension, ToVertexPos(0, 0), m_config.VertexPatchSize(), (PatchOrder::E)order);
+        int numIndices = culler.WriteAllIndices(indices.data());
+        m_patchOrderBenchmark.grid[order] = SimulateVertexCache(Span<const uint32>(indices.data(), numIndices), 4);
+        numIndices = culler.WriteVisibleIndices(frustum, indices.data());
+        m_patchOrderBenchmark.view[order] = SimulateVertexCache(Span<const uint32>(indices.data(), numIndices), 4);
+
+        // Pieces are drawn separately, so give each its own range of vertices.
+        ringIndices.clear();
+        int baseVertex = 0;
+        for (int piece = 0; piece < RingPiece::Count; ++piece)
+        {
+            const Vec2i size = m_clipmapRings.GetPieceSize((RingPiece::E)piece);
+            const size_t firstIndex = ringIndices.size();
+            WriteRingPieceIndices(size, (PatchOrder::E)order, ringIndices);
+            for (size_t i = firstIndex; i < ringIndices.size(); ++i)
+            {
+                ringIndices[i] = (uint16)(ringIndices[i] + baseVertex);
+            }
+            baseVertex += (size.x + 1) * (size.y + 1);
+        }
+        m_patchOrderBenchmark.rings[order] = SimulateVertexCache(Span<const uint16>(ringIndices.data(), ringIndices.size()), 4);
+    }
+    m_patchOrderBenchmark.cacheSize = DefaultVertexCacheSize;
+}
+
+void Terrain::BenchmarkRoughness()
+{
+    // Every cell of every level, as if the whole clipmap had just been regenerated.
+    const int dim = m_config.textureDimension;
+    Timer timer;
+    for (int level = 0; level < m_config.numLevels; ++level)
+    {
+        ClipmapLevel& levelData = m_clipmapLevels[level];
+        levelData.roughness.Update(levelData.heights.data(), dim, Vec2iZero, Vec2i(dim, dim));
+    }
+    m_roughnessBenchmark.rebuildMs = 1000.f * timer.GetSecondsAndReset();
+    m_roughnessBenchmark.numCells = m_config.numLevels * math::Square(dim / RoughnessCellDimension);
+}
+
+void Terrain::BenchmarkOcclusionRaster(const Vec3f& camPos, const Mat4f& viewProj)
+{
+    // The current view's occluders from scratch, then every ring instance (or grid patch) in the frustum as if it were an object.
+    constexpr int NumRuns = 16;
+    UpdateHorizon(camPos, true);
+    if (m_occlusionRasteriser.GetWidth() == 0)
+    {
+        m_occlusionRasteriser.Init(OcclusionBufferWidth, OcclusionBufferHeight);
+    }
+
+    OcclusionRasterBenchmark& bench = m_occlusionRasterBenchmark;
+    Timer timer;
+    for (int run = 0; run < NumRuns; ++run)
+    {
+        m_horizonCuller.BuildOccluderMesh(camPos, GetResidentBounds().m_min.y - 1.f, m_occluderMesh);
+        m_occlusionRasteriser.Begin(viewProj);
+        m_occlusionRasteriser.RasteriseTriangles(m_occluderMesh);
+        m_occlusionRasteriser.BuildPyramid();
+    }
+    bench.rasteriseMs = 1000.f * timer.GetSecondsAndReset() / (float)NumRuns;
+    bench.stats = m_occlusionRasteriser.GetStats();
+
+    const Frustumf frustum(viewProj);
+    std::vector<AABB3f> boxes;
+    if (m_useRings)
+    {
+        for (int i = 0; i < m_ringInstanceBoxes.Size(); ++i)
+        {
+            boxes.push_back(m_ringInstanceBoxes.Get(i));
+        }
+    }
+    else
+    {
+        for (int z = 0; z < m_patchCuller.GetPatchesPerSide(); ++z)
+        {
+            for (int x = 0; x < m_patchCuller.GetPatchesPerSide(); ++x)
+            {
+                boxes.push_back(m_patchCuller.GetPatchBounds(x, z));
+            }
         }
     }
+    boxes.erase(std::remove_if(boxes.begin(), boxes.end(), [&](const AABB3f& box) { return frustum.Classify(box) == FrustumTest::Outside; }), boxes.end());
+
+    std::unique_ptr<bool[]> occluded(new bool[boxes.size()]);
+    timer.GetSecondsAndReset();
+    m_occlusionRasteriser.TestOcclusion(Span<const AABB3f>(boxes.data(), boxes.size()), Span<bool>(occluded.get(), boxes.size()));
+    bench.testMs = 1000.f * timer.GetSecondsAndReset();
+    bench.numBoxes = (int)boxes.size();
+    bench.numOccluded = (int)std::count(occluded.get(), occluded.get() + boxes.size(), true);
+    bench.numHorizonOccluded = (int)std::count_if(boxes.begin(), boxes.end(), [&](const AABB3f& box) { return m_horizonCuller.IsOccluded(box); });
 }
 
 }
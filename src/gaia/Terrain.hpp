@@ -1,4 +1,22 @@
 #pragma once
+#include "Math/AABB.hpp"
+#include "Math/Ray.hpp"
+#include "BlockCompression.hpp"
+#include "ClipmapRings.hpp"
+#include "ClipmapConfig.hpp"
+#include "ClipmapUpdater.hpp"
+#include "HeightfieldRaycast.hpp"
+#include "HeightfieldSweep.hpp"
+#include "HeightfieldVisibility.hpp"
+#include "HorizonCuller.hpp"
+#include "MinMaxPyramid.hpp"
+#include "OcclusionRasteriser.hpp"
+#include "PatchCuller.hpp"
+#include "RoughnessPyramid.hpp"
+#include "RtinHierarchy.hpp"
+#include "ShadowCascades.hpp"
+#include "TerrainEditQueue.hpp"
+#include "TerrainEncoding.hpp"
 
 namespace gaia
 {
@@ -14,12 +32,14 @@ public:
     Terrain();
     ~Terrain();
 
-    bool Init(Renderer& renderer);
+    bool Init(Renderer& renderer, const ClipmapConfig& config = ClipmapConfig());
     void Build(Renderer& renderer);
     void PreRender(Renderer& renderer);
     void Render(Renderer& renderer);
     void RenderShadowPass(Renderer& renderer);
-    void RaiseAreaRounded(Renderer& renderer, Vec2f posXZ, float radius, float raiseBy);
+
+    // Queues an edit to be applied on the edit worker thread; the result is uploaded at the start of a later frame.
+    void RaiseAreaRounded(Vec2f posXZ, float radius, float raiseBy);
 
     bool LoadCompiledShaders(Renderer& renderer);
     bool HotloadShaders(Renderer& renderer);
@@ -29,15 +49,79 @@ public:
 
     void Imgui(Renderer& renderer);
 
+    const ClipmapConfig& GetConfig() const { return m_config; }
+
+    // Bounds of everything currently in the clipmap, i.e. the area the coarsest level covers.
+    AABB3f GetResidentBounds() const;
+
+    // Finds where a ray first hits the resident terrain, using the finest level covering each part of the ray.
+    // Like HasLineOfSight() and SampleHeights(), reads the CPU copies of the clipmap levels, which PreRender() updates, so call it from the render thread.
+    // Returns whether it hit, and if so how far along the ray.
+    bool Raycast(const Rayf& ray, float& outDistance) const;
+
+    // Batched version, spread across the thread pool. Rays that miss get FLT_MAX.
+    void Raycast(const Span<const Rayf>& rays, const Span<float>& outDistances) const;
+
+    // Continuous collision of a sphere or capsule moving by delta through the terrain. Reads the heights around its path from the tile
+    // caches (edited tiles where there are any, the noise elsewhere) at the finest level where they fit in SweepGatherDimension texels,
+    // so don't depend on the renderer or what's resident, and can be used from any thread, e.g. by a server. They hold the tile cache
+    // lock while reading, so wait for any batch of edits being applied, and the next batch waits for them.
+    // Returns whether it touched, and if so the first contact, in world space.
+    bool SweepSphere(const Spheref& sphere, const Vec3f& delta, SweepHit& outHit) const;
+    bool SweepCapsule(const Capsulef& capsule, const Vec3f& delta, SweepHit& outHit) const;
+
+    // Batched versions, spread across the thread pool under a single lock. Movers that don't touch get a time of FLT_MAX.
+    void SweepSpheres(const Span<const Spheref>& spheres, const Span<const Vec3f>& deltas, const Span<SweepHit>& outHits) const;
+    void SweepCapsules(const Span<const Capsulef>& capsules, const Span<const Vec3f>& deltas, const Span<SweepHit>& outHits) const;
+
+    // Whether nothing in the resident terrain blocks the line between two points.
+    bool HasLineOfSight(const Vec3f& from, const Vec3f& to) const;
+
+    // Batched version, spread across the thread pool.
+    void HasLineOfSight(const Span<const Vec3f>& from, const Span<const Vec3f>& to, const Span<bool>& outVisible) const;
+
+    // Whether boxes are wholly hidden behind the drawn terrain from the camera of the last PreRender(), for culling objects before they're drawn.
+    // Conservative: uses the horizon and the software occlusion depth buffer, whichever are on, and is always false with both off.
+    void TestOcclusion(const Span<const AABB3f>& boxes, const Span<bool>& outOccluded) const;
+
+    // Viewsheds of observers standing on the ground at the given positions, out to a (world) radius, at the finest level covering each.
+    // Observers are spread across the thread pool.
+    void ComputeViewsheds(const Span<const Vec2f>& observersXZ, float observerHeight, float targetHeight, float radius, const Span<Viewshed>& outViewsheds) const;
+
+    // Bilinearly interpolated ground heights, and optionally normals, at many world XZ positions (in any order), from the finest
+    // resident level covering each. Reads the CPU copies of the clipmap levels, so don't call it during PreRender().
+    void SampleHeights(const Span<const float>& posX, const Span<const float>& posZ, const Span<float>& outHeights,
+        const Span<Vec3f>& outNormals = Span<Vec3f>()) const;
+
+    // Builds an RTIN over a square of numTiles by numTiles tiles of a level (a power of two), in world space, for extracting
+    // simplified meshes for collision, navmeshes or tools. Reads edited tiles where there are any and the noise elsewhere,
+    // so the area doesn't need to be resident. Meshes extracted per tile with the tile dimension meet without cracks.
+    void BuildRtin(int level, Vec2i firstTile, int numTiles, RtinHierarchy& outRtin) const;
+
+    // Normals of a tile of a level, row major, filtered with the edges of the neighbouring tiles so they're right up to its own edges.
+    // Like BuildRtin(), reads edited tiles where there are any and the noise elsewhere. outNormals must hold the tile dimension squared.
+    void ComputeTileNormals(int level, Vec2i tile, const Span<Vec3f>& outNormals) const;
+
 private:
     using HeightmapData = std::vector<float>;
-    static constexpr int NumClipLevels = 8; // Number of clipmap levels (i.e. number of textures).
+    static constexpr int MaxClipLevels = ClipmapConfig::MaxClipLevels;
 
     struct ClipmapLevel
     {
         ComPtr<ID3D12Resource> heightMap;
         ComPtr<ID3D12Resource> normalMap;
-        ComPtr<ID3D12Resource> intermediateBuffer; // TODO: Optimise this. We don't need a separate intermediate buffer per layer.
+        std::vector<float> heights; // CPU copy of the height map (in texture layout, wrapped), which uploads are written from.
+        MinMaxPyramid bounds;       // Over heights.
+        RoughnessPyramid roughness; // Over heights too, for tessellation.
+    };
+
+    // Heights around a sweep's path read from the tile caches, laid out like a clipmap level. Kept per thread to reuse the allocations.
+    struct GatheredHeightfield
+    {
+        std::vector<float> heights;
+        std::vector<float> row; // Each row before it's wrapped.
+        MinMaxPyramid bounds;
+        WrappedHeightfield heightfield;
     };
 
     struct TerrainPSConstantBuffer
@@ -45,6 +129,98 @@ private:
         Vec2f highlightPosXZ;
         Vec2f clipmapUVOffset;
         float highlightRadiusSq;
+        float invTextureDimension;
+        float texelSize;
+        int numClipLevels;
+        Vec4f heightScaleBias[MaxClipLevels / 2]; // Height range of each clip level as (scale, bias), two levels per element.
+        Vec4f ringBounds[MaxClipLevels];          // Outer edge of each ring level that meets a coarser one, in level 0 patches, as (min x, min z, max x, max z).
+        float vertexPatchSize;
+        float screenErrorScale; // Pixels per metre at a distance of 1m, over the target error. 0 to tessellate by distance alone.
+        int roughnessNodes;     // Along each side of the finest level of each clip level's roughness pyramid.
+        int roughnessCellTexels;
+    };
+
+    // Written by the edit worker and read by the UI, so each field is atomic (though not the set of them).
+    struct EditStats
+    {
+        std::atomic<float> raiseMs = 0.f;
+        std::atomic<float> mipsMs = 0.f;
+        std::atomic<int> numStrokes = 0;
+    };
+
+    struct NormalsBenchmark
+    {
+        float singleMtexelsPerSec = 0.f;
+        float parallelMtexelsPerSec = 0.f;
+        float maxDifference = 0.f; // Between the parallel results and the shader's arithmetic, i.e. ComputeSobelNormalReference().
+        int numThreads = 0;
+    };
+
+    struct RoughnessBenchmark
+    {
+        float rebuildMs = 0.f; // Of every level's roughness pyramid.
+        int numCells = 0;
+    };
+
+    struct HeightQueryBenchmark
+    {
+        float mqueriesPerSec = 0.f;
+        float mqueriesPerSecWithNormals = 0.f;
+        int numQueries = 0;
+    };
+
+    struct MeshExtractionBenchmark
+    {
+        float buildMs = 0.f;
+        float extractMs = 0.f;
+        int numTriangles = 0;
+        int gridTriangles = 0; // Of the uniform grid over the same area.
+        int numTiles = 0;      // Along each side.
+    };
+
+    struct OcclusionRasterBenchmark
+    {
+        float rasteriseMs = 0.f; // Occluder mesh to depth pyramid.
+        float testMs = 0.f;
+        int numBoxes = 0;        // Ring instances, or grid patches, in the frustum.
+        int numOccluded = 0;
+        int numHorizonOccluded = 0;
+        OcclusionRasteriser::Stats stats;
+    };
+
+    struct PatchOrderBenchmark
+    {
+        VertexCacheStats grid[PatchOrder::Count];
+        VertexCacheStats view[PatchOrder::Count];  // Of the patches culled to the view.
+        VertexCacheStats rings[PatchOrder::Count]; // Over all the ring pieces.
+        int cacheSize = 0;
+    };
+
+    // Compacted indices of the grid patches, or the ring instances, that survived culling for one pass, written to upload memory each frame.
+    struct VisiblePatches
+    {
+        IndexBuffer indexBuffers[BackbufferCount];
+        void* mappedIndices[BackbufferCount] = {};
+        VertexBuffer instanceBuffers[BackbufferCount]; // Grouped by piece.
+        void* mappedInstances[BackbufferCount] = {};
+        int numPatches = 0; // Last frame, for the stats.
+        int numInstances = 0;
+        int numOccluded = 0; // Patches in the frustum but hidden below the horizon.
+        float cullMs = 0.f;
+    };
+
+    // Where one ring piece's patches are in the ring vertex and index buffers.
+    struct RingPieceMesh
+    {
+        int firstIndex = 0;
+        int numIndices = 0;
+        int baseVertex = 0;
+    };
+
+    struct CompressionStats
+    {
+        uint64 numBlocks = 0;     // BC4 blocks encoded.
+        uint64 uploadedBytes = 0; // Including row pitch padding.
     };
 
     struct NoiseOctave
@@ -57,18 +233,55 @@ private:
     bool CreateShadowPipelineState(Renderer& renderer, ID3DBlob* vertexShader, ID3DBlob* hullShader, ID3DBlob* domainShader);
     bool CreateWaterPipelineState(Renderer& renderer, ID3DBlob* vertexShader, ID3DBlob* pixelShader);
     void CreateConstantBuffers(Renderer& renderer);
+    void CreateRoughnessBuffers(Renderer& renderer);
     void BuildIndexBuffer(Renderer& renderer);
+    void BuildVisiblePatchIndexBuffers(Renderer& renderer, VisiblePatches& outPatches);
     void BuildVertexBuffer(Renderer& renderer);
+    void BuildRings(Renderer& renderer);
     void BuildWater(Renderer& renderer);
+    void UpdateWater(Renderer& renderer);
     void UpdateClipmapTextures(Renderer& renderer);
-    void UpdateClipmapTextureLevel(Renderer& renderer, int level, Vec2i oldTexelOffset, Vec2i newTexelOffset);
-    void UploadClipmapTextureRegion(Renderer& renderer, int level, Vec2i globalMin, Vec2i globalMax, Vec2i newTexelOffset);
+    void ExecuteClipmapUpdate(Renderer& renderer, int level, const ClipmapLevelUpdate& update);
+    void ApplyEdits(const std::vector<TerrainEditQueue::RaiseCommand>& commands);
+    void RaiseTiles(const TerrainEditQueue::RaiseCommand& command, Vec2i minGlobalCoords, Vec2i maxGlobalCoords);
+    void UpdateTileMips(Vec2i minGlobalCoords, Vec2i maxGlobalCoords);
+    void AddDirtyRegion(Vec2i globalMin, Vec2i globalMax);
+    bool HasDirtyRegion() const;
     HeightmapData& GetOrCreateTile(Vec2i tile, int level);
     float GetHeight(Vec2i levelGlobalCoords, int level) const;
     float GenerateHeight(Vec2i levelGlobalCoords, int level) const;
+    void GenerateHeights(Vec2i levelGlobalStart, int count, int level, float* heights) const;
+    void ReadHeights(int level, Vec2i levelGlobalStart, int count, float* heights) const;
     Vec2f ToVertexPos(int globalX, int globalZ);
     Vec2i CalcClipmapTexelOffset(const Vec3f& camPos) const;
-    void WriteIntermediateTextureData(float* mappedHeights, int level, Vec2i levelGlobalMin, Vec2i levelGlobalMax);
+    void UpdateResidentHeights(int level, Vec2i levelGlobalMin, Vec2i levelGlobalMax);
+    void WriteUploadStrip(uint8* strip, int rowPitch, int level, Vec2i texMin, Vec2i texMax, float& inOutLow, float& inOutHigh) const;
+    void WriteCompressedUploadStrip(uint8* strip, int rowPitch, int level, Vec2i texMin, Vec2i texMax, float& inOutLow, float& inOutHigh);
+    HeightRange CalcGeneratedHeightRange() const;
+    void UpdatePatchHeightBounds();
+    void UpdateRingBounds();
+    Vec2f CalcRenderedHeightBounds(Vec2f worldMin, Vec2f worldMax) const;
+    Vec2f CalcRingHeightBounds(Vec2f worldMin, Vec2f worldMax) const;
+    Vec2f CalcLevelRegionHeightBounds(int level, Vec2f worldMin, Vec2f worldMax) const;
+    void UpdateHorizon(const Vec3f& camPos, bool drawnSurfaceChanged);
+    void RasteriseOccluders(const Vec3f& camPos, const Mat4f& viewProj);
+    void DrawPatches(Renderer& renderer, const Mat4f& viewProj, const HorizonCuller* horizon, VisiblePatches& patches);
+    void DrawRings(Renderer& renderer, const Mat4f& viewProj, const HorizonCuller* horizon, VisiblePatches& patches);
+    WrappedHeightfield GetResidentHeightfield(int level) const;
+    void ToLevelTexelSpace(int level, const Rayf& ray, Vec3f& outOrigin, Vec3f& outDir) const;
+    int FindCoveringLevel(const Vec3f& boundsMin, const Vec3f& boundsMax) const;
+    int FindSweepLevel(const Vec3f& boundsMin, const Vec3f& boundsMax) const;
+    Vec3f GetLevelSweepOffset(int level) const;
+    void GatherSweepHeightfield(int level, const Vec3f& boundsMin, const Vec3f& boundsMax, GatheredHeightfield& out) const;
+    bool SweepSphereLocked(const Spheref& sphere, const Vec3f& delta, SweepHit& outHit) const;
+    bool SweepCapsuleLocked(const Capsulef& capsule, const Vec3f& delta, SweepHit& outHit) const;
+    void RewriteGrownLevels(Renderer& renderer, Vec2i texelOffset);
+    void BenchmarkCpuNormals();
+    void BenchmarkHeightQueries();
+    void BenchmarkMeshExtraction();
+    void BenchmarkPatchOrders(const Mat4f& viewProj);
+    void BenchmarkRoughness();
+    void BenchmarkOcclusionRaster(const Vec3f& camPos, const Mat4f& viewProj);
 
     // Rendering objects.
     ComPtr<ID3D12PipelineState> m_pipelineState;
@@ -76,19 +289,77 @@ private:
     std::unique_ptr<TerrainComputeNormals> m_computeNormals;
 
     // Heightmap data, lazily populated as tiles are edited (otherwise data is just created from noise on demand).
-    std::unordered_map<Vec2i, HeightmapData> m_tileCaches[NumClipLevels];
+    // Edits are applied on the edit queue's worker thread, so the tile caches and the dirty region are guarded by m_tileCacheMutex.
+    std::unordered_map<Vec2i, HeightmapData> m_tileCaches[MaxClipLevels];
+    std::unordered_map<Vec2i, MinMaxPyramid> m_tileBounds[MaxClipLevels]; // For every cached tile.
+    mutable std::mutex m_tileCacheMutex;
+    TerrainEditQueue m_editQueue;
+    EditStats m_editStats;
 
     // Clipmap and vertex data.
-    ClipmapLevel m_clipmapLevels[NumClipLevels];
+    ClipmapConfig m_config;
+    ClipmapLevel m_clipmapLevels[MaxClipLevels];
+    ClipmapUpdater m_clipmapUpdater{ m_config.textureDimension };
+    HeightRange m_heightRanges[MaxClipLevels];          // Only used for compact heights; the identity range otherwise.
+    bool m_heightRangeGrown[MaxClipLevels] = {};        // Level needs rewriting since its range changed.
+    int m_heightRangeGrowCounts[MaxClipLevels] = {};
+    float m_maxNormalEncodingError = 0.f;               // In degrees.
+    NormalsBenchmark m_normalsBenchmark;
+    HeightQueryBenchmark m_heightQueryBenchmark;
+    MeshExtractionBenchmark m_meshExtractionBenchmark;
+    float m_meshExtractionMaxError = 0.25f;
+    BlockCompressionQuality::E m_compressionQuality = BlockCompressionQuality::Fast;
+    CompressionStats m_compressionStats;
     VertexBuffer m_vertexBuffer;
     IndexBuffer m_indexBuffer;
+    PatchCuller m_patchCuller;
+    PatchOrder::E m_patchOrder = PatchOrder::Hilbert; // Of the full index buffer, the culled lists and the ring pieces.
+    PatchOrderBenchmark m_patchOrderBenchmark;
+
+    // Each clip level's roughness pyramid, one after another, for screen-space error tessellation in the hull shader.
+    // Each frame in flight has its own copy, rewritten after the heights change.
+    ComPtr<ID3D12Resource> m_roughnessBuffers[BackbufferCount];
+    float* m_mappedRoughness[BackbufferCount] = {};
+    int m_roughnessDirtyFrames = 0; // Copies that are out of date.
+    bool m_screenSpaceErrorTess = true;
+    float m_tessPixelError = 1.f;
+    RoughnessBenchmark m_roughnessBenchmark;
+    VisiblePatches m_viewPatches;
+    VisiblePatches m_shadowPatches[MaxShadowCascades];
+    bool m_patchBoundsDirty = true; // Clipmap heights changed since the patch (or ring instance) bounds were last updated.
+    bool m_cullPatches = true;
+
+    // Occlusion of the view pass's patches by the drawn ground nearer the camera. Shadow passes see the terrain from the sun, so they don't use it.
+    HorizonCuller m_horizonCuller;
+    bool m_horizonCulling = true;
+    int m_numHorizonOccluders = 0; // That can occlude, i.e. are over drawn ground.
+    float m_horizonBuildMs = 0.f;
+
+    // Software depth buffer of the horizon's cells, as boxes under the ground, for occlusion culling objects. Off by default since
+    // nothing draws objects yet; TestOcclusion() is what they'd use.
+    OcclusionRasteriser m_occlusionRasteriser;
+    TriangleMesh m_occluderMesh;
+    bool m_occlusionRaster = false;
+    float m_occlusionRasterMs = 0.f;
+    OcclusionRasterBenchmark m_occlusionRasterBenchmark;
+
+    // Camera-following rings of patches, the default, drawn instead of the fixed grid.
+    ClipmapRings m_clipmapRings;
+    VertexBuffer m_ringVertexBuffer;                  // Every piece's vertices, in the piece's own patches.
+    IndexBuffer m_ringIndexBuffer;
+    RingPieceMesh m_ringPieceMeshes[RingPiece::Count];
+    VertexBuffer m_gridInstanceBuffer;                // A single instance that leaves the grid where it is.
+    AABBBatch m_ringInstanceBoxes;                    // Of each ring instance, in the same order.
+    std::vector<uint32> m_ringCullMask;
+    bool m_useRings = true;
     uint64 m_computeFenceVal = 0;
     Vec2i m_clipmapTexelOffset = Vec2iZero;
     Vec2i m_globalDirtyRegionMin = Vec2iZero;
     Vec2i m_globalDirtyRegionMax = Vec2iZero; // Inclusive bounds.
     
     // Water rendering data (TODO: Move water to it's own class).
-    VertexBuffer m_waterVertexBuffer;
+    VertexBuffer m_waterVertexBuffers[BackbufferCount]; // Follows whichever terrain is drawn, so it's rewritten each frame.
+    WaterVertex* m_mappedWaterVertices[BackbufferCount] = {};
     IndexBuffer m_waterIndexBuffer;
     ComPtr<ID3D12PipelineState> m_waterPipelineState;
 
@@ -1,16 +1,14 @@
 #include "TerrainComputeNormals.hpp"
 #include "Renderer.hpp"
-#include "TerrainConstants.hpp"
 
 namespace gaia
 {
 
-using namespace TerrainConstants;
-
 struct ComputeNormalsConstants
 {
     Vec2i uvMin;
     float worldTexelSizeTimes8;
+    int textureMask;
 };
 
 namespace CalculateNormalsRootParam
@@ -36,11 +34,14 @@ bool TerrainComputeNormals::Init(Renderer& renderer)
     return true;
 }
 
-void TerrainComputeNormals::Compute(Renderer& renderer, ID3D12Resource* srcHeightMap, ID3D12Resource* dstNormalMap, Vec2i uvMin, Vec2i uvMax, int level)
+void TerrainComputeNormals::Compute(Renderer& renderer, ID3D12Resource* srcHeightMap, ID3D12Resource* dstNormalMap, Vec2i uvMin, Vec2i uvMax, float worldTexelSize)
 {
     // Validate inputs and ensure we don't wrap around the normalmap multiple times.
+    D3D12_RESOURCE_DESC heightMapDesc = srcHeightMap->GetDesc();
+    const int textureDimension = (int)heightMapDesc.Width;
+    Assert(heightMapDesc.Height == heightMapDesc.Width && math::IsPow2(textureDimension));
     Assert(uvMax.x > uvMin.x && uvMax.y > uvMin.y);
-    uvMax = math::min(uvMax, uvMin + Vec2i(HeightmapDimension, HeightmapDimension));
+    uvMax = math::min(uvMax, uvMin + Vec2i(textureDimension, textureDimension));
 
     const int NumThreads = 8;
 
@@ -56,12 +57,13 @@ void TerrainComputeNormals::Compute(Renderer& renderer, ID3D12Resource* srcHeigh
     uvMin = math::RoundDownPow2(uvMin, Vec2i(NumThreads, NumThreads));
     uvMax = math::RoundUpPow2(uvMax, Vec2i(NumThreads, NumThreads));
     constants.uvMin = uvMin;
-    constants.worldTexelSizeTimes8 = 8.f * TerrainConstants::TexelSize * float(1 << level);
+    constants.worldTexelSizeTimes8 = 8.f * worldTexelSize;
+    constants.textureMask = textureDimension - 1;
     commandList.SetComputeRoot32BitConstants(CalculateNormalsRootParam::CalculateNormalsConstants, sizeof(constants) / 4, &constants, 0);
 
     // Bind textures
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-    srvDesc.Format = srcHeightMap->GetDesc().Format;
+    srvDesc.Format = heightMapDesc.Format;
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MipLevels = 1;
@@ -9,7 +9,7 @@ class TerrainComputeNormals
 {
 public:
     bool Init(Renderer& renderer);
-    void Compute(Renderer& renderer, ID3D12Resource* srcHeightMap, ID3D12Resource* dstNormalMap, Vec2i uvMin, Vec2i uvMax, int level);
+    void Compute(Renderer& renderer, ID3D12Resource* srcHeightMap, ID3D12Resource* dstNormalMap, Vec2i uvMin, Vec2i uvMax, float worldTexelSize);
 
 private:
     bool CreateRootSignature(Renderer& renderer);
@@ -0,0 +1,78 @@
+#include "TerrainEditQueue.hpp"
+
+namespace gaia
+{
+
+TerrainEditQueue::~TerrainEditQueue()
+{
+    Stop();
+}
+
+void TerrainEditQueue::Start(ApplyFunc applyFunc)
+{
+    Assert(!m_thread.joinable());
+    m_applyFunc = std::move(applyFunc);
+    m_stopping = false;
+    m_thread = std::thread([this]() { WorkerMain(); });
+}
+
+void TerrainEditQueue::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_workAvailable.notify_one();
+    m_thread.join();
+}
+
+void TerrainEditQueue::Push(const RaiseCommand& command)
+{
+    Assert(m_thread.joinable());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(command);
+    }
+
+    m_workAvailable.notify_one();
+}
+
+void TerrainEditQueue::Flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_pending.empty() && !m_busy; });
+}
+
+void TerrainEditQueue::WorkerMain()
+{
+    std::vector<RaiseCommand> batch;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_workAvailable.wait(lock, [this]() { return m_stopping || !m_pending.empty(); });
+
+        // Finish off anything already queued before stopping, so no edits are lost.
+        if (m_pending.empty())
+            break;
+
+        // Take everything queued so far and apply it without holding the lock,
+        // so the main thread can keep queuing commands.
+        batch.clear();
+        std::swap(batch, m_pending);
+        m_busy = true;
+        lock.unlock();
+
+        m_applyFunc(batch);
+
+        lock.lock();
+        m_busy = false;
+        m_idle.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * Queues terrain edit commands from the main thread and applies them on a worker thread.
+ * Commands are handed to the apply function in batches (everything queued since the last batch started),
+ * so the worker can coalesce work such as mip propagation across several strokes.
+ * The apply function is responsible for synchronising access to whatever data it modifies.
+ */
+class TerrainEditQueue
+{
+public:
+    struct RaiseCommand
+    {
+        Vec2f posXZ;
+        float radius;
+        float raiseBy;
+    };
+
+    using ApplyFunc = std::function<void(const std::vector<RaiseCommand>&)>;
+
+    ~TerrainEditQueue();
+
+    void Start(ApplyFunc applyFunc);
+    void Stop();
+    void Push(const RaiseCommand& command);
+
+    // Blocks until every command queued so far has been applied.
+    void Flush();
+
+private:
+    void WorkerMain();
+
+    ApplyFunc m_applyFunc;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_idle;
+    std::vector<RaiseCommand> m_pending;
+    bool m_busy = false;
+    bool m_stopping = false;
+};
+
+}
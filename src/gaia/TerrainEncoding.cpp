@@ -0,0 +1,128 @@
+#include "TerrainEncoding.hpp"
+
+namespace gaia
+{
+
+HeightRange HeightRange::Grow(float low, float high) const
+{
+    // Leave a quarter of the new range spare so that repeatedly editing in the same direction doesn't grow it every time.
+    HeightRange ret = *this;
+    float headroom = 0.25f * (std::max(high, max) - std::min(low, min));
+    if (low < min)
+    {
+        ret.min = low - headroom;
+    }
+    if (high > max)
+    {
+        ret.max = high + headroom;
+    }
+    return ret;
+}
+
+void EncodeHeightsUnorm16(uint16* dst, const float* src, int count, const HeightRange& range, float& inOutLow, float& inOutHigh)
+{
+    Assert(range.Scale() > 0.f);
+    const float invScale = 65535.f / range.Scale();
+
+    int i = 0;
+    if (count >= 8)
+    {
+        const __m128 bias = _mm_set1_ps(range.min);
+        const __m128 scale = _mm_set1_ps(invScale);
+        const __m128 maxTexel = _mm_set1_ps(65535.f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128i signFlip32 = _mm_set1_epi32(0x8000);
+        const __m128i signFlip16 = _mm_set1_epi16((short)0x8000);
+        __m128 low = _mm_set1_ps(inOutLow);
+        __m128 high = _mm_set1_ps(inOutHigh);
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 h0 = _mm_loadu_ps(src + i);
+            __m128 h1 = _mm_loadu_ps(src + i + 4);
+            low = _mm_min_ps(low, _mm_min_ps(h0, h1));
+            high = _mm_max_ps(high, _mm_max_ps(h0, h1));
+
+            // Scale to [0, 65535], clamp and round to nearest.
+            __m128 t0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(h0, bias), scale), _mm_setzero_ps()), maxTexel);
+            __m128 t1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(h1, bias), scale), _mm_setzero_ps()), maxTexel);
+            __m128i i0 = _mm_cvttps_epi32(_mm_add_ps(t0, half));
+            __m128i i1 = _mm_cvttps_epi32(_mm_add_ps(t1, half));
+
+            // SSE2 only has a signed saturating pack, so shift into the signed range and back again.
+            __m128i packed = _mm_packs_epi32(_mm_sub_epi32(i0, signFlip32), _mm_sub_epi32(i1, signFlip32));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(packed, signFlip16));
+        }
+
+        float lows[4];
+        float highs[4];
+        _mm_storeu_ps(lows, low);
+        _mm_storeu_ps(highs, high);
+        inOutLow = *std::min_element(lows, lows + 4);
+        inOutHigh = *std::max_element(highs, highs + 4);
+    }
+
+    for (; i < count; ++i)
+    {
+        inOutLow = std::min(inOutLow, src[i]);
+        inOutHigh = std::max(inOutHigh, src[i]);
+        float texel = math::clamp((src[i] - range.min) * invScale, 0.f, 65535.f);
+        dst[i] = (uint16)(texel + 0.5f);
+    }
+}
+
+Vec2f EncodeOctahedral(const Vec3f& normal)
+{
+    // Project onto the octahedron |x| + |y| + |z| = 1, then unfold the lower half over the corners of the upper half.
+    Vec3f p = normal / (fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z));
+    Vec2f encoded(p.x, p.z);
+    if (p.y < 0.f)
+    {
+        encoded = Vec2f((1.f - fabsf(p.z)) * (p.x >= 0.f ? 1.f : -1.f),
+                        (1.f - fabsf(p.x)) * (p.z >= 0.f ? 1.f : -1.f));
+    }
+    return encoded;
+}
+
+Vec3f DecodeOctahedral(Vec2f encoded)
+{
+    Vec3f n(encoded.x, 1.f - fabsf(encoded.x) - fabsf(encoded.y), encoded.y);
+    float t = std::max(-n.y, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.z += n.z >= 0.f ? -t : t;
+    return math::normalize(n);
+}
+
+Vec2f QuantiseSnorm(Vec2f value, int bits)
+{
+    Assert(2 <= bits && bits <= 16);
+    const float maxValue = (float)((1 << (bits - 1)) - 1);
+    Vec2f ret;
+    for (int i = 0; i < 2; ++i)
+    {
+        ret[i] = roundf(math::clamp(value[i], -1.f, 1.f) * maxValue) / maxValue;
+    }
+    return ret;
+}
+
+float MeasureMaxOctahedralError(int bits, int numSamples)
+{
+    // Fibonacci sphere: evenly spaced heights, with a golden angle turn between consecutive samples.
+    const float goldenAngle = Pif * (3.f - sqrtf(5.f));
+    float maxChord = 0.f;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float y = 1.f - 2.f * ((float)i + 0.5f) / (float)numSamples;
+        float radius = sqrtf(std::max(1.f - y * y, 0.f));
+        float angle = goldenAngle * (float)i;
+        Vec3f normal(radius * cosf(angle), y, radius * sinf(angle));
+
+        Vec3f decoded = DecodeOctahedral(QuantiseSnorm(EncodeOctahedral(normal), bits));
+        maxChord = std::max(maxChord, math::length(decoded - normal));
+    }
+
+    // Use the chord length rather than acos(dot()), which can't resolve angles this small in single precision.
+    return 2.f * asinf(std::min(0.5f * maxChord, 1.f)) * 180.f / Pif;
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * Range of heights stored by a compact (16 bit unorm) height map: height = texel / 65535 * Scale() + min.
+ * The shaders are given the scale and bias for each clip level, so a float height map just uses the identity range.
+ */
+struct HeightRange
+{
+    float min = 0.f;
+    float max = 1.f;
+
+    float Scale() const { return max - min; }
+    float MaxQuantisationError() const { return 0.5f * Scale() / 65535.f; }
+    bool Contains(float low, float high) const { return min <= low && high <= max; }
+
+    // Returns a range that also includes [low, high], plus some headroom on whichever side grew.
+    HeightRange Grow(float low, float high) const;
+};
+
+// Encodes count heights as 16 bit unorms, clamping any outside the range.
+// Also widens [inOutLow, inOutHigh] to include every source height, so callers can tell whether anything was clamped.
+void EncodeHeightsUnorm16(uint16* dst, const float* src, int count, const HeightRange& range, float& inOutLow, float& inOutHigh);
+
+inline float DecodeHeightUnorm16(uint16 texel, const HeightRange& range)
+{
+    return (float)texel / 65535.f * range.Scale() + range.min;
+}
+
+// Octahedral normal encoding, folded around +Y so that terrain normals (which always point up) never hit the fold.
+// Must match TerrainComputeNormals.hlsl and TerrainDomain.hlsl.
+Vec2f EncodeOctahedral(const Vec3f& normal);
+Vec3f DecodeOctahedral(Vec2f encoded);
+
+// Rounds each component to the nearest value representable by a signed normalised integer with the given number of bits.
+Vec2f QuantiseSnorm(Vec2f value, int bits);
+
+// Largest angle (in degrees) between a unit vector and its decoded octahedral encoding at the given precision,
+// over an even spread of numSamples directions covering the whole sphere.
+float MeasureMaxOctahedralError(int bits, int numSamples);
+
+}
@@ -0,0 +1,96 @@
+#include "ThreadPool.hpp"
+
+namespace gaia
+{
+
+// Set while a thread is running items, so nested ParallelFor() calls don't wait on the job they're part of.
+static thread_local bool t_inParallelFor = false;
+
+ThreadPool::ThreadPool(int numWorkers)
+{
+    Assert(numWorkers >= 0);
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        m_workers.emplace_back([this]() { WorkerMain(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& func)
+{
+    if (count <= 1 || m_workers.empty() || t_inParallelFor)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            func(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> jobLock(m_jobMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_count = count;
+        m_nextIndex = 0;
+        m_numBusyWorkers = (int)m_workers.size();
+        ++m_jobID;
+    }
+
+    m_workAvailable.notify_all();
+    RunItems();
+
+    // Items are all claimed by now, but wait for the workers to finish theirs (and stop touching func).
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workersDone.wait(lock, [this]() { return m_numBusyWorkers == 0; });
+    m_func = nullptr;
+}
+
+void ThreadPool::WorkerMain()
+{
+    uint64 lastJobID = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [&]() { return m_stopping || m_jobID != lastJobID; });
+            if (m_stopping)
+                return;
+
+            lastJobID = m_jobID;
+        }
+
+        RunItems();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_numBusyWorkers == 0)
+        {
+            m_workersDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunItems()
+{
+    t_inParallelFor = true;
+    for (int i = m_nextIndex++; i < m_count; i = m_nextIndex++)
+    {
+        (*m_func)(i);
+    }
+    t_inParallelFor = false;
+}
+
+}
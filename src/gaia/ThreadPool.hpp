@@ -0,0 +1,46 @@
+#pragma once
+
+namespace gaia
+{
+
+/*
+ * A fixed set of worker threads for splitting data-parallel work (e.g. one item per tile) across cores.
+ * ParallelFor() blocks until every item is done, with the calling thread working through items alongside the workers.
+ * Only one ParallelFor() runs at a time; a nested call from inside an item just runs its items serially.
+ */
+class ThreadPool
+{
+public:
+    static ThreadPool& Instance()
+    {
+        static ThreadPool inst(std::max((int)std::thread::hardware_concurrency() - 1, 0));
+        return inst;
+    }
+
+    explicit ThreadPool(int numWorkers);
+    ~ThreadPool();
+
+    // Including the calling thread.
+    int GetNumThreads() const { return (int)m_workers.size() + 1; }
+
+    // Calls func(i) for every i in [0, count), in any order and on any thread.
+    void ParallelFor(int count, const std::function<void(int)>& func);
+
+private:
+    void WorkerMain();
+    void RunItems();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_jobMutex; // Held for the duration of a ParallelFor().
+    std::mutex m_mutex;    // Guards the job state below.
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workersDone;
+    const std::function<void(int)>* m_func = nullptr;
+    int m_count = 0;
+    std::atomic<int> m_nextIndex = 0;
+    int m_numBusyWorkers = 0;
+    uint64 m_jobID = 0;
+    bool m_stopping = false;
+};
+
+}
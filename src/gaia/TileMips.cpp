@@ -0,0 +1,27 @@
+#include "TileMips.hpp"
+
+namespace gaia
+{
+
+void DownsampleRows(float* dst, const float* srcRow0, const float* srcRow1, int count)
+{
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // Sum vertically, then pairwise add neighbouring columns.
+        __m128 lo = _mm_add_ps(_mm_loadu_ps(srcRow0 + 2 * i), _mm_loadu_ps(srcRow1 + 2 * i));
+        __m128 hi = _mm_add_ps(_mm_loadu_ps(srcRow0 + 2 * i + 4), _mm_loadu_ps(srcRow1 + 2 * i + 4));
+        __m128 even = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 odd = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(even, odd), quarter));
+    }
+
+    // Summed in the same order as the lanes above, so a texel comes out the same whichever path it takes.
+    for (; i < count; ++i)
+    {
+        dst[i] = ((srcRow0[2 * i] + srcRow1[2 * i]) + (srcRow0[2 * i + 1] + srcRow1[2 * i + 1])) * 0.25f;
+    }
+}
+
+}
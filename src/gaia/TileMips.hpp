@@ -0,0 +1,10 @@
+#pragma once
+
+namespace gaia
+{
+
+// Writes count texels to dst, each the average of the 2x2 block under it in the two source rows, which are 2 * count long.
+// Four at a time with SSE, then the rest one at a time, so it writes exactly count and no more.
+void DownsampleRows(float* dst, const float* srcRow0, const float* srcRow1, int count);
+
+}
@@ -4,21 +4,17 @@ namespace gaia
 {
 
 Timer::Timer()
+    : m_lastTick(std::chrono::steady_clock::now())
 {
-    ::QueryPerformanceFrequency(&m_ticksPerSecond);
-    ::QueryPerformanceCounter(&m_lastTick);
 }
 
 float Timer::GetSecondsAndReset()
 {
-    LARGE_INTEGER newTick;
-    ::QueryPerformanceCounter(&newTick);
-
-    LARGE_INTEGER elapsedTicks;
-    elapsedTicks.QuadPart = newTick.QuadPart - m_lastTick.QuadPart;
+    std::chrono::steady_clock::time_point newTick = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = newTick - m_lastTick;
     m_lastTick = newTick;
 
-    return (float)((double)elapsedTicks.QuadPart / (double)m_ticksPerSecond.QuadPart);
+    return (float)elapsed.count();
 }
 
 }
@@ -10,8 +10,7 @@ public:
     float GetSecondsAndReset();
 
 private:
-    LARGE_INTEGER m_ticksPerSecond;
-    LARGE_INTEGER m_lastTick;
+    std::chrono::steady_clock::time_point m_lastTick;
 };
 
 }
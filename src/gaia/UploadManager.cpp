@@ -4,22 +4,143 @@
 namespace gaia
 {
 
-void UploadManager::AddIntermediateResource(ID3D12Resource* resource)
+// Enough for the largest textures we load through the copy queue, and several frames of clipmap updates on the compute queue.
+static constexpr UINT64 RingSizes[UploadQueue::Count] = {
+    64 * 1024 * 1024, // Copy
+    16 * 1024 * 1024, // Compute
+};
+
+#ifdef _DEBUG
+static const wchar_t* RingNames[UploadQueue::Count] = { L"CopyUploadRing", L"ComputeUploadRing" };
+#endif
+
+UploadManager::UploadManager(ID3D12Device* device, CommandQueue* (&queues)[UploadQueue::Count])
+    : m_device(device)
+{
+    for (int i = 0; i < UploadQueue::Count; ++i)
+    {
+        Ring& ring = m_rings[i];
+        ring.commandQueue = queues[i];
+        ring.buffer = CreateUploadBuffer(RingSizes[i]);
+        ring.allocator = std::make_unique<RingAllocator>(RingSizes[i]);
+
+        // Upload heaps are write-combined and can stay mapped for their whole lifetime; we never read from them.
+        D3D12_RANGE readRange = {};
+        ring.buffer->Map(0, &readRange, (void**)&ring.mappedData);
+        Assert(ring.mappedData);
+
+#ifdef _DEBUG
+        ring.buffer->SetName(RingNames[i]);
+#endif
+    }
+}
+
+UploadManager::~UploadManager()
 {
-    m_intermediateResources.push_back(resource);
+    for (Ring& ring : m_rings)
+    {
+        ring.buffer->Unmap(0, nullptr);
+    }
 }
 
-void UploadManager::BeginFrame(CommandQueue& commandQueue)
+UploadAllocation UploadManager::Allocate(UploadQueue::E queue, UINT64 size, UINT64 alignment)
 {
-    // Wait for last frame's uploads to complete.
-    if (m_fenceValue != 0)
+    Ring& ring = m_rings[queue];
+    UINT64 offset = ring.allocator->Allocate(size, alignment);
+    if (offset == RingAllocator::InvalidOffset)
     {
-        commandQueue.WaitFence(m_fenceValue);
-        m_fenceValue = 0;
+        // Free anything that has already finished, then wait on older uploads one at a time until we fit.
+        Retire(ring, ring.commandQueue->GetCompletedFenceValue());
+        offset = ring.allocator->Allocate(size, alignment);
+        while (offset == RingAllocator::InvalidOffset && ring.allocator->GetNumBatchesInFlight() > 0)
+        {
+            UINT64 fenceValue = ring.allocator->GetOldestFenceValue();
+            ring.commandQueue->WaitFence(fenceValue);
+            Retire(ring, fenceValue);
+            offset = ring.allocator->Allocate(size, alignment);
+        }
     }
 
-    // Destroy any resources references we were holding while they uploaded.
-    m_intermediateResources.clear();
+    UploadAllocation ret;
+    if (offset != RingAllocator::InvalidOffset)
+    {
+        ret.buffer = ring.buffer.Get();
+        ret.offset = offset;
+        ret.cpuAddress = ring.mappedData + offset;
+        return ret;
+    }
+
+    // Too big for what's left of the ring, even once everything already submitted has completed.
+    ComPtr<ID3D12Resource> fallback = CreateUploadBuffer(size);
+    D3D12_RANGE readRange = {};
+    fallback->Map(0, &readRange, (void**)&ret.cpuAddress);
+    Assert(ret.cpuAddress);
+    ret.buffer = fallback.Get();
+    ring.pendingFallbacks.push_back(std::move(fallback));
+    ring.fallbackBytes += size;
+    return ret;
+}
+
+void UploadManager::Submit(UploadQueue::E queue, UINT64 fenceValue)
+{
+    Ring& ring = m_rings[queue];
+    ring.allocator->Submit(fenceValue);
+    ring.unwaitedFenceValue = fenceValue;
+    for (ComPtr<ID3D12Resource>& fallback : ring.pendingFallbacks)
+    {
+        fallback->Unmap(0, nullptr);
+        ring.fallbacksInFlight.emplace_back(fenceValue, std::move(fallback));
+    }
+    ring.pendingFallbacks.clear();
+}
+
+void UploadManager::BeginFrame()
+{
+    // Wait for last frame's copies to complete; the direct queue doesn't wait on the copy queue before using their results.
+    Ring& copyRing = m_rings[UploadQueue::Copy];
+    if (copyRing.unwaitedFenceValue != 0)
+    {
+        copyRing.commandQueue->WaitFence(copyRing.unwaitedFenceValue);
+        copyRing.unwaitedFenceValue = 0;
+    }
+
+    // Free anything the GPU has finished with.
+    for (Ring& ring : m_rings)
+    {
+        Retire(ring, ring.commandQueue->GetCompletedFenceValue());
+    }
+}
+
+void UploadManager::Imgui()
+{
+    const char* QueueNames[UploadQueue::Count] = { "Copy", "Compute" };
+    for (int i = 0; i < UploadQueue::Count; ++i)
+    {
+        const Ring& ring = m_rings[i];
+        ImGui::Text("%s upload ring: %llu/%llu KB, %d batches in flight", QueueNames[i],
+                    ring.allocator->GetUsedBytes() / 1024, ring.allocator->GetCapacity() / 1024, ring.allocator->GetNumBatchesInFlight());
+        ImGui::Text("%s fallback uploads: %llu KB total", QueueNames[i], ring.fallbackBytes / 1024);
+    }
+}
+
+void UploadManager::Retire(Ring& ring, UINT64 completedFenceValue)
+{
+    ring.allocator->Retire(completedFenceValue);
+
+    auto firstInFlight = std::remove_if(ring.fallbacksInFlight.begin(), ring.fallbacksInFlight.end(),
+        [completedFenceValue](const Pair<UINT64, ComPtr<ID3D12Resource>>& fallback) { return fallback.first <= completedFenceValue; });
+    ring.fallbacksInFlight.erase(firstInFlight, ring.fallbacksInFlight.end());
+}
+
+ComPtr<ID3D12Resource> UploadManager::CreateUploadBuffer(UINT64 size)
+{
+    ComPtr<ID3D12Resource> ret;
+    CD3DX12_HEAP_PROPERTIES uploadHeapProps(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    m_device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &resourceDesc,
+                                      D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&ret));
+    Assert(ret);
+    return ret;
 }
 
 }
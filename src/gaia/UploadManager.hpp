@@ -1,5 +1,7 @@
 #pragma once
+#include "RingAllocator.hpp"
 
+interface ID3D12Device;
 interface ID3D12Resource;
 
 namespace gaia
@@ -7,16 +9,64 @@ namespace gaia
 
 class CommandQueue;
 
+namespace UploadQueue
+{
+enum E
+{
+    Copy,
+    Compute,
+    Count
+};
+}
+
+// A range of upload memory to write to and copy from. Only valid until the upload has been submitted and completed.
+struct UploadAllocation
+{
+    ID3D12Resource* buffer = nullptr;
+    UINT64 offset = 0;
+    uint8* cpuAddress = nullptr;
+};
+
+/*
+ * Owns a persistently mapped upload ring for each queue that uploads are recorded on.
+ * Allocations are released when the fence value signalled by the submission that used them completes.
+ * Allocations too big for the ring get their own committed buffer, which is held until the same point.
+ */
 class UploadManager
 {
 public:
-    void AddIntermediateResource(ID3D12Resource* resource);
-    void BeginFrame(CommandQueue& commandQueue);
-    void SetFenceValue(UINT64 fenceValue) { m_fenceValue = fenceValue; }
+    UploadManager(ID3D12Device* device, CommandQueue* (&queues)[UploadQueue::Count]);
+    ~UploadManager();
+
+    // May block waiting for earlier uploads on the same queue if the ring is full.
+    [[nodiscard]] UploadAllocation Allocate(UploadQueue::E queue, UINT64 size, UINT64 alignment);
+
+    // Marks everything allocated for a queue since the last submission as in use until fenceValue completes.
+    void Submit(UploadQueue::E queue, UINT64 fenceValue);
+
+    // Waits for the previous frame's copies, then frees whatever the GPU has finished with.
+    void BeginFrame();
+
+    void Imgui();
 
 private:
-    std::vector<ComPtr<ID3D12Resource>> m_intermediateResources;
-    UINT64 m_fenceValue;
+    struct Ring
+    {
+        CommandQueue* commandQueue = nullptr;
+        ComPtr<ID3D12Resource> buffer;
+        uint8* mappedData = nullptr;
+        std::unique_ptr<RingAllocator> allocator;
+        std::vector<ComPtr<ID3D12Resource>> pendingFallbacks;
+        std::vector<Pair<UINT64, ComPtr<ID3D12Resource>>> fallbacksInFlight;
+        UINT64 fallbackBytes = 0;
+        UINT64 unwaitedFenceValue = 0;
+    };
+
+    void Retire(Ring& ring, UINT64 completedFenceValue);
+    ComPtr<ID3D12Resource> CreateUploadBuffer(UINT64 size);
+
+    ID3D12Device* m_device;
+    Ring m_rings[UploadQueue::Count];
 };
 
 }
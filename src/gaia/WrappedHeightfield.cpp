@@ -0,0 +1,21 @@
+#include "WrappedHeightfield.hpp"
+#include "MinMaxPyramid.hpp"
+
+namespace gaia
+{
+
+Vec2f WrappedHeightfield::GetNodeCellBounds(int level, Vec2i node) const
+{
+    // The cells along the node's far edges also use texels from the next nodes along, so take those in too.
+    const int mask = bounds->GetLevelDimension(level) - 1;
+    Vec2f cellBounds(FLT_MAX, -FLT_MAX);
+    for (int i = 0; i < 4; ++i)
+    {
+        Vec2f nodeBounds = bounds->GetNode(level, (node + Vec2i(i & 1, i >> 1)) & mask);
+        cellBounds.x = std::min(cellBounds.x, nodeBounds.x);
+        cellBounds.y = std::max(cellBounds.y, nodeBounds.y);
+    }
+    return cellBounds;
+}
+
+}
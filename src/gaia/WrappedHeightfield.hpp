@@ -0,0 +1,29 @@
+#pragma once
+
+namespace gaia
+{
+
+class MinMaxPyramid;
+
+/*
+ * A wrapped (toroidal) height map, like the CPU copy of a clipmap level, and which texels of level global texel space it currently holds.
+ * Texel (x, z) of level global space lives at ((x, z) & (dimension - 1)) in the map.
+ */
+struct WrappedHeightfield
+{
+    const float* heights = nullptr;        // dimension^2 heights, row major.
+    const MinMaxPyramid* bounds = nullptr; // Over heights, in the same (wrapped) layout. Only needed for raycasts.
+    int dimension = 0;
+    Vec2i validMin = Vec2iZero;            // First texel held; the next dimension texels along each axis are valid.
+
+    float GetHeight(Vec2i levelGlobalCoords) const
+    {
+        Vec2i coords = levelGlobalCoords & (dimension - 1);
+        return heights[dimension * coords.y + coords.x];
+    }
+
+    // Bounds of the cells in a pyramid node, whose coords are in level global space and wrap into the pyramid just like texels do.
+    Vec2f GetNodeCellBounds(int level, Vec2i node) const;
+};
+
+}
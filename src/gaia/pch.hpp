@@ -5,7 +5,14 @@
 #include <numeric>
 #include <algorithm>
 #include <vector>
+#include <deque>
 #include <unordered_map> // TODO: Write/use a real hashmap!
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -21,6 +28,8 @@
 #include <d3dcompiler.h>
 #include <dxgi1_6.h>
 
+#include <emmintrin.h>
+
 #include <imgui.h>
 
 #include "GaiaDefs.hpp"
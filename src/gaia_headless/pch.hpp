@@ -0,0 +1,25 @@
+#include <cstdlib>
+#include <climits>
+#include <cfloat>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <vector>
+#include <deque>
+#include <unordered_map> // TODO: Write/use a real hashmap!
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include <emmintrin.h>
+
+#include "GaiaDefs.hpp"
+#include "Math/GaiaMath.hpp"
+#include "Span.hpp"
@@ -3,7 +3,31 @@
 
 using namespace gaia;
 
-bool GaiaTestbedApp::Init(HWND hwnd)
+static ClipmapConfig ParseClipmapConfig(const char* cmdLine)
+{
+    // Optional overrides, e.g. "-clipLevels 6 -clipTexture 512 -clipTile 64 -vertexGrid 512 -ringBlock 8 -texelSize 0.1 -compactHeights -preciseNormals -compressedLevels 3".
+    ClipmapConfig config;
+    auto ParseArg = [cmdLine](const char* name, const char* format, auto* value)
+    {
+        if (const char* arg = strstr(cmdLine, name))
+        {
+            sscanf_s(arg + strlen(name), format, value);
+        }
+    };
+
+    ParseArg("-clipLevels", "%d", &config.numLevels);
+    ParseArg("-clipTexture", "%d", &config.textureDimension);
+    ParseArg("-clipTile", "%d", &config.tileDimension);
+    ParseArg("-vertexGrid", "%d", &config.vertexGridDimension);
+    ParseArg("-ringBlock", "%d", &config.ringBlockPatches);
+    ParseArg("-texelSize", "%f", &config.texelSize);
+    ParseArg("-compressedLevels", "%d", &config.compressedLevels);
+    config.compactHeights = strstr(cmdLine, "-compactHeights") != nullptr;
+    config.preciseNormals = strstr(cmdLine, "-preciseNormals") != nullptr;
+    return config;
+}
+
+bool GaiaTestbedApp::Init(HWND hwnd, const char* cmdLine)
 {
     m_hwnd = hwnd;
 
@@ -13,7 +37,7 @@ bool GaiaTestbedApp::Init(HWND hwnd)
     if (!m_renderer.Create(hwnd))
         return false;
 
-    if (!m_terrain.Init(m_renderer))
+    if (!m_terrain.Init(m_renderer, ParseClipmapConfig(cmdLine)))
         return false;
 
     if (!m_skybox.Init(m_renderer))
@@ -256,20 +280,22 @@ void GaiaTestbedApp::Update(float dt)
 
     if (m_terrainEditEnabled && !m_input.IsCursorLocked() && IsMouseInWindow())
     {
-        // Do mouse picking (before updating the camera matrix).
+        // Do mouse picking (before updating the camera matrix), by casting a ray from the near to the far plane through the cursor.
         Vec2i mousePos = m_input.GetMousePos();
-        float depth = m_renderer.ReadDepth((int)mousePos.x, (int)mousePos.y);
+        Mat4f oldCamMat = m_camera.GetMatrix();
+        Vec3f nearPointWorldSpace = math::Mat4fTransformVec3f(oldCamMat, m_renderer.Unproject(Vec3f((Vec2f)mousePos, 0.f)));
+        Vec3f farPointWorldSpace = math::Mat4fTransformVec3f(oldCamMat, m_renderer.Unproject(Vec3f((Vec2f)mousePos, 1.f)));
+        Rayf pickRay(nearPointWorldSpace, farPointWorldSpace - nearPointWorldSpace);
         constexpr float modifyRadius = 3.f;
-        if (depth < 1.f)
+        float pickDistance = 0.f;
+        if (m_terrain.Raycast(pickRay, pickDistance))
         {
-            Mat4f oldCamMat = m_camera.GetMatrix();
-            Vec3f pickPointViewSpace = m_renderer.Unproject(Vec3f((Vec2f)mousePos, depth));
-            Vec3f pickPointWorldSpace = math::Mat4fTransformVec3f(oldCamMat, pickPointViewSpace);
+            Vec3f pickPointWorldSpace = pickRay.m_start + pickDistance * pickRay.m_dir;
 
             if (m_input.IsMouseButtonDown(MouseButton::Left))
             {
                 float offset = m_input.IsSpecialKeyDown(SpecialKey::Ctrl) ? -0.005f : 0.005f;
-                m_terrain.RaiseAreaRounded(m_renderer, Vec2f(pickPointWorldSpace.x, pickPointWorldSpace.z), modifyRadius, offset);
+                m_terrain.RaiseAreaRounded(Vec2f(pickPointWorldSpace.x, pickPointWorldSpace.z), modifyRadius, offset);
             }
 
             highlightRadius = modifyRadius;
@@ -295,7 +321,11 @@ void GaiaTestbedApp::Render()
 
     // Shadow pass
     m_renderer.BeginShadowPass();
-    m_terrain.RenderShadowPass(m_renderer);
+    for (int cascade = 0; cascade < m_renderer.GetNumShadowCascades(); ++cascade)
+    {
+        m_renderer.SetShadowCascade(cascade);
+        m_terrain.RenderShadowPass(m_renderer);
+    }
     m_renderer.EndShadowPass();
 
     // "Geometry" pass (currently including anything renderering the to the main render target, excluding the renderer's own imgui)
@@ -10,7 +10,7 @@
 class GaiaTestbedApp
 {
 public:
-    bool Init(HWND hwnd);
+    bool Init(HWND hwnd, const char* cmdLine);
     LRESULT WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
     int Run();
 
@@ -35,7 +35,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, PSTR pCmdLine, int nCmdShow)
     if (hwnd == nullptr)
         return 1;
 
-    if (!g_app.Init(hwnd))
+    if (!g_app.Init(hwnd, pCmdLine))
         return 1;
 
     ::ShowWindow(hwnd, SW_SHOW);
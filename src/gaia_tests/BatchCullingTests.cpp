@@ -0,0 +1,210 @@
+#include "Test.hpp"
+#include "Math/BatchCulling.hpp"
+#include <random>
+
+using namespace gaia;
+
+static bool IsSet(const uint32* mask, int i)
+{
+    return (mask[i >> 5] >> (i & 31)) & 1;
+}
+
+// How near a box's furthest corner along some plane's normal is to that plane. The kernels work from the centre and extent, so
+// they may round the other way to the scalar test within a hair of it.
+static float DistanceToNearestPlane(const Frustumf& frustum, const AABB3f& box)
+{
+    float nearest = FLT_MAX;
+    for (const Planef& plane : frustum.m_planes)
+    {
+        const Vec3f inner = math::Vec3Select(box.m_max, box.m_min, math::greaterThanEqual(plane.m_normal, Vec3fZero));
+        nearest = std::min(nearest, fabsf(math::dot(inner, plane.m_normal) - plane.m_depth));
+    }
+    return nearest;
+}
+
+static Frustumf MakeFrustum(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    const Vec3f eye(100.f * random(rng) - 50.f, 20.f * random(rng), 100.f * random(rng) - 50.f);
+    const float yaw = 2.f * Pif * random(rng);
+    return Frustumf(math::perspectiveFovRH(1.f, 1920.f, 1080.f, 0.1f, 300.f) * math::lookAtRH(eye, eye + Vec3f(cosf(yaw), -0.2f, sinf(yaw)), Vec3fY));
+}
+
+// Every count from 0 to a few words' worth, from offsets that aren't a multiple of four: each bit says what Frustumf::Intersects()
+// does, bits past the count are clear, and the count returned is the number of bits set.
+static void TestCullingMatchesScalar()
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    constexpr int NumElements = 200;
+    AABBBatch boxes;
+    SphereBatch spheres;
+    boxes.Resize(NumElements);
+    spheres.Resize(NumElements);
+    std::vector<AABB3f> scalarBoxes;
+    std::vector<Spheref> scalarSpheres;
+    for (int i = 0; i < NumElements; ++i)
+    {
+        const Vec3f centre(400.f * random(rng) - 200.f, 60.f * random(rng) - 20.f, 400.f * random(rng) - 200.f);
+        const Vec3f extent(10.f * random(rng), 10.f * random(rng), 10.f * random(rng));
+        scalarBoxes.push_back({ centre - extent, centre + extent });
+        scalarSpheres.push_back(Spheref(centre, 10.f * random(rng)));
+        boxes.Set(i, scalarBoxes.back());
+        spheres.Set(i, scalarSpheres.back());
+    }
+    for (int i = 0; i < NumElements; ++i)
+    {
+        const AABB3f box = boxes.Get(i);
+        Check(box.m_min == scalarBoxes[i].m_min && box.m_max == scalarBoxes[i].m_max);
+    }
+
+    bool boxesMatch = true;
+    bool spheresMatch = true;
+    bool tailClear = true;
+    bool countsMatch = true;
+    int numVisible = 0;
+    int numNearPlane = 0;
+    std::vector<uint32> mask(CullMaskWords(NumElements) + 1);
+    for (int view = 0; view < 8; ++view)
+    {
+        const Frustumf frustum = MakeFrustum(rng);
+        for (int first : { 0, 3, 5, 37 })
+        {
+            for (int count = 0; first + count <= NumElements && count <= 100; ++count)
+            {
+                // A word past the end that must be left alone, and stale bits in the ones that are written.
+                std::fill(mask.begin(), mask.end(), 0xffffffffu);
+                int returned = CullAABBs(frustum, boxes, first, count, mask.data());
+                int numSet = 0;
+                for (int i = 0; i < count; ++i)
+                {
+                    const bool expected = frustum.Intersects(scalarBoxes[first + i]);
+                    if (IsSet(mask.data(), i) != expected)
+                    {
+                        const bool nearPlane = DistanceToNearestPlane(frustum, scalarBoxes[first + i]) < 1e-3f;
+                        boxesMatch &= nearPlane;
+                        numNearPlane += nearPlane;
+                    }
+                    numSet += IsSet(mask.data(), i);
+                }
+                for (int i = count; i < 32 * CullMaskWords(count); ++i)
+                {
+                    tailClear &= !IsSet(mask.data(), i);
+                }
+                tailClear &= mask[CullMaskWords(count)] == 0xffffffffu;
+                countsMatch &= returned == numSet;
+                numVisible += numSet;
+
+                std::fill(mask.begin(), mask.end(), 0xffffffffu);
+                returned = CullSpheres(frustum, spheres, first, count, mask.data());
+                numSet = 0;
+                for (int i = 0; i < count; ++i)
+                {
+                    const Spheref& sphere = scalarSpheres[first + i];
+                    if (IsSet(mask.data(), i) != frustum.Intersects(sphere))
+                    {
+                        float nearest = FLT_MAX;
+                        for (const Planef& plane : frustum.m_planes)
+                        {
+                            nearest = std::min(nearest, fabsf(math::dot(sphere.m_centre, plane.m_normal) + sphere.m_radius - plane.m_depth));
+                        }
+                        spheresMatch &= nearest < 1e-3f;
+                        numNearPlane += nearest < 1e-3f;
+                    }
+                    numSet += IsSet(mask.data(), i);
+                }
+                for (int i = count; i < 32 * CullMaskWords(count); ++i)
+                {
+                    tailClear &= !IsSet(mask.data(), i);
+                }
+                countsMatch &= returned == numSet;
+            }
+        }
+    }
+    Check(boxesMatch);
+    Check(spheresMatch);
+    Check(tailClear);
+    Check(countsMatch);
+    Check(numVisible > 0);
+    Check(numNearPlane < 10);
+}
+
+static bool NearlyEqual(const Vec3f& a, const Vec3f& b)
+{
+    return math::length(a - b) <= 1e-5f * std::max(math::length(a), 1.f);
+}
+
+// Counts that aren't a multiple of four, written to separate arrays and over the inputs: the same as the scalar transforms.
+static void TestTransformsMatchScalar()
+{
+    std::mt19937 rng(12);
+    std::uniform_real_distribution<float> random(-1.f, 1.f);
+    Mat3f stretch(1.5f);
+    stretch[1][1] = 0.5f;
+    const Mat4f m = math::Mat4fCompose(math::Mat3fMakeRotationY(0.7f) * math::Mat3fMakeRotationX(0.3f) * stretch, Vec3f(10.f, -4.f, 25.f));
+
+    bool pointsMatch = true;
+    bool inPlacePointsMatch = true;
+    bool boxesMatch = true;
+    bool inPlaceBoxesMatch = true;
+    for (int count : { 0, 1, 3, 4, 5, 7, 8, 13, 64, 67 })
+    {
+        std::vector<float> x(count), y(count), z(count);
+        AABBBatch boxes;
+        boxes.Resize(count);
+        std::vector<AABB3f> scalarBoxes;
+        for (int i = 0; i < count; ++i)
+        {
+            x[i] = 100.f * random(rng);
+            y[i] = 100.f * random(rng);
+            z[i] = 100.f * random(rng);
+            const Vec3f extent = 5.f * Vec3f(fabsf(random(rng)), fabsf(random(rng)), fabsf(random(rng)));
+            scalarBoxes.push_back({ Vec3f(x[i], y[i], z[i]) - extent, Vec3f(x[i], y[i], z[i]) + extent });
+            boxes.Set(i, scalarBoxes.back());
+        }
+
+        std::vector<float> outX(count + 1, -1.f), outY(count + 1, -1.f), outZ(count + 1, -1.f);
+        TransformPoints(m, x.data(), y.data(), z.data(), count, outX.data(), outY.data(), outZ.data());
+        for (int i = 0; i < count; ++i)
+        {
+            pointsMatch &= NearlyEqual(Vec3f(outX[i], outY[i], outZ[i]), math::Mat4fTransformVec3f(m, Vec3f(x[i], y[i], z[i])));
+        }
+        pointsMatch &= outX[count] == -1.f && outY[count] == -1.f && outZ[count] == -1.f;
+
+        std::vector<float> inPlaceX = x, inPlaceY = y, inPlaceZ = z;
+        TransformPoints(m, inPlaceX.data(), inPlaceY.data(), inPlaceZ.data(), count, inPlaceX.data(), inPlaceY.data(), inPlaceZ.data());
+        for (int i = 0; i < count; ++i)
+        {
+            inPlacePointsMatch &= inPlaceX[i] == outX[i] && inPlaceY[i] == outY[i] && inPlaceZ[i] == outZ[i];
+        }
+
+        AABBBatch outBoxes;
+        TransformAABBs(m, boxes, outBoxes);
+        Check(outBoxes.Size() == count);
+        for (int i = 0; i < count; ++i)
+        {
+            const AABB3f expected = scalarBoxes[i].Transformed(m);
+            const AABB3f box = outBoxes.Get(i);
+            boxesMatch &= NearlyEqual(box.m_min, expected.m_min) && NearlyEqual(box.m_max, expected.m_max);
+        }
+
+        TransformAABBs(m, boxes, boxes);
+        for (int i = 0; i < count; ++i)
+        {
+            const AABB3f box = boxes.Get(i);
+            const AABB3f expected = outBoxes.Get(i);
+            inPlaceBoxesMatch &= box.m_min == expected.m_min && box.m_max == expected.m_max;
+        }
+    }
+    Check(pointsMatch);
+    Check(inPlacePointsMatch);
+    Check(boxesMatch);
+    Check(inPlaceBoxesMatch);
+}
+
+int main()
+{
+    TestCullingMatchesScalar();
+    TestTransformsMatchScalar();
+    return test::Finish();
+}
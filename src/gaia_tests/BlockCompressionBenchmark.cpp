@@ -0,0 +1,67 @@
+#include "BlockCompression.hpp"
+#include "Timer.hpp"
+
+using namespace gaia;
+
+// Encoding throughput and error of each preset, over a clipmap level's worth of smooth heights and normals.
+int main()
+{
+    const int dimension = 256;
+    const int numRepeats = 10;
+    std::vector<float> heights(math::Square(dimension));
+    std::vector<Vec2f> normals(math::Square(dimension));
+    for (int z = 0; z < dimension; ++z)
+    {
+        for (int x = 0; x < dimension; ++x)
+        {
+            const float u = (float)x * 0.05f;
+            const float v = (float)z * 0.07f;
+            heights[dimension * z + x] = 0.5f + 0.25f * sinf(u) * cosf(v) + 0.05f * sinf(7.f * u + 3.f * v);
+            normals[dimension * z + x] = 0.6f * Vec2f(cosf(u) * cosf(v), -sinf(u) * sinf(v));
+        }
+    }
+
+    const int blocksPerSide = dimension / BlockDimension;
+    const float numMtexels = (float)numRepeats * (float)math::Square(dimension) / 1e6f;
+    const char* qualityNames[] = { "Fast", "High" };
+    std::vector<uint8> bc4(GetBlockRowBytes(dimension, BC4BlockBytes) * blocksPerSide);
+    std::vector<uint8> bc5(GetBlockRowBytes(dimension, BC5BlockBytes) * blocksPerSide);
+    for (int quality = 0; quality < 2; ++quality)
+    {
+        Timer timer;
+        for (int i = 0; i < numRepeats; ++i)
+        {
+            EncodeBC4(heights.data(), dimension, dimension, dimension, false, (BlockCompressionQuality::E)quality, bc4.data(), GetBlockRowBytes(dimension, BC4BlockBytes));
+        }
+        const float bc4Rate = numMtexels / timer.GetSecondsAndReset();
+        for (int i = 0; i < numRepeats; ++i)
+        {
+            EncodeBC5(normals.data(), dimension, dimension, dimension, true, (BlockCompressionQuality::E)quality, bc5.data(), GetBlockRowBytes(dimension, BC5BlockBytes));
+        }
+        const float bc5Rate = numMtexels / timer.GetSecondsAndReset();
+
+        // RMS error, decoding block by block.
+        double bc4SquaredError = 0.0;
+        double bc5SquaredError = 0.0;
+        for (int blockY = 0; blockY < blocksPerSide; ++blockY)
+        {
+            for (int blockX = 0; blockX < blocksPerSide; ++blockX)
+            {
+                float decodedHeights[BlockDimension * BlockDimension];
+                Vec2f decodedNormals[BlockDimension * BlockDimension];
+                DecodeBC4Block(&bc4[(blocksPerSide * blockY + blockX) * BC4BlockBytes], false, decodedHeights, BlockDimension);
+                DecodeBC5Block(&bc5[(blocksPerSide * blockY + blockX) * BC5BlockBytes], true, decodedNormals, BlockDimension);
+                for (int i = 0; i < BlockDimension * BlockDimension; ++i)
+                {
+                    const int index = dimension * (blockY * BlockDimension + i / BlockDimension) + blockX * BlockDimension + i % BlockDimension;
+                    bc4SquaredError += math::Square(decodedHeights[i] - heights[index]);
+                    bc5SquaredError += math::length2(decodedNormals[i] - normals[index]);
+                }
+            }
+        }
+        const double numTexels = (double)math::Square(dimension);
+        DebugOut("%s: BC4 %.1f Mtexels/s, RMS %.5f; BC5 %.1f Mtexels/s, RMS %.5f\n", qualityNames[quality],
+            bc4Rate, sqrt(bc4SquaredError / numTexels), bc5Rate, sqrt(bc5SquaredError / numTexels));
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "Test.hpp"
+#include "BlockCompression.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr int TexelsPerBlock = BlockDimension * BlockDimension;
+
+// The worst case for endpoints at the block's min and max: half of one of the seven steps between them, plus half a step
+// of endpoint quantisation at each end.
+static float MaxBC4Error(const float* texels, bool isSigned)
+{
+    const float low = isSigned ? -1.f : 0.f;
+    float min = FLT_MAX;
+    float max = -FLT_MAX;
+    for (int i = 0; i < TexelsPerBlock; ++i)
+    {
+        min = std::min(min, std::clamp(texels[i], low, 1.f));
+        max = std::max(max, std::clamp(texels[i], low, 1.f));
+    }
+    const float endpointStep = isSigned ? 1.f / 127.f : 1.f / 255.f;
+    return (max - min) / 14.f + endpointStep;
+}
+
+// Random blocks of various spreads, ramps and the odd texel at the end of the range: each decodes to within the bound of its own
+// range, and the high quality preset never does worse overall than the fast one.
+static void TestBC4RoundTrip()
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    for (bool isSigned : { false, true })
+    {
+        const float low = isSigned ? -1.f : 0.f;
+        double sumSquaredErrors[2] = {};
+        bool withinBound[2] = { true, true };
+        for (int blockIndex = 0; blockIndex < 20000; ++blockIndex)
+        {
+            float texels[TexelsPerBlock];
+            const float base = low + (1.f - low) * random(rng);
+            const float spread = (blockIndex % 3 == 0) ? 0.02f : (blockIndex % 3 == 1) ? 0.2f : 1.f;
+            for (int i = 0; i < TexelsPerBlock; ++i)
+            {
+                const float t = (blockIndex & 4) ? (float)(i % 4 + i / 4) / 6.f : random(rng);
+                texels[i] = base + spread * t; // Sometimes past 1, which should be clamped.
+            }
+            if (blockIndex % 50 == 0)
+            {
+                texels[3] = low;
+            }
+
+            for (int quality = 0; quality < 2; ++quality)
+            {
+                uint8 block[BC4BlockBytes];
+                float decoded[TexelsPerBlock];
+                EncodeBC4Block(texels, BlockDimension, isSigned, (BlockCompressionQuality::E)quality, block);
+                DecodeBC4Block(block, isSigned, decoded, BlockDimension);
+
+                float maxError = 0.f;
+                for (int i = 0; i < TexelsPerBlock; ++i)
+                {
+                    const float error = fabsf(decoded[i] - std::clamp(texels[i], low, 1.f));
+                    maxError = std::max(maxError, error);
+                    sumSquaredErrors[quality] += error * error;
+                }
+                withinBound[quality] &= maxError <= MaxBC4Error(texels, isSigned);
+            }
+        }
+        Check(withinBound[BlockCompressionQuality::Fast]);
+        Check(sumSquaredErrors[BlockCompressionQuality::High] <= sumSquaredErrors[BlockCompressionQuality::Fast]);
+    }
+}
+
+// Flat blocks and blocks of just the range's ends are common in masks and flat ground, and should come back (nearly) exact.
+static void TestBC4SpecialBlocks()
+{
+    for (bool isSigned : { false, true })
+    {
+        const float low = isSigned ? -1.f : 0.f;
+        const float endpointStep = isSigned ? 1.f / 127.f : 1.f / 255.f;
+        for (int quality = 0; quality < 2; ++quality)
+        {
+            float flat[TexelsPerBlock];
+            float ends[TexelsPerBlock];
+            for (int i = 0; i < TexelsPerBlock; ++i)
+            {
+                flat[i] = 0.3f;
+                ends[i] = (i * 7) % 3 ? 1.f : low;
+            }
+
+            uint8 block[BC4BlockBytes];
+            float decoded[TexelsPerBlock];
+            EncodeBC4Block(flat, BlockDimension, isSigned, (BlockCompressionQuality::E)quality, block);
+            DecodeBC4Block(block, isSigned, decoded, BlockDimension);
+            for (int i = 0; i < TexelsPerBlock; ++i)
+            {
+                Check(fabsf(decoded[i] - 0.3f) <= 0.5f * endpointStep + 1e-6f);
+            }
+
+            EncodeBC4Block(ends, BlockDimension, isSigned, (BlockCompressionQuality::E)quality, block);
+            DecodeBC4Block(block, isSigned, decoded, BlockDimension);
+            for (int i = 0; i < TexelsPerBlock; ++i)
+            {
+                Check(decoded[i] == ends[i]);
+            }
+        }
+    }
+}
+
+// Whole image encodes lay blocks out at the destination row pitch, and match encoding each block on its own.
+static void TestImageLayout()
+{
+    const int width = 32;
+    const int height = 16;
+    const int srcPitch = width + 3;
+    const int blocksX = width / BlockDimension;
+    const int blocksY = height / BlockDimension;
+    std::vector<float> heights(srcPitch * height);
+    std::vector<Vec2f> normals(srcPitch * height);
+    for (int i = 0; i < (int)heights.size(); ++i)
+    {
+        heights[i] = 0.5f + 0.5f * sinf(0.37f * (float)i);
+        normals[i] = Vec2f(sinf(0.21f * (float)i), cosf(0.13f * (float)i)) * 0.7f;
+    }
+
+    const int bc4RowPitch = GetBlockRowBytes(width, BC4BlockBytes) + 24;
+    const int bc5RowPitch = GetBlockRowBytes(width, BC5BlockBytes) + 16;
+    std::vector<uint8> bc4(bc4RowPitch * blocksY);
+    std::vector<uint8> bc5(bc5RowPitch * blocksY);
+    EncodeBC4(heights.data(), srcPitch, width, height, false, BlockCompressionQuality::Fast, bc4.data(), bc4RowPitch);
+    EncodeBC5(normals.data(), srcPitch, width, height, true, BlockCompressionQuality::Fast, bc5.data(), bc5RowPitch);
+
+    bool matches = true;
+    for (int blockY = 0; blockY < blocksY; ++blockY)
+    {
+        for (int blockX = 0; blockX < blocksX; ++blockX)
+        {
+            const int srcOffset = srcPitch * blockY * BlockDimension + blockX * BlockDimension;
+            uint8 bc4Block[BC4BlockBytes];
+            uint8 bc5Block[BC5BlockBytes];
+            EncodeBC4Block(&heights[srcOffset], srcPitch, false, BlockCompressionQuality::Fast, bc4Block);
+            EncodeBC5Block(&normals[srcOffset], srcPitch, true, BlockCompressionQuality::Fast, bc5Block);
+            matches &= memcmp(bc4Block, &bc4[bc4RowPitch * blockY + blockX * BC4BlockBytes], BC4BlockBytes) == 0;
+            matches &= memcmp(bc5Block, &bc5[bc5RowPitch * blockY + blockX * BC5BlockBytes], BC5BlockBytes) == 0;
+        }
+    }
+    Check(matches);
+}
+
+// BC5 is two independent BC4 channels, so each is held to the same bound.
+static void TestBC5RoundTrip()
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> random(-1.f, 1.f);
+    double sumSquaredErrors[2] = {};
+    bool withinBound = true;
+    for (int blockIndex = 0; blockIndex < 5000; ++blockIndex)
+    {
+        Vec2f texels[TexelsPerBlock];
+        float channels[2][TexelsPerBlock];
+        const Vec2f base(random(rng), random(rng));
+        for (int i = 0; i < TexelsPerBlock; ++i)
+        {
+            texels[i] = math::clamp(base + 0.3f * Vec2f(random(rng), random(rng)), Vec2f(-1.f, -1.f), Vec2f(1.f, 1.f));
+            channels[0][i] = texels[i].x;
+            channels[1][i] = texels[i].y;
+        }
+        const float maxErrors[2] = { MaxBC4Error(channels[0], true), MaxBC4Error(channels[1], true) };
+
+        for (int quality = 0; quality < 2; ++quality)
+        {
+            uint8 block[BC5BlockBytes];
+            Vec2f decoded[TexelsPerBlock];
+            EncodeBC5Block(texels, BlockDimension, true, (BlockCompressionQuality::E)quality, block);
+            DecodeBC5Block(block, true, decoded, BlockDimension);
+            for (int i = 0; i < TexelsPerBlock; ++i)
+            {
+                const Vec2f error = math::abs(decoded[i] - texels[i]);
+                sumSquaredErrors[quality] += math::length2(error);
+                if (quality == BlockCompressionQuality::Fast)
+                {
+                    withinBound &= error.x <= maxErrors[0] && error.y <= maxErrors[1];
+                }
+            }
+        }
+    }
+    Check(withinBound);
+    Check(sumSquaredErrors[BlockCompressionQuality::High] <= sumSquaredErrors[BlockCompressionQuality::Fast]);
+}
+
+int main()
+{
+    TestBC4RoundTrip();
+    TestBC4SpecialBlocks();
+    TestImageLayout();
+    TestBC5RoundTrip();
+    return test::Finish();
+}
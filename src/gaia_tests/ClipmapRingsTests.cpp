@@ -0,0 +1,229 @@
+#include "Test.hpp"
+#include "ClipmapConfig.hpp"
+#include "ClipmapRings.hpp"
+#include <random>
+#include <set>
+#include <tuple>
+
+using namespace gaia;
+
+static int Mod(int a, int b)
+{
+    return ((a % b) + b) % b;
+}
+
+// Each level's pieces tile exactly the part of its square the finer level doesn't cover, on whole patches of their own level,
+// and the level squares stay snapped to the next level's patches around the centre, as the centre wanders about.
+static void TestPiecesCoverLevelsExactly()
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> random(-5000.f, 5000.f);
+    for (int blockPatches = 1; blockPatches <= 9; ++blockPatches)
+    {
+        for (int numLevels = 1; numLevels <= 6; ++numLevels)
+        {
+            ClipmapRings rings;
+            rings.Init(blockPatches, numLevels);
+            Vec2f centre(random(rng), random(rng));
+            const int span = rings.GetLevelPatches() << (numLevels - 1);
+            for (int step = 0; step < 100; ++step)
+            {
+                centre += Vec2f(random(rng), random(rng)) * (step % 3 == 0 ? 1e-3f : 3e-4f);
+                rings.Update(centre);
+
+                const Vec2i outerMin = rings.GetLevelMin(numLevels - 1);
+                std::vector<int> coverage(math::Square(span), 0);
+                bool onOwnPatches = true;
+                bool insideOwnLevel = true;
+                bool outsideFinerLevel = true;
+                int numInstances = 0;
+                int numPatches = 0;
+                for (int piece = 0; piece < RingPiece::Count; ++piece)
+                {
+                    const Vec2i pieceSize = rings.GetPieceSize((RingPiece::E)piece);
+                    for (const RingPieceInstance& instance : rings.GetInstances((RingPiece::E)piece))
+                    {
+                        const int patchSize = 1 << instance.level;
+                        const Vec2i size = pieceSize * patchSize;
+                        onOwnPatches &= Mod(instance.origin.x, patchSize) == 0 && Mod(instance.origin.y, patchSize) == 0;
+                        ++numInstances;
+                        numPatches += pieceSize.x * pieceSize.y;
+
+                        const Vec2i levelMin = rings.GetLevelMin(instance.level);
+                        const int levelSpan = rings.GetLevelPatches() << instance.level;
+                        insideOwnLevel &= instance.origin.x >= levelMin.x && instance.origin.y >= levelMin.y
+                            && instance.origin.x + size.x <= levelMin.x + levelSpan && instance.origin.y + size.y <= levelMin.y + levelSpan;
+                        if (instance.level > 0)
+                        {
+                            const Vec2i finerMin = rings.GetLevelMin(instance.level - 1);
+                            const int finerSpan = levelSpan / 2;
+                            outsideFinerLevel &= instance.origin.x >= finerMin.x + finerSpan || finerMin.x >= instance.origin.x + size.x
+                                || instance.origin.y >= finerMin.y + finerSpan || finerMin.y >= instance.origin.y + size.y;
+                        }
+
+                        for (int z = 0; z < size.y; ++z)
+                        {
+                            for (int x = 0; x < size.x; ++x)
+                            {
+                                const Vec2i coords = instance.origin + Vec2i(x, z) - outerMin;
+                                if (coords.x >= 0 && coords.y >= 0 && coords.x < span && coords.y < span)
+                                {
+                                    ++coverage[span * coords.y + coords.x];
+                                }
+                            }
+                        }
+                    }
+                }
+
+                bool coveredOnce = true;
+                for (int count : coverage)
+                {
+                    coveredOnce &= count == 1;
+                }
+
+                bool snappedNearCentre = true;
+                for (int level = 0; level < numLevels; ++level)
+                {
+                    const Vec2i levelMin = rings.GetLevelMin(level);
+                    const int coarserPatchSize = 2 << level;
+                    snappedNearCentre &= Mod(levelMin.x, coarserPatchSize) == 0 && Mod(levelMin.y, coarserPatchSize) == 0;
+                    const Vec2f levelCentre = Vec2f(levelMin) + 0.5f * (float)(rings.GetLevelPatches() << level);
+                    snappedNearCentre &= fabsf(levelCentre.x - centre.x) <= (float)coarserPatchSize && fabsf(levelCentre.y - centre.y) <= (float)coarserPatchSize;
+                }
+
+                Check(coveredOnce);
+                Check(onOwnPatches);
+                Check(insideOwnLevel);
+                Check(outsideFinerLevel);
+                Check(snappedNearCentre);
+                Check(numInstances == rings.GetNumInstances());
+                Check(numPatches == rings.GetNumPatches());
+            }
+        }
+    }
+}
+
+// Mirrors IsOnLevelEdge() in TerrainRings.hlsl, with the ring bounds as (min x, min z, max x, max z).
+static bool IsOnLevelEdge(Vec2f a, Vec2f b, Vec4f bounds)
+{
+    bool alongZ = a.x == b.x && (a.x == bounds.x || a.x == bounds.z) && std::min(a.y, b.y) >= bounds.y && std::max(a.y, b.y) <= bounds.w;
+    bool alongX = a.y == b.y && (a.y == bounds.y || a.y == bounds.w) && std::min(a.x, b.x) >= bounds.x && std::max(a.x, b.x) <= bounds.z;
+    return alongZ || alongX;
+}
+
+// Mirrors GetCoarserEdge() in TerrainRings.hlsl.
+static void GetCoarserEdge(Vec2f a, Vec2f b, Vec2f& outCoarseA, Vec2f& outCoarseB)
+{
+    Vec2f along = (a.x == b.x) ? Vec2f(0.f, 1.f) : Vec2f(1.f, 0.f);
+    float coarseSize = 2.f * math::distance(a, b);
+    outCoarseA = math::min(a, b);
+    outCoarseA -= along * (math::dot(outCoarseA, along) - floorf(math::dot(outCoarseA, along) / coarseSize) * coarseSize);
+    outCoarseB = outCoarseA + along * coarseSize;
+}
+
+// Every patch edge the shaders treat as a seam lines up with a real edge of the next level, whose two halves are fine edges,
+// so the tessellation factors they pick for it match on both sides. Edges on the outermost level's edge aren't seams.
+static void TestSeamsMatchCoarserEdges()
+{
+    using Edge = std::tuple<float, float, float, float>;
+    struct PatchEdge
+    {
+        Vec2f a;
+        Vec2f b;
+        int level;
+    };
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> random(-3000.f, 3000.f);
+    int numSeamEdges = 0;
+    for (int blockPatches = 1; blockPatches <= 8; ++blockPatches)
+    {
+        for (int numLevels = 2; numLevels <= 6; ++numLevels)
+        {
+            for (int trial = 0; trial < 20; ++trial)
+            {
+                ClipmapRings rings;
+                rings.Init(blockPatches, numLevels);
+                rings.Update(Vec2f(random(rng), random(rng)));
+
+                // Like TerrainPSConstantBuffer::ringBounds: the outermost level has none.
+                Vec4f bounds[ClipmapConfig::MaxClipLevels];
+                for (int level = 0; level < ClipmapConfig::MaxClipLevels; ++level)
+                {
+                    bounds[level] = Vec4f(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+                    if (level < numLevels - 1)
+                    {
+                        const Vec2i levelMin = rings.GetLevelMin(level);
+                        const int levelSpan = rings.GetLevelPatches() << level;
+                        bounds[level] = Vec4f((float)levelMin.x, (float)levelMin.y, (float)(levelMin.x + levelSpan), (float)(levelMin.y + levelSpan));
+                    }
+                }
+
+                // Every patch's edges, in level 0 patches, as the shaders see them.
+                std::set<Edge> levelEdges[ClipmapConfig::MaxClipLevels];
+                std::vector<PatchEdge> patchEdges;
+                for (int piece = 0; piece < RingPiece::Count; ++piece)
+                {
+                    const Vec2i pieceSize = rings.GetPieceSize((RingPiece::E)piece);
+                    for (const RingPieceInstance& instance : rings.GetInstances((RingPiece::E)piece))
+                    {
+                        const float patchSize = (float)(1 << instance.level);
+                        for (int z = 0; z < pieceSize.y; ++z)
+                        {
+                            for (int x = 0; x < pieceSize.x; ++x)
+                            {
+                                Vec2f corners[4];
+                                for (int i = 0; i < 4; ++i)
+                                {
+                                    corners[i] = Vec2f(instance.origin) + Vec2f((float)(x + (i & 1)), (float)(z + (i >> 1))) * patchSize;
+                                }
+
+                                const int edgeCorners[4][2] = { { 0, 2 }, { 0, 1 }, { 1, 3 }, { 2, 3 } };
+                                for (const auto& ends : edgeCorners)
+                                {
+                                    const Vec2f a = corners[ends[0]];
+                                    const Vec2f b = corners[ends[1]];
+                                    levelEdges[instance.level].insert({ a.x, a.y, b.x, b.y });
+                                    patchEdges.push_back({ a, b, instance.level });
+                                }
+                            }
+                        }
+                    }
+                }
+
+                bool seamsMatch = true;
+                for (const PatchEdge& edge : patchEdges)
+                {
+                    const bool onFinerLevelEdge = edge.level > 0 && IsOnLevelEdge(edge.a, edge.b, bounds[edge.level - 1]);
+                    const bool onOwnLevelEdge = IsOnLevelEdge(edge.a, edge.b, bounds[edge.level]);
+                    seamsMatch &= !(onFinerLevelEdge && onOwnLevelEdge);
+                    if (onOwnLevelEdge)
+                    {
+                        // The fine side: the coarse edge it works out must exist, and see itself on the same seam.
+                        ++numSeamEdges;
+                        Vec2f coarseA, coarseB;
+                        GetCoarserEdge(edge.a, edge.b, coarseA, coarseB);
+                        seamsMatch &= levelEdges[edge.level + 1].count({ coarseA.x, coarseA.y, coarseB.x, coarseB.y }) == 1;
+                        seamsMatch &= IsOnLevelEdge(coarseA, coarseB, bounds[edge.level]);
+                    }
+                    if (onFinerLevelEdge)
+                    {
+                        // The coarse side: both halves must be fine edges.
+                        const Vec2f mid = 0.5f * (edge.a + edge.b);
+                        seamsMatch &= levelEdges[edge.level - 1].count({ edge.a.x, edge.a.y, mid.x, mid.y }) == 1;
+                        seamsMatch &= levelEdges[edge.level - 1].count({ mid.x, mid.y, edge.b.x, edge.b.y }) == 1;
+                    }
+                }
+                Check(seamsMatch);
+            }
+        }
+    }
+    Check(numSeamEdges > 0);
+}
+
+int main()
+{
+    TestPiecesCoverLevelsExactly();
+    TestSeamsMatchCoarserEdges();
+    return test::Finish();
+}
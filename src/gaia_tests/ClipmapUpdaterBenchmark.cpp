@@ -0,0 +1,59 @@
+#include "ClipmapConfig.hpp"
+#include "ClipmapUpdater.hpp"
+#include "CpuClipmapTexture.hpp"
+#include "Timer.hpp"
+
+using namespace gaia;
+
+// Bytes uploaded per metre travelled, and the CPU cost of executing the updates, for a camera flying in a straight line.
+int main()
+{
+    const ClipmapConfig config;
+    ClipmapUpdater updater(config.textureDimension);
+    CpuClipmapTexture::WriteRegionFunc writeRegion = [](float* strip, int rowPitch, Vec2i levelGlobalMin, Vec2i levelGlobalMax)
+    {
+        for (int z = levelGlobalMin.y; z < levelGlobalMax.y; ++z)
+        {
+            for (int x = levelGlobalMin.x; x < levelGlobalMax.x; ++x)
+            {
+                strip[rowPitch * (z - levelGlobalMin.y) + x - levelGlobalMin.x] = (float)(x ^ z);
+            }
+        }
+    };
+
+    // A texel or so a frame: about 60 m/s at the default texel size.
+    const Vec2i stepTexels(1, 0);
+    const int numSteps = 4096;
+    const float metres = (float)numSteps * math::length(Vec2f(stepTexels)) * config.texelSize;
+    DebugOut("%d steps, %.1f m, %d^2 texel levels\n", numSteps, metres, config.textureDimension);
+    DebugOut("level  bytes/m    normal texels/m  strips  updates  ms\n");
+
+    uint64 totalBytes = 0;
+    for (int level = 0; level < config.numLevels; ++level)
+    {
+        CpuClipmapTexture texture(config.textureDimension, config.texelSize, level, config.NormalBits());
+        Vec2i texelOffset = Vec2iZero;
+        ClipmapLevelUpdate update;
+        updater.CalcMoveUpdate(level, -Vec2i(INT_MAX, INT_MAX) / 2, texelOffset, update);
+        texture.Execute(update, writeRegion);
+        texture.ResetStats();
+
+        Timer timer;
+        for (int step = 0; step < numSteps; ++step)
+        {
+            Vec2i newTexelOffset = texelOffset + stepTexels;
+            if (updater.CalcMoveUpdate(level, texelOffset, newTexelOffset, update))
+            {
+                texture.Execute(update, writeRegion);
+            }
+            texelOffset = newTexelOffset;
+        }
+        const float ms = 1000.f * timer.GetSecondsAndReset();
+
+        const CpuClipmapTexture::Stats& stats = texture.GetStats();
+        DebugOut("%5d  %9.1f  %15.1f  %6d  %7d  %.2f\n", level, (float)stats.bytesWritten / metres, (float)stats.normalTexelsComputed / metres, stats.numStrips, stats.numUpdates, ms);
+        totalBytes += stats.bytesWritten;
+    }
+    DebugOut("total  %9.1f\n", (float)totalBytes / metres);
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "Test.hpp"
+#include "ClipmapUpdater.hpp"
+#include "CpuClipmapTexture.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr int TextureDimension = 256;
+static constexpr float TexelSize = 0.05f;
+
+// Stand-in for the terrain: hashed heights, overridden wherever a test has edited them.
+class FakeTerrain
+{
+public:
+    explicit FakeTerrain(int level)
+        : m_level(level)
+    {
+    }
+
+    float GetHeight(Vec2i levelGlobalCoords) const
+    {
+        auto it = m_edits.find(Key(levelGlobalCoords));
+        if (it != m_edits.end())
+            return it->second;
+
+        return (float)((uint32)(levelGlobalCoords.x * 7919 ^ levelGlobalCoords.y * 104729 ^ m_level * 31) % 1000) * 0.01f;
+    }
+
+    // Sets the heights of every texel in [min, max] (inclusive level 0 global coords) at this level.
+    void Edit(Vec2i globalMin, Vec2i globalMax, float height)
+    {
+        for (int z = globalMin.y >> m_level; z <= globalMax.y >> m_level; ++z)
+        {
+            for (int x = globalMin.x >> m_level; x <= globalMax.x >> m_level; ++x)
+            {
+                m_edits[Key(Vec2i(x, z))] = height;
+            }
+        }
+    }
+
+    CpuClipmapTexture::WriteRegionFunc GetWriteRegionFunc()
+    {
+        return [this](float* strip, int rowPitch, Vec2i levelGlobalMin, Vec2i levelGlobalMax)
+        {
+            // Pieces must already have been split so they don't wrap.
+            const int mask = TextureDimension - 1;
+            Check((levelGlobalMin.x & mask) + levelGlobalMax.x - levelGlobalMin.x <= TextureDimension);
+            Check((levelGlobalMin.y & mask) + levelGlobalMax.y - levelGlobalMin.y <= TextureDimension);
+            for (int z = levelGlobalMin.y; z < levelGlobalMax.y; ++z)
+            {
+                for (int x = levelGlobalMin.x; x < levelGlobalMax.x; ++x)
+                {
+                    // Writes are offset by half the texture.
+                    strip[rowPitch * (z - levelGlobalMin.y) + x - levelGlobalMin.x] = GetHeight(Vec2i(x, z) - Vec2i(TextureDimension / 2, TextureDimension / 2));
+                }
+            }
+        };
+    }
+
+private:
+    static uint64 Key(Vec2i coords) { return ((uint64)(uint32)coords.x << 32) | (uint32)coords.y; }
+
+    int m_level;
+    std::unordered_map<uint64, float> m_edits;
+};
+
+// Random walks with the odd teleport and edits, checking the texture against a full regeneration after every step.
+static void TestRandomUpdatesMatchRegeneration(int level)
+{
+    std::mt19937 rng(1234 + level);
+    auto random = [&rng](int min, int max) { return std::uniform_int_distribution<int>(min, max)(rng); };
+
+    ClipmapUpdater updater(TextureDimension);
+    FakeTerrain terrain(level);
+    CpuClipmapTexture::WriteRegionFunc writeRegion = terrain.GetWriteRegionFunc();
+    CpuClipmapTexture texture(TextureDimension, TexelSize, level);
+
+    Vec2i texelOffset = Vec2iZero;
+    ClipmapLevelUpdate update;
+    updater.CalcMoveUpdate(level, -Vec2i(INT_MAX, INT_MAX) / 2, texelOffset, update);
+    texture.Execute(update, writeRegion);
+
+    const int levelExtent = TextureDimension << level;
+    for (int step = 0; step < 300; ++step)
+    {
+        Vec2i newTexelOffset = texelOffset + Vec2i(random(-20, 20), random(-20, 20));
+        if (random(0, 49) == 0)
+        {
+            newTexelOffset = texelOffset + Vec2i(random(-1500, 1500), random(-1500, 1500));
+        }
+        if (updater.CalcMoveUpdate(level, texelOffset, newTexelOffset, update))
+        {
+            texture.Execute(update, writeRegion);
+        }
+        texelOffset = newTexelOffset;
+
+        if (random(0, 2) == 0)
+        {
+            // Anywhere in or around the level, including across the edge of the texture.
+            Vec2i globalMin = texelOffset + Vec2i(random(-levelExtent / 2, levelExtent / 2), random(-levelExtent / 2, levelExtent / 2));
+            Vec2i globalMax = globalMin + Vec2i(random(0, 200), random(0, 200));
+            terrain.Edit(globalMin, globalMax, (float)random(5, 100));
+            if (updater.CalcRegionUpdate(level, globalMin, globalMax, texelOffset, update))
+            {
+                texture.Execute(update, writeRegion);
+            }
+        }
+
+        CpuClipmapTexture::Comparison comparison = texture.CompareWithFullRegeneration(texelOffset, writeRegion);
+        Check(comparison.maxHeightError == 0.f);
+        Check(comparison.maxNormalError <= 1e-6f);
+        if (comparison.maxHeightError != 0.f || comparison.maxNormalError > 1e-6f)
+        {
+            DebugOut("Level %d diverged at step %d: height error %g, normal error %g\n", level, step, comparison.maxHeightError, comparison.maxNormalError);
+            return;
+        }
+    }
+}
+
+// Moving less than a texel of a level mustn't touch it, and moving a whole texture's width must rewrite all of it, once.
+static void TestMoveUpdateSizes()
+{
+    ClipmapUpdater updater(TextureDimension);
+    ClipmapLevelUpdate update;
+    Check(!updater.CalcMoveUpdate(2, Vec2iZero, Vec2i(3, 3), update));
+
+    Check(updater.CalcMoveUpdate(0, Vec2iZero, Vec2i(5, 0), update));
+    Check(update.NumWrittenTexels() == 5 * TextureDimension);
+
+    Check(updater.CalcMoveUpdate(1, Vec2iZero, Vec2i(8 * TextureDimension, -3 * TextureDimension), update));
+    Check(update.NumWrittenTexels() == TextureDimension * TextureDimension);
+}
+
+int main()
+{
+    TestMoveUpdateSizes();
+    for (int level = 0; level < 4; ++level)
+    {
+        TestRandomUpdatesMatchRegeneration(level);
+    }
+    return test::Finish();
+}
@@ -0,0 +1,295 @@
+#include "Test.hpp"
+#include "TestHeightfield.hpp"
+#include "HeightfieldRaycast.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr int Dimension = 64;
+static const Vec2i ValidMin(-23, 41);
+
+// The first t in [tMin, tMax] where the ray is at or below the bilinear surface, found by intersecting it with every valid cell in
+// turn, in double precision. FLT_MAX if it never is.
+static float RaycastBruteForce(const WrappedHeightfield& heightfield, const Vec3f& origin, const Vec3f& dir, float tMin, float tMax)
+{
+    double best = FLT_MAX;
+    for (int cellZ = heightfield.validMin.y; cellZ < heightfield.validMin.y + heightfield.dimension - 1; ++cellZ)
+    {
+        for (int cellX = heightfield.validMin.x; cellX < heightfield.validMin.x + heightfield.dimension - 1; ++cellX)
+        {
+            // Where the ray is over the cell.
+            double t0 = tMin;
+            double t1 = tMax;
+            const double cellMin[2] = { (double)cellX, (double)cellZ };
+            const double o[2] = { origin.x, origin.z };
+            const double d[2] = { dir.x, dir.z };
+            bool over = true;
+            for (int axis = 0; axis < 2; ++axis)
+            {
+                if (d[axis] == 0.0)
+                {
+                    over &= cellMin[axis] <= o[axis] && o[axis] <= cellMin[axis] + 1.0;
+                    continue;
+                }
+                const double a = (cellMin[axis] - o[axis]) / d[axis];
+                const double b = (cellMin[axis] + 1.0 - o[axis]) / d[axis];
+                t0 = std::max(t0, std::min(a, b));
+                t1 = std::min(t1, std::max(a, b));
+            }
+            if (!over || t0 > t1 || t0 >= best)
+                continue;
+
+            // Ray height less surface height, as a quadratic in t.
+            const Vec2i cell(cellX, cellZ);
+            const double h00 = heightfield.GetHeight(cell);
+            const double h10 = heightfield.GetHeight(cell + Vec2i(1, 0));
+            const double h01 = heightfield.GetHeight(cell + Vec2i(0, 1));
+            const double h11 = heightfield.GetHeight(cell + Vec2i(1, 1));
+            const double a = h10 - h00;
+            const double b = h01 - h00;
+            const double c = h00 - h10 - h01 + h11;
+            const double u0 = origin.x - cellMin[0];
+            const double v0 = origin.z - cellMin[1];
+            const double c0 = origin.y - (h00 + a * u0 + b * v0 + c * u0 * v0);
+            const double c1 = dir.y - (a * dir.x + b * dir.z + c * (u0 * dir.z + v0 * dir.x));
+            const double c2 = -c * dir.x * dir.z;
+            const auto f = [&](double t) { return c0 + t * (c1 + t * c2); };
+
+            if (f(t0) <= 0.0)
+            {
+                best = t0;
+                continue;
+            }
+            double roots[2];
+            int numRoots = 0;
+            if (c2 == 0.0)
+            {
+                if (c1 != 0.0)
+                {
+                    roots[numRoots++] = -c0 / c1;
+                }
+            }
+            else
+            {
+                const double discriminant = c1 * c1 - 4.0 * c2 * c0;
+                if (discriminant >= 0.0)
+                {
+                    roots[numRoots++] = (-c1 - sqrt(discriminant)) / (2.0 * c2);
+                    roots[numRoots++] = (-c1 + sqrt(discriminant)) / (2.0 * c2);
+                }
+            }
+            for (int i = 0; i < numRoots; ++i)
+            {
+                if (t0 <= roots[i] && roots[i] <= t1)
+                {
+                    best = std::min(best, roots[i]);
+                }
+            }
+        }
+    }
+    return (float)best;
+}
+
+// The pyramid march and the brute force agree on whether each ray hits, and where. Grazing rays may round the other way; they
+// have to pass within a hair of the surface to be let off.
+static void CheckAgainstBruteForce(const test::TestHeightfield& heightfield, const std::vector<std::pair<Vec3f, Vec3f>>& rays, float tMax, int& outNumHits, int& outNumMisses)
+{
+    bool hitsMatch = true;
+    bool distancesMatch = true;
+    for (const auto& ray : rays)
+    {
+        const Vec3f& origin = ray.first;
+        const Vec3f& dir = ray.second;
+        float t = FLT_MAX;
+        const bool hit = RaycastHeightfield(heightfield.view, origin, dir, 0.f, tMax, t);
+        const float expected = RaycastBruteForce(heightfield.view, origin, dir, 0.f, tMax);
+        if (hit != (expected != FLT_MAX))
+        {
+            // How close the ray comes to the surface, finely sampled over the valid cells.
+            float closest = FLT_MAX;
+            for (float s = 0.f; s <= tMax; s += 1e-3f)
+            {
+                const Vec3f p = origin + s * dir;
+                if (p.x >= (float)ValidMin.x && p.x <= (float)(ValidMin.x + Dimension - 1) && p.z >= (float)ValidMin.y && p.z <= (float)(ValidMin.y + Dimension - 1))
+                {
+                    closest = std::min(closest, fabsf(p.y - heightfield.GetHeight(p.x, p.z)));
+                }
+            }
+            hitsMatch &= closest < 1e-3f;
+            continue;
+        }
+
+        if (hit)
+        {
+            ++outNumHits;
+            distancesMatch &= fabsf(t - expected) <= 1e-3f * std::max(expected, 1.f);
+        }
+        else
+        {
+            ++outNumMisses;
+        }
+    }
+    Check(hitsMatch);
+    Check(distancesMatch);
+}
+
+// Rays every which way from above, through and out of the map, some of them reaching it under the ground.
+static void TestRandomRays()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 1.f);
+    std::mt19937 rng(21);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    std::vector<std::pair<Vec3f, Vec3f>> rays;
+    for (int i = 0; i < 2000; ++i)
+    {
+        const Vec3f origin((float)ValidMin.x - 10.f + (float)(Dimension + 20) * random(rng), 10.f + 10.f * random(rng), (float)ValidMin.y - 10.f + (float)(Dimension + 20) * random(rng));
+        const Vec3f dir = math::normalize(Vec3f(2.f * random(rng) - 1.f, -random(rng), 2.f * random(rng) - 1.f));
+        rays.push_back({ origin, dir });
+    }
+    int numHits = 0;
+    int numMisses = 0;
+    CheckAgainstBruteForce(heightfield, rays, 200.f, numHits, numMisses);
+    Check(numHits > 500);
+    Check(numMisses > 500);
+}
+
+// Rays that miss: pointing up, level above the highest point, leaving the map before coming down to it, and cut short before
+// reaching the ground.
+static void TestMisses()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 1.f);
+    const Vec3f centre((float)ValidMin.x + 0.5f * (float)Dimension, 0.f, (float)ValidMin.y + 0.5f * (float)Dimension);
+    const float top = heightfield.bounds.GetBounds().y;
+    float t = 0.f;
+    Check(!RaycastHeightfield(heightfield.view, centre + Vec3f(0.f, 20.f, 0.f), math::normalize(Vec3f(0.3f, 1.f, 0.2f)), 0.f, 1000.f, t));
+    Check(!RaycastHeightfield(heightfield.view, centre + Vec3f(0.f, top + 0.01f, 0.f), Vec3fX, 0.f, 1000.f, t));
+    Check(!RaycastHeightfield(heightfield.view, centre + Vec3f(0.f, 20.f, 0.f), math::normalize(Vec3f(1.f, -0.05f, 0.f)), 0.f, 1000.f, t));
+    Check(!RaycastHeightfield(heightfield.view, centre + Vec3f(0.f, 20.f, 0.f), -Vec3fY, 0.f, 5.f, t));
+
+    // Over ground outside the valid cells.
+    Check(!RaycastHeightfield(heightfield.view, Vec3f((float)ValidMin.x - 5.f, 20.f, centre.z), -Vec3fY, 0.f, 1000.f, t));
+    Check(!RaycastHeightfield(heightfield.view, Vec3f(centre.x, 20.f, (float)(ValidMin.y + Dimension - 1) + 0.5f), -Vec3fY, 0.f, 1000.f, t));
+}
+
+// A ray starting below the ground hits straight away, whichever way it points.
+static void TestStartBelowGround()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 1.f);
+    std::mt19937 rng(22);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    bool hitAtStart = true;
+    for (int i = 0; i < 200; ++i)
+    {
+        Vec3f origin((float)ValidMin.x + 1.f + (float)(Dimension - 3) * random(rng), 0.f, (float)ValidMin.y + 1.f + (float)(Dimension - 3) * random(rng));
+        origin.y = heightfield.GetHeight(origin.x, origin.z) - 0.01f - random(rng);
+        const Vec3f dir = math::normalize(Vec3f(2.f * random(rng) - 1.f, 2.f * random(rng) - 1.f, 2.f * random(rng) - 1.f));
+        float t = FLT_MAX;
+        hitAtStart &= RaycastHeightfield(heightfield.view, origin, dir, 0.f, 100.f, t) && t == 0.f;
+        hitAtStart &= RaycastBruteForce(heightfield.view, origin, dir, 0.f, 100.f) == 0.f;
+    }
+    Check(hitAtStart);
+}
+
+// Straight down and straight up, anywhere including on texels, cell edges and the edges of the valid region.
+static void TestVerticalRays()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 1.f);
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    bool downHits = true;
+    bool upMisses = true;
+    for (int i = 0; i < 500; ++i)
+    {
+        Vec2f pos((float)ValidMin.x + (float)(Dimension - 1) * random(rng), (float)ValidMin.y + (float)(Dimension - 1) * random(rng));
+        if (i % 4 == 1)
+        {
+            pos.x = floorf(pos.x);
+        }
+        else if (i % 4 == 2)
+        {
+            pos = Vec2f(floorf(pos.x), floorf(pos.y));
+        }
+        else if (i % 4 == 3)
+        {
+            pos.y = (float)(i & 8 ? ValidMin.y : ValidMin.y + Dimension - 1);
+        }
+        const float ground = heightfield.GetHeight(pos.x, pos.y);
+        float t = FLT_MAX;
+        downHits &= RaycastHeightfield(heightfield.view, Vec3f(pos.x, 30.f, pos.y), -Vec3fY, 0.f, 100.f, t) && fabsf(t - (30.f - ground)) < 1e-3f;
+        upMisses &= !RaycastHeightfield(heightfield.view, Vec3f(pos.x, ground + 0.01f, pos.y), Vec3fY, 0.f, 100.f, t);
+    }
+    Check(downHits);
+    Check(upMisses);
+}
+
+// Rays running exactly along cell edges, inside the map and along its valid edges, and through cell corners on the diagonal.
+static void TestRaysAlongCellEdges()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 1.f);
+    std::mt19937 rng(24);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    std::vector<std::pair<Vec3f, Vec3f>> rays;
+    for (int i = 0; i < 400; ++i)
+    {
+        const int line = (i % 8 == 0) ? 0 : (i % 8 == 1) ? Dimension - 1 : (int)(rng() % Dimension);
+        const float along = 2.f * random(rng) - 1.f;
+        const float down = -0.05f - 0.5f * random(rng);
+        if (i % 3 == 0)
+        {
+            const Vec3f origin((float)(ValidMin.x + line), 12.f, (float)ValidMin.y + (float)Dimension * random(rng));
+            rays.push_back({ origin, math::normalize(Vec3f(0.f, down, along)) });
+        }
+        else if (i % 3 == 1)
+        {
+            const Vec3f origin((float)ValidMin.x + (float)Dimension * random(rng), 12.f, (float)(ValidMin.y + line));
+            rays.push_back({ origin, math::normalize(Vec3f(along, down, 0.f)) });
+        }
+        else
+        {
+            const Vec3f origin((float)(ValidMin.x + line), 12.f, (float)(ValidMin.y + (int)(rng() % Dimension)));
+            rays.push_back({ origin, math::normalize(Vec3f(1.f, down, along < 0.f ? -1.f : 1.f)) });
+        }
+    }
+    int numHits = 0;
+    int numMisses = 0;
+    CheckAgainstBruteForce(heightfield, rays, 200.f, numHits, numMisses);
+    Check(numHits > 200);
+}
+
+// Rays that barely move along one axis, so that stepping just past where they cross a cell edge on it rounds back onto the edge
+// this far from the origin. They still reach the end of the march, and agree with the brute force.
+static void TestNearlyAxisAlignedRays()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 1.f);
+    std::mt19937 rng(25);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    std::vector<std::pair<Vec3f, Vec3f>> rays;
+    for (int i = 0; i < 400; ++i)
+    {
+        // Set off so as to cross a cell edge on the minor axis somewhere along the way.
+        const float minor = (random(rng) < 0.5f ? -1.f : 1.f) * powf(10.f, -5.f + 3.f * random(rng));
+        const float down = -0.02f - 0.3f * random(rng);
+        const float sign = (i & 2) ? -1.f : 1.f;
+        const float major = (float)(sign > 0.f ? 0 : Dimension - 1) + 0.5f * sign;
+        const float edge = (float)(1 + (int)(rng() % (Dimension - 2)));
+        const float crossing = edge - minor * (float)(Dimension - 1) * random(rng);
+        Vec3f origin = (i & 1) ? Vec3f(major, 0.f, crossing) : Vec3f(crossing, 0.f, major);
+        origin += Vec3f((float)ValidMin.x, 10.f, (float)ValidMin.y);
+        rays.push_back({ origin, math::normalize((i & 1) ? Vec3f(sign, down, minor) : Vec3f(minor, down, sign)) });
+    }
+    int numHits = 0;
+    int numMisses = 0;
+    CheckAgainstBruteForce(heightfield, rays, 200.f, numHits, numMisses);
+    Check(numHits > 100);
+}
+
+int main()
+{
+    TestRandomRays();
+    TestMisses();
+    TestStartBelowGround();
+    TestVerticalRays();
+    TestRaysAlongCellEdges();
+    TestNearlyAxisAlignedRays();
+    return test::Finish();
+}
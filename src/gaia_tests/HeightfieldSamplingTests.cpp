@@ -0,0 +1,153 @@
+#include "Test.hpp"
+#include "TestHeightfield.hpp"
+#include "ClipmapConfig.hpp"
+#include "HeightfieldSampling.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr float WorldTexelSize = 0.5f;
+
+// The bilinear height and normal at a texel space position, a texel at a time in double precision.
+static void SampleScalar(const WrappedHeightfield& heightfield, float x, float z, float& outHeight, Vec3f& outNormal)
+{
+    const Vec2i cell((int)floorf(x), (int)floorf(z));
+    const double u = (double)x - (double)cell.x;
+    const double v = (double)z - (double)cell.y;
+    const double h00 = heightfield.GetHeight(cell);
+    const double h10 = heightfield.GetHeight(cell + Vec2i(1, 0));
+    const double h01 = heightfield.GetHeight(cell + Vec2i(0, 1));
+    const double h11 = heightfield.GetHeight(cell + Vec2i(1, 1));
+    const double h0 = h00 + u * (h10 - h00);
+    const double h1 = h01 + u * (h11 - h01);
+    outHeight = (float)(h0 + v * (h1 - h0));
+
+    const double slopeX = (h10 - h00) + v * ((h11 - h01) - (h10 - h00));
+    const double slopeZ = h1 - h0;
+    const double nx = -slopeX / WorldTexelSize;
+    const double nz = -slopeZ / WorldTexelSize;
+    const double length = sqrt(nx * nx + 1.0 + nz * nz);
+    outNormal = Vec3f((float)(nx / length), (float)(1.0 / length), (float)(nz / length));
+}
+
+// Positions anywhere in the valid cells, and on the edges of cells, of tiles (including where lookups wrap) and of the valid cells
+// themselves, bucketed by tile as Terrain::SampleHeights() does it and sampled in chunks that don't fill the last four.
+// Every result lands at its caller's index and matches the scalar sampler, with or without normals.
+static void TestBatchMatchesScalar()
+{
+    const ClipmapConfig config;
+    const int dimension = config.textureDimension;
+    const Vec2i validMin(-77, 130);
+    const test::TestHeightfield field(dimension, validMin, 1.f);
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+
+    // Along each axis: the edges of the valid cells, just inside the far one, the edges of tiles and just before them, and a few
+    // cell edges anywhere.
+    std::vector<float> edges[2];
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        const int min = validMin[axis];
+        const int max = validMin[axis] + dimension - 1;
+        edges[axis] = { (float)min, nextafterf((float)min, (float)max), nextafterf((float)max, (float)min) };
+        for (int coord = min + 1; coord < max; ++coord)
+        {
+            if ((coord & (config.tileDimension - 1)) == 0)
+            {
+                edges[axis].push_back((float)coord);
+                edges[axis].push_back(nextafterf((float)coord, (float)min));
+            }
+        }
+        for (int i = 0; i < 8; ++i)
+        {
+            edges[axis].push_back((float)(min + (int)(rng() % (dimension - 1))));
+        }
+    }
+
+    std::vector<float> posX;
+    std::vector<float> posZ;
+    for (float x : edges[0])
+    {
+        for (float z : edges[1])
+        {
+            posX.push_back(x);
+            posZ.push_back(z);
+        }
+    }
+    for (int i = 0; i < 5003; ++i)
+    {
+        // Rounding can take the sum onto the far edge, whose cell isn't valid.
+        posX.push_back(std::min((float)validMin.x + (float)(dimension - 1) * random(rng), edges[0][2]));
+        posZ.push_back(std::min((float)validMin.y + (float)(dimension - 1) * random(rng), edges[1][2]));
+    }
+    const int count = (int)posX.size();
+
+    // Counting sort by tile.
+    const int tilesPerAxis = dimension / config.tileDimension;
+    const int tileShift = math::ILog2(config.tileDimension);
+    std::vector<int> buckets(count);
+    std::vector<int> bucketStarts(math::Square(tilesPerAxis) + 1, 0);
+    for (int i = 0; i < count; ++i)
+    {
+        const Vec2i tile = config.WrapHeightmapCoords(Vec2i((int)floorf(posX[i]), (int)floorf(posZ[i]))) >> tileShift;
+        buckets[i] = tilesPerAxis * tile.y + tile.x;
+        ++bucketStarts[buckets[i] + 1];
+    }
+    for (int bucket = 1; bucket < (int)bucketStarts.size(); ++bucket)
+    {
+        bucketStarts[bucket] += bucketStarts[bucket - 1];
+    }
+    std::vector<int> indices(count);
+    std::vector<float> sortedX(count);
+    std::vector<float> sortedZ(count);
+    for (int i = 0; i < count; ++i)
+    {
+        const int dst = bucketStarts[buckets[i]]++;
+        indices[dst] = i;
+        sortedX[dst] = posX[i];
+        sortedZ[dst] = posZ[i];
+    }
+
+    bool heightsMatch = true;
+    bool normalsMatch = true;
+    bool allWritten = true;
+    bool normalsUntouched = true;
+    for (bool withNormals : { false, true })
+    {
+        std::vector<float> heights(count, FLT_MAX);
+        std::vector<Vec3f> normals(count, Vec3fZero);
+        constexpr int PositionsPerChunk = 1001;
+        for (int begin = 0; begin < count; begin += PositionsPerChunk)
+        {
+            SampleHeightfield(field.view, &sortedX[begin], &sortedZ[begin], &indices[begin], std::min(PositionsPerChunk, count - begin),
+                WorldTexelSize, heights.data(), withNormals ? normals.data() : nullptr);
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            float height;
+            Vec3f normal;
+            SampleScalar(field.view, posX[i], posZ[i], height, normal);
+            allWritten &= heights[i] != FLT_MAX;
+            heightsMatch &= fabsf(heights[i] - height) <= 1e-5f * std::max(fabsf(height), 1.f);
+            if (withNormals)
+            {
+                normalsMatch &= math::length(normals[i] - normal) <= 1e-5f;
+            }
+            else
+            {
+                normalsUntouched &= normals[i] == Vec3fZero;
+            }
+        }
+    }
+    Check(heightsMatch);
+    Check(normalsMatch);
+    Check(allWritten);
+    Check(normalsUntouched);
+}
+
+int main()
+{
+    TestBatchMatchesScalar();
+    return test::Finish();
+}
@@ -0,0 +1,275 @@
+#include "Test.hpp"
+#include "TestHeightfield.hpp"
+#include "HeightfieldSweep.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr int Dimension = 64;
+static const Vec2i ValidMin(-23, 41);
+static constexpr float TexelSize = 0.5f;
+
+// How close two shapes have to get to count as touching, in world units.
+static constexpr float ContactTolerance = 1e-4f;
+
+struct BruteForceTriangle
+{
+    Vec3f v[3];
+};
+
+// The triangles of every valid cell under a box, split along each cell's (0, 0) to (1, 1) diagonal as the sweeps do.
+static std::vector<BruteForceTriangle> GetTriangles(const WrappedHeightfield& heightfield, Vec3f boxMin, Vec3f boxMax)
+{
+    const Vec2i cellsMax = heightfield.validMin + Vec2i(heightfield.dimension - 2, heightfield.dimension - 2);
+    const Vec2i min = math::max(Vec2i((int)floorf(boxMin.x / TexelSize), (int)floorf(boxMin.z / TexelSize)), heightfield.validMin);
+    const Vec2i max = math::min(Vec2i((int)floorf(boxMax.x / TexelSize), (int)floorf(boxMax.z / TexelSize)), cellsMax);
+    std::vector<BruteForceTriangle> triangles;
+    for (int z = min.y; z <= max.y; ++z)
+    {
+        for (int x = min.x; x <= max.x; ++x)
+        {
+            auto Corner = [&](int i, int j) { return Vec3f((float)(x + i) * TexelSize, heightfield.GetHeight(Vec2i(x + i, z + j)), (float)(z + j) * TexelSize); };
+            triangles.push_back({ { Corner(0, 0), Corner(1, 0), Corner(1, 1) } });
+            triangles.push_back({ { Corner(0, 0), Corner(1, 1), Corner(0, 1) } });
+        }
+    }
+    return triangles;
+}
+
+static float PointSegmentDistance(const Vec3f& p, const Vec3f& a, const Vec3f& b)
+{
+    const Vec3f ab = b - a;
+    const float lengthSq = math::dot(ab, ab);
+    const float s = lengthSq > 0.f ? math::clamp(math::dot(p - a, ab) / lengthSq, 0.f, 1.f) : 0.f;
+    return math::length(p - (a + s * ab));
+}
+
+// Distance from a point to a triangle: to its plane if the point is over it, otherwise to the nearest edge.
+static float PointTriangleDistance(const Vec3f& p, const BruteForceTriangle& tri)
+{
+    const Vec3f normal = math::normalize(math::cross(tri.v[1] - tri.v[0], tri.v[2] - tri.v[0]));
+    const Vec3f projected = p - normal * math::dot(p - tri.v[0], normal);
+    bool inside = true;
+    for (int i = 0; i < 3; ++i)
+    {
+        inside &= math::dot(math::cross(tri.v[(i + 1) % 3] - tri.v[i], projected - tri.v[i]), normal) >= 0.f;
+    }
+    if (inside)
+        return fabsf(math::dot(p - tri.v[0], normal));
+
+    return std::min({ PointSegmentDistance(p, tri.v[0], tri.v[1]), PointSegmentDistance(p, tri.v[1], tri.v[2]), PointSegmentDistance(p, tri.v[2], tri.v[0]) });
+}
+
+// Distance from the segment [p0, p1] to a triangle. The distance from a point on the segment is convex along it, so a golden
+// section search finds the least.
+static float SegmentTriangleDistance(const Vec3f& p0, const Vec3f& p1, const BruteForceTriangle& tri, float& outS)
+{
+    const float ratio = 0.5f * (sqrtf(5.f) - 1.f);
+    float lo = 0.f;
+    float hi = 1.f;
+    for (int i = 0; i < 40; ++i)
+    {
+        const float a = hi - ratio * (hi - lo);
+        const float b = lo + ratio * (hi - lo);
+        if (PointTriangleDistance(p0 + a * (p1 - p0), tri) < PointTriangleDistance(p0 + b * (p1 - p0), tri))
+        {
+            hi = b;
+        }
+        else
+        {
+            lo = a;
+        }
+    }
+    outS = 0.5f * (lo + hi);
+    return PointTriangleDistance(p0 + outS * (p1 - p0), tri);
+}
+
+// A sphere is a capsule whose ends are the same point.
+struct Shape
+{
+    Vec3f start;
+    Vec3f end;
+    float radius;
+};
+
+// Gap between a shape and the nearest of the triangles, and the point on the shape's axis closest to them.
+static float GetGap(const Shape& shape, const Vec3f& offset, const std::vector<BruteForceTriangle>& triangles, Vec3f& outAxisPoint)
+{
+    float best = FLT_MAX;
+    for (const BruteForceTriangle& triangle : triangles)
+    {
+        float s;
+        const float distance = SegmentTriangleDistance(shape.start + offset, shape.end + offset, triangle, s);
+        if (distance < best)
+        {
+            best = distance;
+            outAxisPoint = shape.start + offset + s * (shape.end - shape.start);
+        }
+    }
+    return best - shape.radius;
+}
+
+// First time the shape comes within ContactTolerance of any triangle it passes over, by conservative advancement: the gap can
+// close no faster than the shape moves, so stepping by it can't skip a contact. FLT_MAX if it never does.
+static float SweepBruteForce(const WrappedHeightfield& heightfield, const Shape& shape, const Vec3f& delta)
+{
+    const Vec3f extent = 0.5f * math::abs(shape.end - shape.start) + Vec3f(shape.radius + 1.f);
+    const Vec3f centre = 0.5f * (shape.start + shape.end);
+    const std::vector<BruteForceTriangle> triangles = GetTriangles(heightfield, math::min(centre, centre + delta) - extent, math::max(centre, centre + delta) + extent);
+    if (triangles.empty())
+        return FLT_MAX;
+
+    const float speed = math::length(delta);
+    float t = 0.f;
+    for (int step = 0; step < 100000 && t <= 1.f; ++step)
+    {
+        Vec3f axisPoint;
+        const float gap = GetGap(shape, t * delta, triangles, axisPoint);
+        if (gap <= ContactTolerance)
+            return t;
+
+        t += gap / speed;
+    }
+    return FLT_MAX;
+}
+
+// Sweeps agree with the brute force on whether they hit and when. The contact point is on the surface and touching the shape,
+// and the normal points from it to the shape's axis. Grazing sweeps may round the other way, if they come within a hair.
+template <typename SweepFunc>
+static void CheckSweeps(const test::TestHeightfield& heightfield, const std::vector<Shape>& shapes, const std::vector<Vec3f>& deltas, const SweepFunc& sweep,
+    int& outNumHits, int& outNumStartTouching)
+{
+    bool hitsMatch = true;
+    bool timesMatch = true;
+    bool pointsOnSurface = true;
+    bool normalsMatch = true;
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        const Shape& shape = shapes[i];
+        const Vec3f& delta = deltas[i];
+        SweepHit hit;
+        const bool didHit = sweep(shape, delta, hit);
+        const float expected = SweepBruteForce(heightfield.view, shape, delta);
+        if (didHit != (expected != FLT_MAX))
+        {
+            const float t = didHit ? hit.time : 1.f;
+            const Vec3f extent = Vec3f(shape.radius + math::length(shape.end - shape.start) + 1.f);
+            const Vec3f centre = shape.start + t * delta;
+            Vec3f axisPoint;
+            const float gap = GetGap(shape, t * delta, GetTriangles(heightfield.view, centre - extent, centre + extent), axisPoint);
+            hitsMatch &= fabsf(gap) < 1e-3f;
+            continue;
+        }
+        if (!didHit)
+            continue;
+
+        ++outNumHits;
+        outNumStartTouching += hit.time == 0.f;
+        const float speed = math::length(delta);
+        timesMatch &= fabsf(hit.time - expected) * speed <= 2e-3f;
+
+        // Touching the shape where it was then, and on the terrain.
+        const Vec3f offset = hit.time * delta;
+        const float pointToAxis = PointSegmentDistance(hit.point, shape.start + offset, shape.end + offset);
+        const std::vector<BruteForceTriangle> near = GetTriangles(heightfield.view, hit.point - Vec3f(1.f), hit.point + Vec3f(1.f));
+        float pointToSurface = FLT_MAX;
+        for (const BruteForceTriangle& triangle : near)
+        {
+            pointToSurface = std::min(pointToSurface, PointTriangleDistance(hit.point, triangle));
+        }
+        pointsOnSurface &= pointToSurface < 1e-3f;
+        if (hit.time == 0.f)
+            continue;
+
+        // And the normal points from it to the nearest point on the axis.
+        pointsOnSurface &= fabsf(pointToAxis - shape.radius) < 2e-3f;
+        const Vec3f axis = shape.end - shape.start;
+        const float lengthSq = math::dot(axis, axis);
+        const float s = lengthSq > 0.f ? math::clamp(math::dot(hit.point - shape.start - offset, axis) / lengthSq, 0.f, 1.f) : 0.f;
+        const Vec3f axisPoint = shape.start + offset + s * axis;
+        normalsMatch &= fabsf(math::length(hit.normal) - 1.f) < 1e-4f && math::dot(hit.normal, math::normalize(axisPoint - hit.point)) > 0.999f;
+    }
+    Check(hitsMatch);
+    Check(timesMatch);
+    Check(pointsOnSurface);
+    Check(normalsMatch);
+}
+
+static Vec3f RandomPointOverMap(std::mt19937& rng, float margin)
+{
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    const float size = (float)(Dimension - 1) * TexelSize - 2.f * margin;
+    return Vec3f((float)ValidMin.x * TexelSize + margin + size * random(rng), 0.f, (float)ValidMin.y * TexelSize + margin + size * random(rng));
+}
+
+// Spheres of all sizes dropped, thrown and slid across the hills, some starting in them and some missing them.
+static void TestSphereSweeps()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 0.5f);
+    std::mt19937 rng(31);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    std::vector<Shape> shapes;
+    std::vector<Vec3f> deltas;
+    for (int i = 0; i < 300; ++i)
+    {
+        Vec3f centre = RandomPointOverMap(rng, 2.f);
+        const float radius = 0.1f + 1.5f * random(rng);
+        centre.y = heightfield.GetHeight(centre.x / TexelSize, centre.z / TexelSize) + radius + (i % 10 == 0 ? -0.5f : 0.2f + 6.f * random(rng));
+        shapes.push_back({ centre, centre, radius });
+        deltas.push_back(Vec3f(16.f * random(rng) - 8.f, -10.f * random(rng) + (i % 7 == 0 ? 8.f : 0.f), 16.f * random(rng) - 8.f));
+    }
+    int numHits = 0;
+    int numStartTouching = 0;
+    CheckSweeps(heightfield, shapes, deltas, [&](const Shape& shape, const Vec3f& delta, SweepHit& outHit)
+    {
+        return SweepSphereHeightfield(heightfield.view, TexelSize, Spheref(shape.start, shape.radius), delta, outHit);
+    }, numHits, numStartTouching);
+    Check(numHits > 150);
+    Check(numHits < 290);
+    Check(numStartTouching > 10);
+}
+
+// Capsules standing, lying and leaning, falling and sliding over the hills.
+static void TestCapsuleSweeps()
+{
+    const test::TestHeightfield heightfield(Dimension, ValidMin, 0.5f);
+    std::mt19937 rng(32);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    std::vector<Shape> shapes;
+    std::vector<Vec3f> deltas;
+    for (int i = 0; i < 200; ++i)
+    {
+        const Vec3f centre = RandomPointOverMap(rng, 4.f);
+        const float radius = 0.1f + 0.8f * random(rng);
+        const Vec3f axis = (0.3f + 2.5f * random(rng)) * math::normalize(Vec3f(2.f * random(rng) - 1.f, (i % 3 == 0) ? 0.f : 2.f * random(rng) - 1.f, 2.f * random(rng) - 1.f));
+        Shape shape = { centre - 0.5f * axis, centre + 0.5f * axis, radius };
+
+        // Lift it clear of the ground under either end and the middle, or not, for some.
+        float ground = -FLT_MAX;
+        for (float s : { 0.f, 0.25f, 0.5f, 0.75f, 1.f })
+        {
+            const Vec3f p = shape.start + s * (shape.end - shape.start);
+            ground = std::max(ground, heightfield.GetHeight(p.x / TexelSize, p.z / TexelSize) - p.y + centre.y);
+        }
+        const float lift = ground + 0.5f * fabsf(axis.y) + radius + (i % 10 == 0 ? -0.5f : 0.5f + 5.f * random(rng));
+        shape.start.y += lift;
+        shape.end.y += lift;
+        shapes.push_back(shape);
+        deltas.push_back(Vec3f(12.f * random(rng) - 6.f, -8.f * random(rng), 12.f * random(rng) - 6.f));
+    }
+    int numHits = 0;
+    int numStartTouching = 0;
+    CheckSweeps(heightfield, shapes, deltas, [&](const Shape& shape, const Vec3f& delta, SweepHit& outHit)
+    {
+        return SweepCapsuleHeightfield(heightfield.view, TexelSize, Capsulef(shape.start, shape.end, shape.radius), delta, outHit);
+    }, numHits, numStartTouching);
+    Check(numHits > 100);
+    Check(numStartTouching > 5);
+}
+
+int main()
+{
+    TestSphereSweeps();
+    TestCapsuleSweeps();
+    return test::Finish();
+}
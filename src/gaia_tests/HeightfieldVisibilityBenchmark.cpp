@@ -0,0 +1,74 @@
+#include "TestHeightfield.hpp"
+#include "HeightfieldRaycast.hpp"
+#include "HeightfieldVisibility.hpp"
+#include "ThreadPool.hpp"
+#include "Timer.hpp"
+
+using namespace gaia;
+
+// As Terrain::HasLineOfSight() does it, over a single level in texel space.
+static bool HasLineOfSight(const WrappedHeightfield& heightfield, const Vec3f& from, const Vec3f& to)
+{
+    constexpr float EndTolerance = 1e-3f;
+    const Vec3f delta = to - from;
+    const float distance = math::length(delta);
+    if (distance <= EndTolerance)
+        return true;
+
+    float t;
+    return !RaycastHeightfield(heightfield, from, delta / distance, 0.f, distance - EndTolerance, t);
+}
+
+// Line of sight between batches of 1k and 100k pairs of points a little above the ground, up to 100 m apart and scattered over
+// 200 m, split across the thread pool as Terrain does it; then a viewshed from a single observer, over a radius of 40% of the level.
+// Distances are in texels of half a metre, as in the default clipmap.
+int main()
+{
+    constexpr int Dimension = 1024;
+    constexpr int MaxPairs = 100000;
+    constexpr float Spread = 400.f;
+    constexpr float MaxSeparation = 200.f;
+    constexpr float EyeHeight = 3.6f;
+    const Vec2i validMin(-301, 187);
+    const test::TestHeightfield heightfield(Dimension, validMin, 0.5f);
+    const Vec2f centre = Vec2f(validMin) + Vec2f(0.5f * (float)Dimension);
+
+    std::vector<Vec3f> from(MaxPairs);
+    std::vector<Vec3f> to(MaxPairs);
+    for (int i = 0; i < MaxPairs; ++i)
+    {
+        const Vec2f a = centre + Spread * Vec2f(fmodf(0.7548777f * (float)i, 1.f) - 0.5f, fmodf(0.5698403f * (float)i, 1.f) - 0.5f);
+        const Vec2f b = a + MaxSeparation * Vec2f(fmodf(0.4142136f * (float)i, 1.f) - 0.5f, fmodf(0.7320508f * (float)i, 1.f) - 0.5f);
+        from[i] = Vec3f(a.x, heightfield.GetHeight(a.x, a.y) + EyeHeight, a.y);
+        to[i] = Vec3f(b.x, heightfield.GetHeight(b.x, b.y) + EyeHeight, b.y);
+    }
+
+    std::unique_ptr<bool[]> visible(new bool[MaxPairs]);
+    for (int numPairs : { 1000, MaxPairs })
+    {
+        constexpr int QueriesPerJob = 64;
+        Timer timer;
+        ThreadPool::Instance().ParallelFor((numPairs + QueriesPerJob - 1) / QueriesPerJob, [&](int job)
+        {
+            const int end = std::min((job + 1) * QueriesPerJob, numPairs);
+            for (int i = job * QueriesPerJob; i < end; ++i)
+            {
+                visible[i] = HasLineOfSight(heightfield.view, from[i], to[i]);
+            }
+        });
+        const float seconds = timer.GetSecondsAndReset();
+        int numVisible = 0;
+        for (int i = 0; i < numPairs; ++i)
+        {
+            numVisible += visible[i];
+        }
+        DebugOut("Line of sight, %d pairs: %.2f Mqueries/s (%d visible)\n", numPairs, (float)numPairs / seconds / 1e6f, numVisible);
+    }
+
+    const int radius = (int)(0.4f * (float)Dimension);
+    std::vector<uint8> viewshed(math::Square(2 * radius + 1));
+    Timer timer;
+    ComputeViewshed(heightfield.view, Vec2i(centre), EyeHeight, 0.f, radius, viewshed.data());
+    DebugOut("Viewshed, radius %d: %.2f ms\n", radius, 1000.f * timer.GetSecondsAndReset());
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include "Test.hpp"
+#include "TestHeightfield.hpp"
+#include "HeightfieldRaycast.hpp"
+#include "HeightfieldVisibility.hpp"
+#include <random>
+
+using namespace gaia;
+
+// Lowest the segment from a to b gets above the bilinear surface, between fractions sMin and sMax of the way along it, marched
+// a hundredth of a texel at a time.
+static float MarchClearance(const test::TestHeightfield& field, const Vec3f& a, const Vec3f& b, float sMin, float sMax)
+{
+    const float horizontalLength = math::length(Vec2f(b.x - a.x, b.z - a.z));
+    const int numSteps = std::max((int)(100.f * horizontalLength * (sMax - sMin)), 1);
+    float clearance = FLT_MAX;
+    for (int i = 0; i <= numSteps; ++i)
+    {
+        const float s = sMin + (sMax - sMin) * (float)i / (float)numSteps;
+        const Vec3f p = a + s * (b - a);
+        clearance = std::min(clearance, p.y - field.GetHeight(p.x, p.z));
+    }
+    return clearance;
+}
+
+// Line of sight as Terrain::HasLineOfSight() does it, over a single level in texel space.
+static bool HasLineOfSight(const test::TestHeightfield& field, const Vec3f& from, const Vec3f& to)
+{
+    constexpr float EndTolerance = 1e-3f;
+    const Vec3f delta = to - from;
+    const float distance = math::length(delta);
+    float t;
+    return !RaycastHeightfield(field.view, from, delta / distance, 0.f, distance - EndTolerance, t);
+}
+
+// Pairs of points a little above the ground, some far enough apart to have hills between them: each pair can see the other
+// just when the segment between them never dips below the surface, unless it comes within a hair of it.
+static void TestLineOfSightMatchesMarch()
+{
+    constexpr int Dimension = 64;
+    const Vec2i validMin(-23, 41);
+    const test::TestHeightfield field(Dimension, validMin, 0.5f);
+    std::mt19937 rng(21);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    const float extent = (float)(Dimension - 1) - 1e-3f;
+
+    int numVisible = 0;
+    int numBlocked = 0;
+    int numGrazing = 0;
+    bool matches = true;
+    for (int i = 0; i < 2000; ++i)
+    {
+        Vec3f ends[2];
+        for (Vec3f& end : ends)
+        {
+            end.x = (float)validMin.x + extent * random(rng);
+            end.z = (float)validMin.y + extent * random(rng);
+            end.y = field.GetHeight(end.x, end.z) + 3.f * random(rng);
+        }
+        const bool visible = HasLineOfSight(field, ends[0], ends[1]);
+        const float clearance = MarchClearance(field, ends[0], ends[1], 0.f, 1.f - 1e-3f / math::length(ends[1] - ends[0]));
+        if (visible != (clearance >= 0.f))
+        {
+            matches &= fabsf(clearance) < 1e-2f;
+            ++numGrazing;
+        }
+        numVisible += visible;
+        numBlocked += !visible;
+    }
+    Check(matches);
+    Check(numGrazing < 20);
+    Check(numVisible > 200 && numBlocked > 200);
+}
+
+// Observers in the middle of the height field and up against the edge of its valid texels, with targets on the ground and above
+// it. The viewshed's lines of sight only pass near most cells and it sees the horizon where they cross the texel grid, so it
+// can disagree with a straight march to the cell where the march only just clears or is only just blocked; anywhere else it
+// must agree. Cells outside the valid texels are hidden, and the observer can always see its own cell.
+static void TestViewshedMatchesMarch()
+{
+    constexpr int Dimension = 256;
+    constexpr int Radius = 60;
+    constexpr float ObserverHeight = 1.8f;
+    constexpr float Margin = 0.5f;
+    const Vec2i validMin(-100, 37);
+    const test::TestHeightfield field(Dimension, validMin, 0.5f);
+    const Vec2i validMax = validMin + Vec2i(Dimension - 1, Dimension - 1);
+    const int viewshedDimension = 2 * Radius + 1;
+    std::vector<uint8> visible(math::Square(viewshedDimension));
+
+    int numVisible = 0;
+    int numHidden = 0;
+    int numDisagreeing = 0;
+    int numChecked = 0;
+    bool matches = true;
+    bool outsideHidden = true;
+    bool centreVisible = true;
+    for (Vec2i observerCell : { validMin + Vec2i(128, 128), validMin + Vec2i(77, 190), validMin + Vec2i(10, 200), validMax - Vec2i(3, 40) })
+    {
+        for (float targetHeight : { 0.f, 1.5f })
+        {
+            ComputeViewshed(field.view, observerCell, ObserverHeight, targetHeight, Radius, visible.data());
+            const Vec3f eye((float)observerCell.x, field.view.GetHeight(observerCell) + ObserverHeight, (float)observerCell.y);
+            centreVisible &= visible[viewshedDimension * Radius + Radius] != 0;
+            for (int z = -Radius; z <= Radius; ++z)
+            {
+                for (int x = -Radius; x <= Radius; ++x)
+                {
+                    const bool isVisible = visible[viewshedDimension * (z + Radius) + (x + Radius)] != 0;
+                    const Vec2i cell = observerCell + Vec2i(x, z);
+                    if (cell.x < validMin.x || cell.y < validMin.y || cell.x > validMax.x || cell.y > validMax.y)
+                    {
+                        outsideHidden &= !isVisible;
+                        continue;
+                    }
+                    if (x == 0 && z == 0)
+                        continue;
+
+                    // Up to the step before the cell's, as the viewshed's horizon only comes from the steps before it.
+                    const Vec3f target((float)cell.x, field.view.GetHeight(cell) + targetHeight, (float)cell.y);
+                    const int numSteps = std::max(abs(x), abs(z));
+                    const float clearance = MarchClearance(field, eye, target, 0.f, (float)(numSteps - 1) / (float)numSteps);
+                    if (isVisible != (clearance >= 0.f))
+                    {
+                        matches &= fabsf(clearance) < Margin;
+                        ++numDisagreeing;
+                    }
+                    numVisible += isVisible;
+                    numHidden += !isVisible;
+                    ++numChecked;
+                }
+            }
+        }
+    }
+    Check(matches);
+    Check(outsideHidden);
+    Check(centreVisible);
+    Check(numDisagreeing < numChecked / 50);
+    Check(numVisible > numChecked / 10 && numHidden > numChecked / 10);
+}
+
+int main()
+{
+    TestLineOfSightMatchesMarch();
+    TestViewshedMatchesMarch();
+    return test::Finish();
+}
@@ -0,0 +1,142 @@
+#include "Test.hpp"
+#include "HorizonCuller.hpp"
+#include <random>
+
+using namespace gaia;
+
+// As TerrainConstants has them.
+static constexpr float HorizonCellSize = 4.f;
+static constexpr int HorizonCellsPerSide = 16;
+
+// Rolling hills with ridges across them, shifted about by random phases.
+struct Hills
+{
+    static constexpr float MaxSlope = 40.f * (0.01f + 0.013f) + 10.f * (0.05f + 0.03f) + 3.f * (0.2f + 0.15f);
+
+    float GetHeight(float x, float z) const
+    {
+        return 40.f * sinf(0.01f * x + phases[0]) * cosf(0.013f * z + phases[1]) + 10.f * sinf(0.05f * x + 0.03f * z + phases[2])
+            + 3.f * sinf(0.2f * x - 0.15f * z + phases[3]);
+    }
+
+    float phases[4];
+};
+
+// Like Terrain::UpdateHorizon(): every cell occludes down to the lowest the ground gets over it. Dense samples, less the most
+// the ground can dip between them going by its steepest slope, stand in for the exact bound.
+static void InitOccluders(const Hills& hills, HorizonCuller& horizon, Vec3f eye)
+{
+    constexpr int NumSamples = 16;
+    horizon.UpdateLayout(Vec2f(eye.x, eye.z));
+    for (int i = 0; i < horizon.GetNumOccluders(); ++i)
+    {
+        const Vec4f& rect = horizon.GetOccluderRect(i);
+        const float spacing = (rect.z - rect.x) / (float)NumSamples;
+        float minHeight = FLT_MAX;
+        for (int z = 0; z <= NumSamples; ++z)
+        {
+            for (int x = 0; x <= NumSamples; ++x)
+            {
+                minHeight = std::min(minHeight, hills.GetHeight(rect.x + (float)x * spacing, rect.y + (float)z * spacing));
+            }
+        }
+        horizon.SetOccluderHeight(i, minHeight - Hills::MaxSlope * spacing);
+    }
+    horizon.Build(eye);
+}
+
+// Whether the line of sight from the eye to a point clears the ground, marched in small steps. Only lines that clear it at every
+// step by more than the ground could rise between steps count, so a line the march calls clear really is.
+static bool IsLineClear(const Hills& hills, Vec3f eye, Vec3f point)
+{
+    constexpr float StepLength = 0.25f;
+    const Vec3f delta = point - eye;
+    const int numSteps = (int)(math::length(delta) / StepLength) + 1;
+    const Vec3f step = delta / (float)numSteps;
+    const float margin = 0.5f * (Hills::MaxSlope * math::length(Vec2f(step.x, step.z)) + fabsf(step.y));
+    for (int i = 1; i <= numSteps; ++i)
+    {
+        const Vec3f pos = eye + (float)i * step;
+        if (pos.y - hills.GetHeight(pos.x, pos.z) <= margin)
+            return false;
+    }
+    return true;
+}
+
+// From eyes a little above random hills, looking every way, no box the horizon says is hidden can be seen: the lines of sight to
+// its corners, and to the middle of its top, are all blocked. A good share of the boxes are culled.
+static void TestOccludedBoxesAreHidden()
+{
+    std::mt19937 rng(48);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    HorizonCuller horizon;
+    horizon.Init(HorizonCellSize, HorizonCellsPerSide, 7);
+
+    int numBoxes = 0;
+    int numOccluded = 0;
+    int numVisible = 0;
+    int numClearLines = 0;
+    for (int view = 0; view < 12; ++view)
+    {
+        Hills hills;
+        for (float& phase : hills.phases)
+        {
+            phase = 2.f * Pif * random(rng);
+        }
+        Vec3f eye(2000.f * random(rng) - 1000.f, 0.f, 2000.f * random(rng) - 1000.f);
+        eye.y = hills.GetHeight(eye.x, eye.z) + 1.f + ((view & 3) == 0 ? 40.f : 10.f) * random(rng);
+        InitOccluders(hills, horizon, eye);
+
+        for (int i = 0; i < 500; ++i)
+        {
+            const float distance = 10.f + 1000.f * random(rng);
+            const float angle = 2.f * Pif * random(rng);
+            const Vec2f centre = Vec2f(eye.x, eye.z) + distance * Vec2f(cosf(angle), sinf(angle));
+            const Vec3f extent(0.5f + 8.f * random(rng), 0.5f + 8.f * random(rng), 0.5f + 8.f * random(rng));
+            const float ground = hills.GetHeight(centre.x, centre.y);
+            const AABB3f box{ Vec3f(centre.x, ground, centre.y) - extent, Vec3f(centre.x, ground, centre.y) + extent };
+            ++numBoxes;
+
+            bool anyClear = false;
+            for (int corner = 0; corner < 9; ++corner)
+            {
+                const Vec3f point = (corner < 8)
+                    ? Vec3f((corner & 1) ? box.m_max.x : box.m_min.x, (corner & 2) ? box.m_max.y : box.m_min.y, (corner & 4) ? box.m_max.z : box.m_min.z)
+                    : Vec3f(centre.x, box.m_max.y, centre.y);
+                anyClear |= IsLineClear(hills, eye, point);
+            }
+            numClearLines += anyClear;
+            if (!horizon.IsOccluded(box))
+                continue;
+
+            ++numOccluded;
+            numVisible += anyClear;
+        }
+    }
+    Check(numVisible == 0);
+    Check(numOccluded > numBoxes / 5);
+    Check(numClearLines > numBoxes / 5);
+}
+
+// Nothing is culled before Init(), nor anything over the eye or reaching behind it, however far below the horizon it is.
+static void TestNeverOccluded()
+{
+    const AABB3f below{ Vec3f(100.f, -1000.f, 100.f), Vec3f(101.f, -999.f, 101.f) };
+    HorizonCuller horizon;
+    Check(!horizon.IsOccluded(below));
+
+    Hills hills = { { 0.f, 0.f, 0.f, 0.f } };
+    const Vec3f eye(0.f, hills.GetHeight(0.f, 0.f) + 2.f, 0.f);
+    horizon.Init(HorizonCellSize, HorizonCellsPerSide, 7);
+    InitOccluders(hills, horizon, eye);
+    Check(horizon.IsOccluded(below));
+    Check(!horizon.IsOccluded(AABB3f{ eye - Vec3f(1.f, 500.f, 1.f), eye - Vec3f(-1.f, 499.f, -1.f) }));
+    Check(!horizon.IsOccluded(AABB3f{ Vec3f(-300.f, -1000.f, -1.f), Vec3f(100.f, -999.f, 1.f) }));
+}
+
+int main()
+{
+    TestOccludedBoxesAreHidden();
+    TestNeverOccluded();
+    return test::Finish();
+}
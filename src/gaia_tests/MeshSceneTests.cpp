@@ -0,0 +1,163 @@
+#include "Test.hpp"
+#include "MeshScene.hpp"
+#include "ShadowCascades.hpp"
+#include <random>
+#include <set>
+#include <tuple>
+
+using namespace gaia;
+
+static constexpr int NumMeshes = 8;
+static constexpr float SceneSize = 4096.f;
+
+// What a cull found, told apart by mesh and translation, since the batches don't say which instances they hold.
+using InstanceKey = std::tuple<int, float, float, float>;
+
+// Culls the scene, checking the batches are in mesh order and laid out back to back, and returns what they hold.
+static std::multiset<InstanceKey> CullScene(MeshScene& scene, const Frustumf& frustum, const MeshScene::OcclusionTest& occlusionTest)
+{
+    std::vector<MeshScene::Batch> batches;
+    std::vector<MeshInstanceTransform> transforms;
+    scene.Cull(frustum, occlusionTest, batches, transforms);
+
+    std::multiset<InstanceKey> found;
+    int lastMesh = -1;
+    int nextInstance = 0;
+    for (const MeshScene::Batch& batch : batches)
+    {
+        Check(batch.mesh > lastMesh && batch.numInstances > 0 && batch.firstInstance == nextInstance);
+        lastMesh = batch.mesh;
+        nextInstance += batch.numInstances;
+        for (int i = batch.firstInstance; i < batch.firstInstance + batch.numInstances; ++i)
+        {
+            const MeshInstanceTransform& transform = transforms[i];
+            found.insert({ batch.mesh, transform.rows[0].w, transform.rows[1].w, transform.rows[2].w });
+        }
+    }
+    Check(nextInstance == (int)transforms.size());
+    Check(scene.GetLastCullStats().numVisible == (int)transforms.size());
+    return found;
+}
+
+// Tens of thousands of instances, some outside the quadtree, then moved and removed at random, culled against camera views (with
+// an occlusion test) and shadow cascades: the quadtree finds exactly what testing every instance's box does. The cascades pick up
+// instances the camera can't see, which is why each pass has to be culled against its own frustum.
+static void TestCullMatchesBruteForce()
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    MeshScene scene;
+    scene.Init(Vec2f(-0.5f * SceneSize, -0.5f * SceneSize), SceneSize, 8);
+    for (int mesh = 0; mesh < NumMeshes; ++mesh)
+    {
+        const float scale = 1.f + (float)mesh;
+        Check(scene.AddMesh({ Vec3f(-1.f, 0.f, -1.f) * scale, Vec3f(1.f, 3.f, 1.f) * scale }) == mesh);
+    }
+
+    struct Placed
+    {
+        int instance = -1; // -1 once removed.
+        int mesh = 0;
+        Mat4f transform;
+    };
+    std::vector<Placed> placed;
+    for (int i = 0; i < 40000; ++i)
+    {
+        const float scale = 0.5f + 2.f * random(rng);
+        const float angle = 2.f * Pif * random(rng);
+        const Vec3f pos(2200.f * (2.f * random(rng) - 1.f), 50.f * random(rng), 2200.f * (2.f * random(rng) - 1.f));
+        Mat3f stretch(scale);
+        stretch[1][1] *= 0.5f + random(rng);
+        Placed instance;
+        instance.mesh = (int)(rng() % NumMeshes);
+        instance.transform = math::Mat4fCompose(math::Mat3fMakeRotationY(angle) * stretch, pos);
+        instance.instance = scene.AddInstance(instance.mesh, instance.transform);
+        placed.push_back(instance);
+    }
+    for (int i = 0; i < 20000; ++i)
+    {
+        Placed& instance = placed[rng() % placed.size()];
+        if (instance.instance < 0)
+            continue;
+
+        if (random(rng) < 0.3f)
+        {
+            scene.RemoveInstance(instance.instance);
+            instance.instance = -1;
+        }
+        else
+        {
+            instance.transform[3] += Vec4f(20.f * (random(rng) - 0.5f), 0.f, 20.f * (random(rng) - 0.5f), 0.f);
+            scene.SetTransform(instance.instance, instance.transform);
+        }
+    }
+
+    const auto bruteForce = [&](const Frustumf& frustum, float maxHeight)
+    {
+        std::multiset<InstanceKey> expected;
+        for (const Placed& instance : placed)
+        {
+            if (instance.instance < 0)
+                continue;
+
+            const AABB3f& box = scene.GetInstanceBounds(instance.instance);
+            if (frustum.Classify(box) != FrustumTest::Outside && box.m_min.y <= maxHeight)
+            {
+                expected.insert({ instance.mesh, instance.transform[3].x, instance.transform[3].y, instance.transform[3].z });
+            }
+        }
+        return expected;
+    };
+
+    // Pretends everything starting above 40 m is hidden.
+    const MeshScene::OcclusionTest occlusionTest = [](const Span<const AABB3f>& boxes, const Span<bool>& outOccluded)
+    {
+        for (size_t i = 0; i < boxes.Size(); ++i)
+        {
+            outOccluded[i] = boxes[i].m_min.y > 40.f;
+        }
+    };
+    const HeightBoundsQuery heightBounds = [](Vec2f, Vec2f) { return Vec2f(0.f, 60.f); };
+    const Vec3f sunDirection = math::normalize(Vec3f(0.65f, -0.5f, 0.65f));
+
+    bool viewsMatch = true;
+    bool cascadesMatch = true;
+    int numShadowOnly = 0;
+    for (int view = 0; view < 20; ++view)
+    {
+        const Vec3f eye(4000.f * random(rng) - 2000.f, 30.f, 4000.f * random(rng) - 2000.f);
+        const float yaw = 2.f * Pif * random(rng);
+        const Mat4f viewMat = math::lookAtRH(eye, eye + Vec3f(cosf(yaw), -0.1f, sinf(yaw)), Vec3fY);
+        const Frustumf frustum(math::perspectiveFovRH(1.f, 1920.f, 1080.f, 0.1f, 1500.f) * viewMat);
+        viewsMatch &= CullScene(scene, frustum, occlusionTest) == bruteForce(frustum, 40.f);
+
+        ShadowCameraParams camera;
+        camera.viewMat = viewMat;
+        camera.tanHalfFovY = tanf(0.5f);
+        camera.aspect = 1920.f / 1080.f;
+        camera.nearClip = 0.1f;
+        camera.farClip = 1500.f;
+        ShadowCascade cascades[MaxShadowCascades];
+        const int numCascades = CalcShadowCascades(camera, ShadowCascadeParams(), sunDirection, heightBounds, cascades);
+        const std::multiset<InstanceKey> seen = bruteForce(frustum, FLT_MAX);
+        for (int i = 0; i < numCascades; ++i)
+        {
+            const Frustumf cascadeFrustum(cascades[i].viewProjMat);
+            const std::multiset<InstanceKey> casters = CullScene(scene, cascadeFrustum, nullptr);
+            cascadesMatch &= casters == bruteForce(cascadeFrustum, FLT_MAX);
+            for (const InstanceKey& caster : casters)
+            {
+                numShadowOnly += seen.count(caster) == 0;
+            }
+        }
+    }
+    Check(viewsMatch);
+    Check(cascadesMatch);
+    Check(numShadowOnly > 0);
+}
+
+int main()
+{
+    TestCullMatchesBruteForce();
+    return test::Finish();
+}
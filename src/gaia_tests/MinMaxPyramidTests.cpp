@@ -0,0 +1,106 @@
+#include "Test.hpp"
+#include "MinMaxPyramid.hpp"
+#include <random>
+
+using namespace gaia;
+
+static bool SameNodes(const MinMaxPyramid& a, const MinMaxPyramid& b)
+{
+    bool same = a.GetNumLevels() == b.GetNumLevels();
+    for (int level = 0; level < a.GetNumLevels() && same; ++level)
+    {
+        for (int z = 0; z < a.GetLevelDimension(level); ++z)
+        {
+            for (int x = 0; x < a.GetLevelDimension(level); ++x)
+            {
+                same &= a.GetNode(level, Vec2i(x, z)) == b.GetNode(level, Vec2i(x, z));
+            }
+        }
+    }
+    return same;
+}
+
+// Random edits, raising and lowering rectangles of a height map with a row pitch wider than the map: after each, updating just
+// the edited rectangle leaves every node at every level as a full rebuild has it. Rectangles include single texels, the whole
+// map, ones hanging off its edges and empty ones. Every node of the rebuild is the exact range of the texels under it.
+static void TestUpdateMatchesBuild()
+{
+    for (int blockDimension : { 4, 8, 64 })
+    {
+        constexpr int Dimension = 64;
+        constexpr int Pitch = Dimension + 5;
+        std::mt19937 rng(blockDimension);
+        std::uniform_real_distribution<float> random(0.f, 1.f);
+        std::vector<float> heights(Pitch * Dimension);
+        for (float& height : heights)
+        {
+            height = 100.f * random(rng) - 50.f;
+        }
+
+        MinMaxPyramid updated(Dimension, blockDimension);
+        updated.Build(heights.data(), Pitch);
+        bool matches = true;
+        for (int edit = 0; edit < 300; ++edit)
+        {
+            Vec2i min(-8 + (int)(rng() % (Dimension + 8)), -8 + (int)(rng() % (Dimension + 8)));
+            Vec2i max = min + Vec2i((int)(rng() % 24), (int)(rng() % 24));
+            if (edit % 50 == 0)
+            {
+                min = Vec2iZero;
+                max = Vec2i(Dimension, Dimension);
+            }
+            else if (edit % 50 == 1)
+            {
+                max = min + Vec2i(1, 1);
+            }
+
+            // Mostly small nudges either way, sometimes well outside the range so far.
+            const float delta = (edit % 7 == 0) ? 500.f * (random(rng) - 0.5f) : 2.f * (random(rng) - 0.5f);
+            for (int z = std::max(min.y, 0); z < std::min(max.y, Dimension); ++z)
+            {
+                for (int x = std::max(min.x, 0); x < std::min(max.x, Dimension); ++x)
+                {
+                    heights[Pitch * z + x] += delta * random(rng);
+                }
+            }
+            updated.Update(heights.data(), Pitch, min, max);
+
+            MinMaxPyramid built(Dimension, blockDimension);
+            built.Build(heights.data(), Pitch);
+            matches &= SameNodes(updated, built);
+        }
+        Check(matches);
+
+        MinMaxPyramid built(Dimension, blockDimension);
+        built.Build(heights.data(), Pitch);
+        bool exact = true;
+        for (int level = 0; level < built.GetNumLevels(); ++level)
+        {
+            const int nodeTexels = built.GetNodeTexels(level);
+            for (int z = 0; z < built.GetLevelDimension(level); ++z)
+            {
+                for (int x = 0; x < built.GetLevelDimension(level); ++x)
+                {
+                    Vec2f bounds(FLT_MAX, -FLT_MAX);
+                    for (int texZ = z * nodeTexels; texZ < (z + 1) * nodeTexels; ++texZ)
+                    {
+                        for (int texX = x * nodeTexels; texX < (x + 1) * nodeTexels; ++texX)
+                        {
+                            bounds.x = std::min(bounds.x, heights[Pitch * texZ + texX]);
+                            bounds.y = std::max(bounds.y, heights[Pitch * texZ + texX]);
+                        }
+                    }
+                    exact &= built.GetNode(level, Vec2i(x, z)) == bounds;
+                }
+            }
+        }
+        Check(exact);
+        Check(built.GetLevelDimension(built.GetNumLevels() - 1) == 1);
+    }
+}
+
+int main()
+{
+    TestUpdateMatchesBuild();
+    return test::Finish();
+}
@@ -0,0 +1,95 @@
+#include "HorizonCuller.hpp"
+#include "OcclusionRasteriser.hpp"
+#include "ThreadPool.hpp"
+#include "Timer.hpp"
+#include <random>
+
+using namespace gaia;
+
+static float GetHeight(float x, float z)
+{
+    return 40.f * sinf(0.01f * x) * cosf(0.013f * z) + 10.f * sinf(0.05f * x + 0.03f * z);
+}
+
+// Rasterising the horizon culler's occluder boxes and testing boxes on the ground against them, from eyes just above rolling hills,
+// and how many of the boxes each culler hides.
+int main()
+{
+    constexpr int NumViews = 10;
+    constexpr int NumRuns = 20;
+    constexpr int NumBoxes = 3000;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    HorizonCuller horizon;
+    horizon.Init(4.f, 16, 7);
+    OcclusionRasteriser rasteriser;
+    rasteriser.Init(256, 144);
+    TriangleMesh mesh;
+
+    float rasteriseMs = 0.f;
+    float testMs = 0.f;
+    int numOccluded = 0;
+    int numHorizonOccluded = 0;
+    OcclusionRasteriser::Stats stats;
+    for (int view = 0; view < NumViews; ++view)
+    {
+        Vec3f eye(400.f * random(rng) - 200.f, 0.f, 400.f * random(rng) - 200.f);
+        eye.y = GetHeight(eye.x, eye.z) + 2.f + 10.f * random(rng);
+        horizon.UpdateLayout(Vec2f(eye.x, eye.z));
+        for (int i = 0; i < horizon.GetNumOccluders(); ++i)
+        {
+            // Roughly the lowest the ground gets over each cell; it doesn't have to be conservative to time.
+            const Vec4f& rect = horizon.GetOccluderRect(i);
+            float minHeight = FLT_MAX;
+            for (int z = 0; z <= 4; ++z)
+            {
+                for (int x = 0; x <= 4; ++x)
+                {
+                    minHeight = std::min(minHeight, GetHeight(rect.x + 0.25f * (float)x * (rect.z - rect.x), rect.y + 0.25f * (float)z * (rect.w - rect.y)));
+                }
+            }
+            horizon.SetOccluderHeight(i, minHeight - 1.f);
+        }
+        horizon.Build(eye);
+
+        const float yaw = 2.f * Pif * random(rng);
+        const Mat4f viewProj = math::perspectiveFovRH(1.f, 1920.f, 1080.f, 0.1f, 5000.f)
+            * math::lookAtRH(eye, eye + Vec3f(cosf(yaw), -0.05f, sinf(yaw)), Vec3fY);
+        Timer timer;
+        for (int run = 0; run < NumRuns; ++run)
+        {
+            horizon.BuildOccluderMesh(eye, -100.f, mesh);
+            rasteriser.Begin(viewProj);
+            rasteriser.RasteriseTriangles(mesh);
+            rasteriser.BuildPyramid();
+        }
+        rasteriseMs += 1000.f * timer.GetSecondsAndReset() / (float)NumRuns;
+        stats.numTriangles += rasteriser.GetStats().numTriangles;
+        stats.numRasterised += rasteriser.GetStats().numRasterised;
+        stats.numBinned += rasteriser.GetStats().numBinned;
+
+        std::vector<AABB3f> boxes;
+        for (int i = 0; i < NumBoxes; ++i)
+        {
+            const float distance = 20.f + 800.f * random(rng);
+            const float angle = yaw + 1.2f * (random(rng) - 0.5f);
+            const Vec2f centre = Vec2f(eye.x, eye.z) + distance * Vec2f(cosf(angle), sinf(angle));
+            const float size = 2.f + 6.f * random(rng);
+            const float ground = GetHeight(centre.x, centre.y);
+            boxes.push_back({ Vec3f(centre.x - size, ground - 1.f, centre.y - size), Vec3f(centre.x + size, ground + 2.f * size, centre.y + size) });
+        }
+        std::unique_ptr<bool[]> occluded(new bool[NumBoxes]);
+        timer.GetSecondsAndReset();
+        rasteriser.TestOcclusion(Span<const AABB3f>(boxes.data(), boxes.size()), Span<bool>(occluded.get(), boxes.size()));
+        testMs += 1000.f * timer.GetSecondsAndReset();
+        numOccluded += (int)std::count(occluded.get(), occluded.get() + NumBoxes, true);
+        numHorizonOccluded += (int)std::count_if(boxes.begin(), boxes.end(), [&](const AABB3f& box) { return horizon.IsOccluded(box); });
+    }
+
+    DebugOut("%d views, %d threads, 256 x 144 depth\n", NumViews, ThreadPool::Instance().GetNumThreads());
+    DebugOut("Rasterise:  %.3f ms (%d triangles, %d rasterised, %d binned)\n", rasteriseMs / (float)NumViews,
+        stats.numTriangles / NumViews, stats.numRasterised / NumViews, stats.numBinned / NumViews);
+    DebugOut("Test:       %.3f ms per %d boxes\n", testMs / (float)NumViews, NumBoxes);
+    DebugOut("Occluded:   %.1f%%, horizon %.1f%%\n", 100.f * (float)numOccluded / (float)(NumViews * NumBoxes), 100.f * (float)numHorizonOccluded / (float)(NumViews * NumBoxes));
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "Test.hpp"
+#include "HorizonCuller.hpp"
+#include "OcclusionRasteriser.hpp"
+#include <random>
+
+using namespace gaia;
+
+// As TerrainConstants has them.
+static constexpr int BufferWidth = 256;
+static constexpr int BufferHeight = 144;
+static constexpr int HorizonCellsPerSide = 16;
+
+static float GetHeight(float x, float z)
+{
+    return 40.f * sinf(0.01f * x) * cosf(0.013f * z) + 10.f * sinf(0.05f * x + 0.03f * z);
+}
+
+// Like Terrain::UpdateHorizon(): every cell occludes down to the lowest the ground gets over it. Dense samples, less the most
+// the ground can dip between them going by its steepest slope, stand in for the exact bound.
+static void InitOccluders(HorizonCuller& horizon, Vec3f eye)
+{
+    constexpr int NumSamples = 16;
+    constexpr float MaxSlope = 40.f * (0.01f + 0.013f) + 10.f * (0.05f + 0.03f);
+    horizon.UpdateLayout(Vec2f(eye.x, eye.z));
+    for (int i = 0; i < horizon.GetNumOccluders(); ++i)
+    {
+        const Vec4f& rect = horizon.GetOccluderRect(i);
+        const float spacing = (rect.z - rect.x) / (float)NumSamples;
+        float minHeight = FLT_MAX;
+        for (int z = 0; z <= NumSamples; ++z)
+        {
+            for (int x = 0; x <= NumSamples; ++x)
+            {
+                minHeight = std::min(minHeight, GetHeight(rect.x + (float)x * spacing, rect.y + (float)z * spacing));
+            }
+        }
+        horizon.SetOccluderHeight(i, minHeight - MaxSlope * spacing);
+    }
+    horizon.Build(eye);
+}
+
+// Whether the ground blocks the line of sight from the eye to a point, marched in small steps.
+static bool IsLineBlocked(Vec3f eye, Vec3f point)
+{
+    const float length = math::length(point - eye);
+    const int numSteps = (int)(length / 0.25f) + 1;
+    for (int step = 1; step < numSteps; ++step)
+    {
+        const Vec3f pos = eye + (point - eye) * ((float)step / (float)numSteps);
+        if (pos.y < GetHeight(pos.x, pos.z))
+            return true;
+    }
+    return false;
+}
+
+// A camera at the origin looking down -z, so view space is world space.
+static Mat4f MakeAxisViewProj()
+{
+    return math::perspectiveFovRH(1.f, (float)BufferWidth, (float)BufferHeight, 0.1f, 1000.f) * math::lookAtRH(Vec3fZero, -Vec3fZ, Vec3fY);
+}
+
+// Where a screen position (in pixels) points in view space, at z = -1.
+static Vec3f ScreenToDirection(Vec2f screen)
+{
+    const float tanHalfFovY = tanf(0.5f);
+    const Vec2f ndc(2.f * screen.x / (float)BufferWidth - 1.f, 1.f - 2.f * screen.y / (float)BufferHeight);
+    return Vec3f(ndc.x * tanHalfFovY * (float)BufferWidth / (float)BufferHeight, ndc.y * tanHalfFovY, -1.f);
+}
+
+static void AddQuad(const Vec3f corners[4], TriangleMesh& mesh)
+{
+    const uint32 firstVertex = (uint32)mesh.vertices.size();
+    mesh.vertices.insert(mesh.vertices.end(), corners, corners + 4);
+    for (uint32 corner : { 0, 1, 2, 0, 2, 3 })
+    {
+        mesh.indices.push_back(firstVertex + corner);
+    }
+}
+
+// Only pixels a triangle wholly covers take its depth, and then the furthest it has in them, so a box poking out past an edge by
+// less than a pixel isn't culled, and nothing is culled by a slanted occluder that's further away somewhere in the pixel.
+static void TestPixelsAreConservative()
+{
+    OcclusionRasteriser rasteriser;
+    rasteriser.Init(BufferWidth, BufferHeight);
+
+    // A wall 10 m away whose right edge is at 100.7 pixels across, so pixel 100's centre is inside it but not all of the pixel is.
+    const float edgeX = 10.f * ScreenToDirection(Vec2f(100.7f, 0.f)).x;
+    const Vec3f wall[4] = { Vec3f(-100.f, -100.f, -10.f), Vec3f(edgeX, -100.f, -10.f), Vec3f(edgeX, 100.f, -10.f), Vec3f(-100.f, 100.f, -10.f) };
+    TriangleMesh mesh;
+    AddQuad(wall, mesh);
+    rasteriser.Begin(MakeAxisViewProj());
+    rasteriser.RasteriseTriangles(mesh);
+    rasteriser.BuildPyramid();
+
+    const float* depth = rasteriser.GetLevel(0);
+    const int row = BufferWidth * (BufferHeight / 2);
+    Check(fabsf(depth[row + 99] - 0.1f) < 1e-5f && depth[row + 99] <= 0.1f);
+    Check(depth[row + 100] == 0.f);
+
+    // Thin boxes 20 m away, across the four pixels left of that one, and across the part of it inside the wall and past its edge.
+    const float boxY = 20.f * ScreenToDirection(Vec2f(0.f, 0.5f * (float)BufferHeight - 0.3f)).y;
+    const Vec2f insideX(20.f * ScreenToDirection(Vec2f(96.2f, 0.f)).x, 20.f * ScreenToDirection(Vec2f(99.8f, 0.f)).x);
+    const Vec2f pastX(20.f * ScreenToDirection(Vec2f(100.2f, 0.f)).x, 20.f * ScreenToDirection(Vec2f(100.9f, 0.f)).x);
+    Check(rasteriser.IsOccluded(AABB3f{ Vec3f(insideX.x, -boxY, -20.01f), Vec3f(insideX.y, boxY, -20.f) }));
+    Check(!rasteriser.IsOccluded(AABB3f{ Vec3f(pastX.x, -boxY, -20.01f), Vec3f(pastX.y, boxY, -20.f) }));
+
+    // Ground 2 m below the eye: the depth stored in each pixel is no nearer than anywhere the ground is in it.
+    const Vec3f ground[4] = { Vec3f(-50.f, -2.f, -3.f), Vec3f(50.f, -2.f, -3.f), Vec3f(50.f, -2.f, -500.f), Vec3f(-50.f, -2.f, -500.f) };
+    mesh = TriangleMesh();
+    AddQuad(ground, mesh);
+    rasteriser.Begin(MakeAxisViewProj());
+    rasteriser.RasteriseTriangles(mesh);
+    int numFilled = 0;
+    bool furthestInPixel = true;
+    for (int y = 0; y < BufferHeight; ++y)
+    {
+        for (int x = 0; x < BufferWidth; ++x)
+        {
+            const float stored = depth[BufferWidth * y + x];
+            if (stored == 0.f)
+                continue;
+
+            // 1 / w along a ray to the ground is how steeply it points down over the height of the eye; the top of the pixel is furthest.
+            ++numFilled;
+            furthestInPixel &= stored <= -ScreenToDirection(Vec2f((float)x, (float)y)).y / 2.f + 1e-6f;
+        }
+    }
+    Check(numFilled > BufferWidth * BufferHeight / 4);
+    Check(furthestInPixel);
+}
+
+// From eyes just above rolling hills, the boxes the occlusion buffer says are hidden really are: every corner, and some points inside,
+// that are on screen can't be seen. A good share of the boxes beyond the hills are culled, and the batched test agrees with IsOccluded().
+static void TestOccludedBoxesAreHidden()
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    HorizonCuller horizon;
+    horizon.Init(4.f, HorizonCellsPerSide, 7);
+    OcclusionRasteriser rasteriser;
+    rasteriser.Init(BufferWidth, BufferHeight);
+    TriangleMesh mesh;
+
+    int numBoxes = 0;
+    int numOccluded = 0;
+    int numVisiblePoints = 0;
+    bool batchMatches = true;
+    for (int view = 0; view < 8; ++view)
+    {
+        Vec3f eye(400.f * random(rng) - 200.f, 0.f, 400.f * random(rng) - 200.f);
+        eye.y = GetHeight(eye.x, eye.z) + 2.f + 10.f * random(rng);
+        InitOccluders(horizon, eye);
+        horizon.BuildOccluderMesh(eye, -100.f, mesh);
+
+        const float yaw = 2.f * Pif * random(rng);
+        const Mat4f viewProj = math::perspectiveFovRH(1.f, 1920.f, 1080.f, 0.1f, 5000.f)
+            * math::lookAtRH(eye, eye + Vec3f(cosf(yaw), -0.05f, sinf(yaw)), Vec3fY);
+        rasteriser.Begin(viewProj);
+        rasteriser.RasteriseTriangles(mesh);
+        rasteriser.BuildPyramid();
+
+        std::vector<AABB3f> boxes;
+        for (int i = 0; i < 500; ++i)
+        {
+            const float distance = 20.f + 800.f * random(rng);
+            const float angle = yaw + 1.2f * (random(rng) - 0.5f);
+            const Vec2f centre = Vec2f(eye.x, eye.z) + distance * Vec2f(cosf(angle), sinf(angle));
+            const float size = 2.f + 6.f * random(rng);
+            const float ground = GetHeight(centre.x, centre.y);
+            boxes.push_back({ Vec3f(centre.x - size, ground - 1.f, centre.y - size), Vec3f(centre.x + size, ground + 2.f * size, centre.y + size) });
+        }
+        std::unique_ptr<bool[]> occluded(new bool[boxes.size()]);
+        rasteriser.TestOcclusion(Span<const AABB3f>(boxes.data(), boxes.size()), Span<bool>(occluded.get(), boxes.size()));
+
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            const AABB3f& box = boxes[i];
+            batchMatches &= occluded[i] == rasteriser.IsOccluded(box);
+            ++numBoxes;
+            if (!occluded[i])
+                continue;
+
+            ++numOccluded;
+            for (int sample = 0; sample < 12; ++sample)
+            {
+                Vec3f point = box.m_min + (box.m_max - box.m_min) * Vec3f(random(rng), random(rng), random(rng));
+                if (sample < 8)
+                {
+                    point = Vec3f((sample & 1) ? box.m_max.x : box.m_min.x, (sample & 2) ? box.m_max.y : box.m_min.y, (sample & 4) ? box.m_max.z : box.m_min.z);
+                }
+                const Vec4f clip = viewProj * Vec4f(point, 1.f);
+                if (clip.w <= 0.f || fabsf(clip.x) > clip.w || fabsf(clip.y) > clip.w)
+                    continue;
+
+                numVisiblePoints += !IsLineBlocked(eye, point);
+            }
+        }
+    }
+    Check(batchMatches);
+    Check(numVisiblePoints == 0);
+    Check(numOccluded > numBoxes / 5);
+
+    // Boxes standing right in front of the eye, and reaching behind it, are never culled.
+    const Vec3f eye(0.f, GetHeight(0.f, 0.f) + 5.f, 0.f);
+    InitOccluders(horizon, eye);
+    horizon.BuildOccluderMesh(eye, -100.f, mesh);
+    rasteriser.Begin(math::perspectiveFovRH(1.f, 1920.f, 1080.f, 0.1f, 5000.f) * math::lookAtRH(eye, eye + Vec3fX, Vec3fY));
+    rasteriser.RasteriseTriangles(mesh);
+    rasteriser.BuildPyramid();
+    Check(!rasteriser.IsOccluded(AABB3f{ eye + Vec3f(5.f, -1.f, -1.f), eye + Vec3f(6.f, 1.f, 1.f) }));
+    Check(!rasteriser.IsOccluded(AABB3f{ eye - Vec3f(10.f, 10.f, 10.f), eye + Vec3f(10.f, 10.f, 10.f) }));
+}
+
+int main()
+{
+    TestPixelsAreConservative();
+    TestOccludedBoxesAreHidden();
+    return test::Finish();
+}
@@ -0,0 +1,105 @@
+#include "Test.hpp"
+#include "TerrainEncoding.hpp"
+
+using namespace gaia;
+
+// Angle between two unit vectors, in degrees, from the chord, which stays accurate for tiny angles.
+static float AngleDegrees(const Vec3f& a, const Vec3f& b)
+{
+    return 2.f * asinf(std::min(0.5f * math::length(a - b), 1.f)) * 180.f / Pif;
+}
+
+// numSamples directions spread evenly over the hemisphere above y = minY.
+static std::vector<Vec3f> MakeDirections(int numSamples, float minY)
+{
+    const float goldenAngle = Pif * (3.f - sqrtf(5.f));
+    std::vector<Vec3f> directions;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float y = 1.f - (1.f - minY) * ((float)i + 0.5f) / (float)numSamples;
+        const float radius = sqrtf(std::max(1.f - y * y, 0.f));
+        const float angle = goldenAngle * (float)i;
+        directions.push_back(Vec3f(radius * cosf(angle), y, radius * sinf(angle)));
+    }
+    return directions;
+}
+
+// Unquantised, every direction that points up comes back as it went in, and lands inside the diamond |u| + |v| <= 1.
+static void TestRoundTripsOverUpperHemisphere()
+{
+    float maxError = 0.f;
+    bool insideDiamond = true;
+    for (const Vec3f& normal : MakeDirections(1 << 16, 0.f))
+    {
+        const Vec2f encoded = EncodeOctahedral(normal);
+        insideDiamond &= fabsf(encoded.x) + fabsf(encoded.y) <= 1.f + 1e-6f;
+        maxError = std::max(maxError, AngleDegrees(DecodeOctahedral(encoded), normal));
+    }
+    Check(insideDiamond);
+    Check(maxError < 1e-3f);
+    Check(AngleDegrees(DecodeOctahedral(EncodeOctahedral(Vec3fY)), Vec3fY) == 0.f);
+}
+
+// Quantising each component moves it by at most half a step, d. The decoded vector before normalising has |x| + |y| + |z| = 1, so
+// is at least 1 / sqrt(3) long, and moves by at most sqrt(6) d (y takes up both components' changes), so the direction turns by at
+// most sqrt(18) d radians. That's under a degree at 8 bits, and the measured error is within it and not far under.
+static void TestQuantisedErrorIsBounded()
+{
+    for (int bits : { 8, 16 })
+    {
+        const float halfStep = 0.5f / (float)((1 << (bits - 1)) - 1);
+        const float bound = sqrtf(18.f) * halfStep * 180.f / Pif;
+        float maxError = 0.f;
+        for (const Vec3f& normal : MakeDirections(1 << 16, -1.f))
+        {
+            maxError = std::max(maxError, AngleDegrees(DecodeOctahedral(QuantiseSnorm(EncodeOctahedral(normal), bits)), normal));
+        }
+        Check(maxError < bound);
+        Check(maxError > 0.1f * bound);
+
+        // The figure the terrain shows in its stats agrees.
+        Check(fabsf(MeasureMaxOctahedralError(bits, 1 << 16) - maxError) <= 0.01f * maxError);
+    }
+    Check(MeasureMaxOctahedralError(8, 1 << 16) < 1.f);
+}
+
+// Either side of the fold at y = 0 encodes to the same place, so the encoding is continuous across it, and directions just below
+// it, the axes and straight down all decode back to themselves, quantised or not. A quantised normal that points up never decodes
+// to one pointing further down than the quantisation error allows.
+static void TestFold()
+{
+    bool continuous = true;
+    float maxError = 0.f;
+    float maxQuantisedError = 0.f;
+    for (const Vec3f& direction : MakeDirections(4096, 0.f))
+    {
+        const Vec3f flat = math::normalize(Vec3f(direction.x, 0.f, direction.z));
+        const Vec3f above = math::normalize(flat + Vec3f(0.f, 1e-4f, 0.f));
+        const Vec3f below = math::normalize(flat - Vec3f(0.f, 1e-4f, 0.f));
+        continuous &= math::length(EncodeOctahedral(above) - EncodeOctahedral(below)) < 1e-3f;
+        for (const Vec3f& normal : { flat, above, below })
+        {
+            maxError = std::max(maxError, AngleDegrees(DecodeOctahedral(EncodeOctahedral(normal)), normal));
+            maxQuantisedError = std::max(maxQuantisedError, AngleDegrees(DecodeOctahedral(QuantiseSnorm(EncodeOctahedral(normal), 8)), normal));
+        }
+    }
+    Check(continuous);
+    Check(maxError < 1e-3f);
+    Check(maxQuantisedError < sqrtf(18.f) * 0.5f / 127.f * 180.f / Pif);
+
+    for (const Vec3f& axis : { Vec3fX, -Vec3fX, Vec3fZ, -Vec3fZ, -Vec3fY })
+    {
+        Check(AngleDegrees(DecodeOctahedral(EncodeOctahedral(axis)), axis) < 1e-3f);
+        Check(AngleDegrees(DecodeOctahedral(QuantiseSnorm(EncodeOctahedral(axis), 8)), axis) < 1e-3f);
+    }
+    const Vec2f down = EncodeOctahedral(-Vec3fY);
+    Check(fabsf(down.x) == 1.f && fabsf(down.y) == 1.f);
+}
+
+int main()
+{
+    TestRoundTripsOverUpperHemisphere();
+    TestQuantisedErrorIsBounded();
+    TestFold();
+    return test::Finish();
+}
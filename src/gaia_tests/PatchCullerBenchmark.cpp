@@ -0,0 +1,74 @@
+#include "PatchCuller.hpp"
+#include "Timer.hpp"
+#include <random>
+
+using namespace gaia;
+
+// Culling a 255 x 255 patch grid over rolling hills against random perspective and orthographic frusta, by blocks with
+// WriteVisibleIndices() and by testing every patch's box with Frustumf::Intersects(), and how many frusta the two agree on.
+int main()
+{
+    constexpr int VertexGridDimension = 256;
+    constexpr int PatchesPerSide = VertexGridDimension - 1;
+    constexpr float PatchSize = 3.2f;
+    constexpr int NumFrusta = 200;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    PatchCuller culler;
+    culler.Init(VertexGridDimension, Vec2f(-0.5f * PatchSize * (float)PatchesPerSide), PatchSize, PatchOrder::RowMajor);
+    for (int z = 0; z < PatchesPerSide; ++z)
+    {
+        for (int x = 0; x < PatchesPerSide; ++x)
+        {
+            const float height = 40.f * sinf(0.05f * (float)x) * cosf(0.07f * (float)z);
+            culler.SetHeightBounds(x, z, Vec2f(height - 5.f * random(rng), height + 5.f * random(rng)));
+        }
+    }
+    culler.UpdateBlocks();
+
+    std::vector<uint32> indices(4 * math::Square(PatchesPerSide));
+    std::vector<uint8> visible(math::Square(PatchesPerSide));
+    float culledMs = 0.f;
+    float bruteForceMs = 0.f;
+    int numVisible = 0;
+    int numMatching = 0;
+    for (int i = 0; i < NumFrusta; ++i)
+    {
+        const Vec3f eye(600.f * random(rng) - 300.f, 20.f + 80.f * random(rng), 600.f * random(rng) - 300.f);
+        const float yaw = 2.f * Pif * random(rng);
+        const float pitch = -0.8f * random(rng);
+        const Vec3f dir(cosf(yaw) * cosf(pitch), sinf(pitch), sinf(yaw) * cosf(pitch));
+        const Mat4f proj = (i & 1) ? math::orthoRH(-100.f, 100.f, -80.f, 80.f, -50.f, 300.f) : math::perspectiveFovRH(0.25f * Pif, 1280.f, 720.f, 0.01f, 1000.f);
+        const Frustumf frustum(proj * math::lookAtRH(eye, eye + dir, Vec3fY));
+
+        Timer timer;
+        const int numIndices = culler.WriteVisibleIndices(frustum, indices.data());
+        culledMs += 1000.f * timer.GetSecondsAndReset();
+
+        int numBruteForce = 0;
+        for (int z = 0; z < PatchesPerSide; ++z)
+        {
+            for (int x = 0; x < PatchesPerSide; ++x)
+            {
+                visible[PatchesPerSide * z + x] = frustum.Intersects(culler.GetPatchBounds(x, z));
+                numBruteForce += visible[PatchesPerSide * z + x];
+            }
+        }
+        bruteForceMs += 1000.f * timer.GetSecondsAndReset();
+
+        // The first index of each patch is its first vertex.
+        bool matches = numIndices == 4 * numBruteForce;
+        for (int j = 0; j < numIndices && matches; j += 4)
+        {
+            const int x = (int)indices[j] % VertexGridDimension;
+            const int z = (int)indices[j] / VertexGridDimension;
+            matches = visible[PatchesPerSide * z + x] != 0;
+        }
+        numMatching += matches;
+        numVisible += numIndices / 4;
+    }
+
+    DebugOut("%d frusta, %d of %d patches visible on average, %d matching the brute force\n", NumFrusta, numVisible / NumFrusta, math::Square(PatchesPerSide), numMatching);
+    DebugOut("Blocks %.3f ms, brute force %.3f ms per frustum\n", culledMs / (float)NumFrusta, bruteForceMs / (float)NumFrusta);
+    return 0;
+}
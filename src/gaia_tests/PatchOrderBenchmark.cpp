@@ -0,0 +1,44 @@
+#include "PatchCuller.hpp"
+#include "PatchOrder.hpp"
+#include "Timer.hpp"
+
+using namespace gaia;
+
+// Post-transform cache misses of the full patch index list in each order, for a few grid and cache sizes, and how long the orders take to work out.
+int main()
+{
+    const char* orderNames[PatchOrder::Count] = { "Row Major", "Morton", "Hilbert" };
+    for (int vertexGridDimension : { 129, 256, 257 })
+    {
+        const int patchesPerSide = vertexGridDimension - 1;
+        DebugOut("%d x %d patches, ACMR (ATVR):\n", patchesPerSide, patchesPerSide);
+        for (int order = 0; order < PatchOrder::Count; ++order)
+        {
+            PatchCuller culler;
+            culler.Init(vertexGridDimension, Vec2fZero, 1.f, (PatchOrder::E)order);
+            std::vector<uint32> indices(4 * math::Square(patchesPerSide));
+            const int numIndices = culler.WriteAllIndices(indices.data());
+
+            DebugOut("  %-9s", orderNames[order]);
+            for (int cacheSize : { 16, DefaultVertexCacheSize, 64 })
+            {
+                const VertexCacheStats stats = SimulateVertexCache(Span<const uint32>(indices.data(), numIndices), 4, cacheSize);
+                DebugOut("  %2d entries %.3f (%.2f)", cacheSize, stats.acmr, stats.atvr);
+            }
+            DebugOut("\n");
+        }
+    }
+
+    const int numRepeats = 20;
+    std::vector<Vec2i> patches;
+    for (int order = 0; order < PatchOrder::Count; ++order)
+    {
+        Timer timer;
+        for (int i = 0; i < numRepeats; ++i)
+        {
+            CalcPatchOrder((PatchOrder::E)order, 255, 255, patches);
+        }
+        DebugOut("CalcPatchOrder %-9s 255 x 255: %.3f ms\n", orderNames[order], 1000.f * timer.GetSecondsAndReset() / (float)numRepeats);
+    }
+    return 0;
+}
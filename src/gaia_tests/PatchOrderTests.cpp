@@ -0,0 +1,178 @@
+#include "Test.hpp"
+#include "PatchCuller.hpp"
+#include "PatchOrder.hpp"
+#include <random>
+
+using namespace gaia;
+
+static int CountLongSteps(const std::vector<Vec2i>& patches)
+{
+    int numLongSteps = 0;
+    for (size_t i = 1; i < patches.size(); ++i)
+    {
+        const Vec2i step = math::abs(patches[i] - patches[i - 1]);
+        numLongSteps += step.x + step.y != 1;
+    }
+    return numLongSteps;
+}
+
+// Every order visits each patch once. The curves keep each aligned power of two square together, and the Hilbert curve
+// only ever steps to a neighbour over a power of two square; on other grids the patches it skips leave longer jumps.
+static void TestOrders()
+{
+    for (int order = 0; order < PatchOrder::Count; ++order)
+    {
+        for (int width = 1; width < 40; width += 3)
+        {
+            for (int height = 1; height < 40; height += 5)
+            {
+                std::vector<Vec2i> patches;
+                CalcPatchOrder((PatchOrder::E)order, width, height, patches);
+                std::vector<int> position(width * height, -1);
+                bool isPermutation = (int)patches.size() == width * height;
+                for (int i = 0; i < (int)patches.size() && isPermutation; ++i)
+                {
+                    const Vec2i coords = patches[i];
+                    isPermutation &= coords.x >= 0 && coords.y >= 0 && coords.x < width && coords.y < height && position[width * coords.y + coords.x] < 0;
+                    position[width * coords.y + coords.x] = i;
+                }
+                Check(isPermutation);
+                if (!isPermutation || order == PatchOrder::RowMajor)
+                    continue;
+
+                // The patches of each aligned square (clipped to the grid) take up a run of positions as long as the square.
+                bool squaresContiguous = true;
+                for (int size = 2; size < std::max(width, height); size *= 2)
+                {
+                    for (int z = 0; z < height; z += size)
+                    {
+                        for (int x = 0; x < width; x += size)
+                        {
+                            int first = INT_MAX;
+                            int last = -1;
+                            const Vec2i end = math::min(Vec2i(x + size, z + size), Vec2i(width, height));
+                            for (int j = z; j < end.y; ++j)
+                            {
+                                for (int i = x; i < end.x; ++i)
+                                {
+                                    first = std::min(first, position[width * j + i]);
+                                    last = std::max(last, position[width * j + i]);
+                                }
+                            }
+                            squaresContiguous &= last - first + 1 == (end.x - x) * (end.y - z);
+                        }
+                    }
+                }
+                Check(squaresContiguous);
+            }
+        }
+    }
+
+    std::vector<Vec2i> patches;
+    for (int size : { 2, 16, 256 })
+    {
+        CalcPatchOrder(PatchOrder::Hilbert, size, size, patches);
+        Check(CountLongSteps(patches) == 0);
+    }
+    CalcPatchOrder(PatchOrder::Hilbert, 255, 255, patches);
+    Check(CountLongSteps(patches) > 0);
+}
+
+static void TestSimulateVertexCache()
+{
+    // The same patch over and over only misses on its four vertices.
+    const uint16 repeated[16] = { 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3 };
+    VertexCacheStats stats = SimulateVertexCache(Span<const uint16>(repeated, 16), 4);
+    Check(stats.numMisses == 4 && stats.acmr == 1.f && stats.atvr == 1.f);
+
+    // FIFO: a hit doesn't save a vertex from being pushed out.
+    const uint32 fifo[6] = { 0, 1, 0, 2, 0, 1 };
+    stats = SimulateVertexCache(Span<const uint32>(fifo, 6), 3, 2);
+    Check(stats.numMisses == 5); // An LRU cache would keep 0 and miss 4 times.
+}
+
+// The full and culled index lists of a patch grid in each order: each culled list keeps the full list's order, and the curves
+// miss the vertex cache much less than row major.
+static void TestPatchCullerOrders()
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    for (int vertexGridDimension : { 2, 17, 100, 256, 257 })
+    {
+        const int patchesPerSide = vertexGridDimension - 1;
+        const int numIndices = 4 * math::Square(patchesPerSide);
+        float acmr[PatchOrder::Count];
+        for (int order = 0; order < PatchOrder::Count; ++order)
+        {
+            PatchCuller culler;
+            culler.Init(vertexGridDimension, Vec2f(-50.f, -50.f), 1.f, (PatchOrder::E)order);
+            for (int z = 0; z < patchesPerSide; ++z)
+            {
+                for (int x = 0; x < patchesPerSide; ++x)
+                {
+                    const float height = 10.f * random(rng);
+                    culler.SetHeightBounds(x, z, Vec2f(height, height + 1.f));
+                }
+            }
+            culler.UpdateBlocks();
+
+            std::vector<uint32> indices(numIndices);
+            Check(culler.WriteAllIndices(indices.data()) == numIndices);
+            std::vector<int> position(math::Square(vertexGridDimension), -1);
+            bool patchesValid = true;
+            for (int i = 0; i < numIndices; i += 4)
+            {
+                const uint32 first = indices[i];
+                patchesValid &= indices[i + 1] == first + 1 && indices[i + 2] == first + vertexGridDimension && indices[i + 3] == first + vertexGridDimension + 1;
+                patchesValid &= first % vertexGridDimension < (uint32)patchesPerSide && position[first] < 0;
+                position[first] = i;
+            }
+            Check(patchesValid);
+            acmr[order] = SimulateVertexCache(Span<const uint32>(indices.data(), numIndices), 4).acmr;
+
+            for (int view = 0; view < 20; ++view)
+            {
+                const Vec3f eye(200.f * random(rng) - 100.f, 5.f + 30.f * random(rng), 200.f * random(rng) - 100.f);
+                const float yaw = 2.f * Pif * random(rng);
+                const Mat4f viewProj = math::perspectiveFovRH(0.25f * Pif, 1280.f, 720.f, 0.01f, 80.f)
+                    * math::lookAtRH(eye, eye + Vec3f(cosf(yaw), -0.3f, sinf(yaw)), Vec3fY);
+                const Frustumf frustum(viewProj);
+
+                std::vector<uint32> visible(numIndices);
+                const int numVisible = culler.WriteVisibleIndices(frustum, visible.data());
+                bool inOrder = true;
+                int last = -1;
+                for (int i = 0; i < numVisible; i += 4)
+                {
+                    inOrder &= position[visible[i]] > last;
+                    last = position[visible[i]];
+                }
+                Check(inOrder);
+
+                int numIntersecting = 0;
+                for (int z = 0; z < patchesPerSide; ++z)
+                {
+                    for (int x = 0; x < patchesPerSide; ++x)
+                    {
+                        numIntersecting += frustum.Intersects(culler.GetPatchBounds(x, z));
+                    }
+                }
+                Check(numVisible == 4 * numIntersecting);
+            }
+        }
+
+        if (patchesPerSide >= 64)
+        {
+            Check(acmr[PatchOrder::Morton] < 0.75f * acmr[PatchOrder::RowMajor]);
+            Check(acmr[PatchOrder::Hilbert] < 0.75f * acmr[PatchOrder::RowMajor]);
+        }
+    }
+}
+
+int main()
+{
+    TestOrders();
+    TestSimulateVertexCache();
+    TestPatchCullerOrders();
+    return test::Finish();
+}
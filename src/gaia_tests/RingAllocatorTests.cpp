@@ -0,0 +1,157 @@
+#include "Test.hpp"
+#include "RingAllocator.hpp"
+#include <random>
+
+using namespace gaia;
+
+// Stands in for a GPU fence: values are signalled as work is submitted, and complete whenever the test says so.
+class FakeFence
+{
+public:
+    uint64 Signal() { return ++m_lastSignalled; }
+    void CompleteUpTo(uint64 value) { m_completed = std::max(m_completed, std::min(value, m_lastSignalled)); }
+    void CompleteAll() { m_completed = m_lastSignalled; }
+
+    uint64 GetLastSignalled() const { return m_lastSignalled; }
+    uint64 GetCompleted() const { return m_completed; }
+
+private:
+    uint64 m_lastSignalled = 0;
+    uint64 m_completed = 0;
+};
+
+static void TestAllocationsWaitForTheirFence()
+{
+    FakeFence fence;
+    RingAllocator ring(1024);
+
+    Check(ring.Allocate(512, 1) == 0);
+    Check(ring.Allocate(256, 256) == 512);
+    ring.Submit(fence.Signal());
+    Check(ring.Allocate(384, 1) == RingAllocator::InvalidOffset);
+
+    // Nothing is freed until the GPU has finished with it.
+    ring.Retire(fence.GetCompleted());
+    Check(ring.GetUsedBytes() == 768);
+    Check(ring.GetOldestFenceValue() == fence.GetLastSignalled());
+
+    fence.CompleteAll();
+    ring.Retire(fence.GetCompleted());
+    Check(ring.GetUsedBytes() == 0);
+    Check(ring.GetNumBatchesInFlight() == 0);
+    Check(ring.Allocate(1024, 1) == 0);
+}
+
+static void TestWrapsAroundToTheStart()
+{
+    FakeFence fence;
+    RingAllocator ring(1000);
+
+    Check(ring.Allocate(400, 1) == 0);
+    ring.Submit(fence.Signal());
+    Check(ring.Allocate(400, 1) == 400);
+    ring.Submit(fence.Signal());
+
+    // Only the first batch completes, so there's room at the start but not at the end.
+    fence.CompleteUpTo(1);
+    ring.Retire(fence.GetCompleted());
+    Check(ring.Allocate(300, 1) == 0);
+
+    // The 200 bytes skipped at the end are accounted to this batch, and freed along with it.
+    Check(ring.GetUsedBytes() == 400 + 200 + 300);
+    ring.Submit(fence.Signal());
+    Check(ring.Allocate(200, 1) == RingAllocator::InvalidOffset);
+
+    fence.CompleteAll();
+    ring.Retire(fence.GetCompleted());
+    Check(ring.GetUsedBytes() == 0);
+}
+
+static void TestAlignment()
+{
+    RingAllocator ring(4096);
+    Check(ring.Allocate(3, 1) == 0);
+    Check(ring.Allocate(16, 512) == 512);
+    Check(ring.Allocate(1, 4) == 528);
+    Check(ring.GetPendingBytes() == 529);
+    Check(ring.Allocate(0, 4) == RingAllocator::InvalidOffset);
+    Check(ring.Allocate(4097, 1) == RingAllocator::InvalidOffset);
+}
+
+// Random allocations, submits and partial completions, checking that live allocations never overlap and everything is freed eventually.
+static void TestRandomUsage()
+{
+    struct Allocation
+    {
+        uint64 offset;
+        uint64 size;
+        uint64 fenceValue; // 0 until submitted.
+    };
+
+    std::mt19937 rng(1);
+    for (int trial = 0; trial < 200; ++trial)
+    {
+        const uint64 capacity = 1 + rng() % 5000;
+        FakeFence fence;
+        RingAllocator ring(capacity);
+        std::vector<Allocation> live;
+        for (int step = 0; step < 5000; ++step)
+        {
+            const int op = rng() % 10;
+            if (op < 6)
+            {
+                const uint64 size = 1 + rng() % (capacity / 2 + 1);
+                const uint64 alignment = 1ull << (rng() % 10);
+                const uint64 offset = ring.Allocate(size, alignment);
+                if (offset == RingAllocator::InvalidOffset)
+                    continue;
+
+                Check(offset % alignment == 0 && offset + size <= capacity);
+                for (const Allocation& other : live)
+                {
+                    Check(offset + size <= other.offset || other.offset + other.size <= offset);
+                }
+                live.push_back({ offset, size, 0 });
+            }
+            else if (op < 8)
+            {
+                const uint64 fenceValue = fence.Signal();
+                ring.Submit(fenceValue);
+                for (Allocation& allocation : live)
+                {
+                    if (allocation.fenceValue == 0)
+                    {
+                        allocation.fenceValue = fenceValue;
+                    }
+                }
+            }
+            else
+            {
+                fence.CompleteUpTo(fence.GetCompleted() + 1 + rng() % 4);
+                ring.Retire(fence.GetCompleted());
+                live.erase(std::remove_if(live.begin(), live.end(), [&fence](const Allocation& allocation)
+                    { return allocation.fenceValue != 0 && allocation.fenceValue <= fence.GetCompleted(); }), live.end());
+                if (live.empty())
+                {
+                    Check(ring.GetUsedBytes() == 0);
+                }
+            }
+        }
+
+        // Once everything retires, the whole ring must be usable again.
+        ring.Submit(fence.Signal());
+        fence.CompleteAll();
+        ring.Retire(fence.GetCompleted());
+        Check(ring.GetUsedBytes() == 0);
+        Check(ring.Allocate(capacity, 1) == 0);
+    }
+}
+
+int main()
+{
+    TestAllocationsWaitForTheirFence();
+    TestWrapsAroundToTheStart();
+    TestAlignment();
+    TestRandomUsage();
+    return test::Finish();
+}
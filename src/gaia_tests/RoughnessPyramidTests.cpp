@@ -0,0 +1,183 @@
+#include "Test.hpp"
+#include "RoughnessPyramid.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr int Dimension = 256;
+static constexpr int CellDimension = 8;
+
+// The deviation computed the obvious way, texel by texel in double precision, as the kernel's reference.
+static float CalcBilinearDeviationReference(const float* heights, int pitch, int dimension)
+{
+    const double h00 = heights[0];
+    const double h10 = heights[dimension - 1];
+    const double h01 = heights[pitch * (dimension - 1)];
+    const double h11 = heights[pitch * (dimension - 1) + dimension - 1];
+    double maxDeviation = 0.0;
+    for (int z = 0; z < dimension; ++z)
+    {
+        for (int x = 0; x < dimension; ++x)
+        {
+            const double u = (double)x / (double)(dimension - 1);
+            const double v = (double)z / (double)(dimension - 1);
+            const double bilinear = (1.0 - u) * (1.0 - v) * h00 + u * (1.0 - v) * h10 + (1.0 - u) * v * h01 + u * v * h11;
+            maxDeviation = std::max(maxDeviation, fabs((double)heights[pitch * z + x] - bilinear));
+        }
+    }
+    return (float)maxDeviation;
+}
+
+// Rolling hills with noise on top, and a ramp over half of it so heights reach well over 100.
+static std::vector<float> MakeHeights(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+    std::vector<float> heights(math::Square(Dimension));
+    for (int z = 0; z < Dimension; ++z)
+    {
+        for (int x = 0; x < Dimension; ++x)
+        {
+            heights[Dimension * z + x] = 20.f * sinf(0.05f * (float)x) * cosf(0.03f * (float)z) + 0.2f * noise(rng) + (x > Dimension / 2 ? 0.5f * (float)x : 0.f);
+        }
+    }
+    return heights;
+}
+
+// Blocks of every size the kernel takes, at random places (so random alignments) in a wider map, against the reference.
+static void TestKernelMatchesReference()
+{
+    std::mt19937 rng(1);
+    const std::vector<float> heights = MakeHeights(rng);
+    float worstError = 0.f;
+    for (int dimension : { 4, 8, 12, 16, 32, 64 })
+    {
+        for (int trial = 0; trial < 200; ++trial)
+        {
+            const int x = (int)(rng() % (Dimension - dimension));
+            const int z = (int)(rng() % (Dimension - dimension));
+            const float* block = &heights[Dimension * z + x];
+            const float deviation = CalcBilinearDeviation(block, Dimension, dimension);
+            const float reference = CalcBilinearDeviationReference(block, Dimension, dimension);
+
+            // Float rounding of heights up to a couple of hundred metres.
+            worstError = std::max(worstError, fabsf(deviation - reference) / std::max(1.f, fabsf(block[0])));
+        }
+    }
+    Check(worstError < 1e-5f);
+
+    // A bilinear surface doesn't deviate from itself.
+    std::vector<float> bilinear(math::Square(64));
+    for (int z = 0; z < 64; ++z)
+    {
+        for (int x = 0; x < 64; ++x)
+        {
+            bilinear[64 * z + x] = 3.f + 0.5f * (float)x - 0.25f * (float)z + 0.01f * (float)(x * z);
+        }
+    }
+    Check(CalcBilinearDeviation(bilinear.data(), 64, 64) < 1e-4f);
+}
+
+// Updating just an edited region gives exactly what rebuilding everything does.
+static void TestIncrementalUpdateMatchesRebuild()
+{
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<float> noise(-5.f, 5.f);
+    std::vector<float> heights = MakeHeights(rng);
+    RoughnessPyramid pyramid(Dimension, CellDimension);
+    pyramid.Update(heights.data(), Dimension, Vec2iZero, Vec2i(Dimension, Dimension));
+
+    for (int edit = 0; edit < 20; ++edit)
+    {
+        const Vec2i min((int)(rng() % Dimension), (int)(rng() % Dimension));
+        const Vec2i max = math::min(min + Vec2i(1 + rng() % 90, 1 + rng() % 90), Vec2i(Dimension, Dimension));
+        for (int z = min.y; z < max.y; ++z)
+        {
+            for (int x = min.x; x < max.x; ++x)
+            {
+                heights[Dimension * z + x] += noise(rng);
+            }
+        }
+        pyramid.Update(heights.data(), Dimension, min, max);
+    }
+
+    RoughnessPyramid rebuilt(Dimension, CellDimension);
+    rebuilt.Update(heights.data(), Dimension, Vec2iZero, Vec2i(Dimension, Dimension));
+    Check(pyramid.GetNodes() == rebuilt.GetNodes());
+}
+
+// Mirrors SampleRoughness() in TerrainHull.hlsl from where it has the texel region, with the pyramids of every clip level in one buffer.
+static float QueryLikeShader(const std::vector<float>& buffer, int clipLevel, int nodes, Vec2i texelMin, Vec2i texelMax)
+{
+    int extentCells = (std::max(texelMax.x - texelMin.x, texelMax.y - texelMin.y) + CellDimension - 1) / CellDimension;
+    int level = std::min(extentCells > 1 ? math::ILog2(extentCells - 1) + 1 : 0, math::ILog2(nodes));
+    int levelNodes = nodes >> level;
+    int offset = clipLevel * (4 * nodes * nodes - 1) / 3 + 4 * (nodes * nodes - levelNodes * levelNodes) / 3;
+    int shift = math::ILog2(CellDimension) + level;
+    Vec2i nodeMin = texelMin >> shift;
+    Vec2i nodeMax = math::min((texelMax - Vec2i(1, 1)) >> shift, nodeMin + Vec2i(1, 1));
+
+    float roughness = 0.f;
+    for (int i = 0; i < 4; ++i)
+    {
+        Vec2i node = math::min(nodeMin + Vec2i(i & 1, i >> 1), nodeMax) & (levelNodes - 1);
+        roughness = std::max(roughness, buffer[offset + levelNodes * node.y + node.x]);
+    }
+    return roughness;
+}
+
+// Query() is never less than the max over the (wrapped) cells a region touches, and gives exactly what the hull shader reads.
+static void TestQuery()
+{
+    const int numClipLevels = 3;
+    const int nodes = Dimension / CellDimension;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+    std::vector<RoughnessPyramid> pyramids;
+    std::vector<float> buffer;
+    std::vector<float> heights(math::Square(Dimension));
+    for (int clipLevel = 0; clipLevel < numClipLevels; ++clipLevel)
+    {
+        for (float& height : heights)
+        {
+            height = (float)(clipLevel + 1) * noise(rng);
+        }
+        pyramids.emplace_back(Dimension, CellDimension);
+        pyramids.back().Update(heights.data(), Dimension, Vec2iZero, Vec2i(Dimension, Dimension));
+        buffer.insert(buffer.end(), pyramids.back().GetNodes().begin(), pyramids.back().GetNodes().end());
+    }
+
+    bool conservative = true;
+    bool matchesShader = true;
+    for (int trial = 0; trial < 20000; ++trial)
+    {
+        const int clipLevel = (int)(rng() % numClipLevels);
+        const RoughnessPyramid& pyramid = pyramids[clipLevel];
+        const Vec2i min((int)(rng() % 2000) - 1000, (int)(rng() % 2000) - 1000);
+        const int extent = 1 + (int)(rng() % (trial % 4 == 0 ? 600 : 50));
+        const Vec2i max = min + Vec2i(extent, 1 + (int)(rng() % extent));
+        const float roughness = pyramid.Query(min, max);
+
+        float cellsMax = 0.f;
+        const Vec2i cellMin = math::Vec2Floor(Vec2f(min) / (float)CellDimension);
+        const Vec2i cellMax = math::Vec2Floor(Vec2f(max - Vec2i(1, 1)) / (float)CellDimension);
+        for (int z = cellMin.y; z <= cellMax.y && z < cellMin.y + nodes; ++z)
+        {
+            for (int x = cellMin.x; x <= cellMax.x && x < cellMin.x + nodes; ++x)
+            {
+                cellsMax = std::max(cellsMax, pyramid.GetNode(0, Vec2i(x, z) & (nodes - 1)));
+            }
+        }
+        conservative &= roughness >= cellsMax;
+        matchesShader &= roughness == QueryLikeShader(buffer, clipLevel, nodes, min, max);
+    }
+    Check(conservative);
+    Check(matchesShader);
+}
+
+int main()
+{
+    TestKernelMatchesReference();
+    TestIncrementalUpdateMatchesRebuild();
+    TestQuery();
+    return test::Finish();
+}
@@ -0,0 +1,176 @@
+#include "Test.hpp"
+#include "RtinHierarchy.hpp"
+#include <random>
+#include <unordered_map>
+
+using namespace gaia;
+
+// Grids from a single cell up to ones wide enough that a triangle's area times a barycentric weight no longer fits in an int,
+// so a sanitizer build catches that creeping back in.
+static constexpr int GridCells[] = { 1, 4, 64, 256 };
+static constexpr int SpikeGridCells[] = { 4, 64, 256, 1024 };
+
+// A directed edge between two grid samples, as a key.
+static uint64 EdgeKey(Vec2i from, Vec2i to)
+{
+    return ((uint64)from.x << 48) | ((uint64)from.y << 32) | ((uint64)to.x << 16) | (uint64)to.y;
+}
+
+static std::vector<float> MakeHeights(int cells, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> noise(0.f, 1.f);
+    const int gridDimension = cells + 1;
+    std::vector<float> heights(math::Square(gridDimension));
+    for (int z = 0; z < gridDimension; ++z)
+    {
+        for (int x = 0; x < gridDimension; ++x)
+        {
+            heights[gridDimension * z + x] = 5.f * sinf(0.3f * (float)x) * cosf(0.2f * (float)z) + noise(rng);
+        }
+    }
+    return heights;
+}
+
+// Checks meshes made with a cell size of 1 at the origin: they're wound counter-clockwise seen from above, cover the grid exactly,
+// meet without T-junctions or cracks, and no sample is further than maxError from the triangles over it.
+static void CheckMeshes(const std::vector<TriangleMesh>& meshes, const std::vector<float>& heights, int cells, float maxError)
+{
+    const int gridDimension = cells + 1;
+    std::vector<float> sampleErrors(math::Square(gridDimension), -1.f);
+    std::unordered_map<uint64, int> edges;
+
+    int64 doubleArea = 0;
+    bool allCounterClockwise = true;
+    for (const TriangleMesh& mesh : meshes)
+    {
+        for (size_t i = 0; i < mesh.indices.size(); i += 3)
+        {
+            Vec3f v[3];
+            Vec2i p[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                v[j] = mesh.vertices[mesh.indices[i + j]];
+                p[j] = Vec2i((int)v[j].x, (int)v[j].z);
+            }
+
+            // Twice the signed area seen from above, positive when counter-clockwise with x right and z down the page.
+            auto edge = [](Vec2i from, Vec2i to, Vec2i q) { return (int64)(to.x - from.x) * (q.y - from.y) - (int64)(to.y - from.y) * (q.x - from.x); };
+            const int64 area = edge(p[0], p[2], p[1]);
+            allCounterClockwise &= area > 0;
+            doubleArea += area;
+            for (int j = 0; j < 3; ++j)
+            {
+                ++edges[EdgeKey(p[j], p[(j + 1) % 3])];
+            }
+
+            const Vec2i min = math::min(math::min(p[0], p[1]), p[2]);
+            const Vec2i max = math::max(math::max(p[0], p[1]), p[2]);
+            for (int z = min.y; z <= max.y; ++z)
+            {
+                for (int x = min.x; x <= max.x; ++x)
+                {
+                    const Vec2i q(x, z);
+                    const int64 w0 = edge(p[2], p[1], q);
+                    const int64 w1 = edge(p[0], p[2], q);
+                    const int64 w2 = edge(p[1], p[0], q);
+                    if (w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+
+                    const float planeHeight = ((float)w0 * v[0].y + (float)w1 * v[1].y + (float)w2 * v[2].y) / (float)area;
+                    float& error = sampleErrors[gridDimension * z + x];
+                    error = std::max(error, fabsf(planeHeight - heights[gridDimension * z + x]));
+                }
+            }
+        }
+    }
+
+    Check(allCounterClockwise);
+    Check(doubleArea == 2 * (int64)math::Square(cells));
+
+    // Each edge is used once in each direction, except along the border of the grid.
+    bool conforming = true;
+    for (const TriangleMesh& mesh : meshes)
+    {
+        for (size_t i = 0; i < mesh.indices.size(); ++i)
+        {
+            const Vec3f& from = mesh.vertices[mesh.indices[i]];
+            const Vec3f& to = mesh.vertices[mesh.indices[i % 3 == 2 ? i - 2 : i + 1]];
+            const Vec2i a((int)from.x, (int)from.z);
+            const Vec2i b((int)to.x, (int)to.z);
+            const bool border = (a.x == b.x && (a.x == 0 || a.x == cells)) || (a.y == b.y && (a.y == 0 || a.y == cells));
+            conforming &= edges[EdgeKey(a, b)] == 1 && (border || edges.count(EdgeKey(b, a)) == 1);
+        }
+    }
+    Check(conforming);
+
+    float worstError = 0.f;
+    bool allCovered = true;
+    for (float error : sampleErrors)
+    {
+        allCovered &= error >= 0.f;
+        worstError = std::max(worstError, error);
+    }
+    Check(allCovered);
+    Check(worstError <= maxError + 1e-4f);
+}
+
+static void TestWholeAndTiledMeshes()
+{
+    std::mt19937 rng(1);
+    for (int cells : GridCells)
+    {
+        const std::vector<float> heights = MakeHeights(cells, rng);
+        RtinHierarchy rtin;
+        rtin.Build(heights.data(), cells + 1, Vec3f(0.f), 1.f);
+        for (float maxError : { 0.f, 0.5f, 2.f, 100.f })
+        {
+            TriangleMesh mesh;
+            rtin.Extract(maxError, mesh);
+            CheckMeshes({ mesh }, heights, cells, maxError);
+
+            // Tiles of a few sizes, which must meet each other as well as the whole mesh does.
+            for (int tileDimension = std::max(1, cells / 16); tileDimension <= cells; tileDimension *= 4)
+            {
+                std::vector<TriangleMesh> tiles;
+                for (int z = 0; z < cells / tileDimension; ++z)
+                {
+                    for (int x = 0; x < cells / tileDimension; ++x)
+                    {
+                        tiles.emplace_back();
+                        rtin.ExtractTile(maxError, tileDimension, Vec2i(x, z), tiles.back());
+                    }
+                }
+                CheckMeshes(tiles, heights, cells, maxError);
+            }
+        }
+    }
+}
+
+// A single spike on flat ground is only kept by the triangles over it, so the meshes stay small.
+static void TestSpikeOnFlatGround()
+{
+    for (int cells : SpikeGridCells)
+    {
+        const int gridDimension = cells + 1;
+        const Vec2i spike(cells / 2 + 3, cells / 2 - 1);
+        std::vector<float> heights(math::Square(gridDimension), 0.f);
+        heights[gridDimension * spike.y + spike.x] = 1.f;
+
+        RtinHierarchy rtin;
+        rtin.Build(heights.data(), gridDimension, Vec3f(0.f), 1.f);
+        TriangleMesh mesh;
+        rtin.Extract(1.f, mesh);
+        Check(mesh.indices.size() == 6);
+
+        rtin.Extract(0.5f, mesh);
+        CheckMeshes({ mesh }, heights, cells, 0.5f);
+        Check(mesh.indices.size() / 3 <= (size_t)(16 * math::ILog2(cells))); // A bintree path down to the spike, and the splits that keep it conforming.
+    }
+}
+
+int main()
+{
+    TestWholeAndTiledMeshes();
+    TestSpikeOnFlatGround();
+    return test::Finish();
+}
@@ -0,0 +1,160 @@
+#include "Test.hpp"
+#include "PatchCuller.hpp"
+#include "ShadowCascades.hpp"
+#include <random>
+
+using namespace gaia;
+
+// A patch grid over [-512, 512] around a smooth height function, like the terrain's, to fit cascade depths to.
+static constexpr int VertexGridDimension = 129;
+static constexpr float PatchSize = 8.f;
+static constexpr Vec2f GridOrigin(-512.f, -512.f);
+static constexpr float GridExtent = 510.f; // Samples stay this far inside it.
+
+static float GetHeight(float x, float z)
+{
+    return 20.f * sinf(0.01f * x) * cosf(0.013f * z) + 5.f * sinf(0.07f * x + 0.05f * z);
+}
+
+static void InitCuller(PatchCuller& culler)
+{
+    culler.Init(VertexGridDimension, GridOrigin, PatchSize, PatchOrder::RowMajor);
+    for (int z = 0; z < VertexGridDimension - 1; ++z)
+    {
+        for (int x = 0; x < VertexGridDimension - 1; ++x)
+        {
+            // Dense samples and a margin stand in for the exact bounds of each patch.
+            Vec2f bounds(FLT_MAX, -FLT_MAX);
+            for (int j = 0; j <= 8; ++j)
+            {
+                for (int i = 0; i <= 8; ++i)
+                {
+                    float height = GetHeight(GridOrigin.x + ((float)x + (float)i / 8.f) * PatchSize, GridOrigin.y + ((float)z + (float)j / 8.f) * PatchSize);
+                    bounds.x = std::min(bounds.x, height - 0.5f);
+                    bounds.y = std::max(bounds.y, height + 0.5f);
+                }
+            }
+            culler.SetHeightBounds(x, z, bounds);
+        }
+    }
+    culler.UpdateBlocks();
+}
+
+static ShadowCameraParams MakeCamera(const Vec3f& pos, float yaw, float pitch)
+{
+    ShadowCameraParams camera;
+    camera.viewMat = math::affineInverse(math::Mat4fCompose(math::Mat3fMakeRotationY(yaw) * math::Mat3fMakeRotationX(pitch), pos));
+    camera.tanHalfFovY = tanf(0.125f * Pif);
+    camera.aspect = 16.f / 9.f;
+    camera.nearClip = 0.01f;
+    camera.farClip = 1000.f;
+    return camera;
+}
+
+static const Vec3f SunDirection = math::normalize(Vec3f(0.65f, -0.5f, 0.65f));
+
+// The same camera must give bit identical cascades every time, or the shadows shimmer with the camera standing still.
+static void TestStaticCameraIsBitStable(const HeightBoundsQuery& heightBounds)
+{
+    const ShadowCameraParams camera = MakeCamera(Vec3f(10.f, 30.f, 5.f), 0.3f, -0.4f);
+    const ShadowCascadeParams params;
+    ShadowCascade first[MaxShadowCascades];
+    const int numCascades = CalcShadowCascades(camera, params, SunDirection, heightBounds, first);
+    Check(numCascades == params.numCascades);
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        ShadowCascade cascades[MaxShadowCascades];
+        Check(CalcShadowCascades(camera, params, SunDirection, heightBounds, cascades) == numCascades);
+        Check(memcmp(first, cascades, numCascades * sizeof(ShadowCascade)) == 0);
+    }
+}
+
+// As the camera moves and turns, each cascade keeps its size and moves in whole shadow map texels.
+static void TestMovingCameraSnapsToTexels(const HeightBoundsQuery& heightBounds)
+{
+    const ShadowCascadeParams params;
+    ShadowCascade first[MaxShadowCascades];
+    const int numCascades = CalcShadowCascades(MakeCamera(Vec3f(10.f, 30.f, 5.f), 0.3f, -0.4f), params, SunDirection, heightBounds, first);
+
+    bool sameSize = true;
+    float worstFraction = 0.f;
+    for (int frame = 1; frame < 500; ++frame)
+    {
+        const float t = (float)frame;
+        const ShadowCameraParams camera = MakeCamera(Vec3f(10.f + 0.013f * t, 30.f + 0.002f * t, 5.f - 0.007f * t), 0.3f + 0.01f * t, -0.4f + 0.001f * t);
+        ShadowCascade cascades[MaxShadowCascades];
+        CalcShadowCascades(camera, params, SunDirection, heightBounds, cascades);
+        for (int i = 0; i < numCascades; ++i)
+        {
+            sameSize &= cascades[i].radius == first[i].radius && cascades[i].texelSize == first[i].texelSize;
+            for (int axis = 0; axis < 2; ++axis)
+            {
+                float texels = (cascades[i].lightSpaceBounds.m_min[axis] - first[i].lightSpaceBounds.m_min[axis]) / first[i].texelSize;
+                worstFraction = std::max(worstFraction, fabsf(texels - roundf(texels)));
+            }
+        }
+    }
+    Check(sameSize);
+    Check(worstFraction < 1e-2f);
+}
+
+// Ground inside each cascade's sphere lands inside its map, and the ground between that and the sun isn't clipped by the near plane.
+static void TestDepthRangeIsConservative(const HeightBoundsQuery& heightBounds)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> random(-1.f, 1.f);
+    const ShadowCascadeParams params;
+    int numReceivers = 0;
+    int numOutside = 0;
+    int numCastersClipped = 0;
+    for (int view = 0; view < 20; ++view)
+    {
+        const ShadowCameraParams camera = MakeCamera(Vec3f(200.f * random(rng), 30.f, 200.f * random(rng)), Pif * random(rng), -0.3f);
+        ShadowCascade cascades[MaxShadowCascades];
+        const int numCascades = CalcShadowCascades(camera, params, SunDirection, heightBounds, cascades);
+        for (int i = 0; i < numCascades; ++i)
+        {
+            const ShadowCascade& cascade = cascades[i];
+            for (int sample = 0; sample < 200; ++sample)
+            {
+                Vec2f xz = Vec2f(cascade.centre.x, cascade.centre.z) + Vec2f(random(rng), random(rng)) * cascade.radius;
+                Vec3f receiver(xz.x, GetHeight(xz.x, xz.y), xz.y);
+                if (std::max(fabsf(xz.x), fabsf(xz.y)) > GridExtent || math::length(receiver - cascade.centre) > cascade.radius)
+                    continue;
+
+                ++numReceivers;
+                Vec4f clip = cascade.viewProjMat * Vec4f(receiver, 1.f);
+                numOutside += fabsf(clip.x) > 1.0001f || fabsf(clip.y) > 1.0001f || clip.z < -1e-4f || clip.z > 1.0001f;
+
+                for (float distance = 1.f; distance < 400.f; distance += 2.f)
+                {
+                    Vec3f towardsSun = receiver - SunDirection * distance;
+                    if (std::max(fabsf(towardsSun.x), fabsf(towardsSun.z)) > GridExtent)
+                        break;
+
+                    float height = GetHeight(towardsSun.x, towardsSun.z);
+                    if (height >= towardsSun.y)
+                    {
+                        Vec4f casterClip = cascade.viewProjMat * Vec4f(towardsSun.x, height, towardsSun.z, 1.f);
+                        numCastersClipped += casterClip.z < -1e-4f;
+                    }
+                }
+            }
+        }
+    }
+    Check(numReceivers > 1000);
+    Check(numOutside == 0);
+    Check(numCastersClipped == 0);
+}
+
+int main()
+{
+    PatchCuller culler;
+    InitCuller(culler);
+    const HeightBoundsQuery heightBounds = [&culler](Vec2f worldMin, Vec2f worldMax) { return culler.CalcHeightBounds(worldMin, worldMax); };
+
+    TestStaticCameraIsBitStable(heightBounds);
+    TestMovingCameraSnapsToTexels(heightBounds);
+    TestDepthRangeIsConservative(heightBounds);
+    return test::Finish();
+}
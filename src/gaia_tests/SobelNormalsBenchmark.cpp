@@ -0,0 +1,50 @@
+#include "SobelNormals.hpp"
+#include "ThreadPool.hpp"
+#include "Timer.hpp"
+
+using namespace gaia;
+
+// Throughput of the CPU Sobel filters, in texels per second, over a whole clipmap level's worth of texels and over tiles.
+int main()
+{
+    const int dimension = 2048;
+    const int tileDimension = 64;
+    const int numRepeats = 5;
+    std::vector<float> heights(math::Square(dimension));
+    for (int i = 0; i < (int)heights.size(); ++i)
+    {
+        heights[i] = (float)((uint32)i * 2654435761u >> 20) * 0.001f;
+    }
+    std::vector<Vec3f> normals(math::Square(dimension));
+    const float numMtexels = (float)numRepeats * (float)math::Square(dimension) / 1e6f;
+
+    Timer timer;
+    for (int i = 0; i < numRepeats; ++i)
+    {
+        ComputeSobelNormals(heights.data(), dimension, Vec2iZero, Vec2i(dimension, dimension), 0.1f, normals.data());
+    }
+    DebugOut("Single threaded: %.1f Mtexels/s\n", numMtexels / timer.GetSecondsAndReset());
+
+    for (int i = 0; i < numRepeats; ++i)
+    {
+        ComputeSobelNormalsParallel(heights.data(), dimension, Vec2iZero, Vec2i(dimension, dimension), 0.1f, normals.data());
+    }
+    DebugOut("Parallel:        %.1f Mtexels/s (%d threads)\n", numMtexels / timer.GetSecondsAndReset(), ThreadPool::Instance().GetNumThreads());
+
+    // Every whole tile that has a border inside the map, one at a time, as a tile producer would.
+    const int tilesPerSide = dimension / tileDimension - 1;
+    for (int i = 0; i < numRepeats; ++i)
+    {
+        for (int tileZ = 0; tileZ < tilesPerSide; ++tileZ)
+        {
+            for (int tileX = 0; tileX < tilesPerSide; ++tileX)
+            {
+                const float* bordered = &heights[dimension * tileZ * tileDimension + tileX * tileDimension];
+                ComputeSobelNormalsBordered(bordered, dimension, Vec2i(tileDimension, tileDimension), 0.1f, normals.data());
+            }
+        }
+    }
+    const float numTileMtexels = (float)numRepeats * (float)math::Square(tilesPerSide * tileDimension) / 1e6f;
+    DebugOut("Bordered tiles:  %.1f Mtexels/s\n", numTileMtexels / timer.GetSecondsAndReset());
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include "Test.hpp"
+#include "SobelNormals.hpp"
+#include "TerrainEncoding.hpp"
+#include <random>
+
+using namespace gaia;
+
+static constexpr float TexelSize = 0.1f;
+
+// Within float rounding of the shader's arithmetic, which is far finer than even the 16 bit normal encoding.
+static constexpr float MaxError = 1e-5f;
+
+static std::vector<float> MakeHeights(int dimension, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> random(0.f, 3.f);
+    std::vector<float> heights(math::Square(dimension));
+    for (float& height : heights)
+    {
+        height = random(rng);
+    }
+    return heights;
+}
+
+// Random regions, including ones that wrap or lie outside the texture, against the shader's arithmetic texel by texel.
+static void TestWrappedMatchesReference()
+{
+    std::mt19937 rng(1);
+    auto random = [&rng](int min, int max) { return std::uniform_int_distribution<int>(min, max)(rng); };
+    for (int dimension : { 8, 64, 256 })
+    {
+        const std::vector<float> heights = MakeHeights(dimension, rng);
+        const int mask = dimension - 1;
+        for (int trial = 0; trial < 50; ++trial)
+        {
+            const Vec2i min(random(-dimension, 2 * dimension), random(-dimension, 2 * dimension));
+            const Vec2i size(random(1, dimension), random(1, dimension));
+            const Vec3f unwritten(9.f, 9.f, 9.f);
+            std::vector<Vec3f> normals(math::Square(dimension), unwritten);
+            if (trial & 1)
+            {
+                ComputeSobelNormalsParallel(heights.data(), dimension, min, min + size, TexelSize, normals.data());
+            }
+            else
+            {
+                ComputeSobelNormals(heights.data(), dimension, min, min + size, TexelSize, normals.data());
+            }
+
+            float maxError = 0.f;
+            bool wroteOutside = false;
+            for (int z = 0; z < dimension; ++z)
+            {
+                for (int x = 0; x < dimension; ++x)
+                {
+                    const Vec3f& normal = normals[dimension * z + x];
+                    if (((x - min.x) & mask) < size.x && ((z - min.y) & mask) < size.y)
+                    {
+                        maxError = std::max(maxError, math::length(normal - ComputeSobelNormalReference(heights.data(), dimension, Vec2i(x, z), TexelSize)));
+                    }
+                    else
+                    {
+                        wroteOutside |= normal != unwritten;
+                    }
+                }
+            }
+            Check(maxError <= MaxError);
+            Check(!wroteOutside);
+        }
+    }
+}
+
+// A tile cut out of a bigger map, with a border from its neighbours, must get the same normals as the same texels of the whole map.
+static void TestBorderedMatchesWholeMap()
+{
+    std::mt19937 rng(2);
+    const int dimension = 64;
+    const std::vector<float> heights = MakeHeights(dimension, rng);
+    std::vector<Vec3f> whole(math::Square(dimension));
+    ComputeSobelNormals(heights.data(), dimension, Vec2iZero, Vec2i(dimension, dimension), TexelSize, whole.data());
+
+    for (Vec2i size : { Vec2i(16, 16), Vec2i(13, 7), Vec2i(1, 1) })
+    {
+        for (Vec2i tileMin : { Vec2i(1, 1), Vec2i(24, 40), Vec2i(dimension - size.x - 1, 5) })
+        {
+            // The bordered block, as the caller would gather it from the tile and its neighbours, with some slack at the end of each row.
+            const int pitch = size.x + 5;
+            std::vector<float> bordered(pitch * (size.y + 2));
+            for (int z = 0; z < size.y + 2; ++z)
+            {
+                const float* row = &heights[dimension * (tileMin.y - 1 + z) + tileMin.x - 1];
+                std::copy(row, row + size.x + 2, &bordered[pitch * z]);
+            }
+
+            std::vector<Vec3f> normals(size.x * size.y);
+            ComputeSobelNormalsBordered(bordered.data(), pitch, size, TexelSize, normals.data());
+
+            bool matches = true;
+            for (int z = 0; z < size.y; ++z)
+            {
+                for (int x = 0; x < size.x; ++x)
+                {
+                    matches &= normals[size.x * z + x] == whole[dimension * (tileMin.y + z) + tileMin.x + x];
+                }
+            }
+            Check(matches);
+        }
+    }
+}
+
+// After encoding, as the clipmap stores them, the CPU and shader's normals should land on the same texel values, bar the odd rounding tie.
+static void TestEncodedMatchesReference()
+{
+    std::mt19937 rng(3);
+    const int dimension = 256;
+    const std::vector<float> heights = MakeHeights(dimension, rng);
+    std::vector<Vec3f> normals(math::Square(dimension));
+    ComputeSobelNormalsParallel(heights.data(), dimension, Vec2iZero, Vec2i(dimension, dimension), TexelSize, normals.data());
+
+    for (int bits : { 8, 16 })
+    {
+        const float step = 1.f / (float)((1 << (bits - 1)) - 1);
+        float maxDifference = 0.f;
+        for (int z = 0; z < dimension; ++z)
+        {
+            for (int x = 0; x < dimension; ++x)
+            {
+                Vec2f encoded = QuantiseSnorm(EncodeOctahedral(normals[dimension * z + x]), bits);
+                Vec2f reference = QuantiseSnorm(EncodeOctahedral(ComputeSobelNormalReference(heights.data(), dimension, Vec2i(x, z), TexelSize)), bits);
+                Vec2f difference = math::abs(encoded - reference);
+                maxDifference = std::max(maxDifference, std::max(difference.x, difference.y));
+            }
+        }
+        Check(maxDifference <= 1.001f * step);
+    }
+}
+
+int main()
+{
+    TestWrappedMatchesReference();
+    TestBorderedMatchesWholeMap();
+    TestEncodedMatchesReference();
+    return test::Finish();
+}
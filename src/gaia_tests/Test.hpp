@@ -0,0 +1,41 @@
+#pragma once
+
+namespace gaia
+{
+
+namespace test
+{
+
+inline int& NumFailures()
+{
+    static int numFailures = 0;
+    return numFailures;
+}
+
+// Returns the exit code for main().
+inline int Finish()
+{
+    if (NumFailures() > 0)
+    {
+        DebugOut("%d check(s) failed\n", NumFailures());
+        return 1;
+    }
+
+    DebugOut("All checks passed\n");
+    return 0;
+}
+
+}
+
+}
+
+// Like Assert(), but always on, and records the failure rather than stopping.
+#define Check(expr)                                                                   \
+    do                                                                                \
+    {                                                                                 \
+        if (!(expr))                                                                  \
+        {                                                                             \
+            DebugOut("Check failed in %s, line %d: %s\n", __FILE__, __LINE__, #expr); \
+            ++gaia::test::NumFailures();                                              \
+        }                                                                             \
+    } while (0)
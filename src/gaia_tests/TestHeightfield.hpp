@@ -0,0 +1,58 @@
+#pragma once
+#include "MinMaxPyramid.hpp"
+#include "WrappedHeightfield.hpp"
+
+namespace gaia
+{
+
+namespace test
+{
+
+/*
+ * A wrapped height field for the height field queries to run over: rolling hills with some per-texel noise, held at an offset
+ * that isn't a multiple of its dimension, so lookups wrap, with the min/max pyramid the raycasts need.
+ */
+struct TestHeightfield
+{
+    static constexpr int BlockDimension = 8; // As TerrainConstants has it.
+
+    TestHeightfield(int dimension, Vec2i validMin, float noise)
+        : heights(math::Square(dimension))
+        , bounds(dimension, BlockDimension)
+    {
+        for (int z = validMin.y; z < validMin.y + dimension; ++z)
+        {
+            for (int x = validMin.x; x < validMin.x + dimension; ++x)
+            {
+                const uint32 hash = ((uint32)x * 73856093u) ^ ((uint32)z * 19349663u);
+                const float height = 6.f * sinf(0.15f * (float)x) * cosf(0.11f * (float)z) + 2.f * sinf(0.4f * (float)(x + z))
+                    + noise * ((float)(hash % 1000u) / 1000.f - 0.5f);
+                heights[dimension * (z & (dimension - 1)) + (x & (dimension - 1))] = height;
+            }
+        }
+        bounds.Build(heights.data(), dimension);
+        view.heights = heights.data();
+        view.bounds = &bounds;
+        view.dimension = dimension;
+        view.validMin = validMin;
+    }
+
+    // Bilinear height at a texel space position, which must be within the valid cells.
+    float GetHeight(float x, float z) const
+    {
+        const Vec2i cell((int)floorf(x), (int)floorf(z));
+        const float u = x - (float)cell.x;
+        const float v = z - (float)cell.y;
+        const float h0 = view.GetHeight(cell) + u * (view.GetHeight(cell + Vec2i(1, 0)) - view.GetHeight(cell));
+        const float h1 = view.GetHeight(cell + Vec2i(0, 1)) + u * (view.GetHeight(cell + Vec2i(1, 1)) - view.GetHeight(cell + Vec2i(0, 1)));
+        return h0 + v * (h1 - h0);
+    }
+
+    std::vector<float> heights;
+    MinMaxPyramid bounds;
+    WrappedHeightfield view;
+};
+
+}
+
+}
@@ -0,0 +1,170 @@
+#include "ClipmapConfig.hpp"
+#include "TileMips.hpp"
+#include "Timer.hpp"
+#include <unordered_map>
+
+using namespace gaia;
+
+using TileCache = std::unordered_map<Vec2i, std::vector<float>>;
+
+// What a texel holds before any update: noise that depends only on where it is, so it doesn't matter which order tiles are created in.
+static float GetNoise(Vec2i tile, int level, int index)
+{
+    const uint32 hash = ((uint32)tile.x * 73856093u) ^ ((uint32)tile.y * 19349663u) ^ ((uint32)level * 83492791u) ^ ((uint32)index * 2654435761u);
+    return (float)(hash % 10000u) * 0.01f;
+}
+
+// Scratch tiles standing in for Terrain's tile caches, filled with noise as they're first touched.
+struct ScratchTiles
+{
+    explicit ScratchTiles(const ClipmapConfig& config) : config(config) {}
+
+    std::vector<float>& GetOrCreateTile(Vec2i tile, int level)
+    {
+        std::vector<float>& heights = levels[level][tile];
+        if (heights.empty())
+        {
+            heights.resize(math::Square(config.tileDimension));
+            for (int i = 0; i < (int)heights.size(); ++i)
+            {
+                heights[i] = GetNoise(tile, level, i);
+            }
+        }
+        return heights;
+    }
+
+    const ClipmapConfig& config;
+    TileCache levels[ClipmapConfig::MaxClipLevels];
+};
+
+// The reference: a texel at a time, looking up the tile for each sample.
+static void UpdateTileMipsScalar(ScratchTiles& tiles, Vec2i minGlobalCoords, Vec2i maxGlobalCoords)
+{
+    const ClipmapConfig& config = tiles.config;
+    for (int level = 1; level < config.numLevels; ++level)
+    {
+        Vec2i levelGlobalMin = minGlobalCoords >> level;
+        Vec2i levelGlobalMax = (maxGlobalCoords >> level) + Vec2i(1, 1);
+        for (int z = levelGlobalMin.y; z < levelGlobalMax.y; ++z)
+        {
+            for (int x = levelGlobalMin.x; x < levelGlobalMax.x; ++x)
+            {
+                auto dst = config.LevelGlobalCoordsToTile(Vec2i(x, z));
+                float sum = 0.f;
+                for (Vec2i offset : { Vec2i(0, 0), Vec2i(1, 0), Vec2i(0, 1), Vec2i(1, 1) })
+                {
+                    auto src = config.LevelGlobalCoordsToTile(2 * Vec2i(x, z) + offset);
+                    sum += tiles.GetOrCreateTile(src.first, level - 1)[config.TileIndex(src.second)];
+                }
+                tiles.GetOrCreateTile(dst.first, level)[config.TileIndex(dst.second)] = 0.25f * sum;
+            }
+        }
+    }
+}
+
+// As Terrain::UpdateTileMips() does it, less the bounds: tile to tile, a row span at a time.
+static void UpdateTileMipsBlocked(ScratchTiles& tiles, Vec2i minGlobalCoords, Vec2i maxGlobalCoords)
+{
+    const ClipmapConfig& config = tiles.config;
+    const int tileDimension = config.tileDimension;
+    const int halfTileDimension = tileDimension / 2;
+    for (int level = 1; level < config.numLevels; ++level)
+    {
+        Vec2i levelGlobalMin = minGlobalCoords >> level;
+        Vec2i levelGlobalMax = (maxGlobalCoords >> level) + Vec2i(1, 1);
+        Vec2i minTile = config.LevelGlobalCoordsToTile(levelGlobalMin).first;
+        Vec2i maxTile = config.LevelGlobalCoordsToTile(levelGlobalMax - Vec2i(1, 1)).first;
+        for (int tileZ = minTile.y; tileZ <= maxTile.y; ++tileZ)
+        {
+            for (int tileX = minTile.x; tileX <= maxTile.x; ++tileX)
+            {
+                Vec2i dstTile(tileX, tileZ);
+                Vec2i dstMin = math::max(config.LevelGlobalCoordsToTileCoords(levelGlobalMin, dstTile), Vec2iZero);
+                Vec2i dstMax = math::min(config.LevelGlobalCoordsToTileCoords(levelGlobalMax, dstTile), Vec2i(tileDimension, tileDimension));
+                float* dst = tiles.GetOrCreateTile(dstTile, level).data();
+                for (int z = dstMin.y; z < dstMax.y; ++z)
+                {
+                    int j = z / halfTileDimension;
+                    int srcZ = 2 * z - j * tileDimension;
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        int spanMin = std::max(dstMin.x, i * halfTileDimension);
+                        int spanMax = std::min(dstMax.x, (i + 1) * halfTileDimension);
+                        if (spanMin >= spanMax)
+                            continue;
+
+                        const float* src = tiles.GetOrCreateTile(2 * dstTile + Vec2i(i, j), level - 1).data();
+                        int srcX = 2 * spanMin - i * tileDimension;
+                        DownsampleRows(&dst[config.TileIndex(spanMin, z)], &src[config.TileIndex(srcX, srcZ)], &src[config.TileIndex(srcX, srcZ + 1)], spanMax - spanMin);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Propagating a brush edit down the mips, texel by texel and tile to tile, for a small and a large brush placed off the tile grid.
+// Also counts texels the blocked path changes outside the dirty region, which the GPU would never be sent; there should be none.
+// Level 0 is the edit itself, so it's never written here.
+int main()
+{
+    constexpr int NumRuns = 20;
+    const ClipmapConfig config;
+    for (float radius : { 3.f, 64.f })
+    {
+        const Vec2i centre(1013, -701);
+        const int radiusTexels = (int)(radius / config.texelSize);
+        const Vec2i minGlobalCoords = centre - Vec2i(radiusTexels, radiusTexels);
+        const Vec2i maxGlobalCoords = centre + Vec2i(radiusTexels, radiusTexels);
+
+        ScratchTiles scalar(config);
+        UpdateTileMipsScalar(scalar, minGlobalCoords, maxGlobalCoords);
+        ScratchTiles blocked(config);
+        UpdateTileMipsBlocked(blocked, minGlobalCoords, maxGlobalCoords);
+
+        float maxDifference = 0.f;
+        int numOutside = 0;
+        for (int level = 0; level < config.numLevels; ++level)
+        {
+            const Vec2i levelGlobalMin = level > 0 ? minGlobalCoords >> level : Vec2i(INT_MAX, INT_MAX);
+            const Vec2i levelGlobalMax = level > 0 ? (maxGlobalCoords >> level) + Vec2i(1, 1) : Vec2i(INT_MIN, INT_MIN);
+            for (const auto& tile : scalar.levels[level])
+            {
+                const std::vector<float>& blockedHeights = blocked.levels[level].at(tile.first);
+                for (int z = 0; z < config.tileDimension; ++z)
+                {
+                    for (int x = 0; x < config.tileDimension; ++x)
+                    {
+                        const int index = config.TileIndex(x, z);
+                        const Vec2i coords = config.tileDimension * tile.first + Vec2i(x, z);
+                        const bool inRegion = levelGlobalMin.x <= coords.x && coords.x < levelGlobalMax.x && levelGlobalMin.y <= coords.y && coords.y < levelGlobalMax.y;
+                        if (inRegion)
+                        {
+                            maxDifference = std::max(maxDifference, fabsf(tile.second[index] - blockedHeights[index]));
+                        }
+                        else
+                        {
+                            numOutside += blockedHeights[index] != GetNoise(tile.first, level, index);
+                        }
+                    }
+                }
+            }
+        }
+
+        Timer timer;
+        for (int run = 0; run < NumRuns; ++run)
+        {
+            UpdateTileMipsScalar(scalar, minGlobalCoords, maxGlobalCoords);
+        }
+        const float scalarMs = 1000.f * timer.GetSecondsAndReset() / (float)NumRuns;
+        for (int run = 0; run < NumRuns; ++run)
+        {
+            UpdateTileMipsBlocked(blocked, minGlobalCoords, maxGlobalCoords);
+        }
+        const float blockedMs = 1000.f * timer.GetSecondsAndReset() / (float)NumRuns;
+
+        DebugOut("Radius %.0f m: scalar %.3f ms, blocked %.3f ms (%.1fx), max difference %g, %d texels written outside the region\n",
+            radius, scalarMs, blockedMs, scalarMs / blockedMs, maxDifference, numOutside);
+    }
+    return 0;
+}